@@ -0,0 +1,180 @@
+/** @file abatchedlinalg.cpp
+ * @brief Implementation of batched small dense matrix operations
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include "abatchedlinalg.hpp"
+
+/// Number of matrices processed together by one thread
+/** Chosen so that a chunk of a few small matrices fits comfortably in L1 cache.
+ */
+#define BATCHCHUNK 256
+
+namespace tadgens {
+
+void BatchedMatrices::setZero()
+{
+	std::fill(data.begin(), data.end(), 0.0);
+}
+
+void BatchedMatrices::gather(const std::vector<Matrix>& mats, const std::vector<a_int>& ids)
+{
+	const int nb = static_cast<int>(ids.size());
+	if(nb == 0) {
+		resize(0,0,0);
+		return;
+	}
+	resize(nb, static_cast<int>(mats[ids[0]].rows()), static_cast<int>(mats[ids[0]].cols()));
+
+#pragma omp parallel for default(shared)
+	for(int k = 0; k < nbatch; k++)
+	{
+		const Matrix& m = mats[ids[k]];
+#ifdef DEBUG
+		if(m.rows() != nrows || m.cols() != ncols)
+			std::printf("! BatchedMatrices: gather: Matrix %d has the wrong size!\n", ids[k]);
+#endif
+		for(int i = 0; i < nrows; i++)
+			for(int j = 0; j < ncols; j++)
+				data[static_cast<size_t>(i*ncols + j)*nbatch + k] = m(i,j);
+	}
+}
+
+void BatchedMatrices::scatter(std::vector<Matrix>& mats, const std::vector<a_int>& ids) const
+{
+#pragma omp parallel for default(shared)
+	for(int k = 0; k < nbatch; k++)
+	{
+		Matrix& m = mats[ids[k]];
+		m.resize(nrows,ncols);
+		for(int i = 0; i < nrows; i++)
+			for(int j = 0; j < ncols; j++)
+				m(i,j) = data[static_cast<size_t>(i*ncols + j)*nbatch + k];
+	}
+}
+
+void BatchedMatrices::scatterAdd(const a_real alpha, std::vector<Matrix>& mats,
+		const std::vector<a_int>& ids) const
+{
+#pragma omp parallel for default(shared)
+	for(int k = 0; k < nbatch; k++)
+	{
+		Matrix& m = mats[ids[k]];
+		for(int i = 0; i < nrows; i++)
+			for(int j = 0; j < ncols; j++)
+				m(i,j) += alpha*data[static_cast<size_t>(i*ncols + j)*nbatch + k];
+	}
+}
+
+/// Scales or zeroes one slice of the output for the chunk [k0,k1)
+static inline void scaleSlice(const a_real beta, a_real *const c, const int k0, const int k1)
+{
+	if(beta == 0.0) {
+#pragma omp simd
+		for(int k = k0; k < k1; k++)
+			c[k] = 0.0;
+	}
+	else if(beta != 1.0) {
+#pragma omp simd
+		for(int k = k0; k < k1; k++)
+			c[k] *= beta;
+	}
+}
+
+void batchedGemm(const a_real alpha, const BatchedMatrices& A, const BatchedMatrices& B,
+                 const a_real beta, BatchedMatrices& C)
+{
+	const int nb = C.batchSize(), m = C.rows(), n = C.cols(), p = A.cols();
+#ifdef DEBUG
+	if(A.batchSize() != nb || B.batchSize() != nb || A.rows() != m || B.cols() != n || B.rows() != p)
+		std::printf("! batchedGemm: Incompatible sizes!\n");
+#endif
+
+#pragma omp parallel for default(shared)
+	for(int k0 = 0; k0 < nb; k0 += BATCHCHUNK)
+	{
+		const int k1 = std::min(k0+BATCHCHUNK, nb);
+		for(int i = 0; i < m; i++)
+			for(int j = 0; j < n; j++)
+			{
+				a_real *const c = C.slice(i,j);
+				scaleSlice(beta, c, k0, k1);
+				for(int l = 0; l < p; l++)
+				{
+					const a_real *const a = A.slice(i,l);
+					const a_real *const b = B.slice(l,j);
+#pragma omp simd
+					for(int k = k0; k < k1; k++)
+						c[k] += alpha*a[k]*b[k];
+				}
+			}
+	}
+}
+
+void batchedGemmSharedRight(const a_real alpha, const BatchedMatrices& A, const Matrix& B,
+                            const a_real beta, BatchedMatrices& C)
+{
+	const int nb = C.batchSize(), m = C.rows(), n = C.cols(), p = A.cols();
+#ifdef DEBUG
+	if(A.batchSize() != nb || A.rows() != m || B.cols() != n || B.rows() != p)
+		std::printf("! batchedGemmSharedRight: Incompatible sizes!\n");
+#endif
+
+#pragma omp parallel for default(shared)
+	for(int k0 = 0; k0 < nb; k0 += BATCHCHUNK)
+	{
+		const int k1 = std::min(k0+BATCHCHUNK, nb);
+		for(int i = 0; i < m; i++)
+			for(int j = 0; j < n; j++)
+			{
+				a_real *const c = C.slice(i,j);
+				scaleSlice(beta, c, k0, k1);
+				for(int l = 0; l < p; l++)
+				{
+					const a_real *const a = A.slice(i,l);
+					const a_real ab = alpha*B(l,j);
+					if(ab == 0.0)
+						continue;
+#pragma omp simd
+					for(int k = k0; k < k1; k++)
+						c[k] += ab*a[k];
+				}
+			}
+	}
+}
+
+void batchedGemmSharedLeft(const a_real alpha, const Matrix& A, const BatchedMatrices& B,
+                           const a_real beta, BatchedMatrices& C)
+{
+	const int nb = C.batchSize(), m = C.rows(), n = C.cols(), p = B.rows();
+#ifdef DEBUG
+	if(B.batchSize() != nb || A.rows() != m || B.cols() != n || A.cols() != p)
+		std::printf("! batchedGemmSharedLeft: Incompatible sizes!\n");
+#endif
+
+#pragma omp parallel for default(shared)
+	for(int k0 = 0; k0 < nb; k0 += BATCHCHUNK)
+	{
+		const int k1 = std::min(k0+BATCHCHUNK, nb);
+		for(int i = 0; i < m; i++)
+			for(int j = 0; j < n; j++)
+			{
+				a_real *const c = C.slice(i,j);
+				scaleSlice(beta, c, k0, k1);
+				for(int l = 0; l < p; l++)
+				{
+					const a_real ab = alpha*A(i,l);
+					if(ab == 0.0)
+						continue;
+					const a_real *const b = B.slice(l,j);
+#pragma omp simd
+					for(int k = k0; k < k1; k++)
+						c[k] += ab*b[k];
+				}
+			}
+	}
+}
+
+}
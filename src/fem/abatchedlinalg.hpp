@@ -0,0 +1,91 @@
+/** @file abatchedlinalg.hpp
+ * @brief Batched small dense matrix operations across elements
+ * @author Aditya Kashi
+ */
+
+#ifndef ABATCHEDLINALG_H
+#define ABATCHEDLINALG_H
+
+#include <vector>
+#include "aconstants.hpp"
+
+namespace tadgens {
+
+/// A batch of small dense matrices of the same size, stored interleaved across the batch
+/** Entry (i,j) of matrix k is stored at data[(i*ncols + j)*nbatch + k], so that the same entry of
+ * all matrices in the batch is contiguous. Operations on the batch then loop over the batch index
+ * innermost, which vectorizes regardless of how small the matrices are.
+ *
+ * Typically, one batch holds one matrix per element of an [element block](@ref ElementBlock).
+ */
+class BatchedMatrices
+{
+protected:
+	int nbatch;                             ///< Number of matrices
+	int nrows;                              ///< Number of rows of each matrix
+	int ncols;                              ///< Number of columns of each matrix
+	std::vector<a_real> data;               ///< Interleaved storage
+
+public:
+	BatchedMatrices() : nbatch{0}, nrows{0}, ncols{0} { }
+
+	/// Sets the sizes; existing entries are not preserved
+	void resize(const int nb, const int nr, const int nc) {
+		nbatch = nb; nrows = nr; ncols = nc;
+		data.resize(static_cast<size_t>(nb)*nr*nc);
+	}
+
+	int batchSize() const { return nbatch; }
+	int rows() const { return nrows; }
+	int cols() const { return ncols; }
+
+	/// Entry (i,j) of every matrix in the batch, contiguously
+	a_real* slice(const int i, const int j) {
+		return &data[static_cast<size_t>(i*ncols + j)*nbatch];
+	}
+
+	const a_real* slice(const int i, const int j) const {
+		return &data[static_cast<size_t>(i*ncols + j)*nbatch];
+	}
+
+	/// Entry (i,j) of matrix k
+	a_real& operator()(const int k, const int i, const int j) {
+		return data[static_cast<size_t>(i*ncols + j)*nbatch + k];
+	}
+
+	a_real operator()(const int k, const int i, const int j) const {
+		return data[static_cast<size_t>(i*ncols + j)*nbatch + k];
+	}
+
+	void setZero();
+
+	/// Copies the matrices mats[ids[k]] into the batch, resizing it as needed
+	/** All the matrices must have the same size.
+	 */
+	void gather(const std::vector<Matrix>& mats, const std::vector<a_int>& ids);
+
+	/// Copies matrix k of the batch into mats[ids[k]], resizing it if needed
+	void scatter(std::vector<Matrix>& mats, const std::vector<a_int>& ids) const;
+
+	/// Adds alpha times matrix k of the batch to mats[ids[k]] for each k
+	void scatterAdd(const a_real alpha, std::vector<Matrix>& mats, const std::vector<a_int>& ids) const;
+};
+
+/// Computes \f$ C_k = \alpha A_k B_k + \beta C_k \f$ for each k
+/** C must be allocated. If beta is zero, C need not be initialized.
+ */
+void batchedGemm(const a_real alpha, const BatchedMatrices& A, const BatchedMatrices& B,
+                 const a_real beta, BatchedMatrices& C);
+
+/// Computes \f$ C_k = \alpha A_k B + \beta C_k \f$ for each k, with B common to the batch
+/** Useful for multiplying by tables of reference basis functions, for instance.
+ */
+void batchedGemmSharedRight(const a_real alpha, const BatchedMatrices& A, const Matrix& B,
+                            const a_real beta, BatchedMatrices& C);
+
+/// Computes \f$ C_k = \alpha A B_k + \beta C_k \f$ for each k, with A common to the batch
+void batchedGemmSharedLeft(const a_real alpha, const Matrix& A, const BatchedMatrices& B,
+                           const a_real beta, BatchedMatrices& C);
+
+}
+#endif
@@ -0,0 +1,434 @@
+/** @file abernstein.cpp
+ * @brief Implementation of Bernstein-Bezier elements and their sum-factorization kernels
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cmath>
+#include "abernstein.hpp"
+
+namespace tadgens {
+
+/// Number of Bernstein polynomials of degree q on a shape
+static inline int numBernstein(const Shape shape, const int q) {
+	return shape == QUADRANGLE ? (q+1)*(q+1) : (q+1)*(q+2)/2;
+}
+
+/// Index of the triangle DOF (alpha1, alpha2) of degree q
+static inline int triIndex(const int q, const int a1, const int a2) {
+	return a1*(q+1) - a1*(a1-1)/2 + a2;
+}
+
+/// Values of the 1D Bernstein polynomials of degree 0 to q at t
+/** \param[in|out] b Pre-allocated; on output, b[m*(m+1)/2 + i] is \f$ B^m_i(t) \f$
+ */
+static void getBernstein1DAll(const int q, const a_real t, a_real *const b)
+{
+	b[0] = 1.0;
+	for(int m = 1; m <= q; m++)
+	{
+		const a_real *const prev = b + (m-1)*m/2;
+		a_real *const cur = b + m*(m+1)/2;
+		cur[0] = (1-t)*prev[0];
+		for(int i = 1; i < m; i++)
+			cur[i] = (1-t)*prev[i] + t*prev[i-1];
+		cur[m] = t*prev[m-1];
+	}
+}
+
+/// Values of the Bernstein polynomials of degree q on the triangle at barycentric coordinates l
+/** \param[in] fact Factorials upto q
+ * \param[in|out] b Pre-allocated values in the DOF ordering of degree q
+ */
+static void getBernsteinTriangle(const int q, const a_real *const l, const a_real *const fact,
+                                 a_real *const b)
+{
+	for(int a1 = 0; a1 <= q; a1++)
+		for(int a2 = 0; a2 <= q-a1; a2++)
+		{
+			const int a3 = q-a1-a2;
+			a_real v = fact[q]/(fact[a1]*fact[a2]*fact[a3]);
+			for(int k = 0; k < a1; k++) v *= l[0];
+			for(int k = 0; k < a2; k++) v *= l[1];
+			for(int k = 0; k < a3; k++) v *= l[2];
+			b[triIndex(q,a1,a2)] = v;
+		}
+}
+
+/// Computes Bernstein basis values and, if basisG is not null, reference gradients at given points
+static void getBernsteinBasisAndGrads(const Matrix& __restrict__ gp, const Shape shape, const int p,
+                                      Matrix& __restrict__ basisv,
+                                      std::vector<Matrix> *const __restrict__ basisG)
+{
+	if(shape == TRIANGLE)
+	{
+		std::vector<a_real> fact(p+1, 1.0), bp(numBernstein(shape,p)), bq(p > 0 ? numBernstein(shape,p-1) : 1);
+		for(int i = 1; i <= p; i++)
+			fact[i] = fact[i-1]*i;
+
+		for(int ip = 0; ip < gp.rows(); ip++)
+		{
+			const a_real l[] = {1-gp(ip,0)-gp(ip,1), gp(ip,0), gp(ip,1)};
+			getBernsteinTriangle(p, l, &fact[0], &bp[0]);
+			for(int i = 0; i < numBernstein(shape,p); i++)
+				basisv(ip,i) = bp[i];
+			if(!basisG)
+				continue;
+			if(p == 0) {
+				(*basisG)[ip].setZero();
+				continue;
+			}
+
+			// d/dxi = p (B^{p-1}_{alpha-e2} - B^{p-1}_{alpha-e1}), and similarly for eta with e3
+			getBernsteinTriangle(p-1, l, &fact[0], &bq[0]);
+			for(int a1 = 0; a1 <= p; a1++)
+				for(int a2 = 0; a2 <= p-a1; a2++)
+				{
+					const int a3 = p-a1-a2, i = triIndex(p,a1,a2);
+					const a_real d1 = a1 > 0 ? bq[triIndex(p-1,a1-1,a2)] : 0;
+					const a_real d2 = a2 > 0 ? bq[triIndex(p-1,a1,a2-1)] : 0;
+					const a_real d3 = a3 > 0 ? bq[triIndex(p-1,a1,a2)] : 0;
+					(*basisG)[ip](i,0) = p*(d2-d1);
+					(*basisG)[ip](i,1) = p*(d3-d1);
+				}
+		}
+	}
+	else
+	{
+		const int n1 = (p+1)*(p+2)/2;
+		std::vector<a_real> bs(n1), br(n1);
+		const int offp = p*(p+1)/2, offq = (p-1)*p/2;
+		for(int ip = 0; ip < gp.rows(); ip++)
+		{
+			getBernstein1DAll(p, 0.5*(1+gp(ip,0)), &bs[0]);
+			getBernstein1DAll(p, 0.5*(1+gp(ip,1)), &br[0]);
+			for(int i = 0; i <= p; i++)
+				for(int j = 0; j <= p; j++)
+				{
+					basisv(ip,i*(p+1)+j) = bs[offp+i]*br[offp+j];
+					if(!basisG)
+						continue;
+					if(p == 0) {
+						(*basisG)[ip](0,0) = (*basisG)[ip](0,1) = 0;
+						continue;
+					}
+					// the factor 1/2 is ds/dxi
+					const a_real ds = 0.5*p*((i > 0 ? bs[offq+i-1] : 0) - (i < p ? bs[offq+i] : 0));
+					const a_real dr = 0.5*p*((j > 0 ? br[offq+j-1] : 0) - (j < p ? br[offq+j] : 0));
+					(*basisG)[ip](i*(p+1)+j,0) = ds*br[offp+j];
+					(*basisG)[ip](i*(p+1)+j,1) = bs[offp+i]*dr;
+				}
+		}
+	}
+}
+
+bool computeBernsteinTables(const Quadrature2D *const quad, const int degree, BernsteinTables& tab)
+{
+	const int n1 = quad->tensorPoints(0), n2 = quad->tensorPoints(1);
+	if(n1 == 0 || n2 == 0)
+		return false;
+	tab.shape = quad->getShape();
+	tab.degree = degree;
+	tab.npoin[0] = n1; tab.npoin[1] = n2;
+
+	// recover the 1D coordinates from the points of the first row and column
+	const Matrix& gp = quad->points();
+	std::vector<a_real> t[NDIM];
+	t[0].resize(n1); t[1].resize(n2);
+	for(int a = 0; a < n1; a++)
+		t[0][a] = tab.shape == QUADRANGLE ? 0.5*(1+gp(a*n2,0)) : 1-gp(a*n2,0)-gp(a*n2,1);
+	for(int b = 0; b < n2; b++)
+		t[1][b] = tab.shape == QUADRANGLE ? 0.5*(1+gp(b,1)) : gp(b,0)/(gp(b,0)+gp(b,1));
+
+	std::vector<a_real> b1d((degree+1)*(degree+2)/2);
+	for(int dir = 0; dir < NDIM; dir++)
+	{
+		tab.vals[dir].resize(degree+1);
+		for(int m = 0; m <= degree; m++)
+			tab.vals[dir][m].resize(tab.npoin[dir], m+1);
+		for(int a = 0; a < tab.npoin[dir]; a++) {
+			getBernstein1DAll(degree, t[dir][a], &b1d[0]);
+			for(int m = 0; m <= degree; m++)
+				for(int i = 0; i <= m; i++)
+					tab.vals[dir][m](a,i) = b1d[m*(m+1)/2 + i];
+		}
+	}
+	return true;
+}
+
+void computeBernsteinReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                       BasisSet& bset)
+{
+	const int ngauss = quad->numGauss(), ndof = numBernstein(quad->getShape(), degree);
+	bset.deg.assign(1, degree);
+	bset.basis.resize(1);
+	bset.basisGrad.resize(1);
+	bset.basis[0].resize(ngauss,ndof);
+	bset.basisGrad[0].resize(ngauss);
+	for(int i = 0; i < ngauss; i++)
+		bset.basisGrad[0][i].resize(ndof,NDIM);
+	getBernsteinBasisAndGrads(quad->points(), quad->getShape(), degree, bset.basis[0],
+	                          &bset.basisGrad[0]);
+}
+
+void elevateBernsteinDegree(const Shape shape, const int p, const Matrix& dofs, Matrix& elevated)
+{
+	const int nvars = static_cast<int>(dofs.rows());
+	elevated.resize(nvars, numBernstein(shape,p+1));
+	const a_real r = 1.0/(p+1);
+
+	if(shape == TRIANGLE)
+	{
+		// c'_beta = sum_k beta_k/(p+1) c_{beta-e_k}
+		for(int ivar = 0; ivar < nvars; ivar++)
+			for(int b1 = 0; b1 <= p+1; b1++)
+				for(int b2 = 0; b2 <= p+1-b1; b2++)
+				{
+					const int b3 = p+1-b1-b2;
+					a_real c = 0;
+					if(b1 > 0) c += b1*dofs(ivar,triIndex(p,b1-1,b2));
+					if(b2 > 0) c += b2*dofs(ivar,triIndex(p,b1,b2-1));
+					if(b3 > 0) c += b3*dofs(ivar,triIndex(p,b1,b2));
+					elevated(ivar,triIndex(p+1,b1,b2)) = r*c;
+				}
+	}
+	else
+	{
+		// elevate along the second direction, then along the first
+		Matrix half(p+1, p+2);
+		for(int ivar = 0; ivar < nvars; ivar++)
+		{
+			for(int i = 0; i <= p; i++)
+				for(int j = 0; j <= p+1; j++)
+					half(i,j) = (j > 0 ? j*r*dofs(ivar,i*(p+1)+j-1) : 0)
+						+ (j <= p ? (p+1-j)*r*dofs(ivar,i*(p+1)+j) : 0);
+			for(int i = 0; i <= p+1; i++)
+				for(int j = 0; j <= p+1; j++)
+					elevated(ivar,i*(p+2)+j) = (i > 0 ? i*r*half(i-1,j) : 0)
+						+ (i <= p ? (p+1-i)*r*half(i,j) : 0);
+		}
+	}
+}
+
+/// Sum-factorized integration of one variable against all Bernstein polynomials of given degrees
+/** On triangles, only q1 is used. On quads, the degrees along the two directions are q1 and q2.
+ * \param[in] g Values at quadrature points, with stride ldg between consecutive points
+ * \param[in|out] mu The moments in the DOF ordering of the degree(s), overwritten
+ */
+static void computeMoments(const BernsteinTables& tab, const int q1, const int q2,
+                           const a_real *const g, const int ldg, a_real *const mu)
+{
+	const int n1 = tab.npoin[0], n2 = tab.npoin[1];
+	Matrix G = Matrix::Zero(q1+1, n2);
+
+	// contract along the first direction
+	const Matrix& b1 = tab.vals[0][q1];
+	for(int a = 0; a < n1; a++)
+		for(int i = 0; i <= q1; i++) {
+			const a_real ba = b1(a,i);
+			for(int b = 0; b < n2; b++)
+				G(i,b) += ba*g[(a*n2+b)*ldg];
+		}
+
+	// then along the second, where the degree depends on the first index on triangles
+	for(int i = 0; i <= q1; i++)
+	{
+		const int m = tab.shape == TRIANGLE ? q1-i : q2;
+		const int start = tab.shape == TRIANGLE ? triIndex(q1,i,0) : i*(q2+1);
+		const Matrix& b2 = tab.vals[1][m];
+		for(int j = 0; j <= m; j++) {
+			a_real sum = 0;
+			for(int b = 0; b < n2; b++)
+				sum += b2(b,j)*G(i,b);
+			mu[start+j] = sum;
+		}
+	}
+}
+
+void BernsteinElement::initialize(int degr, GeomMapping2D* geommap)
+{
+	type = REFERENTIAL;
+	degree = degr;
+	geommap->computeForReferenceElement();
+	gmap = const_cast<const GeomMapping2D*>(geommap);
+	ndof = numBernstein(gmap->getShape(), degree);
+
+	const Matrix& gp = gmap->getQuadrature()->points();
+	const int ngauss = gmap->getQuadrature()->numGauss();
+	if(tables && (tables->shape != gmap->getShape() || tables->degree != degree
+	              || tables->npoin[0]*tables->npoin[1] != ngauss))
+	{
+		std::printf("! BernsteinElement: initialize: Tables do not match the element!\n");
+		tables = nullptr;
+	}
+
+	basisGrad.resize(ngauss);
+	for(int i = 0; i < ngauss; i++)
+		basisGrad[i].resize(ndof,NDIM);
+	if(bset) {
+		basis = bset->basis[0];
+		for(int ip = 0; ip < ngauss; ip++)
+			basisGrad[ip] = bset->basisGrad[0][ip];
+	}
+	else {
+		basis.resize(ngauss,ndof);
+		getBernsteinBasisAndGrads(gp, gmap->getShape(), degree, basis, &basisGrad);
+	}
+
+	for(int ip = 0; ip < ngauss; ip++)
+		basisGrad[ip] = (basisGrad[ip]*gmap->jacInv(ip)).eval();
+}
+
+size_t BernsteinElement::releasePhysicalGradients()
+{
+	if(!bset)
+		return 0;
+	const size_t nbytes = basisGrad.size() > 0 ?
+		basisGrad.size()*basisGrad[0].size()*sizeof(a_real) : 0;
+	basisGrad.clear();
+	basisGrad.shrink_to_fit();
+	return nbytes;
+}
+
+void BernsteinElement::computeBasis(const Matrix& __restrict__ gp, Matrix& __restrict__ basisv) const
+{
+	getBernsteinBasisAndGrads(gp, gmap->getShape(), degree, basisv, nullptr);
+}
+
+void BernsteinElement::computeBasisGrads(const Matrix& __restrict__ gp,
+                                         const std::vector<MatrixDim>& __restrict__ jinv,
+                                         std::vector<Matrix>& __restrict__ basisG) const
+{
+	Matrix basisv(gp.rows(), ndof);
+	getBernsteinBasisAndGrads(gp, gmap->getShape(), degree, basisv, &basisG);
+	for(int ip = 0; ip < gp.rows(); ip++)
+		basisG[ip] = (basisG[ip]*jinv[ip]).eval();
+}
+
+Matrix BernsteinElement::getDomainPoints() const
+{
+	Matrix refs(ndof,NDIM);
+	const int p = degree > 0 ? degree : 1;
+	if(gmap->getShape() == TRIANGLE)
+		for(int a1 = 0; a1 <= degree; a1++)
+			for(int a2 = 0; a2 <= degree-a1; a2++) {
+				refs(triIndex(degree,a1,a2),0) = static_cast<a_real>(a2)/p;
+				refs(triIndex(degree,a1,a2),1) = static_cast<a_real>(degree-a1-a2)/p;
+			}
+	else
+		for(int i = 0; i <= degree; i++)
+			for(int j = 0; j <= degree; j++) {
+				refs(i*(degree+1)+j,0) = -1.0 + 2.0*i/p;
+				refs(i*(degree+1)+j,1) = -1.0 + 2.0*j/p;
+			}
+	return refs;
+}
+
+int BernsteinElement::vertexDOF(const int ivert) const
+{
+	const int p = degree;
+	if(gmap->getShape() == TRIANGLE) {
+		const int verts[] = {triIndex(p,p,0), p, 0};
+		return verts[ivert];
+	}
+	const int verts[] = {0, p*(p+1), (p+1)*(p+1)-1, p};
+	return verts[ivert];
+}
+
+void BernsteinElement::evaluate(const Matrix& __restrict__ dofs, Matrix& __restrict__ values) const
+{
+	const int n1 = tables->npoin[0], n2 = tables->npoin[1];
+	const int p = degree;
+	const bool tri = tables->shape == TRIANGLE;
+	Matrix W(p+1, n2);
+
+	for(int ivar = 0; ivar < dofs.rows(); ivar++)
+	{
+		// contract along the second direction, then the first
+		for(int i = 0; i <= p; i++)
+		{
+			const int m = tri ? p-i : p;
+			const int start = tri ? triIndex(p,i,0) : i*(p+1);
+			const Matrix& b2 = tables->vals[1][m];
+			for(int b = 0; b < n2; b++) {
+				a_real sum = 0;
+				for(int j = 0; j <= m; j++)
+					sum += b2(b,j)*dofs(ivar,start+j);
+				W(i,b) = sum;
+			}
+		}
+
+		const Matrix& b1 = tables->vals[0][p];
+		for(int a = 0; a < n1; a++)
+			for(int b = 0; b < n2; b++) {
+				a_real sum = 0;
+				for(int i = 0; i <= p; i++)
+					sum += b1(a,i)*W(i,b);
+				values(a*n2+b,ivar) = sum;
+			}
+	}
+}
+
+void BernsteinElement::addMoments(const Matrix& __restrict__ g, Matrix& __restrict__ res) const
+{
+	std::vector<a_real> mu(ndof);
+	for(int ivar = 0; ivar < g.cols(); ivar++) {
+		computeMoments(*tables, degree, degree, &g(0,ivar), static_cast<int>(g.cols()), &mu[0]);
+		for(int i = 0; i < ndof; i++)
+			res(ivar,i) += mu[i];
+	}
+}
+
+void BernsteinElement::addGradientMoments(const Matrix& __restrict__ gx, const Matrix& __restrict__ gy,
+                                          Matrix& __restrict__ res) const
+{
+	const int p = degree;
+	if(p == 0)
+		return;
+	const int ldg = static_cast<int>(gx.cols());
+
+	if(tables->shape == TRIANGLE)
+	{
+		const int nq = numBernstein(TRIANGLE, p-1);
+		std::vector<a_real> mx(nq), my(nq), ms(nq);
+		Matrix gs = gx + gy;
+		for(int ivar = 0; ivar < gx.cols(); ivar++)
+		{
+			computeMoments(*tables, p-1, p-1, &gx(0,ivar), ldg, &mx[0]);
+			computeMoments(*tables, p-1, p-1, &gy(0,ivar), ldg, &my[0]);
+			computeMoments(*tables, p-1, p-1, &gs(0,ivar), ldg, &ms[0]);
+			for(int a1 = 0; a1 <= p; a1++)
+				for(int a2 = 0; a2 <= p-a1; a2++)
+				{
+					const int a3 = p-a1-a2;
+					a_real v = 0;
+					if(a2 > 0) v += mx[triIndex(p-1,a1,a2-1)];
+					if(a3 > 0) v += my[triIndex(p-1,a1,a2)];
+					if(a1 > 0) v -= ms[triIndex(p-1,a1-1,a2)];
+					res(ivar,triIndex(p,a1,a2)) += p*v;
+				}
+		}
+	}
+	else
+	{
+		// the derivative along xi lowers the degree in the first direction only, and vice versa
+		std::vector<a_real> mx(p*(p+1)), my(p*(p+1));
+		for(int ivar = 0; ivar < gx.cols(); ivar++)
+		{
+			computeMoments(*tables, p-1, p, &gx(0,ivar), ldg, &mx[0]);
+			computeMoments(*tables, p, p-1, &gy(0,ivar), ldg, &my[0]);
+			for(int i = 0; i <= p; i++)
+				for(int j = 0; j <= p; j++)
+				{
+					a_real v = 0;
+					if(i > 0) v += mx[(i-1)*(p+1)+j];
+					if(i < p) v -= mx[i*(p+1)+j];
+					if(j > 0) v += my[i*p+j-1];
+					if(j < p) v -= my[i*p+j];
+					res(ivar,i*(p+1)+j) += 0.5*p*v;
+				}
+		}
+	}
+}
+
+}
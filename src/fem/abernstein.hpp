@@ -0,0 +1,132 @@
+/** @file abernstein.hpp
+ * @brief Bernstein-Bezier finite elements and sum-factorization kernels for them
+ * @author Aditya Kashi
+ */
+
+#ifndef ABERNSTEIN_H
+#define ABERNSTEIN_H
+
+#include "aelements.hpp"
+
+namespace tadgens {
+
+/// Values of 1D Bernstein polynomials of all degrees upto some p at the 1D points of a
+/// tensor-product or collapsed quadrature rule
+/** On quads, the 1D coordinates are \f$ s = (1+\xi)/2 \f$ and \f$ r = (1+\eta)/2 \f$. On triangles,
+ * they are the collapsed coordinates \f$ t_1, t_2 \f$ of \ref Quadrature2DTriangleCollapsed.
+ * These tables depend only on the shape, the degree and the quadrature rule, so they can be shared
+ * by all Bernstein elements using that rule.
+ */
+struct BernsteinTables
+{
+	Shape shape;
+	int degree;
+	int npoin[NDIM];                    ///< Number of quadrature points along each direction
+	/// Entry (a,i) of vals[dir][m] is the value of \f$ B^m_i \f$ at the a-th point along direction dir
+	std::vector<Matrix> vals[NDIM];
+};
+
+/// Computes the 1D tables for a quadrature rule
+/** \return False if the rule does not have the required [tensor structure](@ref
+ *   Quadrature2D::tensorPoints); then the tables cannot be used.
+ */
+bool computeBernsteinTables(const Quadrature2D *const quad, const int degree, BernsteinTables& tab);
+
+/// Computes Bernstein basis function values and reference-space gradients at the points of
+/// a quadrature rule, as the only entry of a BasisSet
+void computeBernsteinReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                       BasisSet& bset);
+
+/// Computes the coefficients w.r.t. the Bernstein basis of degree p+1 of a polynomial of degree p
+/** This is done in O(p^2) operations per variable, for triangles and quads.
+ * \param[in] dofs Coefficients of degree p, one row per physical variable
+ * \param[in|out] elevated Coefficients of degree p+1 in the same layout, resized as needed
+ */
+void elevateBernsteinDegree(const Shape shape, const int degree, const Matrix& dofs,
+                            Matrix& elevated);
+
+/// Bernstein-Bezier finite element on triangles and quadrilaterals
+/** On triangles, the basis functions are
+ * \f[ B^p_\alpha = \frac{p!}{\alpha_1!\alpha_2!\alpha_3!} \lambda_1^{\alpha_1}
+ *   \lambda_2^{\alpha_2} \lambda_3^{\alpha_3}, \quad |\alpha| = p, \f]
+ * where \f$ \lambda_1 = 1-\xi-\eta, \lambda_2 = \xi, \lambda_3 = \eta \f$ are the barycentric
+ * coordinates. The DOF of \f$ \alpha \f$ has index \f$ \alpha_1(p+1) - \alpha_1(\alpha_1-1)/2
+ * + \alpha_2 \f$. On quads, they are tensor products \f$ B^p_i(s)B^p_j(r) \f$ of 1D Bernstein
+ * polynomials and the DOF with index i(p+1)+j belongs to (i,j).
+ *
+ * The basis is not nodal; only the coefficients of vertices are values of the function there
+ * (see \ref vertexDOF). Values and gradients at quadrature points are available as for other
+ * elements. In addition, if [tables](@ref setTables) for a tensor-product or collapsed quadrature rule
+ * are given, evaluation at the quadrature points and integration against all basis functions and
+ * their gradients are done by sum factorization in \f$ O(p^3) \f$ operations, following
+ * Ainsworth, Andriamaro and Davydov, "Bernstein-Bezier finite elements of arbitrary order and
+ * optimal assembly procedures", SIAM J. Sci. Comput. 33 (2011), instead of the \f$ O(p^4) \f$
+ * products with the dense basis tables. The spatial discretizations use this only for the
+ * volume terms of the residual: the state is evaluated at the quadrature points, and the flux
+ * and source are integrated against the basis gradients and functions. The dense basis and
+ * gradient tables are still computed and stored as for other elements, and are used elsewhere,
+ * such as in the Jacobians. The mass matrix is inverted densely like that of any other element.
+ */
+class BernsteinElement : public Element
+{
+	const BernsteinTables* tables;      ///< 1D tables for sum factorization, if available
+
+public:
+	BernsteinElement() : tables{nullptr} {
+		type = REFERENTIAL;
+	}
+
+	/// Sets 1D tables for the quadrature rule of the element, to enable sum factorization
+	/** Must be called before [initialization](@ref initialize) to have any effect.
+	 */
+	void setTables(const BernsteinTables *const tab) {
+		tables = tab;
+	}
+
+	/// Sets data and computes basis functions and their gradients
+	void initialize(int degr, GeomMapping2D* geommap);
+
+	/// Whether sum-factorized evaluation and integration are available
+	bool hasTables() const {
+		return tables != nullptr;
+	}
+
+	/// Computes values of basis functions at given points in reference space
+	void computeBasis(const Matrix& points, Matrix& basisvalues) const;
+
+	/// Computes basis functions' gradients at given points in reference space
+	void computeBasisGrads(const Matrix& points, const std::vector<MatrixDim>& jinv,
+	                       std::vector<Matrix>& basisgrads) const;
+
+	/// Reference coordinates of the domain points (control points) of the basis functions
+	Matrix getDomainPoints() const;
+
+	/// Index of the DOF which is the value at a vertex
+	int vertexDOF(const int ivert) const;
+
+	/// Values of a function at the quadrature points by sum factorization
+	/** \param[in] dofs Coefficients, one row per physical variable (nvars x ndofs)
+	 * \param[in|out] values Pre-allocated values at quadrature points (ngauss x nvars)
+	 */
+	void evaluate(const Matrix& dofs, Matrix& values) const;
+
+	/// Adds to res(v,i) the sum over quadrature points of g(ig,v) times basis function i
+	/** Any weights and Jacobian determinants must be included in g.
+	 * \param[in] g Values at quadrature points (ngauss x nvars)
+	 * \param[in|out] res Pre-allocated (nvars x ndofs)
+	 */
+	void addMoments(const Matrix& g, Matrix& res) const;
+
+	/// Adds to res(v,i) the sum over quadrature points of (gx(ig,v), gy(ig,v)) dotted with the
+	/// reference gradient of basis function i
+	/** Physical fluxes should be transformed to reference space by the inverse Jacobian.
+	 * Uses that the derivatives of Bernstein polynomials of degree p are differences of
+	 * Bernstein polynomials of degree p-1.
+	 */
+	void addGradientMoments(const Matrix& gx, const Matrix& gy, Matrix& res) const;
+
+	size_t releasePhysicalGradients();
+};
+
+}
+#endif
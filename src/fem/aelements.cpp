@@ -5,18 +5,60 @@
  */
 
 #include <iostream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
 #include "aelements.hpp"
 
 namespace tadgens {
 
 using namespace amat;
 
+/// Reference coordinates of the nodes of cubic Lagrange elements along an edge
+static const a_real cubicnodes1d[4] = {-1.0, -1.0/3, 1.0/3, 1.0};
+
+/// Values and derivatives of the 1D cubic Lagrange polynomials through \ref cubicnodes1d at x
+static void getCubicLagrange1D(const a_real x, a_real *const vals, a_real *const ders)
+{
+	for(int i = 0; i < 4; i++)
+	{
+		vals[i] = 1.0; ders[i] = 0.0;
+		for(int k = 0; k < 4; k++)
+		{
+			if(k == i) continue;
+			const a_real denom = cubicnodes1d[i]-cubicnodes1d[k];
+			ders[i] = ders[i]*(x-cubicnodes1d[k])/denom + vals[i]/denom;
+			vals[i] *= (x-cubicnodes1d[k])/denom;
+		}
+	}
+}
+
+/// Positions in \ref cubicnodes1d of the coordinates of the nodes of the cubic Lagrange quad
+/** Vertices, then 2 nodes on each edge in the direction of the edge, then the interior nodes
+ * counter-clockwise; the same order as \ref getLagrangeReferenceNodes.
+ */
+static const int cubicquadnodes[16][NDIM] = {{0,0}, {3,0}, {3,3}, {0,3},
+	{1,0}, {2,0}, {3,1}, {3,2}, {2,3}, {1,3}, {0,2}, {0,1},
+	{1,1}, {2,1}, {2,2}, {1,2}};
+
+/// Barycentric coordinates of the vertices that bound each edge of the cubic Lagrange triangle
+/** The nodes on edge e are 3+2e, near its first vertex, and 4+2e, near its second.
+ */
+static const int cubictriedges[3][2] = {{0,1}, {1,2}, {2,0}};
+
 /** Computes Lagrange basis function values at given points in the reference element.
  * \note NOTE: For efficiency, we would want to able to request computation of only certain basis functions.
  */
 void getLagrangeBasis(const Matrix& __restrict__ gp, const Shape shape, const int degree,
                       Matrix& __restrict__ basisv)
 {
+	if(degree == 0) {
+		for(int ip = 0; ip < gp.rows(); ip++)
+			basisv(ip,0) = 1.0;
+		return;
+	}
+
 	if(shape == TRIANGLE) {
 		if(degree == 1) {
 			for(int ip = 0; ip < gp.rows(); ip++)
@@ -37,6 +79,20 @@ void getLagrangeBasis(const Matrix& __restrict__ gp, const Shape shape, const in
 				basisv(ip,5) = 4.0*(gp(ip,1) - gp(ip,1)*gp(ip,1) - gp(ip,0)*gp(ip,1));
 			}
 		}
+		if(degree == 3) {
+			for(int ip = 0; ip < gp.rows(); ip++)
+			{
+				const a_real L[3] = {1.0-gp(ip,0)-gp(ip,1), gp(ip,0), gp(ip,1)};
+				for(int i = 0; i < 3; i++)
+					basisv(ip,i) = 0.5*L[i]*(3*L[i]-1)*(3*L[i]-2);
+				for(int e = 0; e < 3; e++) {
+					const a_real la = L[cubictriedges[e][0]], lb = L[cubictriedges[e][1]];
+					basisv(ip,3+2*e) = 4.5*la*lb*(3*la-1);
+					basisv(ip,4+2*e) = 4.5*la*lb*(3*lb-1);
+				}
+				basisv(ip,9) = 27.0*L[0]*L[1]*L[2];
+			}
+		}
 	}
 	else {
 		if(degree == 1) {
@@ -62,6 +118,16 @@ void getLagrangeBasis(const Matrix& __restrict__ gp, const Shape shape, const in
 				basisv(ip,8) = (1-gp(ip,0)*gp(ip,0))        * (1-gp(ip,1)*gp(ip,1));
 			}
 		}
+		if(degree == 3) {
+			for(int ip = 0; ip < gp.rows(); ip++)
+			{
+				a_real lx[4], ly[4], dlx[4], dly[4];
+				getCubicLagrange1D(gp(ip,0), lx, dlx);
+				getCubicLagrange1D(gp(ip,1), ly, dly);
+				for(int i = 0; i < 16; i++)
+					basisv(ip,i) = lx[cubicquadnodes[i][0]]*ly[cubicquadnodes[i][1]];
+			}
+		}
 	}
 }
 
@@ -73,6 +139,13 @@ void getLagrangeBasis(const Matrix& __restrict__ gp, const Shape shape, const in
 void getLagrangeBasisGrads(const Matrix& __restrict__ gp, const Shape shape, const int degree,
                            std::vector<Matrix>& __restrict__ basisG)
 {
+	if(degree == 0) {
+		for(int ip = 0; ip < gp.rows(); ip++) {
+			basisG[ip](0,0) = 0.0; basisG[ip](0,1) = 0.0;
+		}
+		return;
+	}
+
 	if(shape == TRIANGLE) {
 		if(degree == 1) {
 			for(int ip = 0; ip < gp.rows(); ip++)
@@ -93,6 +166,28 @@ void getLagrangeBasisGrads(const Matrix& __restrict__ gp, const Shape shape, con
 				basisG[ip](5,0) = -4.0*gp(ip,1);                basisG[ip](5,1) = 4.0*(1.0-2*gp(ip,1)-gp(ip,0));
 			}
 		}
+		if(degree == 3) {
+			// derivatives of the barycentric coordinates w.r.t. x and y
+			const a_real dL[3][NDIM] = {{-1.0,-1.0}, {1.0,0.0}, {0.0,1.0}};
+			for(int ip = 0; ip < gp.rows(); ip++)
+			{
+				const a_real L[3] = {1.0-gp(ip,0)-gp(ip,1), gp(ip,0), gp(ip,1)};
+				for(int idim = 0; idim < NDIM; idim++)
+				{
+					for(int i = 0; i < 3; i++)
+						basisG[ip](i,idim) = 0.5*(27*L[i]*L[i]-18*L[i]+2)*dL[i][idim];
+					for(int e = 0; e < 3; e++) {
+						const int a = cubictriedges[e][0], b = cubictriedges[e][1];
+						const a_real la = L[a], lb = L[b];
+						const a_real dprod = dL[a][idim]*lb + la*dL[b][idim];
+						basisG[ip](3+2*e,idim) = 4.5*(dprod*(3*la-1) + 3*la*lb*dL[a][idim]);
+						basisG[ip](4+2*e,idim) = 4.5*(dprod*(3*lb-1) + 3*la*lb*dL[b][idim]);
+					}
+					basisG[ip](9,idim) = 27.0*(dL[0][idim]*L[1]*L[2] + L[0]*dL[1][idim]*L[2]
+					                           + L[0]*L[1]*dL[2][idim]);
+				}
+			}
+		}
 	}
 	else { // QUADRANGLE
 		if(degree == 1) {
@@ -127,6 +222,168 @@ void getLagrangeBasisGrads(const Matrix& __restrict__ gp, const Shape shape, con
 				basisG[ip](8,1) = -2*gp(ip,1)*(1-gp(ip,0)*gp(ip,0));
 			}
 		}
+		if(degree == 3) {
+			for(int ip = 0; ip < gp.rows(); ip++)
+			{
+				a_real lx[4], ly[4], dlx[4], dly[4];
+				getCubicLagrange1D(gp(ip,0), lx, dlx);
+				getCubicLagrange1D(gp(ip,1), ly, dly);
+				for(int i = 0; i < 16; i++) {
+					const int ix = cubicquadnodes[i][0], iy = cubicquadnodes[i][1];
+					basisG[ip](i,0) = dlx[ix]*ly[iy];
+					basisG[ip](i,1) = lx[ix]*dly[iy];
+				}
+			}
+		}
+	}
+}
+
+/// Locations of the nodes of Lagrange elements in reference space
+/** The ordering is vertices first, then edge nodes, then interior nodes.
+ * \param[in|out] refs Pre-allocated (nnodes x ndim) matrix
+ */
+static void getLagrangeReferenceNodes(const Shape shape, const int degree, Matrix& refs)
+{
+	if(shape == TRIANGLE)
+	{
+		if(degree >= 1) {
+			refs(0,0) = 0; refs(0,1) = 0;
+			refs(1,0) = 1; refs(1,1) = 0;
+			refs(2,0) = 0; refs(2,1) = 1;
+		}
+		if(degree == 2) {
+			refs(3,0) = 0.5; refs(3,1) = 0.0;
+			refs(4,0) = 0.5; refs(4,1) = 0.5;
+			refs(5,0) = 0.0; refs(5,1) = 0.5;
+		}
+		if(degree == 3) {
+			const a_real verts[3][NDIM] = {{0,0}, {1,0}, {0,1}};
+			for(int e = 0; e < 3; e++)
+				for(int idim = 0; idim < NDIM; idim++) {
+					const a_real va = verts[cubictriedges[e][0]][idim], vb = verts[cubictriedges[e][1]][idim];
+					refs(3+2*e,idim) = (2*va + vb)/3;
+					refs(4+2*e,idim) = (va + 2*vb)/3;
+				}
+			refs(9,0) = 1.0/3; refs(9,1) = 1.0/3;
+		}
+	}
+	else if(shape == QUADRANGLE)
+	{
+		if(degree >= 1) {
+			refs(0,0) = -1; refs(0,1) = -1;
+			refs(1,0) = 1;  refs(1,1) = -1;
+			refs(2,0) = 1;  refs(2,1) = 1;
+			refs(3,0) = -1; refs(3,1) = 1;
+		}
+		if(degree == 2) {
+			refs(4,0) = 0;  refs(4,1) = -1;
+			refs(5,0) = 1;  refs(5,1) = 0;
+			refs(6,0) = 0;  refs(6,1) = 1;
+			refs(7,0) = -1; refs(7,1) = 0;
+			refs(8,0) = 0;  refs(8,1) = 0;
+		}
+		if(degree == 3) {
+			for(int i = 0; i < 16; i++)
+				for(int idim = 0; idim < NDIM; idim++)
+					refs(i,idim) = cubicnodes1d[cubicquadnodes[i][idim]];
+		}
+	}
+}
+
+/// Locations of the nodes of serendipity quadrilaterals in reference space
+/** Vertices first, then the (p-1) nodes of each edge in the direction of the edge.
+ * \param[in|out] refs Pre-allocated (4p x ndim) matrix
+ */
+static void getSerendipityReferenceNodes(const int degree, Matrix& refs)
+{
+	const a_real verts[4][NDIM] = {{-1,-1}, {1,-1}, {1,1}, {-1,1}};
+	for(int i = 0; i < 4; i++) {
+		refs(i,0) = verts[i][0]; refs(i,1) = verts[i][1];
+	}
+	for(int iedge = 0; iedge < 4; iedge++)
+		for(int k = 1; k < degree; k++)
+		{
+			const a_real t = static_cast<a_real>(k)/degree;
+			const int ino = 4 + iedge*(degree-1) + k-1;
+			for(int idim = 0; idim < NDIM; idim++)
+				refs(ino,idim) = (1-t)*verts[iedge][idim] + t*verts[(iedge+1)%4][idim];
+		}
+}
+
+/** Computes serendipity basis function values and, if basisG is not null, reference gradients
+ * at given points in the reference square, for degrees 2 and 3.
+ * Each basis function is written in terms of the reference coordinates \f$ (\xi_i,\eta_i) \f$
+ * of its node. With \f$ a = 1+\xi\xi_i \f$ and \f$ b = 1+\eta\eta_i \f$:
+ * - p=2, vertices: \f$ \frac14 ab(\xi\xi_i+\eta\eta_i-1) \f$,
+ *   edge nodes: \f$ \frac12 (1-\xi^2)b \f$ or \f$ \frac12 a(1-\eta^2) \f$
+ * - p=3, vertices: \f$ \frac1{32} ab(9(\xi^2+\eta^2)-10) \f$,
+ *   edge nodes: \f$ \frac9{32} (1-\xi^2)(1+9\xi\xi_i)b \f$ or
+ *   \f$ \frac9{32} a(1-\eta^2)(1+9\eta\eta_i) \f$
+ */
+static void getSerendipityBasisAndGrads(const Matrix& __restrict__ gp, const int degree,
+                                        Matrix& __restrict__ basisv,
+                                        std::vector<Matrix> *const __restrict__ basisG)
+{
+	const int ndof = 4*degree;
+	Matrix nodes(ndof,NDIM);
+	getSerendipityReferenceNodes(degree, nodes);
+
+	for(int ip = 0; ip < gp.rows(); ip++)
+	{
+		const a_real x = gp(ip,0), y = gp(ip,1);
+		for(int i = 0; i < ndof; i++)
+		{
+			const a_real xi = nodes(i,0), yi = nodes(i,1);
+			const a_real a = 1+x*xi, b = 1+y*yi;
+			a_real val, dx, dy;
+			if(i < 4) {
+				if(degree == 2) {
+					const a_real c = x*xi+y*yi-1;
+					val = 0.25*a*b*c;
+					dx = 0.25*xi*b*(c+a);
+					dy = 0.25*yi*a*(c+b);
+				}
+				else {
+					const a_real c = 9*(x*x+y*y)-10;
+					val = a*b*c/32.0;
+					dx = b*(xi*c + 18*x*a)/32.0;
+					dy = a*(yi*c + 18*y*b)/32.0;
+				}
+			}
+			else if(std::fabs(std::fabs(yi)-1) < SMALL_NUMBER) {
+				// node on an edge with constant eta
+				if(degree == 2) {
+					val = 0.5*(1-x*x)*b;
+					dx = -x*b;
+					dy = 0.5*(1-x*x)*yi;
+				}
+				else {
+					const a_real c = 1+9*x*xi;
+					val = 9.0/32.0*(1-x*x)*c*b;
+					dx = 9.0/32.0*b*(-2*x*c + 9*xi*(1-x*x));
+					dy = 9.0/32.0*(1-x*x)*c*yi;
+				}
+			}
+			else {
+				// node on an edge with constant xi
+				if(degree == 2) {
+					val = 0.5*a*(1-y*y);
+					dx = 0.5*xi*(1-y*y);
+					dy = -y*a;
+				}
+				else {
+					const a_real c = 1+9*y*yi;
+					val = 9.0/32.0*a*(1-y*y)*c;
+					dx = 9.0/32.0*(1-y*y)*c*xi;
+					dy = 9.0/32.0*a*(-2*y*c + 9*yi*(1-y*y));
+				}
+			}
+			basisv(ip,i) = val;
+			if(basisG) {
+				(*basisG)[ip](i,0) = dx;
+				(*basisG)[ip](i,1) = dy;
+			}
+		}
 	}
 }
 
@@ -215,72 +472,152 @@ void getLagrangeMap(const Matrix& __restrict__ pts, const Shape shape,
 	}
 }
 
-void getTaylorBasis(const Matrix& gp, const int degree,
-                    const a_real *const center, const a_real *const delta,
-                    const std::vector<std::vector<a_real>>& basisOffset, Matrix& __restrict__ basiss)
+void getTaylorBasisBatch(const int nbatch, const int npoin, const a_real *const __restrict__ x,
+                         const a_real *const __restrict__ y, const int ldx, const int lde,
+                         const int degree, const a_real *const centers, const a_real *const deltas,
+                         const a_real *const offsets, const int ldb, const int ldp,
+                         a_real *const *const basis)
 {
-	for(int ip = 0; ip < gp.rows(); ip++)
-		basiss(ip,0) = 1.0;
-
-	if(degree >= 1) {
-		for(int ip = 0; ip < gp.rows(); ip++)
-		{
-			basiss(ip,1) = (gp(ip,0)-center[0])/delta[0];
-			basiss(ip,2) = (gp(ip,1)-center[1])/delta[1];
+	for(int ie = 0; ie < nbatch; ie++)
+	{
+		const a_real *const __restrict__ xe = x + ie*lde;
+		const a_real *const __restrict__ ye = y + ie*lde;
+		a_real *const __restrict__ b = basis[ie];
+		const a_real cx = centers[ie*NDIM], cy = centers[ie*NDIM+1];
+		const a_real idx = 1.0/deltas[ie*NDIM], idy = 1.0/deltas[ie*NDIM+1];
+
+		if(degree == 0) {
+#pragma omp simd
+			for(int ip = 0; ip < npoin; ip++)
+				b[ip*ldp] = 1.0;
+		}
+		else if(degree == 1) {
+#pragma omp simd
+			for(int ip = 0; ip < npoin; ip++)
+			{
+				b[ip*ldp] = 1.0;
+				b[ldb+ip*ldp] = (xe[ip*ldx]-cx)*idx;
+				b[2*ldb+ip*ldp] = (ye[ip*ldx]-cy)*idy;
+			}
+		}
+		else {
+			const a_real oxx = offsets[ie*3], oxy = offsets[ie*3+1], oyy = offsets[ie*3+2];
+#pragma omp simd
+			for(int ip = 0; ip < npoin; ip++)
+			{
+				const a_real bx = (xe[ip*ldx]-cx)*idx, by = (ye[ip*ldx]-cy)*idy;
+				b[ip*ldp] = 1.0;
+				b[ldb+ip*ldp] = bx;
+				b[2*ldb+ip*ldp] = by;
+				b[3*ldb+ip*ldp] = 0.5*bx*bx - oxx;
+				b[4*ldb+ip*ldp] = bx*by - oxy;
+				b[5*ldb+ip*ldp] = 0.5*by*by - oyy;
+			}
 		}
 	}
+}
 
-	if(degree >= 2) {
-		for(int ip = 0; ip < gp.rows(); ip++)
+void getTaylorBasisGradsBatch(const int nbatch, const int npoin, const a_real *const __restrict__ x,
+                              const a_real *const __restrict__ y, const int ldx, const int lde,
+                              const int degree, const a_real *const centers,
+                              const a_real *const deltas, std::vector<Matrix> *const *const basisG)
+{
+	for(int ie = 0; ie < nbatch; ie++)
+	{
+		const a_real *const __restrict__ xe = x + ie*lde;
+		const a_real *const __restrict__ ye = y + ie*lde;
+		std::vector<Matrix>& grads = *basisG[ie];
+		const a_real cx = centers[ie*NDIM], cy = centers[ie*NDIM+1];
+		const a_real idx = 1.0/deltas[ie*NDIM], idy = 1.0/deltas[ie*NDIM+1];
+
+		// each point's gradients are a row-major (ndof x NDIM) matrix of their own
+		for(int ip = 0; ip < npoin; ip++)
 		{
-			basiss(ip,3) = (gp(ip,0)-center[0])*(gp(ip,0)-center[0])/(2.0*delta[0]*delta[0])
-				- basisOffset[0][0];
-			basiss(ip,4) = (gp(ip,0)-center[0])*(gp(ip,1)-center[1])/(delta[0]*delta[1])
-				- basisOffset[0][2];
-			basiss(ip,5) = (gp(ip,1)-center[1])*(gp(ip,1)-center[1])/(2.0*delta[1]*delta[1])
-				- basisOffset[0][1];
+			a_real *const __restrict__ g = grads[ip].data();
+			g[0] = 0.0; g[1] = 0.0;
+			if(degree >= 1) {
+				g[2] = idx; g[3] = 0.0;
+				g[4] = 0.0; g[5] = idy;
+			}
+			if(degree >= 2) {
+				const a_real bx = (xe[ip*ldx]-cx)*idx, by = (ye[ip*ldx]-cy)*idy;
+				g[6] = bx*idx;  g[7] = 0.0;
+				g[8] = by*idx;  g[9] = bx*idy;
+				g[10] = 0.0;    g[11] = by*idy;
+			}
 		}
 	}
 }
 
+/** The kernel reads the coordinates from, and writes the values into, the row-major matrices
+ * directly; this is a batch of one element.
+ */
+void getTaylorBasis(const Matrix& gp, const int degree,
+                    const a_real *const center, const a_real *const delta,
+                    const std::vector<std::vector<a_real>>& basisOffset, Matrix& __restrict__ basiss)
+{
+	assert(gp.cols() == NDIM);
+	assert(basiss.rows() == gp.rows());
+	const a_real nooffsets[] = {0,0,0};
+	const a_real *const offsets = degree >= 2 && !basisOffset.empty() ? basisOffset[0].data()
+		: nooffsets;
+	a_real *const dest = basiss.data();
+	getTaylorBasisBatch(1, static_cast<int>(gp.rows()), gp.data(), gp.data()+1, NDIM, 0, degree,
+	                    center, delta, offsets, 1, static_cast<int>(basiss.cols()), &dest);
+}
+
 void getTaylorBasisGrads(const Matrix& gp, const int degree, const a_real *const center,
                          const a_real *const delta, std::vector<Matrix>& __restrict__ basisG)
 {
-	for(int ip = 0; ip < gp.rows(); ip++)
-		basisG[ip](0,0) = basisG[ip](0,1) = 0.0;
+	assert(gp.cols() == NDIM);
+	std::vector<Matrix> *const dest = &basisG;
+	getTaylorBasisGradsBatch(1, static_cast<int>(gp.rows()), gp.data(), gp.data()+1, NDIM, 0, degree,
+	                         center, delta, &dest);
+}
 
-	if(degree >= 1) {
-		for(int ip = 0; ip < gp.rows(); ip++)
-		{
-			basisG[ip](1,0) = 1.0/delta[0]; basisG[ip](1,1) = 0.0;
-			basisG[ip](2,0) = 0.0;          basisG[ip](2,1) = 1.0/delta[1];
-		}
-	}
+size_t GeomMapping1D::releaseQuadratureData()
+{
+	const size_t nbytes = normals.size()*(sizeof(Vector) + NDIM*sizeof(a_real))
+		+ (speeds.size() + mapping.size())*sizeof(a_real);
+	normals.clear();
+	normals.shrink_to_fit();
+	speeds.clear();
+	speeds.shrink_to_fit();
+	mapping.resize(0,0);
+	quadstored = false;
+	return nbytes;
+}
 
-	if(degree >= 2) {
-		for(int ip = 0; ip < gp.rows(); ip++)
-		{
-			basisG[ip](3,0) = (gp(ip,0)-center[0])/(delta[0]*delta[0]);
-			basisG[ip](3,1) = 0.0;
-			basisG[ip](4,0) = (gp(ip,1)-center[1])/(delta[0]*delta[1]);
-			basisG[ip](4,1) = (gp(ip,0)-center[0])/(delta[0]*delta[1]);
-			basisG[ip](5,0) = 0.0;
-			basisG[ip](5,1) = (gp(ip,1)-center[1])/(delta[1]*delta[1]);
-		}
-	}
+bool LagrangeMapping1D::reduceDegree()
+{
+	if(degree != 2)
+		return false;
+	const a_real scale = std::max(std::fabs(phyNodes(0,1)-phyNodes(0,0)), std::fabs(phyNodes(1,1)-phyNodes(1,0)));
+	for(int idim = 0; idim < NDIM; idim++)
+		if(std::fabs(phyNodes(idim,2) - 0.5*(phyNodes(idim,0)+phyNodes(idim,1))) > SMALL_NUMBER*scale)
+			return false;
+	degree = 1;
+	phyNodes = phyNodes.leftCols(2).eval();
+	return true;
+}
+
+void LagrangeMapping1D::computeAll()
+{
+	calculateAll(mapping, normals, speeds);
 }
 
 /** Currently, Lagrange mappings upto polynomial degree 2 are implemented.
  */
-void LagrangeMapping1D::computeAll()
+void LagrangeMapping1D::calculateAll(Matrix& __restrict__ maps, std::vector<Vector>& __restrict__ norms,
+                                     std::vector<a_real>& __restrict__ sps) const
 {
 	const Matrix& points = quadrature->points();
 	int npoin = points.rows();
-	speeds.resize(npoin);
-	normals.resize(npoin);
+	sps.resize(npoin);
+	norms.resize(npoin);
 	for(int i = 0; i < npoin; i++)
-		normals[i].resize(NDIM);
-	mapping.resize(npoin,NDIM);
+		norms[i].resize(NDIM);
+	maps.resize(npoin,NDIM);
 
 	a_real vel[NDIM];
 
@@ -289,43 +626,166 @@ void LagrangeMapping1D::computeAll()
 		{
 			for(int idim = 0; idim < NDIM; idim++) {
 				// mapping - sum of Lagrange shape functions multiplied by resp coeffs
-				mapping(i,idim) = phyNodes(idim,0)*(1.0-points(i))*0.5
+				maps(i,idim) = phyNodes(idim,0)*(1.0-points(i))*0.5
 					+ phyNodes(idim,1)*(1.0+points(i))*0.5;
 				// get sum Lagrange derivatives multiplied by coeffs
 				vel[idim] = (phyNodes(idim,1) - phyNodes(idim,0))/2.0;
 			}
 
-			speeds[i] = std::sqrt(vel[0]*vel[0] + vel[1]*vel[1]);
+			sps[i] = std::sqrt(vel[0]*vel[0] + vel[1]*vel[1]);
 
 			// normalize tangent to get unit tangent and thus unit normal
 			for(int idim = 0; idim < NDIM; idim++)
-				vel[idim] /= speeds[i];
-			normals[i][0] = vel[1]; normals[i][1] = -vel[0];
+				vel[idim] /= sps[i];
+			norms[i][0] = vel[1]; norms[i][1] = -vel[0];
 		}
 	}
 	else if(degree == 2) {
 		for(int i = 0; i < npoin; i++)
 		{
 			for(int idim = 0; idim < NDIM; idim++) {
-				mapping(i,idim) = phyNodes(idim,0)*points(i)*(points(i)-1.0)/2
+				maps(i,idim) = phyNodes(idim,0)*points(i)*(points(i)-1.0)/2
 					+ phyNodes(idim,1)*points(i)*(points(i)+1.0)/2
 					+ phyNodes(idim,2)*(1.0-points(i)*points(i));
 				vel[idim] = phyNodes(idim,0)*(points(i)-0.5) + phyNodes(idim,1)*(points(i)+0.5)
 					+ phyNodes(idim,2)*(-2.0*points(i));
 			}
 
-			speeds[i] = std::sqrt(vel[0]*vel[0] + vel[1]*vel[1]);
+			sps[i] = std::sqrt(vel[0]*vel[0] + vel[1]*vel[1]);
 
 			// normalize tangent to get unit tangent and thus unit normal
 			for(int idim = 0; idim < NDIM; idim++)
-				vel[idim] /= speeds[i];
-			normals[i][0] = vel[1]; normals[i][1] = -vel[0];
+				vel[idim] /= sps[i];
+			norms[i][0] = vel[1]; norms[i][1] = -vel[0];
 		}
 	}
 	else
 		std::cout << "! LagrangeMapping1D: Chosen geometric order not available!\n";
 }
 
+void FaceGeometry::evaluate(const GeomMapping1D& fmap)
+{
+	if(fmap.storesQuadratureData()) {
+		norms = &fmap.normal();
+		sps = &fmap.speed();
+		pts = &fmap.map();
+	}
+	else {
+		fmap.calculateAll(ptsw, normsw, spsw);
+		norms = &normsw;
+		sps = &spsw;
+		pts = &ptsw;
+	}
+}
+
+/** For affine maps, the single Jacobian inverse and determinant are always kept by the mapping.
+ */
+size_t GeomMapping2D::releaseQuadratureData()
+{
+	size_t nbytes = jaco.size()*sizeof(MatrixDim) + mapping.size()*sizeof(a_real);
+	if(!affine) {
+		nbytes += jacoinv.size()*sizeof(MatrixDim) + jacodet.size()*sizeof(a_real);
+		jacoinv.clear();
+		jacoinv.shrink_to_fit();
+		jacodet.clear();
+		jacodet.shrink_to_fit();
+	}
+	jaco.clear();
+	jaco.shrink_to_fit();
+	mapping.resize(0,0);
+	quadstored = false;
+	return nbytes;
+}
+
+size_t GeomMapping2D::shareJacobiansWith(const GeomMapping2D *const other)
+{
+	const size_t nbytes = (jaco.size() + jacoinv.size())*sizeof(MatrixDim)
+		+ jacodet.size()*sizeof(a_real);
+	jaco.clear();
+	jaco.shrink_to_fit();
+	jacoinv.clear();
+	jacoinv.shrink_to_fit();
+	jacodet.clear();
+	jacodet.shrink_to_fit();
+	congruent = other;
+	return nbytes;
+}
+
+size_t Element::shareDataWith(const Element *const other)
+{
+	size_t nbytes = basis.size()*sizeof(a_real);
+	for(size_t i = 0; i < basisGrad.size(); i++)
+		nbytes += basisGrad[i].size()*sizeof(a_real);
+	basis.resize(0,0);
+	basisGrad.clear();
+	basisGrad.shrink_to_fit();
+	congruent = other;
+	return nbytes;
+}
+
+void ElementGeometry::updateTables(const GeomMapping2D& gmap)
+{
+	const Quadrature2D *const quad = gmap.getQuadrature();
+	if(quad == tquad && gmap.getShape() == tshape && gmap.getDegree() == tdegree)
+		return;
+	tquad = quad;
+	tshape = gmap.getShape();
+	tdegree = gmap.getDegree();
+
+	const Matrix& points = quad->points();
+	const int npoin = static_cast<int>(points.rows());
+	const int nnodes = static_cast<int>(gmap.getPhyNodes().cols());
+	gbasis.resize(npoin, nnodes);
+	getLagrangeBasis(points, tshape, tdegree, gbasis);
+	ggrads.resize(npoin);
+	for(int ip = 0; ip < npoin; ip++)
+		ggrads[ip].resize(nnodes, NDIM);
+	getLagrangeBasisGrads(points, tshape, tdegree, ggrads);
+}
+
+void ElementGeometry::evaluate(const GeomMapping2D& gmap, const bool coords)
+{
+	const bool stored = gmap.storesQuadratureData();
+	if(!stored)
+		updateTables(gmap);
+	const Matrix& phy = gmap.getPhyNodes();
+	const int npoin = gmap.getQuadrature()->numGauss();
+
+	if(stored || gmap.isAffine()) {
+		jinv = &gmap.jacInv();
+		jdet = &gmap.jacDet();
+		single = gmap.isAffine();
+	}
+	else {
+		jinvw.resize(npoin);
+		jdetw.resize(npoin);
+		for(int ip = 0; ip < npoin; ip++)
+		{
+			MatrixDim jac = MatrixDim::Zero();
+			for(int inode = 0; inode < phy.cols(); inode++)
+				for(int i = 0; i < NDIM; i++)
+					for(int j = 0; j < NDIM; j++)
+						jac(i,j) += phy(i,inode)*ggrads[ip](inode,j);
+
+			jdetw[ip] = jac(0,0)*jac(1,1) - jac(0,1)*jac(1,0);
+			jinvw[ip](0,0) = jac(1,1)/jdetw[ip]; jinvw[ip](0,1) = -jac(0,1)/jdetw[ip];
+			jinvw[ip](1,0) = -jac(1,0)/jdetw[ip]; jinvw[ip](1,1) = jac(0,0)/jdetw[ip];
+		}
+		jinv = &jinvw;
+		jdet = &jdetw;
+		single = false;
+	}
+
+	if(!coords)
+		pts = nullptr;
+	else if(stored)
+		pts = &gmap.map();
+	else {
+		ptsw.noalias() = gbasis*phy.transpose();
+		pts = &ptsw;
+	}
+}
+
 void LagrangeMapping2D::calculateMap(const Matrix& __restrict__ points, Matrix& __restrict__ maps) const
 {
 	getLagrangeMap(points, shape, degree, phyNodes, maps);
@@ -338,15 +798,86 @@ void LagrangeMapping2D::calculateJacobianDetAndInverse(const Matrix& __restrict_
 	getLagrangeJacobianDetAndInverse(po, shape, degree, phyNodes, jacoi, jacod);
 }
 
+/** The map is affine if every physical node is the image of its reference node under the affine map
+ * defined by vertex 0 and the two vertices adjacent to it.
+ */
+bool LagrangeMapping2D::detectAffine() const
+{
+	const int nnodes = static_cast<int>(phyNodes.cols());
+	const int nvert = shape == TRIANGLE ? 3 : 4;
+	if(nnodes < nvert)
+		return false;
+
+	Matrix refs(shape == TRIANGLE ? (degree+1)*(degree+2)/2 : (degree+1)*(degree+1), NDIM);
+	getLagrangeReferenceNodes(shape, degree, refs);
+
+	// reference-space lengths of the two edges meeting at vertex 0
+	const a_real e1 = refs(1,0)-refs(0,0), e2 = refs(nvert-1,1)-refs(0,1);
+
+	a_real scale = 0;
+	for(int i = 1; i < nvert; i++)
+		for(int idim = 0; idim < NDIM; idim++)
+			scale = std::max(scale, std::fabs(phyNodes(idim,i)-phyNodes(idim,0)));
+
+	for(int i = 0; i < std::min(nnodes, static_cast<int>(refs.rows())); i++)
+	{
+		const a_real s = (refs(i,0)-refs(0,0))/e1, t = (refs(i,1)-refs(0,1))/e2;
+		for(int idim = 0; idim < NDIM; idim++) {
+			const a_real x = phyNodes(idim,0) + s*(phyNodes(idim,1)-phyNodes(idim,0))
+				+ t*(phyNodes(idim,nvert-1)-phyNodes(idim,0));
+			if(std::fabs(x - phyNodes(idim,i)) > SMALL_NUMBER*scale)
+				return false;
+		}
+	}
+	return true;
+}
+
+/** The vertices are the first 3 or 4 nodes. The bilinear (or linear) map through them is
+ * evaluated at the reference nodes of the current degree and compared with the physical nodes.
+ */
+bool LagrangeMapping2D::reduceDegree()
+{
+	if(degree != 2)
+		return false;
+	const int nvert = shape == TRIANGLE ? 3 : 4;
+	const int nnodes = static_cast<int>(phyNodes.cols());
+
+	Matrix refs(shape == TRIANGLE ? 6 : 9, NDIM);
+	getLagrangeReferenceNodes(shape, degree, refs);
+	const Matrix vertices = phyNodes.leftCols(nvert);
+	Matrix linmap(refs.rows(), NDIM);
+	getLagrangeMap(refs, shape, 1, vertices, linmap);
+
+	a_real scale = 0;
+	for(int i = 1; i < nvert; i++)
+		for(int idim = 0; idim < NDIM; idim++)
+			scale = std::max(scale, std::fabs(phyNodes(idim,i)-phyNodes(idim,0)));
+
+	for(int i = nvert; i < std::min(nnodes, static_cast<int>(refs.rows())); i++)
+		for(int idim = 0; idim < NDIM; idim++)
+			if(std::fabs(linmap(i,idim) - phyNodes(idim,i)) > SMALL_NUMBER*scale)
+				return false;
+
+	degree = 1;
+	phyNodes = vertices;
+	return true;
+}
+
 void LagrangeMapping2D::computeForReferenceElement()
 {
 	const Matrix& points = quadrature->points();
 	shape = quadrature->getShape();
-	int npoin = points.rows();
+	affine = detectAffine();
+	const int npoin = affine ? 1 : points.rows();
 	jacoinv.resize(npoin);
 	jacodet.resize(npoin);
 
-	getLagrangeJacobianDetAndInverse(points, shape, degree, phyNodes, jacoinv, jacodet);
+	if(affine) {
+		const Matrix point = points.topRows(1);
+		getLagrangeJacobianDetAndInverse(point, shape, degree, phyNodes, jacoinv, jacodet);
+	}
+	else
+		getLagrangeJacobianDetAndInverse(points, shape, degree, phyNodes, jacoinv, jacodet);
 }
 
 /** We can make this more efficient by not computing the Jacobian inverse below.
@@ -356,13 +887,22 @@ void LagrangeMapping2D::computeForPhysicalElement()
 {
 	const Matrix& points = quadrature->points();
 	shape = quadrature->getShape();
+	affine = detectAffine();
 	int npoin = points.rows();
-	jacodet.resize(npoin);
 	mapping.resize(npoin,NDIM);
-
-	std::vector<MatrixDim> jacoi(npoin);
 	getLagrangeMap(points, shape, degree, phyNodes, mapping);
-	getLagrangeJacobianDetAndInverse(points, shape, degree, phyNodes, jacoi, jacodet);
+
+	if(affine) {
+		jacodet.resize(1);
+		std::vector<MatrixDim> jacoi(1);
+		const Matrix point = points.topRows(1);
+		getLagrangeJacobianDetAndInverse(point, shape, degree, phyNodes, jacoi, jacodet);
+	}
+	else {
+		jacodet.resize(npoin);
+		std::vector<MatrixDim> jacoi(npoin);
+		getLagrangeJacobianDetAndInverse(points, shape, degree, phyNodes, jacoi, jacodet);
+	}
 }
 
 void LagrangeMapping2D::computePhysicalCoordsOfDomainQuadraturePoints()
@@ -381,7 +921,7 @@ void LagrangeMapping2D::computePhysicalCoordsOfDomainQuadraturePoints()
  * Note that for a quad element of degree bi p (p=1 is bi linear etc), the jacodet is of degree bi 2p-1.
  * For a tri element of degree p, the jacodet is of degree 2p-2.
  */
-void TaylorElement::initialize(int degr, GeomMapping2D* geommap)
+void TaylorElement::initializeGeometry(int degr, GeomMapping2D* geommap)
 {
 	type = PHYSICAL;
 	degree = degr;
@@ -440,9 +980,9 @@ void TaylorElement::initialize(int degr, GeomMapping2D* geommap)
 #endif
 	for(int ig = 0; ig < ng; ig++)
 	{
-		area += gmap->jacDet()[ig] * gw(ig);
+		area += gmap->jacDet(ig) * gw(ig);
 		for(int idim = 0; idim < NDIM; idim++)
-			center[idim] += gmap->map()(ig,idim) * gmap->jacDet()[ig] * gw(ig);
+			center[idim] += gmap->map()(ig,idim) * gmap->jacDet(ig) * gw(ig);
 	}
 	for(int idim = 0; idim < NDIM; idim++)
 		center[idim] /= area;
@@ -467,58 +1007,269 @@ void TaylorElement::initialize(int degr, GeomMapping2D* geommap)
 	if(degree >= 2) {
 		for(int ig = 0; ig < ng; ig++)
 		{
-			basisOffset[0][0] += (gmap->map()(ig,0)-center[0])*(gmap->map()(ig,0)-center[0]) * gmap->jacDet()[ig] * gw(ig);
-			basisOffset[0][2] += (gmap->map()(ig,1)-center[1])*(gmap->map()(ig,1)-center[1]) * gmap->jacDet()[ig] * gw(ig);
-			basisOffset[0][1] += (gmap->map()(ig,0)-center[0])*(gmap->map()(ig,1)-center[1]) * gmap->jacDet()[ig] * gw(ig);
+			basisOffset[0][0] += (gmap->map()(ig,0)-center[0])*(gmap->map()(ig,0)-center[0]) * gmap->jacDet(ig) * gw(ig);
+			basisOffset[0][2] += (gmap->map()(ig,1)-center[1])*(gmap->map()(ig,1)-center[1]) * gmap->jacDet(ig) * gw(ig);
+			basisOffset[0][1] += (gmap->map()(ig,0)-center[0])*(gmap->map()(ig,1)-center[1]) * gmap->jacDet(ig) * gw(ig);
 		}
 		basisOffset[0][0] *= 1.0/(area*2*delta[0]*delta[0]);
 		basisOffset[0][2] *= 1.0/(area*2*delta[1]*delta[1]);
 		basisOffset[0][1] *= 1.0/(area*delta[0]*delta[1]);
 	}
+}
+
+void TaylorElement::initialize(int degr, GeomMapping2D* geommap)
+{
+	initializeGeometry(degr, geommap);
 
-	// Compute basis functions and gradients
 	const Matrix& gp = gmap->map();
 	getTaylorBasis(gp, degree, center, delta, basisOffset, basis);
 	getTaylorBasisGrads(gp, degree, center, delta, basisGrad);
+
+	orthonormalizeBasis();
+}
+
+/** The coordinates of the quadrature points of the batch are gathered into one array for each
+ * direction, and the basis values and gradients of all its elements are then computed by one
+ * call to each of the batched kernels, which write into the elements' tables directly.
+ */
+void TaylorElement::initializeBatch(const int degr, const int nbatch, TaylorElement *const *const elems,
+                                    GeomMapping2D *const *const maps)
+{
+	if(nbatch == 0) return;
+	for(int ie = 0; ie < nbatch; ie++)
+		elems[ie]->initializeGeometry(degr, maps[ie]);
+
+	const int npoin = maps[0]->getQuadrature()->numGauss();
+	const int ndof = elems[0]->ndof;
+	std::vector<a_real> x(nbatch*npoin), y(nbatch*npoin), centers(nbatch*NDIM), deltas(nbatch*NDIM),
+		offsets(3*nbatch, 0.0);
+	std::vector<a_real*> bdest(nbatch);
+	std::vector<std::vector<Matrix>*> gdest(nbatch);
+	for(int ie = 0; ie < nbatch; ie++)
+	{
+		TaylorElement& el = *elems[ie];
+		assert(maps[ie]->getQuadrature()->numGauss() == npoin);
+		const Matrix& gp = el.gmap->map();
+		for(int ip = 0; ip < npoin; ip++) {
+			x[ie*npoin+ip] = gp(ip,0);
+			y[ie*npoin+ip] = gp(ip,1);
+		}
+		for(int idim = 0; idim < NDIM; idim++) {
+			centers[ie*NDIM+idim] = el.center[idim];
+			deltas[ie*NDIM+idim] = el.delta[idim];
+		}
+		if(degr >= 2)
+			for(int j = 0; j < 3; j++)
+				offsets[ie*3+j] = el.basisOffset[0][j];
+		bdest[ie] = el.basis.data();
+		gdest[ie] = &el.basisGrad;
+	}
+
+	getTaylorBasisBatch(nbatch, npoin, &x[0], &y[0], 1, npoin, degr, &centers[0], &deltas[0],
+	                    &offsets[0], 1, ndof, &bdest[0]);
+	getTaylorBasisGradsBatch(nbatch, npoin, &x[0], &y[0], 1, npoin, degr, &centers[0], &deltas[0],
+	                         &gdest[0]);
+
+	for(int ie = 0; ie < nbatch; ie++)
+		elems[ie]->orthonormalizeBasis();
+}
+
+/** The elements are evaluated in chunks, so that their data can be gathered on the stack.
+ */
+void TaylorElement::computeBasisBatch(const int nbatch, const TaylorElement *const *const elems,
+                                      const Matrix& points, Matrix *const *const basisv)
+{
+	assert(points.cols() == NDIM);
+	const int npoin = static_cast<int>(points.rows());
+	constexpr int maxchunk = 8;
+	for(int start = 0; start < nbatch; start += maxchunk)
+	{
+		const int nchunk = std::min(maxchunk, nbatch-start);
+		const int degr = elems[start]->degree;
+		a_real centers[maxchunk*NDIM], deltas[maxchunk*NDIM], offsets[maxchunk*3] = {};
+		a_real* dest[maxchunk];
+		for(int ie = 0; ie < nchunk; ie++)
+		{
+			const TaylorElement& el = *elems[start+ie];
+			assert(el.degree == degr);
+			assert(basisv[start+ie]->rows() == npoin && basisv[start+ie]->cols() == el.ndof);
+			for(int idim = 0; idim < NDIM; idim++) {
+				centers[ie*NDIM+idim] = el.center[idim];
+				deltas[ie*NDIM+idim] = el.delta[idim];
+			}
+			if(degr >= 2)
+				for(int j = 0; j < 3; j++)
+					offsets[ie*3+j] = el.basisOffset[0][j];
+			dest[ie] = basisv[start+ie]->data();
+		}
+
+		getTaylorBasisBatch(nchunk, npoin, points.data(), points.data()+1, NDIM, 0, degr, centers,
+		                    deltas, offsets, 1, elems[start]->ndof, dest);
+		for(int ie = 0; ie < nchunk; ie++)
+			elems[start+ie]->transformBasis(*basisv[start+ie]);
+	}
+}
+
+void TaylorElement::orthonormalizeBasis()
+{
+	orthonormal = false;
+	if(!orthonormalize)
+		return;
+
+	const Array2d<a_real>& gw = gmap->getQuadrature()->weights();
+	const int ng = gmap->getQuadrature()->numGauss();
+
+	/* Modified Gram-Schmidt on the columns of the basis matrix, in the inner product
+	 * <f,g> = sum_g w_g J_g f_g g_g, recording the operations in an upper triangular matrix.
+	 */
+	orthoT = Matrix::Identity(ndof,ndof);
+	Vector wj(ng);
+	for(int ig = 0; ig < ng; ig++)
+		wj(ig) = gw(ig)*gmap->jacDet(ig);
+
+	for(int j = 0; j < ndof; j++)
+	{
+		const a_real norm0 = std::sqrt(basis.col(j).dot(wj.cwiseProduct(basis.col(j))));
+		for(int i = 0; i < j; i++) {
+			const a_real r = basis.col(j).dot(wj.cwiseProduct(basis.col(i)));
+			basis.col(j) -= r*basis.col(i);
+			orthoT.col(j) -= r*orthoT.col(i);
+		}
+
+		/* If the function is (nearly) in the span of the previous ones in the discrete inner
+		 * product, such as when the quadrature rule has too few points, keep the Taylor basis.
+		 */
+		const a_real norm = std::sqrt(basis.col(j).dot(wj.cwiseProduct(basis.col(j))));
+		if(!(norm > std::sqrt(ZERO_TOL)*norm0)) {
+			std::printf("! TaylorElement: initialize: Basis function %d is linearly dependent;"
+			            " not orthonormalizing.\n", j);
+			getTaylorBasis(gmap->map(), degree, center, delta, basisOffset, basis);
+			orthonormalize = false;
+			return;
+		}
+		basis.col(j) /= norm;
+		orthoT.col(j) /= norm;
+	}
+
+	transformBasisGrads(basisGrad);
+	orthonormal = true;
+}
+
+void TaylorElement::transformBasis(Matrix& basisv) const
+{
+	if(orthonormalize)
+		basisv = (basisv*orthoT).eval();
+}
+
+/** The gradient of orthonormal basis function j is the row j of \f$ T^T G \f$, where the rows of G
+ * are the gradients of the Taylor basis functions.
+ */
+void TaylorElement::transformBasisGrads(std::vector<Matrix>& basisG) const
+{
+	if(orthonormalize)
+		for(size_t ip = 0; ip < basisG.size(); ip++)
+			basisG[ip] = (orthoT.transpose()*basisG[ip]).eval();
+}
+
+void TaylorElement::getTaylorCoeffs(const Matrix& __restrict__ dofs, Matrix& __restrict__ coeffs) const
+{
+	if(orthonormalize)
+		coeffs.noalias() = dofs*orthoT.transpose();
+	else
+		coeffs = dofs;
+}
+
+void TaylorElement::getDOFsFromTaylorCoeffs(const Matrix& __restrict__ coeffs,
+                                            Matrix& __restrict__ dofs) const
+{
+	if(orthonormalize)
+		// solve dofs T^T = coeffs, ie, T dofs^T = coeffs^T
+		dofs = orthoT.triangularView<Eigen::Upper>().solve(coeffs.transpose()).transpose();
+	else
+		dofs = coeffs;
 }
 
 void TaylorElement::computeBasis(const Matrix& __restrict__ gp, Matrix& __restrict__ basiss) const
 {
 	getTaylorBasis(gp, degree, center, delta, basisOffset, basiss);
+	transformBasis(basiss);
 }
 
 void TaylorElement::computeBasisGrads(const Matrix& __restrict__ gp, const std::vector<MatrixDim>& jinv, std::vector<Matrix>& __restrict__ basisG) const
 {
 	getTaylorBasisGrads(gp, degree, center, delta, basisG);
+	transformBasisGrads(basisG);
 }
 
-void LagrangeElement::initialize(int degr, GeomMapping2D* geommap)
+/// Allocates a BasisSet with one entry for a given number of points and DOFs
+static void allocateBasisSet(const int ngauss, const int ndof, const int degree, BasisSet& bset)
 {
-	type = REFERENTIAL;
-	degree = degr;
-	geommap->computeForReferenceElement();
-	gmap = const_cast<const GeomMapping2D*>(geommap);
+	bset.deg.assign(1, degree);
+	bset.basis.resize(1);
+	bset.basisGrad.resize(1);
+	bset.basis[0].resize(ngauss,ndof);
+	bset.basisGrad[0].resize(ngauss);
+	for(int i = 0; i < ngauss; i++)
+		bset.basisGrad[0][i].resize(ndof,NDIM);
+}
 
-	if(gmap->getShape() == QUADRANGLE)
+void computeLagrangeReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                      BasisSet& bset)
+{
+	const Shape shape = quad->getShape();
+	int ndof = 0;
+	if(shape == QUADRANGLE)
 		ndof = (degree+1)*(degree+1);
-	else {
-		ndof = 0;
+	else
 		for(int i = 1; i <= degree+1; i++)
 			ndof += i;
+
+	allocateBasisSet(quad->numGauss(), ndof, degree, bset);
+	getLagrangeBasis(quad->points(), shape, degree, bset.basis[0]);
+	getLagrangeBasisGrads(quad->points(), shape, degree, bset.basisGrad[0]);
+}
+
+void computeSerendipityReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                         BasisSet& bset)
+{
+	if(quad->getShape() != QUADRANGLE || degree < 2) {
+		computeLagrangeReferenceBasisSet(quad, degree, bset);
+		return;
 	}
+	allocateBasisSet(quad->numGauss(), 4*degree, degree, bset);
+	getSerendipityBasisAndGrads(quad->points(), degree, bset.basis[0], &bset.basisGrad[0]);
+}
 
-	int ngauss = gmap->getQuadrature()->numGauss();
-	basis.resize(ngauss,ndof);
+void LagrangeElement::initialize(int degr, GeomMapping2D* geommap)
+{
+	if(degr > 3) {
+		std::printf("! LagrangeElement: initialize: Only degrees up to 3 are supported!\n");
+		throw std::logic_error("Lagrange elements of degree above 3 are not available");
+	}
+	type = REFERENTIAL;
+	degree = degr;
+	geommap->computeForReferenceElement();
+	gmap = const_cast<const GeomMapping2D*>(geommap);
+	ndof = countDOFs(gmap->getShape());
+
+	const Matrix& gp = gmap->getQuadrature()->points();
+	const int ngauss = gmap->getQuadrature()->numGauss();
 	basisGrad.resize(ngauss);
 	for(int i = 0; i < ngauss; i++) {
 		basisGrad[i].resize(ndof,NDIM);
 	}
 
-	// Compute basis functions and gradients
-	const Matrix& gp = gmap->getQuadrature()->points();
-	const std::vector<MatrixDim>& jinv = gmap->jacInv();
-	getLagrangeBasis(gp, gmap->getShape(), degree, basis);
-	getLagrangeBasisGrads(gp, gmap->getShape(), degree, basisGrad);
+	// Compute basis functions and gradients w.r.t. reference coordinates, unless shared tables exist
+	if(bset) {
+		basis = bset->basis[0];
+		for(int ip = 0; ip < ngauss; ip++)
+			basisGrad[ip] = bset->basisGrad[0][ip];
+	}
+	else {
+		basis.resize(ngauss,ndof);
+		computeBasis(gp, basis);
+		computeReferenceBasisGrads(gp, basisGrad);
+	}
 
 	for(int ip = 0; ip < gp.rows(); ip++)
 	{
@@ -527,42 +1278,37 @@ void LagrangeElement::initialize(int degr, GeomMapping2D* geommap)
 		 * we need \f$ a = J^{-T} b \f$. Instead, we can compute \f$ a^T = b^T J^{-1} \f$,
 		 * for efficiency reasons since we have a row-major storage. This latter equation is used.
 		 */
-		basisGrad[ip] = (basisGrad[ip]*jinv[ip]).eval();
+		basisGrad[ip] = (basisGrad[ip]*gmap->jacInv(ip)).eval();
 	}
 }
 
+/** The physical gradients are the reference gradients of the shared table times the Jacobian inverse.
+ */
+size_t LagrangeElement::releasePhysicalGradients()
+{
+	if(!bset)
+		return 0;
+	const size_t nbytes = basisGrad.size() > 0 ?
+		basisGrad.size()*basisGrad[0].size()*sizeof(a_real) : 0;
+	basisGrad.clear();
+	basisGrad.shrink_to_fit();
+	return nbytes;
+}
+
+int LagrangeElement::countDOFs(const Shape shape) const
+{
+	if(shape == QUADRANGLE)
+		return (degree+1)*(degree+1);
+	int nd = 0;
+	for(int i = 1; i <= degree+1; i++)
+		nd += i;
+	return nd;
+}
+
 Matrix LagrangeElement::getReferenceNodes() const
 {
 	Matrix refs(ndof,NDIM);
-	if(gmap->getShape() == TRIANGLE)
-	{
-		if(degree >= 1) {
-			refs(0,0) = 0; refs(0,1) = 0;
-			refs(1,0) = 1; refs(1,1) = 0;
-			refs(2,0) = 0; refs(2,1) = 1;
-		}
-		if(degree == 2) {
-			refs(3,0) = 0.5; refs(3,1) = 0.0;
-			refs(4,0) = 0.5; refs(4,1) = 0.5;
-			refs(5,0) = 0.0; refs(5,1) = 0.5;
-		}
-	}
-	else if(gmap->getShape() == QUADRANGLE)
-	{
-		if(degree >= 1) {
-			refs(0,0) = -1; refs(0,1) = -1;
-			refs(1,0) = 1;  refs(1,1) = -1;
-			refs(2,0) = 1;  refs(2,1) = 1;
-			refs(3,0) = -1; refs(3,1) = 1;
-		}
-		if(degree == 2) {
-			refs(4,0) = 0;  refs(4,1) = -1;
-			refs(5,0) = 1;  refs(5,1) = 0;
-			refs(6,0) = 0;  refs(6,1) = 1;
-			refs(7,0) = -1; refs(7,1) = 0;
-			refs(8,0) = 0;  refs(8,1) = 0;
-		}
-	}
+	getLagrangeReferenceNodes(gmap->getShape(), degree, refs);
 	return refs;
 }
 
@@ -571,9 +1317,15 @@ void LagrangeElement::computeBasis(const Matrix& __restrict__ gp, Matrix& __rest
 	getLagrangeBasis(gp, gmap->getShape(), degree, basisv);
 }
 
-void LagrangeElement::computeBasisGrads(const Matrix& __restrict__ gp, const std::vector<MatrixDim>& __restrict__ jinv, std::vector<Matrix>& __restrict__ basisG) const
+void LagrangeElement::computeReferenceBasisGrads(const Matrix& __restrict__ gp,
+                                                 std::vector<Matrix>& __restrict__ basisG) const
 {
 	getLagrangeBasisGrads(gp, gmap->getShape(), degree, basisG);
+}
+
+void LagrangeElement::computeBasisGrads(const Matrix& __restrict__ gp, const std::vector<MatrixDim>& __restrict__ jinv, std::vector<Matrix>& __restrict__ basisG) const
+{
+	computeReferenceBasisGrads(gp, basisG);
 
 	for(int ip = 0; ip < gp.rows(); ip++)
 	{
@@ -586,6 +1338,152 @@ void LagrangeElement::computeBasisGrads(const Matrix& __restrict__ gp, const std
 	}
 }
 
+void SerendipityElement::initialize(int degr, GeomMapping2D* geommap)
+{
+	if(degr > 3 && geommap->getShape() == QUADRANGLE) {
+		std::printf("! SerendipityElement: initialize: Only degrees up to 3 are supported!\n");
+		throw std::logic_error("Serendipity elements of degree above 3 are not available");
+	}
+	LagrangeElement::initialize(degr, geommap);
+}
+
+int SerendipityElement::countDOFs(const Shape shape) const
+{
+	if(shape == QUADRANGLE && degree >= 2)
+		return 4*degree;
+	return LagrangeElement::countDOFs(shape);
+}
+
+Matrix SerendipityElement::getReferenceNodes() const
+{
+	if(gmap->getShape() != QUADRANGLE || degree < 2)
+		return LagrangeElement::getReferenceNodes();
+	Matrix refs(ndof,NDIM);
+	getSerendipityReferenceNodes(degree, refs);
+	return refs;
+}
+
+void SerendipityElement::computeBasis(const Matrix& __restrict__ gp, Matrix& __restrict__ basisv) const
+{
+	if(gmap->getShape() != QUADRANGLE || degree < 2)
+		LagrangeElement::computeBasis(gp, basisv);
+	else
+		getSerendipityBasisAndGrads(gp, degree, basisv, nullptr);
+}
+
+void SerendipityElement::computeReferenceBasisGrads(const Matrix& __restrict__ gp,
+                                                    std::vector<Matrix>& __restrict__ basisG) const
+{
+	if(gmap->getShape() != QUADRANGLE || degree < 2)
+		LagrangeElement::computeReferenceBasisGrads(gp, basisG);
+	else {
+		Matrix basisv(gp.rows(), ndof);
+		getSerendipityBasisAndGrads(gp, degree, basisv, &basisG);
+	}
+}
+
+void SpectralElement::getLagrange1D(const a_real x, a_real *const vals, a_real *const ders) const
+{
+	const int n = static_cast<int>(nodes1d.size());
+	for(int i = 0; i < n; i++)
+	{
+		vals[i] = 1.0; ders[i] = 0.0;
+		for(int k = 0; k < n; k++)
+		{
+			if(k == i) continue;
+			const a_real denom = nodes1d[i]-nodes1d[k];
+			// product rule: d/dx (prod) = prod' * factor + prod * factor'
+			ders[i] = ders[i]*(x-nodes1d[k])/denom + vals[i]/denom;
+			vals[i] *= (x-nodes1d[k])/denom;
+		}
+	}
+}
+
+void SpectralElement::initialize(int degr, GeomMapping2D* geommap)
+{
+	type = REFERENTIAL;
+	degree = degr;
+	geommap->computeForReferenceElement();
+	gmap = const_cast<const GeomMapping2D*>(geommap);
+	ndof = (degree+1)*(degree+1);
+
+	if(gmap->getShape() != QUADRANGLE)
+		std::printf("! SpectralElement: initialize: Only quadrilaterals are supported!\n");
+
+	// p+1 GLL points integrate polynomials of degree 2p-1 exactly
+	Quadrature1DGLL gll;
+	gll.initialize(2*degree-1);
+	assert(gll.numGauss() == degree+1);
+	nodes1d.resize(gll.numGauss());
+	for(int i = 0; i < gll.numGauss(); i++)
+		nodes1d[i] = gll.points()(i,0);
+
+	const Matrix& gp = gmap->getQuadrature()->points();
+	const int ngauss = gmap->getQuadrature()->numGauss();
+	basis.resize(ngauss,ndof);
+	basisGrad.resize(ngauss);
+	for(int i = 0; i < ngauss; i++) {
+		basisGrad[i].resize(ndof,NDIM);
+	}
+
+	std::vector<MatrixDim> jinv(ngauss);
+	for(int ig = 0; ig < ngauss; ig++)
+		jinv[ig] = gmap->jacInv(ig);
+	computeBasis(gp, basis);
+	computeBasisGrads(gp, jinv, basisGrad);
+
+	collocated = (ngauss == ndof) && (basis - Matrix::Identity(ndof,ndof)).norm() < SMALL_NUMBER;
+	if(collocated)
+		basis = Matrix::Identity(ndof,ndof);
+}
+
+Matrix SpectralElement::getReferenceNodes() const
+{
+	const int n = degree+1;
+	Matrix refs(ndof,NDIM);
+	for(int i = 0; i < n; i++)
+		for(int j = 0; j < n; j++) {
+			refs(i*n+j,0) = nodes1d[i];
+			refs(i*n+j,1) = nodes1d[j];
+		}
+	return refs;
+}
+
+void SpectralElement::computeBasis(const Matrix& __restrict__ gp, Matrix& __restrict__ basisv) const
+{
+	const int n = degree+1;
+	std::vector<a_real> lx(n), dx(n), ly(n), dy(n);
+	for(int ip = 0; ip < gp.rows(); ip++)
+	{
+		getLagrange1D(gp(ip,0), &lx[0], &dx[0]);
+		getLagrange1D(gp(ip,1), &ly[0], &dy[0]);
+		for(int i = 0; i < n; i++)
+			for(int j = 0; j < n; j++)
+				basisv(ip,i*n+j) = lx[i]*ly[j];
+	}
+}
+
+void SpectralElement::computeBasisGrads(const Matrix& __restrict__ gp,
+                                        const std::vector<MatrixDim>& __restrict__ jinv,
+                                        std::vector<Matrix>& __restrict__ basisG) const
+{
+	const int n = degree+1;
+	std::vector<a_real> lx(n), dx(n), ly(n), dy(n);
+	for(int ip = 0; ip < gp.rows(); ip++)
+	{
+		getLagrange1D(gp(ip,0), &lx[0], &dx[0]);
+		getLagrange1D(gp(ip,1), &ly[0], &dy[0]);
+		for(int i = 0; i < n; i++)
+			for(int j = 0; j < n; j++) {
+				basisG[ip](i*n+j,0) = dx[i]*ly[j];
+				basisG[ip](i*n+j,1) = lx[i]*dy[j];
+			}
+
+		// reference to physical gradients, as for Lagrange elements
+		basisG[ip] = (basisG[ip]*jinv[ip]).eval();
+	}
+}
+
 /** If the elements' basis functions are defined in physical space, we just compute the physical coordinates of the face quadrature points,
  * and use the physical coordinates to compute basis function values.
  * However, if the elements' basis functions are defined in reference space, we need to compute reference coordinates of the face quadrature points
@@ -615,12 +1513,26 @@ void LagrangeElement::computeBasisGrads(const Matrix& __restrict__ gp, const std
  * Face 3: \f[ \xi = -\zeta, \, \eta = 1 \f]
  * Face 4: \f[ \xi = -1, \, \eta = -\zeta \f]
  */
-void FaceElement::initialize(const Element*const lelem, const Element*const relem, const GeomMapping1D*const gmapping, const int l_lfn, const int r_lfn)
+void FaceElement::initialize(const Element*const lelem, const Element*const relem, const GeomMapping1D*const gmapping, const int l_lfn, const int r_lfn,
+                             const FaceTraceTables *const traces)
 {
 	gmap = gmapping; leftel = lelem; rightel = relem; llfn = l_lfn; rlfn = r_lfn;
+	lbasis = &leftbasis; rbasis = &rightbasis;
+	lnodes = nullptr; rnodes = nullptr;
 
 	const int ng = gmap->getQuadrature()->numGauss();
 
+	// basis functions of elements on both sides, defined in physical space, are evaluated together
+	if(lelem->getType() == PHYSICAL && relem->getType() == PHYSICAL) {
+		leftbasis.resize(ng,lelem->getNumDOFs());
+		rightbasis.resize(ng,relem->getNumDOFs());
+		const TaylorElement *const telems[] = {static_cast<const TaylorElement*>(lelem),
+			static_cast<const TaylorElement*>(relem)};
+		Matrix *const dest[] = {&leftbasis, &rightbasis};
+		TaylorElement::computeBasisBatch(2, telems, gmap->map(), dest);
+		return;
+	}
+
 	if(lelem->getType() == PHYSICAL) {
 		leftbasis.resize(ng,lelem->getNumDOFs());
 		const Matrix& points = gmap->map();
@@ -628,14 +1540,21 @@ void FaceElement::initialize(const Element*const lelem, const Element*const rele
 	}
 	else if(lelem->getType() == REFERENTIAL)
 	{
-		// compute element reference coordinates of face quadrature points from their face reference coordinates
-		Matrix lpoints(ng,NDIM);
-		const Matrix& facepoints = gmap->getQuadrature()->points();
-		getElementRefCoords(facepoints, leftel, llfn, 1, lpoints);
-
-		// now compute basis function values
-		leftbasis.resize(ng,lelem->getNumDOFs());
-		lelem->computeBasis(lpoints, leftbasis);
+		const Shape lshape = lelem->getGeometricMapping()->getShape();
+		if(traces && traces->has(lshape, lelem->getDegree(), gmap->getQuadrature())) {
+			lbasis = &traces->basis(lshape, llfn, 0);
+			lnodes = traces->nodes(lshape, llfn, 0);
+		}
+		else {
+			// compute element reference coordinates of face quadrature points from their face reference coordinates
+			Matrix lpoints(ng,NDIM);
+			const Matrix& facepoints = gmap->getQuadrature()->points();
+			getElementRefCoords(facepoints, leftel, llfn, 1, lpoints);
+
+			// now compute basis function values
+			leftbasis.resize(ng,lelem->getNumDOFs());
+			lelem->computeBasis(lpoints, leftbasis);
+		}
 	}
 
 	if(relem->getType() == PHYSICAL) {
@@ -645,27 +1564,21 @@ void FaceElement::initialize(const Element*const lelem, const Element*const rele
 	}
 	else if(relem->getType() == REFERENTIAL)
 	{
-		// compute element reference coordinates of face quadrature points from their face reference coordinates
-		Matrix rpoints(ng,NDIM);
-		const Matrix& facepoints = gmap->getQuadrature()->points();
-		getElementRefCoords(facepoints, rightel, rlfn, -1, rpoints);
-
-		/*std::vector<MatrixDim> jacinv(ng); std::vector<a_real> jacdet(ng);
-		const std::vector<a_real> facedet = gmap->speed();
-		rightel->getGeometricMapping()->calculateJacobianDetAndInverse(rpoints, jacinv, jacdet);*/
-		/*for(int ig = 0; ig < ng; ig++) {
-			a_real diff = std::fabs(jacdet[ig]*fspeed - facedet[ig]);
-			std::cout << "  Rightel: Diff = " << diff;
-			if(diff > ZERO_TOL) std::cout << "!! --- !!";
-			std::cout << std::endl;
-		}*/
-
-		// now compute basis function values
-		rightbasis.resize(ng,relem->getNumDOFs());
-		relem->computeBasis(rpoints, rightbasis);
-
-		/*for(int ig = 0; ig < ng; ig++)
-			rightbasis.row(ig) *= jacdet[ig]*fspeed/facedet[ig];*/
+		const Shape rshape = relem->getGeometricMapping()->getShape();
+		if(traces && traces->has(rshape, relem->getDegree(), gmap->getQuadrature())) {
+			rbasis = &traces->basis(rshape, rlfn, 1);
+			rnodes = traces->nodes(rshape, rlfn, 1);
+		}
+		else {
+			// compute element reference coordinates of face quadrature points from their face reference coordinates
+			Matrix rpoints(ng,NDIM);
+			const Matrix& facepoints = gmap->getQuadrature()->points();
+			getElementRefCoords(facepoints, rightel, rlfn, -1, rpoints);
+
+			// now compute basis function values
+			rightbasis.resize(ng,relem->getNumDOFs());
+			relem->computeBasis(rpoints, rightbasis);
+		}
 	}
 }
 
@@ -725,8 +1638,7 @@ void FaceElement::computeBasisGrads()
 /** Note that the order of points has to be reversed for the right element.
  * We use lr for this.
  */
-a_real FaceElement::getElementRefCoords(const Matrix& __restrict__ facepoints,
-                                        const Element *const __restrict__ elem,
+static a_real getFaceRefCoordsInElement(const Matrix& __restrict__ facepoints, const Shape shape,
                                         const int llfn, const int lr, Matrix& __restrict__ dompoints)
 {
 	const int ng = facepoints.rows();
@@ -734,7 +1646,7 @@ a_real FaceElement::getElementRefCoords(const Matrix& __restrict__ facepoints,
 	if(ng != dompoints.rows())
 		printf("!  FaceElement: getElementRefCoords: Size mismatch!\n");
 #endif
-	if(elem->getGeometricMapping()->getShape() == TRIANGLE) {
+	if(shape == TRIANGLE) {
 		if(llfn == 0)
 		{
 			for(int ig = 0; ig < ng; ig++) {
@@ -760,7 +1672,7 @@ a_real FaceElement::getElementRefCoords(const Matrix& __restrict__ facepoints,
 			return 0.5;
 		}
 	}
-	else if(elem->getGeometricMapping()->getShape() == QUADRANGLE) {
+	else if(shape == QUADRANGLE) {
 		if(llfn == 0)
 		{
 			for(int ig = 0; ig < ng; ig++) {
@@ -795,4 +1707,71 @@ a_real FaceElement::getElementRefCoords(const Matrix& __restrict__ facepoints,
 	else return 0;
 }
 
+a_real FaceElement::getElementRefCoords(const Matrix& __restrict__ facepoints,
+                                        const Element *const __restrict__ elem,
+                                        const int llfn, const int lr, Matrix& __restrict__ dompoints)
+{
+	return getFaceRefCoordsInElement(facepoints, elem->getGeometricMapping()->getShape(), llfn, lr,
+	                                 dompoints);
+}
+
+FaceTraceTables::FaceTraceTables() : tables(NSHAPES*MAXFACES*2), nodeindices(NSHAPES*MAXFACES*2)
+{
+	for(int i = 0; i < NSHAPES; i++) {
+		degrees[i] = -1;
+		quads[i] = nullptr;
+	}
+}
+
+void FaceTraceTables::addShape(const Element *const elem, const Quadrature1D *const fquad)
+{
+	if(elem->getType() != REFERENTIAL) {
+		std::printf("! FaceTraceTables: addShape: Element is not referential!\n");
+		return;
+	}
+	const Shape shape = elem->getGeometricMapping()->getShape();
+	if(has(shape, elem->getDegree(), fquad))
+		return;
+	if(degrees[shape] >= 0)
+		std::printf("! FaceTraceTables: addShape: Replacing tables of degree %d by degree %d!\n",
+		            degrees[shape], elem->getDegree());
+
+	const int nfael = shape == TRIANGLE ? 3 : 4;
+	const int ng = fquad->numGauss();
+	const Matrix& facepoints = fquad->points();
+	Matrix points(ng,NDIM);
+
+	for(int lfn = 0; lfn < nfael; lfn++)
+		for(int side = 0; side < 2; side++)
+		{
+			getFaceRefCoordsInElement(facepoints, shape, lfn, side == 0 ? 1 : -1, points);
+			Matrix& tab = tables[(shape*MAXFACES + lfn)*2 + side];
+			tab.resize(ng, elem->getNumDOFs());
+			elem->computeBasis(points, tab);
+
+			// detect whether each face point coincides with a node of the element
+			std::vector<int>& nd = nodeindices[(shape*MAXFACES + lfn)*2 + side];
+			nd.assign(ng, -1);
+			bool selects = true;
+			for(int ig = 0; ig < ng && selects; ig++)
+			{
+				int ione = -1;
+				for(int j = 0; j < tab.cols(); j++)
+				{
+					if(std::fabs(tab(ig,j)-1.0) < SMALL_NUMBER && ione < 0)
+						ione = j;
+					else if(std::fabs(tab(ig,j)) > SMALL_NUMBER)
+						selects = false;
+				}
+				nd[ig] = ione;
+				if(ione < 0) selects = false;
+			}
+			if(!selects)
+				nd.clear();
+		}
+
+	degrees[shape] = elem->getDegree();
+	quads[shape] = fquad;
+}
+
 }
@@ -36,8 +36,11 @@ protected:
 	Matrix mapping;
 
 	const Quadrature1D* quadrature;			///< Gauss points and weights for integrating quantities
+	bool quadstored;                        ///< Whether quantities at quadrature points are stored
 
 public:
+	GeomMapping1D() : quadrature{nullptr}, quadstored{true} { }
+
 	/// Return the order
 	int getDegree() const {
 		return degree;
@@ -73,6 +76,22 @@ public:
 	/// Computes the curve normals at quadrature points in the reference space
 	virtual void computeAll() = 0;
 
+	/// Computes physical coordinates, unit normals and speeds at the quadrature points into the
+	/// arguments, which are resized as needed
+	virtual void calculateAll(Matrix& maps, std::vector<Vector>& norms, std::vector<a_real>& sps) const = 0;
+
+	/// Frees the physical coordinates, normals and speeds stored at the quadrature points
+	/** They can be recomputed from the node coordinates with \ref FaceGeometry.
+	 * The corresponding accessors must not be used afterwards.
+	 * \return The number of bytes freed
+	 */
+	size_t releaseQuadratureData();
+
+	/// Whether quantities at quadrature points are stored, ie, have not been released
+	bool storesQuadratureData() const {
+		return quadstored;
+	}
+
 	/// Access to quadrature context
 	const Quadrature1D* getQuadrature() const {
 		return quadrature;
@@ -95,7 +114,15 @@ public:
 class LagrangeMapping1D : public GeomMapping1D
 {
 public:
+	/// Lowers the degree to 1 if the face is straight with its midside node at the midpoint
+	/** Call after [setting up](@ref setAll) and before computing anything.
+	 * \return Whether the degree was lowered
+	 */
+	bool reduceDegree();
+
 	void computeAll();
+
+	void calculateAll(Matrix& maps, std::vector<Vector>& norms, std::vector<a_real>& sps) const;
 };
 
 /// Abstract geometric mapping between a 2D physical element and a reference element
@@ -105,13 +132,18 @@ protected:
 	Shape shape;								///< Shape of the element
 	int degree;									///< Polynomial degree of the map
 	Matrix phyNodes;							///< Physical coordinates of the nodes (ndim x ndofs)
+	bool affine;								///< Whether the Jacobian is constant over the element
 	std::vector<MatrixDim> jaco;				///< Jacobian matrix of the mapping
 	std::vector<MatrixDim> jacoinv;				///< Inverse of the Jacobian matrix
 	std::vector<a_real> jacodet;				///< Determinant of the Jacobian matrix
 	Matrix mapping;								///< Physical coords of the quadrature points
 	const Quadrature2D* quadrature;				///< Gauss points and weights for integrating quantities
+	bool quadstored;                            ///< Whether quantities at quadrature points are stored
+	const GeomMapping2D* congruent;             ///< Mapping whose Jacobians are used, if not this one's
 
 public:
+	GeomMapping2D() : affine{false}, quadrature{nullptr}, quadstored{true}, congruent{nullptr} { }
+
 	/// Return the order
 	int getDegree() const {
 		return degree;
@@ -121,11 +153,20 @@ public:
 		return shape;
 	}
 
+	/// Whether the mapping is affine, ie, has the same Jacobian at every point of the element
+	/** Only known after one of the compute functions has been called.
+	 * For affine maps, only one Jacobian inverse and determinant are stored.
+	 */
+	bool isAffine() const {
+		return affine;
+	}
+
 	/// Sets the polynomial degree, coordinates of physical nodes of the element and the integration context
 	void setAll(const int deg, const Matrix& physicalnodes, const Quadrature2D* const quad) {
 		degree = deg;
 		phyNodes = physicalnodes;
 		quadrature = quad;
+		shape = quad->getShape();
 	}
 
 	/// Allocates and sets the Jacobian inverses and Jacobian determinants at the quadrature points
@@ -152,6 +193,28 @@ public:
 	/// Computes physical locations of points given their reference coordinates
 	virtual void calculateMap(const Matrix& points, Matrix& maps) const = 0;
 
+	/// Frees the physical coordinates of the quadrature points and, unless the map is affine,
+	/// the Jacobian inverses and determinants there
+	/** They can be recomputed from the node coordinates with \ref ElementGeometry.
+	 * The corresponding accessors must not be used afterwards, except jacInv(0) and jacDet(0)
+	 * of affine maps.
+	 * \return The number of bytes freed
+	 */
+	size_t releaseQuadratureData();
+
+	/// Uses the Jacobians of another mapping, freeing this one's
+	/** The other mapping must be of a translate of this element, with the same quadrature rule,
+	 * so that its Jacobians at the quadrature points are the same. Physical coordinates of
+	 * quadrature points are not shared. Call after the Jacobians have been computed.
+	 * \return The number of bytes freed
+	 */
+	size_t shareJacobiansWith(const GeomMapping2D *const other);
+
+	/// Whether quantities at quadrature points are stored, ie, have not been released
+	bool storesQuadratureData() const {
+		return quadstored;
+	}
+
 	/// Read-only access to physical node locations
 	const Matrix& getPhyNodes() const {
 		return phyNodes;
@@ -164,17 +227,33 @@ public:
 
 	/// Read-only access to jacobians at domain quadrature points
 	const std::vector<MatrixDim>& jac() const {
-		return jaco;
+		return congruent ? congruent->jaco : jaco;
 	}
 
 	/// Read-only access to inverse of jacobians at domain quadrature points
+	/** \warning Contains only one entry if the mapping is [affine](@ref isAffine);
+	 * prefer the indexed accessor.
+	 */
 	const std::vector<MatrixDim>& jacInv() const {
-		return jacoinv;
+		return congruent ? congruent->jacoinv : jacoinv;
 	}
 
 	/// Jacobian determinant at domain quadrature points
+	/** \warning Contains only one entry if the mapping is [affine](@ref isAffine);
+	 * prefer the indexed accessor.
+	 */
 	const std::vector<a_real>& jacDet() const {
-		return jacodet;
+		return congruent ? congruent->jacodet : jacodet;
+	}
+
+	/// Inverse of the Jacobian at the domain quadrature point ig
+	const MatrixDim& jacInv(const int ig) const {
+		return (congruent ? congruent->jacoinv : jacoinv)[affine ? 0 : ig];
+	}
+
+	/// Jacobian determinant at the domain quadrature point ig
+	a_real jacDet(const int ig) const {
+		return (congruent ? congruent->jacodet : jacodet)[affine ? 0 : ig];
 	}
 
 	/// Access to quadrature context
@@ -190,10 +269,27 @@ public:
  * The reference square's vertices are (-1,-1), (1,-1), (1,1), (-1,1) in that order.
  *
  * \note The Jacobian matrix is not actually stored, instead the inverse is stored.
+ *
+ * Elements whose physical nodes are an affine image of the reference nodes (all P1 triangles,
+ * parallelograms and straight-sided high-order elements with evenly placed nodes) are detected
+ * and only a single Jacobian inverse and determinant is stored for them.
  */
 class LagrangeMapping2D: public GeomMapping2D
 {
 public:
+	/// Checks whether the physical nodes are an affine image of the reference nodes
+	/** Only needs the mapping to be [set up](@ref setAll).
+	 */
+	bool detectAffine() const;
+
+	/// Lowers the degree to 1 if the map of degree 1 through the vertices reproduces all nodes
+	/** This is the case for high-order elements with straight sides and evenly placed nodes.
+	 * Such a triangle is then affine, and such a quadrilateral is bilinear. Only the vertices are
+	 * kept as nodes. Call after [setting up](@ref setAll) and before computing anything.
+	 * \return Whether the degree was lowered
+	 */
+	bool reduceDegree();
+
 	void computeForReferenceElement();
 
 	void computeForPhysicalElement();
@@ -206,6 +302,88 @@ public:
 	void calculateMap(const Matrix& __restrict__ points, Matrix& __restrict__ maps) const;
 };
 
+/// Geometric quantities at the domain quadrature points of an element, usable whether or not its
+/// mapping [stores](@ref GeomMapping2D::storesQuadratureData) them
+/** If they are stored, this only refers to the mapping's storage. Otherwise, they are recomputed
+ * from the node coordinates of the (Lagrange) mapping into this object, which should then be reused
+ * across elements by one thread. The values and gradients of the geometric basis functions at the
+ * quadrature points are tabulated once and reused as long as the quadrature rule, shape and degree
+ * of the mapping do not change, so that recomputation is only a small product with the node coordinates.
+ */
+class ElementGeometry
+{
+	const std::vector<MatrixDim>* jinv;
+	const std::vector<a_real>* jdet;
+	const Matrix* pts;
+	bool single;                                ///< Whether only one Jacobian is available
+	std::vector<MatrixDim> jinvw;               ///< Recomputed Jacobian inverses
+	std::vector<a_real> jdetw;                  ///< Recomputed Jacobian determinants
+	Matrix ptsw;                                ///< Recomputed physical coordinates
+
+	const Quadrature2D* tquad;                  ///< Quadrature rule for which the tables are computed
+	Shape tshape;                               ///< Shape for which the tables are computed
+	int tdegree;                                ///< Mapping degree for which the tables are computed
+	Matrix gbasis;                              ///< Geometric basis values (nquad x nnodes)
+	std::vector<Matrix> ggrads;                 ///< Geometric basis reference gradients at each point
+
+	/// Recomputes the tables of geometric basis functions if the mapping needs different ones
+	void updateTables(const GeomMapping2D& gmap);
+
+public:
+	ElementGeometry() : jinv{nullptr}, jdet{nullptr}, pts{nullptr}, single{false},
+		tquad{nullptr}, tshape{LINE}, tdegree{0}
+	{ }
+
+	/// Makes the quantities of an element's mapping available
+	/** \param[in] gmap The mapping, which must have been set up
+	 * \param[in] coords Whether physical coordinates of the quadrature points are needed
+	 */
+	void evaluate(const GeomMapping2D& gmap, const bool coords = true);
+
+	const MatrixDim& jacInv(const int ig) const {
+		return (*jinv)[single ? 0 : ig];
+	}
+
+	a_real jacDet(const int ig) const {
+		return (*jdet)[single ? 0 : ig];
+	}
+
+	/// Physical coordinates of the quadrature points, if requested
+	const Matrix& map() const {
+		return *pts;
+	}
+};
+
+/// Normals, speeds and physical coordinates at the quadrature points of a face, usable whether
+/// or not its mapping [stores](@ref GeomMapping1D::storesQuadratureData) them \sa ElementGeometry
+class FaceGeometry
+{
+	const std::vector<Vector>* norms;
+	const std::vector<a_real>* sps;
+	const Matrix* pts;
+	std::vector<Vector> normsw;
+	std::vector<a_real> spsw;
+	Matrix ptsw;
+
+public:
+	FaceGeometry() : norms{nullptr}, sps{nullptr}, pts{nullptr} { }
+
+	/// Makes the quantities of a face's mapping available
+	void evaluate(const GeomMapping1D& fmap);
+
+	const std::vector<Vector>& normal() const {
+		return *norms;
+	}
+
+	const std::vector<a_real>& speed() const {
+		return *sps;
+	}
+
+	const Matrix& map() const {
+		return *pts;
+	}
+};
+
 /** \brief A type defining whether basis functions are defined in reference space or physical space
  * or whether it's a dummy.
  *
@@ -227,6 +405,21 @@ struct BasisSet
 	std::vector<std::vector<Matrix>> basisGrad;
 };
 
+/// Computes Lagrange basis function values and reference-space gradients at the points of
+/// a quadrature rule, as the only entry of a BasisSet
+/** These tables depend only on the shape, the degree and the quadrature rule, so they can be shared
+ * by all [Lagrange elements](@ref LagrangeElement) using that rule.
+ */
+void computeLagrangeReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                      BasisSet& bset);
+
+/// Computes the reference tables of [serendipity elements](@ref SerendipityElement), as for
+/// Lagrange elements
+/** On triangles, these are the same as the Lagrange tables.
+ */
+void computeSerendipityReferenceBasisSet(const Quadrature2D *const quad, const int degree,
+                                         BasisSet& bset);
+
 /// Abstract finite element
 /** \todo Note that this implementation is not very good for elements with basis functions defined
  * on the reference element. Such elements would only need to store 1 set of basis function values
@@ -249,8 +442,33 @@ protected:
 	const GeomMapping2D* gmap;
 	/// This can be used to store basis and basis gradient values too
 	const BasisSet* bset;							
+	/// Whether the nodes coincide with the quadrature points, ie, the basis matrix is the identity
+	bool collocated;
+	/// Whether the basis is orthonormal in the element's (discrete) L2 inner product
+	bool orthonormal;
+	/// Element whose basis values and gradients are used, if not this one's
+	const Element* congruent;
+
+	/// Basis values at quadrature points, this element's or those of the congruent one
+	const Matrix& basisValues() const {
+		return congruent ? congruent->basis : basis;
+	}
 
 public:
+	Element() : gmap{nullptr}, bset{nullptr}, collocated{false}, orthonormal{false}, congruent{nullptr} { }
+
+	/// Sets a table of basis values and gradients that may be shared by several elements
+	/** Must be called before [initialization](@ref initialize) to have any effect.
+	 * Only elements with basis functions defined in reference space use this.
+	 */
+	void setBasisSet(const BasisSet *const bs) {
+		bset = bs;
+	}
+
+	/// Shared table of basis values and reference gradients, if any; otherwise nullptr
+	const BasisSet* getBasisSet() const {
+		return bset;
+	}
 
 	/// Set the data, compute geom map, and compute basis and basis grad
 	/** \param[in] geommap The geometric mapping should be initialized beforehand;
@@ -271,8 +489,9 @@ public:
 	a_real interpolate(const int ig, const Vector& dofs) const
 	{
 		a_real val = 0;
+		const Matrix& bas = basisValues();
 		for(int i = 0; i < ndof; i++)
-			val += dofs[i]*basis(ig,i);
+			val += dofs[i]*bas(ig,i);
 		return val;
 	}
 
@@ -287,7 +506,10 @@ public:
 	//[[deprecated(" in favor of evaluateFunctions")]]
 	void interpolateAll(const Matrix& __restrict__ dofs, Matrix& __restrict__ values) const
 	{
-		values.noalias() = basis * dofs.transpose();
+		if(collocated)
+			values = dofs.transpose();
+		else
+			values.noalias() = basisValues() * dofs.transpose();
 	}
 	
 	/// Computes values of the specified component at domain quadrature points using DOFs supplied
@@ -296,17 +518,42 @@ public:
 	void interpolateComponent(const int comp, const Matrix& __restrict__ dofs,
 	                          Vector& __restrict__ values) const
 	{
-		values.noalias() = basis * dofs.row(comp).transpose();
+		if(collocated)
+			values = dofs.row(comp).transpose();
+		else
+			values.noalias() = basisValues() * dofs.row(comp).transpose();
 	}
 
 	/// Read-only access to basis at a given quadrature point
 	virtual const Matrix& bFunc() const {
-		return basis;
+		return basisValues();
 	}
 
 	/// Read-only access to basis gradients at the element's domain quadrature point
 	virtual const std::vector<Matrix>& bGrad() const {
-		return basisGrad;
+		return congruent ? congruent->basisGrad : basisGrad;
+	}
+
+	/// Frees the basis gradients at the quadrature points if they can be recovered from
+	/// [shared reference tables](@ref getBasisSet) and the Jacobian inverses
+	/** If freed, [bGrad](@ref bGrad) is empty afterwards.
+	 * \return The number of bytes freed
+	 */
+	virtual size_t releasePhysicalGradients() {
+		return 0;
+	}
+
+	/// Uses the basis values and gradients of another element of the same kind, freeing this one's
+	/** The other element must be a translate of this one, initialized with the same degree and
+	 * quadrature rule, so that its values at the quadrature points are the same.
+	 * Call after [initialization](@ref initialize).
+	 * \return The number of bytes freed
+	 */
+	size_t shareDataWith(const Element *const other);
+
+	/// Whether this element uses the basis data of a [congruent](@ref shareDataWith) one
+	bool sharesData() const {
+		return congruent != nullptr;
 	}
 
 	int getDegree() const {
@@ -321,6 +568,18 @@ public:
 		return type;
 	}
 
+	/// True if the DOFs are the values at the domain quadrature points
+	/** Then the [basis matrix](@ref bFunc) is the identity and the mass matrix is diagonal.
+	 */
+	bool isCollocated() const {
+		return collocated;
+	}
+
+	/// True if the mass matrix (computed with the element's quadrature rule) is the identity
+	bool hasOrthonormalBasis() const {
+		return orthonormal;
+	}
+
 	const GeomMapping2D* getGeometricMapping() const {
 		return gmap;
 	}
@@ -346,13 +605,64 @@ class TaylorElement : public Element
 	/// The quantities by which the basis functions are offset from actual Taylor polynomial basis
 	std::vector<std::vector<a_real>> basisOffset;
 
+	/// Whether the basis is to be orthonormalized during initialization
+	bool orthonormalize;
+
+	/// Upper triangular transform from Taylor to orthonormal basis functions, if orthonormalized
+	/** The orthonormal basis function j is \f$ \sum_{i \le j} T_{ij} B_i \f$, where B are
+	 * the Taylor basis functions.
+	 */
+	Matrix orthoT;
+
+	/// Applies [the transform](@ref orthoT) to basis values or gradients in place, if required
+	void transformBasis(Matrix& basisv) const;
+	void transformBasisGrads(std::vector<Matrix>& basisG) const;
+
+	/// Sets data and computes the geometric data, extents, center and basis offsets
+	/** The basis tables are allocated but not computed.
+	 */
+	void initializeGeometry(int degr, GeomMapping2D* geommap);
+
+	/// Orthonormalizes the computed basis tables, if [requested](@ref setOrthonormalize)
+	void orthonormalizeBasis();
+
 public:
-	TaylorElement() {
+	TaylorElement() : orthonormalize{false} {
 		type = PHYSICAL;
 	}
 
+	/// Requests that the basis be orthonormalized; must be called before initialization
+	/** The Taylor basis functions are orthonormalized by modified Gram-Schmidt in the L2
+	 * inner product of the element. The mass matrix then becomes the identity, and need not be
+	 * stored or inverted. The Taylor coefficients can be recovered by
+	 * [a triangular transform](@ref getTaylorCoeffs), for instance for reconstruction.
+	 * If the basis is found to be linearly dependent in the discrete inner product, it is left as
+	 * is and [not marked orthonormal](@ref hasOrthonormalBasis).
+	 */
+	void setOrthonormalize(const bool ortho) {
+		orthonormalize = ortho;
+	}
+
 	/// Sets data, computes geometric map data and computes basis functions and their gradients
 	void initialize(int degr, GeomMapping2D* geommap);
+
+	/// Initializes a batch of elements, computing their basis tables with the batched kernels
+	/** Has the same effect as [initializing](@ref initialize) each element with its map.
+	 * \param[in] elems The elements to initialize
+	 * \param[in] maps The geometric mappings of the elements, which must all use quadrature rules
+	 *   with the same number of points
+	 */
+	static void initializeBatch(const int degr, const int nbatch, TaylorElement *const *const elems,
+	                            GeomMapping2D *const *const maps);
+
+	/// Computes values of the basis functions of several elements of the same degree at the same
+	/// physical points
+	/** \param[in] elems The initialized elements
+	 * \param[in] points The physical points
+	 * \param[in|out] basisv Pre-allocated (npoin x ndof) matrices, one for each element
+	 */
+	static void computeBasisBatch(const int nbatch, const TaylorElement *const *const elems,
+	                              const Matrix& points, Matrix *const *const basisv);
 	
 	/// Computes values of basis functions at a given point in physical space
 	void computeBasis(const Matrix& points, Matrix& basisvalues) const;
@@ -382,10 +692,27 @@ public:
 	const std::vector<std::vector<a_real>>& getBasisOffsets() const {
 		return basisOffset;
 	}
+
+	/// Converts DOFs w.r.t. the (possibly orthonormalized) basis into Taylor coefficients
+	/** \param[in] dofs DOFs, one row per physical variable
+	 * \param[in|out] coeffs Taylor coefficients in the same layout; CANNOT be the same as dofs.
+	 */
+	void getTaylorCoeffs(const Matrix& dofs, Matrix& coeffs) const;
+
+	/// Converts Taylor coefficients into DOFs w.r.t. the (possibly orthonormalized) basis
+	void getDOFsFromTaylorCoeffs(const Matrix& coeffs, Matrix& dofs) const;
 };
 
 /// Lagrange finite element with equi-spaced nodes
-/** Computation of basis function gradients requires geometric Jacobian.
+/** Degrees up to 3 are available; [initialization](@ref initialize) with a higher degree throws
+ * std::logic_error. The nodes are ordered as vertices first, then the nodes on each edge in the
+ * direction of the edge, then the interior nodes.
+ *
+ * If a [shared table](@ref setBasisSet) of reference basis values and gradients is available,
+ * it is used instead of re-evaluating the basis at the quadrature points. On affine elements,
+ * the constant Jacobian inverse is then folded into the reference gradients.
+ *
+ * Computation of basis function gradients requires geometric Jacobian.
  * \f[ 
  * \nabla B(x) = \nabla \hat{B}(F^{-1}(x)) = J^{-T} \nabla_\xi \hat{B}(F^{-1}(F(\xi)))
  * = \nabla_\xi \hat{B}(\xi)
@@ -411,18 +738,88 @@ public:
 	void computeBasisGrads(const Matrix& points, const std::vector<MatrixDim>& jinv,
 	                       std::vector<Matrix>& basisgrads) const;
 	
+	/// Returns the locations of nodes in reference space
+	virtual Matrix getReferenceNodes() const;
+
+	size_t releasePhysicalGradients();
+
+protected:
+	/// Number of DOFs of an element of the given shape and the current degree
+	virtual int countDOFs(const Shape shape) const;
+
+	/// Computes basis functions' gradients w.r.t. reference coordinates at given reference points
+	virtual void computeReferenceBasisGrads(const Matrix& points, std::vector<Matrix>& basisgrads) const;
+};
+
+/// Serendipity finite element on quadrilaterals, and Lagrange element on triangles
+/** The serendipity space \f$ S_p \f$ has only the vertex and edge nodes of the tensor-product
+ * Lagrange space \f$ Q_p \f$ - 8 DOFs instead of 9 for p=2 and 12 instead of 16 for p=3 -
+ * but contains all polynomials of total degree p. Degrees up to 3 are available; on quads,
+ * [initialization](@ref initialize) with a higher degree throws std::logic_error.
+ * The nodes are ordered as for Lagrange elements: vertices first, then the nodes on each edge,
+ * in the direction of the edge.
+ *
+ * The full order of accuracy is only obtained on elements that are parallelograms.
+ * Triangles use the usual Lagrange basis, since that is already the complete polynomial space.
+ */
+class SerendipityElement : public LagrangeElement
+{
+public:
+	/// Sets data and computes basis functions and their gradients
+	void initialize(int degr, GeomMapping2D* geommap);
+
+	/// Computes values of basis functions at a given point in reference space
+	void computeBasis(const Matrix& points, Matrix& basisvalues) const;
+
 	/// Returns the locations of nodes in reference space
 	Matrix getReferenceNodes() const;
-	
-	/// Read-only access to basis at a given quadrature point
-	const Matrix& bFunc() const {
-		return basis;
-	}
 
-	/// Read-only access to basis gradients at the element's domain quadrature point
-	const std::vector<Matrix>& bGrad() const {
-		return basisGrad;
+protected:
+	int countDOFs(const Shape shape) const;
+
+	void computeReferenceBasisGrads(const Matrix& points, std::vector<Matrix>& basisgrads) const;
+};
+
+/// Nodal spectral element on quadrilaterals with Gauss-Lobatto-Legendre nodes
+/** The basis functions are tensor products of 1D Lagrange polynomials through the (p+1)
+ * GLL points in each reference direction. The DOF with index i*(p+1)+j is the value at the
+ * reference point (x_i, x_j), which matches the ordering of points in \ref Quadrature2DSquareGLL.
+ *
+ * If the geometric mapping uses the GLL rule with (p+1) points per direction, the element is
+ * [collocated](@ref isCollocated): the basis matrix is the identity and the mass matrix is diagonal,
+ * with the quadrature weights times the Jacobian determinant on the diagonal. Its traces on faces
+ * integrated with \ref Quadrature1DGLL are likewise just the nodes on that face.
+ * The price is that the mass matrix and the nonlinear terms are not integrated exactly.
+ */
+class SpectralElement : public Element
+{
+	std::vector<a_real> nodes1d;              ///< 1D GLL nodes on [-1,1]
+
+	/// Values and derivatives of the 1D Lagrange polynomials at a point
+	/** \param[in|out] vals Values of the p+1 polynomials
+	 * \param[in|out] ders Derivatives of the p+1 polynomials
+	 */
+	void getLagrange1D(const a_real x, a_real *const vals, a_real *const ders) const;
+
+public:
+	SpectralElement() {
+		type = REFERENTIAL;
 	}
+
+	/// Sets data and computes basis functions and their gradients
+	/** The geometric mapping should be set up with a quadrilateral quadrature rule.
+	 */
+	void initialize(int degr, GeomMapping2D* geommap);
+
+	/// Computes values of basis functions at given points in reference space
+	void computeBasis(const Matrix& points, Matrix& basisvalues) const;
+
+	/// Computes basis functions' gradients at given points in reference space
+	void computeBasisGrads(const Matrix& points, const std::vector<MatrixDim>& jinv,
+	                       std::vector<Matrix>& basisgrads) const;
+
+	/// Returns the locations of nodes in reference space
+	Matrix getReferenceNodes() const;
 };
 
 /// Just that - a dummy element
@@ -437,6 +834,55 @@ public:
 	                       std::vector<Matrix>& basisgrads) const { };
 };
 
+/// Values of reference-space basis functions at face quadrature points
+/** For [referential](@ref REFERENTIAL) elements, the traces of the basis functions on a face depend
+ * only on the shape and degree of the element, the local face number and whether the element is
+ * to the left or right of the face (which reverses the order of the quadrature points), given
+ * the face quadrature rule. One table is stored for each combination of shape, local face number
+ * and side, for one quadrature rule per shape.
+ */
+class FaceTraceTables
+{
+public:
+	FaceTraceTables();
+
+	/// Computes the tables for the shape of the given element, unless already done for that shape
+	/** \param[in] elem A referential element, used as a prototype for all elements of its shape
+	 * \param[in] fquad The quadrature rule used on the faces of elements of this shape, which
+	 *   must be kept alive while the tables are used
+	 */
+	void addShape(const Element *const elem, const Quadrature1D *const fquad);
+
+	/// Whether tables are available for a shape and polynomial degree with a face quadrature rule
+	bool has(const Shape shape, const int degree, const Quadrature1D *const fquad) const {
+		return degrees[shape] == degree && quads[shape] == fquad;
+	}
+
+	/// Basis function values (nquad x ndofs) on local face lfn; side is 0 for left and 1 for right
+	const Matrix& basis(const Shape shape, const int lfn, const int side) const {
+		return tables[(shape*MAXFACES + lfn)*2 + side];
+	}
+
+	/// Indices of the DOFs whose values are the face values, if the table is a selection matrix
+	/** This is the case for [collocated](@ref Element::isCollocated) elements whose nodes on
+	 * the face coincide with the face quadrature points.
+	 * \return The DOF index for each face quadrature point, or nullptr if the table is not
+	 *   a selection matrix.
+	 */
+	const std::vector<int>* nodes(const Shape shape, const int lfn, const int side) const {
+		const std::vector<int>& nd = nodeindices[(shape*MAXFACES + lfn)*2 + side];
+		return nd.size() > 0 ? &nd : nullptr;
+	}
+
+protected:
+	static constexpr int NSHAPES = 3;          ///< Number of [shapes](@ref Shape)
+	static constexpr int MAXFACES = 4;         ///< Max number of faces of an element
+	std::vector<Matrix> tables;                ///< Basis values for each shape, local face and side
+	std::vector<std::vector<int>> nodeindices; ///< DOF index at each face point, if tables select DOFs
+	int degrees[NSHAPES];                      ///< Polynomial degree of tables for each shape, -1 if none
+	const Quadrature1D* quads[NSHAPES];        ///< Face quadrature rule of the tables for each shape
+};
+
 /// An interface "element" between 2 adjacent finite elements
 /** In future, perhaps intfac data could be stored in this class.
  * \todo TODO: Make interpolation functions more efficient for nodal basis functions.
@@ -450,11 +896,21 @@ protected:
 	/// Local face number of this face w.r.t the left and right elements
 	int llfn, rlfn;
 
-	/// Values of the left element's basis functions at the face quadrature points
+	/// Values of the left element's basis functions at the face quadrature points, if not shared
 	Matrix leftbasis;
-	/// Values of the left element's basis functions at the face quadrature points
+	/// Values of the right element's basis functions at the face quadrature points, if not shared
 	Matrix rightbasis;
 
+	/// Left basis values in use - either [leftbasis](@ref leftbasis) or a shared trace table
+	const Matrix* lbasis;
+	/// Right basis values in use - either [rightbasis](@ref rightbasis) or a shared trace table
+	const Matrix* rbasis;
+
+	/// Left element DOF at each face quadrature point if face values are node values, else nullptr
+	const std::vector<int>* lnodes;
+	/// Right element DOF at each face quadrature point if face values are node values, else nullptr
+	const std::vector<int>* rnodes;
+
 	/// left element's basis gradients at face quadrature points
 	std::vector<Matrix> leftbgrad;
 	/// right element's basis gradients at face quadrature points
@@ -478,6 +934,8 @@ protected:
 	                           const int lfn, const int isright, Matrix& lpoints);
 
 public:
+	FaceElement() : lbasis{&leftbasis}, rbasis{&rightbasis}, lnodes{nullptr}, rnodes{nullptr} { }
+
 	/// Sets data; computes basis function values of left and right element at each quadrature point
 	/** \note Call only after element data has been precomputed, ie, by calling the compute function
 	 *   on the elements, first!
@@ -485,9 +943,13 @@ public:
 	 *   and map and normals [computed externally](@ref GeomMapping1D::computeAll)
 	 * \param[in] l_localface The local face number of this face as seen from the left element
 	 * \param[in] r_localface The local face number of this face as seen from the right element
+	 * \param[in] traces Optional shared trace tables; if they are available for the shape and degree
+	 *   of a referential neighbouring element and for the quadrature rule of this face, basis
+	 *   values are not computed for this face.
 	 */
 	void initialize(const Element *const lelem, const Element *const relem,
-	                const GeomMapping1D *const geommap, const int l_localface, const int r_localface);
+	                const GeomMapping1D *const geommap, const int l_localface, const int r_localface,
+	                const FaceTraceTables *const traces = nullptr);
 	
 	/// Computes gradients of the left- and right-elements' basis functions at face quadrature points
 	/** To be called only after [initializing](@ref initialize) the face element.
@@ -496,13 +958,25 @@ public:
 	void computeBasisGrads();
 
 	/// Read-only access to basis function values from left element
-	const Matrix& leftBasis() {
-		return leftbasis;
+	const Matrix& leftBasis() const {
+		return *lbasis;
 	}
 
 	/// Read-only access to basis function values from right element
-	const Matrix& rightBasis() {
-		return rightbasis;
+	const Matrix& rightBasis() const {
+		return *rbasis;
+	}
+
+	/// Index of the left element's DOF at each face quadrature point, if face values are node values
+	/** \return nullptr if the face values are not simply node values of the left element
+	 */
+	const std::vector<int>* leftNodes() const {
+		return lnodes;
+	}
+
+	/// Index of the right element's DOF at each face quadrature point, if face values are node values
+	const std::vector<int>* rightNodes() const {
+		return rnodes;
 	}
 
 	/// Read access to left basis gradients
@@ -520,7 +994,7 @@ public:
 	{
 		a_real val = 0;
 		for(int i = 0; i < leftel->getNumDOFs(); i++)
-			val += dofs[i]*leftbasis(ig,i);
+			val += dofs[i]*(*lbasis)(ig,i);
 		return val;
 	}
 
@@ -529,16 +1003,24 @@ public:
 	{
 		a_real val = 0;
 		for(int i = 0; i < rightel->getNumDOFs(); i++)
-			val += dofs[i]*rightbasis(ig,i);
+			val += dofs[i]*(*rbasis)(ig,i);
 		return val;
 	}
 
 	void interpolateAll_left(const Matrix& dofs, Matrix& __restrict__ values) {
-		values.noalias() = leftbasis*dofs.transpose();
+		if(lnodes)
+			for(size_t ig = 0; ig < lnodes->size(); ig++)
+				values.row(ig) = dofs.col((*lnodes)[ig]).transpose();
+		else
+			values.noalias() = (*lbasis)*dofs.transpose();
 	}
 
 	void interpolateAll_right(const Matrix& dofs, Matrix& __restrict__ values) {
-		values.noalias() = rightbasis*dofs.transpose();
+		if(rnodes)
+			for(size_t ig = 0; ig < rnodes->size(); ig++)
+				values.row(ig) = dofs.col((*rnodes)[ig]).transpose();
+		else
+			values.noalias() = (*rbasis)*dofs.transpose();
 	}
 };
 
@@ -570,11 +1052,48 @@ inline void evaluateGradients(const Matrix& dofs,
 		interp[ig].noalias() = dofs * basisg[ig];
 }
 
+/// Evaluates Taylor basis functions of several elements of the same degree at once
+/** Each element of the batch has npoin points. The coordinates of point i of element ie are
+ * x[ie*lde + i*ldx] and y[ie*lde + i*ldx]: for coordinates of the whole batch in separate
+ * arrays, ldx = 1 and lde = npoin, while for the points of a row-major (npoin x NDIM) matrix,
+ * x and y point to its first two entries and ldx = NDIM. Elements evaluated at the same points,
+ * like the two elements of a face, can pass lde = 0.
+ * \param[in] centers Centers of the elements, NDIM for each element
+ * \param[in] deltas Extents of the elements, NDIM for each element
+ * \param[in] offsets Offsets of the quadratic basis functions of each element, in the order
+ *   xx, xy, yy; 3 for each element and not accessed for degree less than 2
+ * \param[in] ldb Distance between the values of consecutive basis functions at a point
+ * \param[in] ldp Distance between the values of a basis function at consecutive points
+ * \param[in|out] basis The value of basis function j of element ie at its point i is stored in
+ *   basis[ie][j*ldb + i*ldp]; for a row-major (npoin x ndof) matrix, ldb = 1 and ldp = ndof.
+ */
+void getTaylorBasisBatch(const int nbatch, const int npoin, const a_real *const x,
+                         const a_real *const y, const int ldx, const int lde, const int degree,
+                         const a_real *const centers, const a_real *const deltas,
+                         const a_real *const offsets, const int ldb, const int ldp,
+                         a_real *const *const basis);
+
+/// Evaluates Taylor basis function gradients of several elements of the same degree at once
+/** \param[in|out] basisG The gradients of the basis functions of element ie at its point i are
+ *   written into (*basisG[ie])[i], which must be allocated as (ndof x NDIM)
+ * Other parameters are as in \ref getTaylorBasisBatch.
+ */
+void getTaylorBasisGradsBatch(const int nbatch, const int npoin, const a_real *const x,
+                              const a_real *const y, const int ldx, const int lde, const int degree,
+                              const a_real *const centers, const a_real *const deltas,
+                              std::vector<Matrix> *const *const basisG);
+
+/// Evaluates Taylor basis functions of one element at the points gp
+/** \param[in|out] basiss Pre-allocated (npoin x ndof) matrix
+ */
 void getTaylorBasis(const Matrix& gp, const int degree,
                     const a_real *const center, const a_real *const delta,
                     const std::vector<std::vector<a_real>>& basisOffset,
                     Matrix& __restrict__ basiss);
 
+/// Evaluates Taylor basis function gradients of one element at the points gp
+/** \param[in|out] basisG Pre-allocated (ndof x NDIM) matrices, one for each point
+ */
 void getTaylorBasisGrads(const Matrix& gp, const int degree,
                          const a_real *const center, const a_real *const delta,
                          std::vector<Matrix>& __restrict__ basisG);
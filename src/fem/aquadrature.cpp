@@ -10,6 +10,63 @@
 
 namespace tadgens {
 
+/// Value and derivative of the Jacobi polynomial \f$ P^{(\alpha,\beta)}_n \f$ at x, for n >= 1
+static void getJacobiPolynomial(const int n, const a_real alpha, const a_real beta, const a_real x,
+                                a_real& val, a_real& der)
+{
+	const a_real ab = alpha+beta;
+	a_real pm = 1.0;
+	a_real pc = 0.5*((ab+2)*x + alpha-beta);
+	for(int k = 2; k <= n; k++)
+	{
+		const a_real s = 2*k + ab;
+		const a_real pn = ((s-1)*(s*(s-2)*x + alpha*alpha-beta*beta)*pc
+		                   - 2*(k+alpha-1)*(k+beta-1)*s*pm) / (2*k*(k+ab)*(s-2));
+		pm = pc;
+		pc = pn;
+	}
+	val = pc;
+	const a_real s = 2*n + ab;
+	der = (n*(alpha-beta-s*x)*pc + 2*(n+alpha)*(n+beta)*pm) / (s*(1-x*x));
+}
+
+/** The nodes are found by Newton iterations with deflation of the roots already found, starting
+ * from the Chebyshev-Gauss points (Karniadakis and Sherwin, Appendix B).
+ */
+void getGaussJacobiPointsAndWeights(const int npoin, const a_real alpha, const a_real beta,
+                                    std::vector<a_real>& gp, std::vector<a_real>& gw)
+{
+	gp.resize(npoin);
+	gw.resize(npoin);
+	for(int k = 0; k < npoin; k++)
+	{
+		a_real r = -std::cos((2*k+1)*PI/(2*npoin));
+		if(k > 0)
+			r = 0.5*(r + gp[k-1]);
+		for(int it = 0; it < 100; it++)
+		{
+			a_real val, der;
+			getJacobiPolynomial(npoin, alpha, beta, r, val, der);
+			a_real sum = 0;
+			for(int i = 0; i < k; i++)
+				sum += 1.0/(r - gp[i]);
+			const a_real delta = -val/(der - sum*val);
+			r += delta;
+			if(std::fabs(delta) < 1e-15)
+				break;
+		}
+		gp[k] = r;
+	}
+
+	const a_real c = std::pow(2.0, alpha+beta+1) * std::tgamma(npoin+alpha+1)
+		* std::tgamma(npoin+beta+1) / (std::tgamma(npoin+alpha+beta+1) * std::tgamma(npoin+1.0));
+	for(int k = 0; k < npoin; k++) {
+		a_real val, der;
+		getJacobiPolynomial(npoin, alpha, beta, gp[k], val, der);
+		gw[k] = c / ((1-gp[k]*gp[k])*der*der);
+	}
+}
+
 /** Note that Gauss-Legendre quadrature (1D) with n quadrature points integrates
  * polynomials upto degree 2n-1 exactly. NOTE: This should probably be 2n+1.
  */
@@ -54,7 +111,7 @@ void Quadrature1D::initialize(const int n_poly)
 		gptemp.resize(ngauss,1);
 		ggpoints.resize(ngauss,1);
 		gptemp(0) = -sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)); gptemp(1) = -sqrt(3.0/7 - 2.0/7*sqrt(6.0/5));
-		gptemp(2) = sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)); gptemp(3) = sqrt(3.0/7 + 2.0/7*sqrt(6.0/5));
+		gptemp(2) = sqrt(3.0/7 - 2.0/7*sqrt(6.0/5)); gptemp(3) = sqrt(3.0/7 + 2.0/7*sqrt(6.0/5));
 		gweights(0) = (18.0-sqrt(30))/36.0; gweights(1) = (18.0+sqrt(30))/36.0;
 		gweights(2) = (18.0+sqrt(30))/36.0; gweights(3) = (18.0-sqrt(30))/36.0;
 		printf("  Quadrature1D: Ngauss = 4.\n");
@@ -72,13 +129,11 @@ void Quadrature1D::initialize(const int n_poly)
 		gweights(3) = (322.0+13*sqrt(70.0))/900; gweights(4) = (322.0-13*sqrt(70.0))/900;
 		printf("  Quadrature1D: Ngauss = 5.\n");
 	}
-	else {
-		nPoly = 15;
+	else if(nPoly <= 15) {
 		ngauss = 8;
 		gweights.resize(ngauss,1);
 		gptemp.resize(ngauss,1);
 		ggpoints.resize(ngauss,1);
-		printf("! Quadrature1D: Quadrature with this strength is not supported! Setting to 15.\n");
 		
 		a_real gp[][1] = {{-0.960289856497536231684},
 							{-0.796666477413626739592},
@@ -101,6 +156,19 @@ void Quadrature1D::initialize(const int n_poly)
 		gweights.initialize(ngauss, 1, (a_real*)gw);
 		printf("  Quadrature1D: Ngauss = 8.\n");
 	}
+	else {
+		ngauss = nPoly/2+1;
+		std::vector<a_real> gp, gw;
+		getGaussJacobiPointsAndWeights(ngauss, 0.0, 0.0, gp, gw);
+		gweights.resize(ngauss,1);
+		gptemp.resize(ngauss,1);
+		ggpoints.resize(ngauss,1);
+		for(int i = 0; i < ngauss; i++) {
+			gptemp(i) = gp[i];
+			gweights(i) = gw[i];
+		}
+		printf("  Quadrature1D: Ngauss = %d.\n", ngauss);
+	}
 
 	for(int i = 0; i < ggpoints.rows(); i++)
 		ggpoints(i,0) = gptemp(i,0);
@@ -147,7 +215,7 @@ void Quadrature2DSquare::initialize(const int n_poly)
 		ngaussdim = 4;
 		ngauss = 16;
 		a_real gp[] = {-sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)), -sqrt(3.0/7 - 2.0/7*sqrt(6.0/5)),
-		               sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)), sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)) };
+		               sqrt(3.0/7 - 2.0/7*sqrt(6.0/5)), sqrt(3.0/7 + 2.0/7*sqrt(6.0/5)) };
 		a_real gw[] = { (18.0-sqrt(30))/36.0, (18.0+sqrt(30))/36.0,
 		                (18.0+sqrt(30))/36.0, (18.0-sqrt(30))/36.0 };
 		gptemp.initialize(ngaussdim, 1, gp);
@@ -165,11 +233,9 @@ void Quadrature2DSquare::initialize(const int n_poly)
 		gwtemp.initialize(ngaussdim, 1, gw);
 		printf("  Quadrature2DSquare: Ngauss per dim = 5.\n");
 	}
-	else {
-		nPoly = 15;
+	else if(nPoly <= 15) {
 		ngaussdim = 8;
 		ngauss = 64;
-		std::printf("Quadrature1D: NOTE: Using quadrature sufficient for 15th degree polynomial.\n");
 		
 		a_real gp[] =      {-0.960289856497536231684,
 							-0.796666477413626739592,
@@ -192,6 +258,16 @@ void Quadrature2DSquare::initialize(const int n_poly)
 		gwtemp.initialize(ngaussdim, 1, gw);
 		printf("  Quadrature2DSquare: Ngauss per dim = 8.\n");
 	}
+	else {
+		ngaussdim = nPoly/2+1;
+		ngauss = ngaussdim*ngaussdim;
+		std::vector<a_real> gp, gw;
+		getGaussJacobiPointsAndWeights(ngaussdim, 0.0, 0.0, gp, gw);
+		gptemp.initialize(ngaussdim, 1, &gp[0]);
+		gwtemp.initialize(ngaussdim, 1, &gw[0]);
+		printf("  Quadrature2DSquare: Ngauss per dim = %d.\n", ngaussdim);
+	}
+	ntensor[0] = ntensor[1] = ngaussdim;
 
 	gweights.resize(ngauss,1);
 	ggpoints.resize(ngauss,2);
@@ -205,6 +281,106 @@ void Quadrature2DSquare::initialize(const int n_poly)
 	}
 }
 
+/// Gauss-Lobatto-Legendre points and weights on [-1,1] for a given number of points
+/** Closed forms are used for upto 6 points. For more, the interior points are the roots of
+ * \f$ P'_{n-1} \f$, which are the Gauss-Jacobi points for \f$ \alpha = \beta = 1 \f$, and the
+ * weights are \f$ 2/(n(n-1)P_{n-1}(x_i)^2) \f$.
+ * \param[in] npoin The number of points, at least 2
+ * \param[in|out] gp Points, pre-allocated
+ * \param[in|out] gw Weights, pre-allocated
+ */
+static void getGLLPointsAndWeights(const int npoin, amat::Array2d<a_real>& gp,
+                                   amat::Array2d<a_real>& gw)
+{
+	using std::sqrt;
+	if(npoin == 2) {
+		gp(0) = -1.0; gp(1) = 1.0;
+		gw(0) = 1.0; gw(1) = 1.0;
+	}
+	else if(npoin == 3) {
+		gp(0) = -1.0; gp(1) = 0.0; gp(2) = 1.0;
+		gw(0) = 1.0/3; gw(1) = 4.0/3; gw(2) = 1.0/3;
+	}
+	else if(npoin == 4) {
+		gp(0) = -1.0; gp(1) = -sqrt(1.0/5); gp(2) = sqrt(1.0/5); gp(3) = 1.0;
+		gw(0) = 1.0/6; gw(1) = 5.0/6; gw(2) = 5.0/6; gw(3) = 1.0/6;
+	}
+	else if(npoin == 5) {
+		gp(0) = -1.0; gp(1) = -sqrt(3.0/7); gp(2) = 0.0; gp(3) = sqrt(3.0/7); gp(4) = 1.0;
+		gw(0) = 1.0/10; gw(1) = 49.0/90; gw(2) = 32.0/45; gw(3) = 49.0/90; gw(4) = 1.0/10;
+	}
+	else if(npoin == 6) {
+		gp(0) = -1.0; gp(1) = -sqrt(1.0/3 + 2.0*sqrt(7.0)/21); gp(2) = -sqrt(1.0/3 - 2.0*sqrt(7.0)/21);
+		gp(3) = sqrt(1.0/3 - 2.0*sqrt(7.0)/21); gp(4) = sqrt(1.0/3 + 2.0*sqrt(7.0)/21); gp(5) = 1.0;
+		gw(0) = 1.0/15; gw(1) = (14.0-sqrt(7.0))/30; gw(2) = (14.0+sqrt(7.0))/30;
+		gw(3) = (14.0+sqrt(7.0))/30; gw(4) = (14.0-sqrt(7.0))/30; gw(5) = 1.0/15;
+	}
+	else {
+		std::vector<a_real> ip, iw;
+		getGaussJacobiPointsAndWeights(npoin-2, 1.0, 1.0, ip, iw);
+		const a_real wend = 2.0/(npoin*(npoin-1));
+		gp(0) = -1.0; gw(0) = wend;
+		gp(npoin-1) = 1.0; gw(npoin-1) = wend;
+		for(int i = 0; i < npoin-2; i++) {
+			a_real val, der;
+			getJacobiPolynomial(npoin-1, 0.0, 0.0, ip[i], val, der);
+			gp(i+1) = ip[i];
+			gw(i+1) = wend/(val*val);
+		}
+	}
+}
+
+/// Number of GLL points needed to integrate polynomials of a given degree exactly
+/** n GLL points integrate polynomials of degree upto 2n-3 exactly.
+ */
+static int getNumGLLPoints(const int n_poly)
+{
+	int npoin = 2;
+	while(2*npoin-3 < n_poly)
+		npoin++;
+	return npoin;
+}
+
+void Quadrature1DGLL::initialize(const int n_poly)
+{
+	shape = LINE;
+	ngauss = getNumGLLPoints(n_poly);
+	nPoly = 2*ngauss-3;
+
+	amat::Array2d<a_real> gptemp(ngauss,1);
+	gweights.resize(ngauss,1);
+	getGLLPointsAndWeights(ngauss, gptemp, gweights);
+
+	ggpoints.resize(ngauss,1);
+	for(int i = 0; i < ngauss; i++)
+		ggpoints(i,0) = gptemp(i,0);
+	printf("  Quadrature1DGLL: Npoints = %d.\n", ngauss);
+}
+
+void Quadrature2DSquareGLL::initialize(const int n_poly)
+{
+	shape = QUADRANGLE;
+	const int ngaussdim = getNumGLLPoints(n_poly);
+	nPoly = 2*ngaussdim-3;
+	ngauss = ngaussdim*ngaussdim;
+	ntensor[0] = ntensor[1] = ngaussdim;
+
+	amat::Array2d<a_real> gptemp(ngaussdim,1), gwtemp(ngaussdim,1);
+	getGLLPointsAndWeights(ngaussdim, gptemp, gwtemp);
+
+	gweights.resize(ngauss,1);
+	ggpoints.resize(ngauss,2);
+	for(int i = 0; i < ngaussdim; i++)
+	{
+		for(int j = 0; j < ngaussdim; j++){
+			ggpoints(i*ngaussdim+j,0) = gptemp(i);
+			ggpoints(i*ngaussdim+j,1) = gptemp(j);
+			gweights(i*ngaussdim+j) = gwtemp(i)*gwtemp(j);
+		}
+	}
+	printf("  Quadrature2DSquareGLL: Npoints per dim = %d.\n", ngaussdim);
+}
+
 void Quadrature2DTriangle::initialize(const int n_poly)
 {
 	amat::Array2d<a_real> gptemp;
@@ -222,8 +398,8 @@ void Quadrature2DTriangle::initialize(const int n_poly)
 	}
 	else if(nPoly == 2) {
 		ngauss = 3;
-		a_real gp[][2] = {{0.6666666666667,0.1666666666667}, {0.1666666666667,0.6666666666667}, {0.1666666666667,0.1666666666667}};
-		a_real gw[][1] = {{0.1666666666667}, {0.1666666666667}, {0.1666666666667}};
+		a_real gp[][2] = {{2.0/3, 1.0/6}, {1.0/6, 2.0/3}, {1.0/6, 1.0/6}};
+		a_real gw[][1] = {{1.0/6}, {1.0/6}, {1.0/6}};
 		gptemp.initialize(ngauss, 2, (a_real*)gp);
 		gweights.initialize(ngauss, 1, (a_real*)gw);
 		printf("  Quadrature2DTriangle: Ngauss = 3.\n");
@@ -231,9 +407,8 @@ void Quadrature2DTriangle::initialize(const int n_poly)
 	}
 	else if(nPoly == 3) {
 		ngauss = 4;
-		a_real gp[][2] = {{0.33333333333,0.33333333333}, {0.20000000000,0.20000000000},
-		                  {0.20000000000, 0.60000000000}, {0.60000000000, 0.20000000000}};
-		a_real gw[][1] = {{-0.28125000000}, {0.26041666667}, {0.26041666667}, {0.26041666667}};
+		a_real gp[][2] = {{1.0/3, 1.0/3}, {0.2, 0.2}, {0.2, 0.6}, {0.6, 0.2}};
+		a_real gw[][1] = {{-27.0/96}, {25.0/96}, {25.0/96}, {25.0/96}};
 		gptemp.initialize(ngauss, 2, (a_real*)gp);
 		gweights.initialize(ngauss, 1, (a_real*)gw);
 		printf("  Quadrature2DTriangle: Ngauss = 4.\n");
@@ -317,4 +492,36 @@ void Quadrature2DTriangle::initialize(const int n_poly)
 			ggpoints(i,j) = gptemp(i,j);
 }
 
+/** With n points per direction, the Gauss-Jacobi rule integrates \f$ (1-t_1) q(t_1) \f$ exactly
+ * for q of degree upto 2n-1, and so does the Gauss-Legendre rule in \f$ t_2 \f$. A polynomial of
+ * degree k in \f$ (\xi,\eta) \f$ has degree at most k in each of \f$ t_1 \f$ and \f$ t_2 \f$.
+ */
+void Quadrature2DTriangleCollapsed::initialize(const int n_poly)
+{
+	nPoly = n_poly < 1 ? 1 : n_poly;
+	shape = TRIANGLE;
+	const int n = nPoly/2+1;
+	ntensor[0] = ntensor[1] = n;
+	ngauss = n*n;
+
+	std::vector<a_real> p1, w1, p2, w2;
+	getGaussJacobiPointsAndWeights(n, 1.0, 0.0, p1, w1);
+	getGaussJacobiPointsAndWeights(n, 0.0, 0.0, p2, w2);
+
+	gweights.resize(ngauss,1);
+	ggpoints.resize(ngauss,2);
+	for(int i = 0; i < n; i++)
+	{
+		// map from [-1,1] to [0,1]; the Jacobian of the Duffy map is in the Jacobi weights
+		const a_real t1 = 0.5*(1+p1[i]);
+		for(int j = 0; j < n; j++) {
+			const a_real t2 = 0.5*(1+p2[j]);
+			ggpoints(i*n+j,0) = (1-t1)*t2;
+			ggpoints(i*n+j,1) = (1-t1)*(1-t2);
+			gweights(i*n+j) = 0.25*w1[i] * 0.5*w2[j];
+		}
+	}
+	printf("  Quadrature2DTriangleCollapsed: Ngauss = %d.\n", ngauss);
+}
+
 }
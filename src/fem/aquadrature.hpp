@@ -7,6 +7,7 @@
 #ifndef AQUADRATURE_H
 #define AQUADRATURE_H
 
+#include <vector>
 #include "aconstants.hpp"
 #include "utilities/aarray2d.hpp"
 
@@ -37,22 +38,53 @@ public:
 		return ngauss;
 	}
 
+	/// Degree of polynomials the rule was requested to integrate exactly
+	int getNumPoly() const {
+		return nPoly;
+	}
+
 	Shape getShape() const {
 		return shape;
 	}
 };
 
 /// 1D Gauss-Legendre quadrature
+/** Rules for polynomials of degree higher than 15 are computed rather than tabulated.
+ */
 class Quadrature1D : public QuadratureRule
 {
 public:
 	void initialize(const int n_poly);
 };
 
+/// 1D Gauss-Lobatto-Legendre quadrature
+/** The end points of the interval are included, which makes the rule suitable for collocated
+ * spectral elements. With n points, polynomials upto degree 2n-3 are integrated exactly.
+ * Any number of points from 2 is available.
+ */
+class Quadrature1DGLL : public Quadrature1D
+{
+public:
+	void initialize(const int n_poly);
+};
+
 class Quadrature2D : public QuadratureRule
 {
+protected:
+	int ntensor[NDIM];                      ///< Number of points along each direction of tensor rules
 public:
+	Quadrature2D() : ntensor{0,0} { }
+
 	virtual void initialize(const int n_poly) = 0;
+
+	/// Number of points along a reference direction, if the rule is a tensor product of 1D rules
+	/** The point with index i*n1+j is then the i-th point along direction 0 and the j-th point along
+	 * direction 1, where n1 is the number of points along direction 1.
+	 * \return 0 if the rule is not a tensor product
+	 */
+	int tensorPoints(const int dir) const {
+		return ntensor[dir];
+	}
 };
 
 /// Integration over the reference square
@@ -64,6 +96,16 @@ public:
 	void initialize(const int n_poly);
 };
 
+/// Tensor-product Gauss-Lobatto-Legendre rule over the reference square
+/** Points are ordered in the same way as in Quadrature2DSquare: the point with index i*n+j has
+ * coordinates (x_i, x_j), where x are the 1D GLL points.
+ */
+class Quadrature2DSquareGLL : public Quadrature2DSquare
+{
+public:
+	void initialize(const int n_poly);
+};
+
 /// Integration over the reference triangle [(0,0), (1,0), (0,1)]
 class Quadrature2DTriangle : public Quadrature2D
 {
@@ -71,5 +113,28 @@ public:
 	void initialize(const int n_poly);
 };
 
+/// Collapsed-coordinate (Stroud conical) rule over the reference triangle, of any strength
+/** The triangle is the image of the unit square under the Duffy map
+ * \f$ \xi = (1-t_1) t_2, \, \eta = (1-t_1)(1-t_2) \f$, so that \f$ t_1 = 1-\xi-\eta \f$ is the
+ * first barycentric coordinate. The rule is the tensor product of a Gauss-Jacobi rule in \f$ t_1 \f$,
+ * which absorbs the Jacobian \f$ 1-t_1 \f$ of the map, and a Gauss-Legendre rule in \f$ t_2 \f$,
+ * with [tensor ordering](@ref tensorPoints). Bernstein polynomials factorize along these
+ * directions, which is what makes sum factorization possible on triangles.
+ */
+class Quadrature2DTriangleCollapsed : public Quadrature2DTriangle
+{
+public:
+	void initialize(const int n_poly);
+};
+
+/// Gauss-Jacobi points and weights on [-1,1] for the weight \f$ (1-x)^\alpha (1+x)^\beta \f$
+/** Computed by Newton iterations, so any number of points is available.
+ * With alpha = beta = 0, this is the Gauss-Legendre rule.
+ * \param[in|out] gp Points in ascending order, resized as needed
+ * \param[in|out] gw Weights, resized as needed
+ */
+void getGaussJacobiPointsAndWeights(const int npoin, const a_real alpha, const a_real beta,
+                                    std::vector<a_real>& gp, std::vector<a_real>& gw);
+
 } // end namespace tadgens
 #endif
@@ -0,0 +1,123 @@
+/** \file
+ * \brief Physics of the compressible Euler equations
+ * \author Aditya Kashi
+ */
+
+#ifndef TADGENS_PDE_EULER_H
+#define TADGENS_PDE_EULER_H
+
+#include <cmath>
+#include "pde.hpp"
+
+namespace tadgens {
+
+/// Compressible Euler equations of a calorically perfect gas in conserved variables
+/** The state is \f$ (\rho, \rho v_1, \rho v_2, \rho E) \f$ and the pressure is
+ * \f$ p = (\gamma-1)(\rho E - \rho |v|^2/2) \f$.
+ */
+class EulerPDE : public PDE<EulerPDE,NDIM+2>
+{
+	const a_real g;                         ///< Adiabatic index
+
+public:
+	EulerPDE(const a_real gamma) : g{gamma}
+	{ }
+
+	a_real gamma() const { return g; }
+
+	/// Pressure from conserved variables at one point, for any scalar type
+	template <typename scalar>
+	scalar getPressure(const scalar rho, const scalar rhovx, const scalar rhovy, const scalar rhoE) const {
+		return (g-1.0)*(rhoE - 0.5*(rhovx*rhovx + rhovy*rhovy)/rho);
+	}
+
+	void convFlux(const int npts, const a_real *const __restrict__ u, a_real *const __restrict__ flux) const
+	{
+		const int nv = nvars;
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+		{
+			const a_real rho = u[ip], rhovx = u[npts+ip], rhovy = u[2*npts+ip], rhoE = u[3*npts+ip];
+			const a_real vx = rhovx/rho, vy = rhovy/rho;
+			const a_real p = getPressure(rho, rhovx, rhovy, rhoE);
+
+			flux[ip] = rhovx;
+			flux[npts+ip] = rhovx*vx + p;
+			flux[2*npts+ip] = rhovy*vx;
+			flux[3*npts+ip] = (rhoE+p)*vx;
+
+			flux[nv*npts+ip] = rhovy;
+			flux[(nv+1)*npts+ip] = rhovx*vy;
+			flux[(nv+2)*npts+ip] = rhovy*vy + p;
+			flux[(nv+3)*npts+ip] = (rhoE+p)*vy;
+		}
+	}
+
+	void normalConvFlux(const int npts, const a_real *const __restrict__ u,
+	                    const a_real *const __restrict__ n, a_real *const __restrict__ flux) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+		{
+			const a_real rho = u[ip], rhovx = u[npts+ip], rhovy = u[2*npts+ip], rhoE = u[3*npts+ip];
+			const a_real nx = n[ip], ny = n[npts+ip];
+			const a_real vn = (rhovx*nx + rhovy*ny)/rho;
+			const a_real p = getPressure(rho, rhovx, rhovy, rhoE);
+
+			flux[ip] = rho*vn;
+			flux[npts+ip] = rhovx*vn + p*nx;
+			flux[2*npts+ip] = rhovy*vn + p*ny;
+			flux[3*npts+ip] = (rhoE+p)*vn;
+		}
+	}
+
+	void dConvFlux_du(const int npts, const a_real *const __restrict__ u,
+	                  const a_real *const __restrict__ n, a_real *const __restrict__ dfdu) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+		{
+			const a_real rho = u[ip], vx = u[npts+ip]/rho, vy = u[2*npts+ip]/rho, rhoE = u[3*npts+ip];
+			const a_real nx = n[ip], ny = n[npts+ip];
+			const a_real vn = vx*nx + vy*ny;
+			const a_real q2 = vx*vx + vy*vy;
+			const a_real p = (g-1.0)*(rhoE - 0.5*rho*q2);
+			const a_real H = (rhoE + p)/rho;
+			const a_real phi = 0.5*(g-1.0)*q2;
+
+			a_real *const J = dfdu + ip;
+			J[0] = 0;                       J[npts] = nx;
+			J[2*npts] = ny;                 J[3*npts] = 0;
+
+			J[4*npts] = phi*nx - vx*vn;     J[5*npts] = vn + vx*nx - (g-1.0)*vx*nx;
+			J[6*npts] = vx*ny - (g-1.0)*vy*nx;
+			J[7*npts] = (g-1.0)*nx;
+
+			J[8*npts] = phi*ny - vy*vn;     J[9*npts] = vy*nx - (g-1.0)*vx*ny;
+			J[10*npts] = vn + vy*ny - (g-1.0)*vy*ny;
+			J[11*npts] = (g-1.0)*ny;
+
+			J[12*npts] = vn*(phi - H);      J[13*npts] = H*nx - (g-1.0)*vx*vn;
+			J[14*npts] = H*ny - (g-1.0)*vy*vn;
+			J[15*npts] = g*vn;
+		}
+	}
+
+	void maxWaveSpeed(const int npts, const a_real *const __restrict__ u,
+	                  const a_real *const __restrict__ n, a_real *const __restrict__ speed) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+		{
+			const a_real rho = u[ip], rhovx = u[npts+ip], rhovy = u[2*npts+ip], rhoE = u[3*npts+ip];
+			const a_real nx = n[ip], ny = n[npts+ip];
+			const a_real vn = (rhovx*nx + rhovy*ny)/rho;
+			const a_real c = std::sqrt(g*getPressure(rho, rhovx, rhovy, rhoE)/rho);
+			speed[ip] = std::fabs(vn) + c*std::sqrt(nx*nx + ny*ny);
+		}
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+/** \file
+ * \brief Physics of scalar linear advection
+ * \author Aditya Kashi
+ */
+
+#ifndef TADGENS_PDE_LINEARADVECTION_H
+#define TADGENS_PDE_LINEARADVECTION_H
+
+#include <cmath>
+#include "pde.hpp"
+
+namespace tadgens {
+
+/// Linear advection of a scalar with a constant velocity a, with flux \f$ F(u) = a u \f$
+class LinearAdvectionPDE : public PDE<LinearAdvectionPDE,1>
+{
+	a_real a[NDIM];                        ///< Advection velocity
+
+public:
+	LinearAdvectionPDE(const a_real vel[NDIM]) {
+		a[0] = vel[0]; a[1] = vel[1];
+	}
+
+	void convFlux(const int npts, const a_real *const __restrict__ u, a_real *const __restrict__ flux) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++) {
+			flux[ip] = a[0]*u[ip];
+			flux[npts+ip] = a[1]*u[ip];
+		}
+	}
+
+	void normalConvFlux(const int npts, const a_real *const __restrict__ u,
+	                    const a_real *const __restrict__ n, a_real *const __restrict__ flux) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+			flux[ip] = (a[0]*n[ip] + a[1]*n[npts+ip])*u[ip];
+	}
+
+	void dConvFlux_du(const int npts, const a_real *const u, const a_real *const __restrict__ n,
+	                  a_real *const __restrict__ dfdu) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+			dfdu[ip] = a[0]*n[ip] + a[1]*n[npts+ip];
+	}
+
+	void maxWaveSpeed(const int npts, const a_real *const u, const a_real *const __restrict__ n,
+	                  a_real *const __restrict__ speed) const
+	{
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
+			speed[ip] = std::fabs(a[0]*n[ip] + a[1]*n[npts+ip]);
+	}
+};
+
+}
+
+#endif
@@ -11,35 +11,114 @@
 namespace tadgens {
 
 /// An abstract PDE context
-/** Every PDE is assumed to have a convective term, a diffusive term and a source term.
+/** Every PDE is assumed to have a convective term, a diffusive term and a source term:
+ * \f[ \partial_t u + \nabla\cdot F(u) - \nabla\cdot F_v(u,\nabla u) = S(u). \f]
  * Note that all functions operate not on one point (in the mesh) but a set of points.
+ *
+ * This is a static interface: a PDE is a class Derived deriving from PDE<Derived,nv>, and code
+ * using it is templated on the derived class. Calls are then resolved at compile time and can be
+ * inlined into the loops over points, which can be vectorized. Derived classes must implement
+ * convFlux, dConvFlux_du and maxWaveSpeed; the defaults here describe the absence of diffusive
+ * and source terms, and compute normal fluxes from the directional fluxes.
+ *
+ * All arrays are in structure-of-arrays layout: for npts points, component k of a quantity at point
+ * ip is at index k*npts + ip. The state has nvars components. Directional fluxes have NDIM*nvars
+ * components, with that of variable ivar in direction idim at idim*nvars + ivar. Normals have NDIM
+ * components. Jacobians have nvars*nvars components, with the derivative of component i w.r.t.
+ * variable j at i*nvars + j. Gradients of the state have NDIM*nvars components, like fluxes.
+ * A row-major Matrix with one row per component and one column per point has this layout.
  */
-template <typename Derived>
+template <typename Derived, int nv>
 class PDE
 {
 public:
-	/// Computes the convective flux along a given direction
-	virtual void convFlux(const ArrayBase<Derived>& u, const a_real *const n, a_real *const flux) const = 0;
+	/// Number of physical variables
+	static constexpr int nvars = nv;
 
-	/// Computes the Jacobian of the convective flux along a direction w.r.t. the state variable(s)
-	virtual void dConvFlux_du(const a_real *const u, const a_real *const n, a_real *const dfdu) const = 0;
+	/// Whether there is a diffusive flux
+	static constexpr bool hasDiffusion = false;
 
-	/// Computes the eigenvalues of the convective flux Jacobian along a given direction
-	virtual void convFluxJacEigenvalues(const a_real *const u, const a_real *const n,
-	                                    a_real *const eigs) const = 0;
+	/// Whether there is a source term
+	static constexpr bool hasSource = false;
 
-	virtual void viscFlux(const a_real *const u, const a_real *const gradu, const a_real *const n,
-	                      a_real *const flux) const = 0;
+	/// Computes the convective fluxes in all coordinate directions
+	void convFlux(const int npts, const a_real *const u, a_real *const flux) const;
 
-	virtual void dViscFlux_du(const a_real *const u, const a_real *const gradu, const a_real *const n,
-	                          a_real *const dfdu) const = 0;
+	/// Computes the convective flux along given directions
+	/** The default implementation computes the fluxes in all directions first.
+	 */
+	void normalConvFlux(const int npts, const a_real *const u, const a_real *const n,
+	                    a_real *const flux) const
+	{
+		a_real dflux[NDIM*nv];
+		for(int ip = 0; ip < npts; ip++)
+		{
+			a_real up[nv];
+			for(int ivar = 0; ivar < nv; ivar++)
+				up[ivar] = u[ivar*npts+ip];
+			derived().convFlux(1, up, dflux);
+			for(int ivar = 0; ivar < nv; ivar++) {
+				flux[ivar*npts+ip] = 0;
+				for(int idim = 0; idim < NDIM; idim++)
+					flux[ivar*npts+ip] += dflux[idim*nv+ivar]*n[idim*npts+ip];
+			}
+		}
+	}
 
-	virtual void dViscFlux_dgradu(const a_real *const u, const a_real *const gradu, const a_real *const n,
-	                              a_real *const dfdgu) const = 0;
+	/// Computes the Jacobian of the convective flux along given directions w.r.t. the state
+	void dConvFlux_du(const int npts, const a_real *const u, const a_real *const n,
+	                  a_real *const dfdu) const;
 
-	virtual void source(const a_real *const u, a_real *const sourceterm) const = 0;
+	/// Computes the largest magnitude of the eigenvalues of the convective flux Jacobian along
+	/// given directions
+	void maxWaveSpeed(const int npts, const a_real *const u, const a_real *const n,
+	                  a_real *const speed) const;
 
-	virtual void dSource_du(const a_real *const u, a_real *const dsourcedu) const = 0;
+	/// Computes the diffusive flux along given directions
+	void viscFlux(const int npts, const a_real *const u, const a_real *const gradu,
+	              const a_real *const n, a_real *const flux) const
+	{
+		for(int k = 0; k < nv*npts; k++)
+			flux[k] = 0;
+	}
+
+	/// Computes the Jacobian of the diffusive flux along given directions w.r.t. the state
+	void dViscFlux_du(const int npts, const a_real *const u, const a_real *const gradu,
+	                  const a_real *const n, a_real *const dfdu) const
+	{
+		for(int k = 0; k < nv*nv*npts; k++)
+			dfdu[k] = 0;
+	}
+
+	/// Computes the Jacobian of the diffusive flux along given directions w.r.t. the gradients
+	/** The derivative of component i w.r.t. the derivative of variable j in direction idim
+	 * is component (idim*nvars + i)*nvars + j.
+	 */
+	void dViscFlux_dgradu(const int npts, const a_real *const u, const a_real *const gradu,
+	                      const a_real *const n, a_real *const dfdgu) const
+	{
+		for(int k = 0; k < NDIM*nv*nv*npts; k++)
+			dfdgu[k] = 0;
+	}
+
+	/// Computes the source term
+	void source(const int npts, const a_real *const u, a_real *const sourceterm) const
+	{
+		for(int k = 0; k < nv*npts; k++)
+			sourceterm[k] = 0;
+	}
+
+	/// Computes the Jacobian of the source term w.r.t. the state
+	void dSource_du(const int npts, const a_real *const u, a_real *const dsourcedu) const
+	{
+		for(int k = 0; k < nv*nv*npts; k++)
+			dsourcedu[k] = 0;
+	}
+
+protected:
+	const Derived& derived() const {
+		return static_cast<const Derived&>(*this);
+	}
 };
 
 }
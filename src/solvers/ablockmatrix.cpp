@@ -0,0 +1,196 @@
+/** @file ablockmatrix.cpp
+ * @brief Implementation of block-sparse matrices
+ * @author Aditya Kashi
+ */
+
+#include <algorithm>
+#include "ablockmatrix.hpp"
+
+namespace tadgens {
+
+void BlockSparseMatrix::setStructure(const UMesh2dh *const m, const std::vector<int>& blocksizes,
+                                     const bool diagonalonly)
+{
+	nbrows = m->gnelem();
+	rowstart.resize(nbrows+1);
+	rowstart[0] = 0;
+	for(a_int i = 0; i < nbrows; i++)
+		rowstart[i+1] = rowstart[i] + blocksizes[i];
+
+	bptr.resize(nbrows+1);
+	bptr[0] = 0;
+	bcolind.clear();
+	for(a_int i = 0; i < nbrows; i++)
+	{
+		bcolind.push_back(i);
+		for(int ifa = 0; ifa < m->gnfael(i) && !diagonalonly; ifa++) {
+			const a_int j = m->gesuel(i,ifa);
+			if(j >= 0 && j < nbrows)
+				bcolind.push_back(j);
+		}
+		std::sort(bcolind.begin()+bptr[i], bcolind.end());
+		bptr[i+1] = static_cast<a_int>(bcolind.size());
+	}
+
+	diagind.resize(nbrows);
+	valptr.resize(bcolind.size()+1);
+	valptr[0] = 0;
+	for(a_int i = 0; i < nbrows; i++)
+		for(a_int k = bptr[i]; k < bptr[i+1]; k++) {
+			if(bcolind[k] == i)
+				diagind[i] = k;
+			valptr[k+1] = valptr[k] + static_cast<size_t>(blockSize(i))*blockSize(bcolind[k]);
+		}
+
+	vals.assign(valptr.back(), 0);
+}
+
+void BlockSparseMatrix::setZero()
+{
+#pragma omp parallel for simd default(shared)
+	for(size_t i = 0; i < vals.size(); i++)
+		vals[i] = 0;
+}
+
+void BlockSparseMatrix::factorDiagonalBlocks(std::vector<Eigen::PartialPivLU<Matrix>>& dlu) const
+{
+	dlu.resize(nbrows);
+#pragma omp parallel for default(shared)
+	for(a_int i = 0; i < nbrows; i++)
+		dlu[i].compute(diagonalBlock(i));
+}
+
+/** Since blocks are row-major, each row of a block is a dot product of contiguous entries with a
+ * contiguous part of x, which is vectorized. Explicit loops are faster here than Eigen's general
+ * matrix-vector kernels for the small blocks of low-order DG.
+ */
+void BlockSparseMatrix::apply(const Vector& x, Vector& y) const
+{
+#pragma omp parallel for default(shared)
+	for(a_int i = 0; i < nbrows; i++)
+	{
+		const int nb = blockSize(i);
+		a_real *const yi = &y[rowstart[i]];
+		for(int r = 0; r < nb; r++)
+			yi[r] = 0;
+
+		for(a_int k = bptr[i]; k < bptr[i+1]; k++)
+		{
+			const a_int j = bcolind[k];
+			const int nbj = blockSize(j);
+			const a_real *const xj = &x[rowstart[j]];
+			const a_real *const blk = &vals[valptr[k]];
+			for(int r = 0; r < nb; r++)
+			{
+				const a_real *const row = blk + (size_t)r*nbj;
+				a_real sum = 0;
+#pragma omp simd reduction(+:sum)
+				for(int c = 0; c < nbj; c++)
+					sum += row[c]*xj[c];
+				yi[r] += sum;
+			}
+		}
+	}
+}
+
+void BlockSparseMatrix::diagonalSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                      const Vector& b, Vector& x) const
+{
+#pragma omp parallel for default(shared)
+	for(a_int i = 0; i < nbrows; i++)
+		x.segment(rowstart[i], blockSize(i)) = dlu[i].solve(b.segment(rowstart[i], blockSize(i)));
+}
+
+template <typename Coupled>
+void BlockSparseMatrix::rowSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                 const a_int i, const Coupled& coupled, const a_real omega,
+                                 const Vector& b, Vector& x, Vector *const dx, Vector& r) const
+{
+	const int nb = blockSize(i);
+	r = b.segment(rowstart[i], nb);
+	for(a_int k = bptr[i]; k < bptr[i+1]; k++) {
+		const a_int j = bcolind[k];
+		if(coupled(j))
+			r.noalias() -= omega * Eigen::Map<const Matrix>(&vals[valptr[k]], nb, blockSize(j))
+				* x.segment(rowstart[j], blockSize(j));
+	}
+	x.segment(rowstart[i], nb) = dlu[i].solve(r);
+	if(dx)
+		dx->segment(rowstart[i], nb) = r;
+}
+
+void BlockSparseMatrix::lowerSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                   const Vector& b, Vector& x, const a_real omega,
+                                   Vector *const dx) const
+{
+	Vector r;
+	for(a_int i = 0; i < nbrows; i++)
+		rowSolve(dlu, i, [i](const a_int j) { return j < i; }, omega, b, x, dx, r);
+}
+
+void BlockSparseMatrix::upperSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                   const Vector& b, Vector& x, const a_real omega) const
+{
+	Vector r;
+	for(a_int i = nbrows-1; i >= 0; i--)
+		rowSolve(dlu, i, [i](const a_int j) { return j > i; }, omega, b, x, nullptr, r);
+}
+
+void BlockSparseMatrix::lowerSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                   const std::vector<int>& color,
+                                   const std::vector<a_int>& colorstart,
+                                   const std::vector<a_int>& colorder, const Vector& b, Vector& x,
+                                   const a_real omega, Vector *const dx) const
+{
+	Vector r;
+	const int ncolors = static_cast<int>(colorstart.size())-1;
+	for(int icolor = 0; icolor < ncolors; icolor++)
+	{
+#pragma omp parallel for default(shared) firstprivate(r)
+		for(a_int io = colorstart[icolor]; io < colorstart[icolor+1]; io++) {
+			const a_int i = colorder[io];
+			rowSolve(dlu, i, [&color,icolor](const a_int j) { return color[j] < icolor; },
+			         omega, b, x, dx, r);
+		}
+	}
+}
+
+void BlockSparseMatrix::upperSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+                                   const std::vector<int>& color,
+                                   const std::vector<a_int>& colorstart,
+                                   const std::vector<a_int>& colorder, const Vector& b, Vector& x,
+                                   const a_real omega) const
+{
+	Vector r;
+	const int ncolors = static_cast<int>(colorstart.size())-1;
+	for(int icolor = ncolors-1; icolor >= 0; icolor--)
+	{
+#pragma omp parallel for default(shared) firstprivate(r)
+		for(a_int io = colorstart[icolor]; io < colorstart[icolor+1]; io++) {
+			const a_int i = colorder[io];
+			rowSolve(dlu, i, [&color,icolor](const a_int j) { return color[j] > icolor; },
+			         omega, b, x, nullptr, r);
+		}
+	}
+}
+
+void BlockSparseMatrix::toSparse(Eigen::SparseMatrix<a_real>& a) const
+{
+	typedef Eigen::Triplet<a_real> COO;
+	std::vector<COO> coo;
+	coo.reserve(vals.size());
+	for(a_int i = 0; i < nbrows; i++)
+		for(a_int k = bptr[i]; k < bptr[i+1]; k++)
+		{
+			const a_int j = bcolind[k];
+			const Eigen::Map<const Matrix> blk(&vals[valptr[k]], blockSize(i), blockSize(j));
+			for(int ii = 0; ii < blk.rows(); ii++)
+				for(int jj = 0; jj < blk.cols(); jj++)
+					coo.push_back(COO(rowstart[i]+ii, rowstart[j]+jj, blk(ii,jj)));
+		}
+
+	a.resize(numRows(), numRows());
+	a.setFromTriplets(coo.begin(), coo.end());
+}
+
+}
@@ -0,0 +1,191 @@
+/** @file ablockmatrix.hpp
+ * @brief Block-sparse matrices of DG operators
+ * @author Aditya Kashi
+ */
+
+#ifndef ABLOCKMATRIX_H
+#define ABLOCKMATRIX_H
+
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+#include <Eigen/LU>
+#include <Eigen/Sparse>
+#include "aconstants.hpp"
+#include "mesh/amesh2dh.hpp"
+
+namespace tadgens {
+
+/// A sparse matrix made of dense blocks, in block compressed sparse row (BSR) format
+/** There is one block row (and block column) per element, of the size of the element's unknowns,
+ * and block row i has nonzero blocks in the block columns of element i and of its face neighbours,
+ * which is the pattern of DG operators with compact stencils. Blocks may have different sizes if
+ * elements have different numbers of DOFs.
+ *
+ * The block columns of each block row are sorted, so that the [diagonal block](@ref diagind)
+ * separates the strictly lower and upper parts. Each block is stored contiguously in row-major
+ * order, so that it can be used as a Matrix through an Eigen::Map. Compared to scalar CSR, only
+ * one column index is stored per block rather than per entry.
+ *
+ * The unknowns of block row i in vectors are at positions [rowStart(i), rowStart(i+1)); with the
+ * block sizes of [SpatialBase](@ref SpatialBase::setupJacobianMatrix), these are the positions of
+ * the DOFs of element i when they are numbered consecutively by element.
+ */
+class BlockSparseMatrix
+{
+public:
+	BlockSparseMatrix() : nbrows{0} { }
+
+	/// Sets up the sparsity pattern of an operator coupling each element with its face neighbours
+	/** All entries are set to zero.
+	 * \param[in] mesh The mesh, on which compute_topological must have been called
+	 * \param[in] blocksizes The number of unknowns of each element
+	 * \param[in] diagonalonly If true, only the diagonal blocks are stored, such as for
+	 *   block-Jacobi preconditioners
+	 */
+	void setStructure(const UMesh2dh *const mesh, const std::vector<int>& blocksizes,
+	                  const bool diagonalonly = false);
+
+	a_int numBlockRows() const { return nbrows; }
+
+	/// Total number of scalar rows
+	a_int numRows() const { return nbrows > 0 ? rowstart[nbrows] : 0; }
+
+	/// Number of nonzero blocks
+	a_int numBlocks() const { return nbrows > 0 ? bptr[nbrows] : 0; }
+
+	/// Whether only the diagonal blocks are stored
+	bool isBlockDiagonal() const { return numBlocks() == nbrows; }
+
+	/// Size of the square diagonal block of block row i
+	int blockSize(const a_int i) const { return rowstart[i+1]-rowstart[i]; }
+
+	/// Position of the first unknown of block row i
+	a_int rowStart(const a_int i) const { return rowstart[i]; }
+
+	/// Bytes of memory used for indices, excluding the values
+	size_t indexMemory() const {
+		return (rowstart.size() + bptr.size() + bcolind.size() + diagind.size())*sizeof(a_int)
+			+ valptr.size()*sizeof(size_t);
+	}
+
+	void setZero();
+
+	/// The block at block row i and block column j, which must be in the sparsity pattern
+	/** Otherwise, std::logic_error is thrown.
+	 */
+	Eigen::Map<Matrix> block(const a_int i, const a_int j) {
+		const a_int k = blockIndex(i,j);
+		return Eigen::Map<Matrix>(&vals[valptr[k]], blockSize(i), blockSize(j));
+	}
+
+	Eigen::Map<const Matrix> block(const a_int i, const a_int j) const {
+		const a_int k = blockIndex(i,j);
+		return Eigen::Map<const Matrix>(&vals[valptr[k]], blockSize(i), blockSize(j));
+	}
+
+	Eigen::Map<Matrix> diagonalBlock(const a_int i) {
+		return Eigen::Map<Matrix>(&vals[valptr[diagind[i]]], blockSize(i), blockSize(i));
+	}
+
+	Eigen::Map<const Matrix> diagonalBlock(const a_int i) const {
+		return Eigen::Map<const Matrix>(&vals[valptr[diagind[i]]], blockSize(i), blockSize(i));
+	}
+
+	/// Position of the first block of block row i; the blocks of the row are those from
+	/// rowBegin(i) to rowBegin(i+1)-1, in order of block column
+	a_int rowBegin(const a_int i) const { return bptr[i]; }
+
+	/// Block column of the k-th block
+	a_int blockColumn(const a_int k) const { return bcolind[k]; }
+
+	/// The k-th block, which is in block row i
+	Eigen::Map<const Matrix> blockAt(const a_int i, const a_int k) const {
+		return Eigen::Map<const Matrix>(&vals[valptr[k]], blockSize(i), blockSize(bcolind[k]));
+	}
+
+	/// Computes LU factorizations of the diagonal blocks, for the block solves below
+	void factorDiagonalBlocks(std::vector<Eigen::PartialPivLU<Matrix>>& dlu) const;
+
+	/// Computes y = A x, in parallel over block rows
+	void apply(const Vector& x, Vector& y) const;
+
+	/// Solves D x = b, where D is the block diagonal of the matrix, in parallel over block rows
+	/** \param[in] dlu Factorizations of the [diagonal blocks](@ref factorDiagonalBlocks)
+	 */
+	void diagonalSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu, const Vector& b,
+	                   Vector& x) const;
+
+	/// Solves (D + wL) x = b by forward substitution, where L is the strictly lower block triangle
+	/** \param[in] dlu Factorizations of the [diagonal blocks](@ref factorDiagonalBlocks)
+	 * \param[in] omega The factor w of the lower triangle
+	 * \param[out] dx If not null, D x = b - wLx, which is computed anyway, is stored in it
+	 */
+	void lowerSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu, const Vector& b,
+	                Vector& x, const a_real omega = 1.0, Vector *const dx = nullptr) const;
+
+	/// Solves (D + wU) x = b by backward substitution, where U is the strictly upper block triangle
+	/** \param[in] dlu Factorizations of the [diagonal blocks](@ref factorDiagonalBlocks)
+	 * \param[in] omega The factor w of the upper triangle
+	 */
+	void upperSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu, const Vector& b,
+	                Vector& x, const a_real omega = 1.0) const;
+
+	/// Solves (D + wL) x = b in multicolor ordering, where L holds the blocks coupling each block
+	/// row to block rows of lower color
+	/** Block rows of the same color must not be coupled. The colors are solved for in increasing
+	 * order, and the block rows of each color in parallel. This is the forward substitution of the
+	 * matrix permuted so that block rows are sorted by color.
+	 * \param[in] dlu Factorizations of the [diagonal blocks](@ref factorDiagonalBlocks)
+	 * \param[in] color The color of each block row
+	 * \param[in] colorstart Start of each color in colorder, with the number of block rows at the end
+	 * \param[in] colorder The block rows sorted by color
+	 * \param[out] dx If not null, D x is stored in it
+	 */
+	void lowerSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+	                const std::vector<int>& color, const std::vector<a_int>& colorstart,
+	                const std::vector<a_int>& colorder, const Vector& b, Vector& x,
+	                const a_real omega = 1.0, Vector *const dx = nullptr) const;
+
+	/// Solves (D + wU) x = b in multicolor ordering, where U holds the blocks coupling each block
+	/// row to block rows of higher color
+	/** The colors are solved for in decreasing order. The arguments are as for the
+	 * [multicolor forward substitution](@ref lowerSolve).
+	 */
+	void upperSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu,
+	                const std::vector<int>& color, const std::vector<a_int>& colorstart,
+	                const std::vector<a_int>& colorder, const Vector& b, Vector& x,
+	                const a_real omega = 1.0) const;
+
+	/// Copies the matrix into a scalar sparse matrix, such as for sparse direct solvers
+	void toSparse(Eigen::SparseMatrix<a_real>& a) const;
+
+protected:
+	a_int nbrows;                           ///< Number of block rows
+	std::vector<a_int> rowstart;            ///< Position of each block row's unknowns (nbrows+1)
+	std::vector<a_int> bptr;                ///< Start of each block row in bcolind (nbrows+1)
+	std::vector<a_int> bcolind;             ///< Block column of each block
+	std::vector<a_int> diagind;             ///< Index of the diagonal block of each block row
+	std::vector<size_t> valptr;             ///< Start of each block in vals
+	std::vector<a_real> vals;               ///< Entries of all blocks
+
+	/// Solves row i of (D + wT) x = b for the unknowns of block row i, where T holds the
+	/// off-diagonal blocks (i,j) of the row for which coupled(j) is true
+	/** If dx is not null, the part of D x of the block row is stored in it.
+	 */
+	template <typename Coupled>
+	void rowSolve(const std::vector<Eigen::PartialPivLU<Matrix>>& dlu, const a_int i,
+	              const Coupled& coupled, const a_real omega, const Vector& b, Vector& x,
+	              Vector *const dx, Vector& r) const;
+
+	/// Index of block (i,j) in the storage
+	a_int blockIndex(const a_int i, const a_int j) const {
+		for(a_int k = bptr[i]; k < bptr[i+1]; k++)
+			if(bcolind[k] == j)
+				return k;
+		throw std::logic_error("BlockSparseMatrix: block is not in the sparsity pattern");
+	}
+};
+
+}
+#endif
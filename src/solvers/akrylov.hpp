@@ -0,0 +1,115 @@
+/** @file akrylov.hpp
+ * @brief Krylov subspace solvers for linear systems given by operators
+ * @author Aditya Kashi
+ */
+
+#ifndef AKRYLOV_H
+#define AKRYLOV_H
+
+#include <cmath>
+#include <vector>
+#include "aconstants.hpp"
+
+namespace tadgens {
+
+/// Solves a linear system by restarted GMRES, right-preconditioned
+/** The operator and preconditioner are only accessed through the given functions, so they may be
+ * matrix-free. Orthogonalization is by modified Gram-Schmidt, and the least-squares problem is
+ * solved by Givens rotations, whose residual estimate is used for the convergence check.
+ * \param[in] matvec Computes y = A x when called as matvec(x, y)
+ * \param[in] precond Applies the preconditioner, z = P^{-1} r, when called as precond(r, z)
+ * \param[in] b The right hand side
+ * \param[in|out] x Initial guess on input, and the solution on output
+ * \param[in] restart Number of iterations after which the Krylov basis is discarded
+ * \param[in] maxiter Maximum total number of iterations
+ * \param[in] reltol Tolerance for the norm of the residual relative to that of b
+ * \param[out] relres The final relative residual
+ * \return The number of iterations carried out
+ */
+template <typename MatVec, typename Precond>
+int gmres(MatVec matvec, Precond precond, const Vector& b, Vector& x, const int restart,
+          const int maxiter, const a_real reltol, a_real& relres)
+{
+	const a_int n = static_cast<a_int>(b.size());
+	const a_real bnorm = b.norm();
+	relres = 0;
+	if(bnorm == 0) {
+		x.setZero();
+		return 0;
+	}
+
+	std::vector<Vector> v(restart+1, Vector(n));
+	Matrix h = Matrix::Zero(restart+1, restart);
+	Vector cs(restart), sn(restart), gs(restart+1);
+	Vector w(n), z(n), y(restart);
+
+	int iter = 0;
+	while(iter < maxiter)
+	{
+		// residual of the current iterate
+		matvec(x, w);
+		v[0] = b - w;
+		a_real beta = v[0].norm();
+		relres = beta/bnorm;
+		if(relres <= reltol)
+			break;
+		v[0] /= beta;
+		gs.setZero();
+		gs(0) = beta;
+
+		int k = 0;
+		for(; k < restart && iter < maxiter; k++, iter++)
+		{
+			precond(v[k], z);
+			matvec(z, w);
+			for(int i = 0; i <= k; i++) {
+				h(i,k) = w.dot(v[i]);
+				w -= h(i,k)*v[i];
+			}
+			h(k+1,k) = w.norm();
+			if(h(k+1,k) > 0)
+				v[k+1] = w/h(k+1,k);
+
+			// apply the previous rotations to the new column, then eliminate its subdiagonal entry
+			for(int i = 0; i < k; i++) {
+				const a_real temp = cs(i)*h(i,k) + sn(i)*h(i+1,k);
+				h(i+1,k) = -sn(i)*h(i,k) + cs(i)*h(i+1,k);
+				h(i,k) = temp;
+			}
+			const a_real r = std::sqrt(h(k,k)*h(k,k) + h(k+1,k)*h(k+1,k));
+			cs(k) = h(k,k)/r;
+			sn(k) = h(k+1,k)/r;
+			h(k,k) = r;
+			h(k+1,k) = 0;
+			gs(k+1) = -sn(k)*gs(k);
+			gs(k) = cs(k)*gs(k);
+
+			relres = std::fabs(gs(k+1))/bnorm;
+			if(relres <= reltol) {
+				k++; iter++;
+				break;
+			}
+		}
+
+		// solve the upper triangular system and update the iterate
+		for(int i = k-1; i >= 0; i--) {
+			y(i) = gs(i);
+			for(int j = i+1; j < k; j++)
+				y(i) -= h(i,j)*y(j);
+			y(i) /= h(i,i);
+		}
+		w.setZero();
+		for(int i = 0; i < k; i++)
+			w += y(i)*v[i];
+		precond(w, z);
+		x += z;
+
+		if(relres <= reltol)
+			break;
+	}
+
+	return iter;
+}
+
+}
+#endif
@@ -1,200 +1,98 @@
 /** @file alinalg.hpp
- * @brief Linear algebra subroutines
+ * @brief Preconditioners and relaxation solvers for block-sparse systems
  * @author Aditya Kashi
  */
 
 #ifndef ALINALG_H
 #define ALINALG_H
 
-#include <mesh/amesh2dh.hpp>
-#include <spatial/aeulerfluxnormal.hpp>
+#include <vector>
+#include <Eigen/LU>
+#include "ablockmatrix.hpp"
 
-namespace acfd {
+namespace tadgens {
 
-/// Solves Ax=b for dense A by Gaussian elimination
-void gausselim(amat::Matrix<acfd_real>& A, amat::Matrix<acfd_real>& b, amat::Matrix<acfd_real>& x);
-
-/// Factors A into unit lower triangular matrix and upper triangular matrix in place, with partial pivoting
-void LUfactor(amat::Matrix<acfd_real>& A, amat::Matrix<int>& p);
-
-/// Solve LUx = b
-/** \param A contains L and U
- * \param p is the permutation array
- * \param b is the RHS
- * \param x will contain the solution
+/// Base class for block iterative solvers of systems with a [block-sparse](@ref BlockSparseMatrix)
+/// matrix, usable either as preconditioners or as relaxation schemes
+/** One step of the iteration from a zero initial guess is z = P^{-1} r for some approximation P of
+ * the matrix. It can be used as a [preconditioner](@ref apply) for Krylov solvers, or repeated as
+ * the [stationary iteration](@ref relax) x <- x + P^{-1} (b - A x).
  */
-void LUsolve(const amat::Matrix<acfd_real>& A, const amat::Matrix<int>& p, const amat::Matrix<acfd_real>& b, amat::Matrix<acfd_real>& x);
-
-/// Base class for AF (approximate factorization)-type iterative linear solver
-class IterativeSolver
+class BlockIterativeSolver
 {
-protected:
-	const int nvars;								///< Number of conserved variables
-	const UMesh2dh* const m;						///< mesh
-	const amat::Matrix<acfd_real>* const res;		///< Vector of `residuals' at previous iteration
 public:
-	IterativeSolver(const int num_vars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual) 
-		: nvars(num_vars), m(mesh), res(residual)
-	{ }
+	/// Sets up the solver for a matrix, which must be kept alive and in place
+	BlockIterativeSolver(const BlockSparseMatrix *const matrix);
 
-	/// Supposed to carry a single step of the corresponding AF solver and store the correction in the argument
-	virtual void compute_update(amat::Matrix<acfd_real>* const deltau) = 0;
-
-	virtual ~IterativeSolver()
-	{ }
-};
-
-/// Base class for matrix-free iterative solvers of AF-type
-/** A FluxFunction object allows us to compute inviscid flux corresponding to a given state vector.
- * This is used to compute the action of the lower/upper parts of the (approximate) Jacobian on a given vector.
- * Adapted from reference: 
- * H. Luo, D. Sharov, J.D. Baum, R. Loehner. "On the Computation of Compressible Turbulent Flows on Unstructured Grids". Intl. Journal of Computational Fluid Dynamics Vol 14, No 4, pp 253-270. 2001.
- */
-class MatrixFreeIterativeSolver : public IterativeSolver
-{
-protected:
-	const FluxFunction* const invf;
-	const amat::Matrix<acfd_real>* const diag;			///< Diagonal blocks
-	const amat::Matrix<int>* const pa;					///< permuation array of diag after LU factorization
-	const amat::Matrix<acfd_real>* const lambdaij;		///< Eigenvalue part of the Jacobian
-	const amat::Matrix<acfd_real>* const elemflux;		///< Flux corresponding to the state at which Jacobian is to be computed
-	const amat::Matrix<acfd_real>* const u;				///< state at which Jacobian is to be computed
-public:
-	MatrixFreeIterativeSolver(const int num_vars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, const FluxFunction* const inviscid_flux,
-			const amat::Matrix<acfd_real>* const diagonal_blocks, const amat::Matrix<int>* const perm, const amat::Matrix<acfd_real>* const lambda_ij, const amat::Matrix<acfd_real>* const elem_flux,
-			const amat::Matrix<acfd_real>* const unk)
-		: IterativeSolver(num_vars, mesh, residual), invf(inviscid_flux), diag(diagonal_blocks), lambdaij(lambda_ij), pa(perm), u(unk), elemflux(elem_flux)
-	{
-	}
-	
-	virtual void compute_update(amat::Matrix<acfd_real>* const deltau) = 0;
-};
+	virtual ~BlockIterativeSolver() { }
 
-/// Matrix-free SSOR solver
-/** Adapted from reference: 
- * H. Luo, D. Sharov, J.D. Baum and R. Loehner. "On the Computation of Compressible Turbulent Flows on Unstructured Grids". Internation Journal of Computational Fluid Dynamics Vol14, No 4, pp 253-270.
- * 2001.
- */
-class SSOR_MFSolver : public MatrixFreeIterativeSolver
-{
-	
-	amat::Matrix<acfd_real> f1;
-	amat::Matrix<acfd_real> f2;
-	amat::Matrix<acfd_real> uelpdu;
-	amat::Matrix<acfd_real> elemres;
-	const double w;								///< Over-relaxation factor
-	acfd_int ielem, jelem, iface;
-	acfd_real s, sum;
-	acfd_real n[NDIM];
-	int jfa;
-	int ivar;
-	acfd_real lambda;
-	
-public:
+	/// Factors the diagonal blocks; must be called whenever the entries of the matrix change
+	virtual void compute();
 
-	SSOR_MFSolver(const int num_vars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, const FluxFunction* const inviscid_flux,
-			const amat::Matrix<acfd_real>* const diagonal_blocks, const amat::Matrix<int>* const perm, const amat::Matrix<acfd_real>* const lambda_ij, const amat::Matrix<acfd_real>* const elem_flux,
-			const amat::Matrix<acfd_real>* const unk, const double omega);
+	/// Carries out one step of the iteration from a zero initial guess, z = P^{-1} r
+	virtual void apply(const Vector& r, Vector& z) const = 0;
 
-	/// Carries out a single step (one forward followed by one backward sweep) of SSOR and stores the correction in the argument.
-	/** \note NOTE: Make sure deltau is an array of length nelem of type Matrix<acfd_real>(nvars,1).
+	/// Carries out steps of the iteration x <- x + P^{-1} (b - A x)
+	/** \param[in] b The right hand side
+	 * \param[in|out] x The initial guess on input, and the new iterate on output
+	 * \param[in] nsweeps The number of steps
 	 */
-	void compute_update(amat::Matrix<acfd_real>* const deltau);
-};
+	void relax(const Vector& b, Vector& x, const int nsweeps) const;
 
-/// Block Jacobi solver
-class BJ_MFSolver : public MatrixFreeIterativeSolver
-{
-	
-	amat::Matrix<acfd_real> f1;
-	amat::Matrix<acfd_real> f2;
-	amat::Matrix<acfd_real> uelpdu;
-	amat::Matrix<acfd_real> elemres;
-	const double w;								///< Over-relaxation factor
-	acfd_int ielem, jelem, iface;
-	acfd_real s, sum;
-	acfd_real n[NDIM];
-	int jfa;
-	int ivar;
-	acfd_real lambda;
-	
-public:
-
-	BJ_MFSolver(const int num_vars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, const FluxFunction* const inviscid_flux,
-			const amat::Matrix<acfd_real>* const diagonal_blocks, const amat::Matrix<int>* const perm, const amat::Matrix<acfd_real>* const lambda_ij, const amat::Matrix<acfd_real>* const elem_flux,
-			const amat::Matrix<acfd_real>* const unk, const double omega);
-
-	/// Carries out a single step (one forward followed by one backward sweep) of SSOR and stores the correction in the argument.
-	/** \note NOTE: Make sure deltau is an array of length nelem of type Matrix<acfd_real>(nvars,1).
-	 */
-	void compute_update(amat::Matrix<acfd_real>* const deltau);
+protected:
+	const BlockSparseMatrix *const A;                   ///< The matrix
+	std::vector<Eigen::PartialPivLU<Matrix>> dlu;       ///< Factorizations of the diagonal blocks
 };
 
-/// Full matrix storage version of the SSOR solver
-class SSOR_Solver : public IterativeSolver
+/// Block Jacobi: P is the block diagonal of the matrix
+/** Only the diagonal blocks are accessed, so the matrix may be
+ * [block-diagonal](@ref BlockSparseMatrix::isBlockDiagonal), as for Jacobian-free solvers.
+ */
+class BlockJacobi : public BlockIterativeSolver
 {
-	const amat::Matrix<acfd_real>* const D;
-	const amat::Matrix<int>* const Dpa;
-	const amat::Matrix<acfd_real>* const U;
-	const amat::Matrix<acfd_real>* const L;
-	const double w;
-	amat::Matrix<acfd_real> f1;
-	amat::Matrix<acfd_real> f2;
-	acfd_int i, j, ielem, jelem, iface;
-
 public:
-	SSOR_Solver(const int nvars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, 
-			const amat::Matrix<acfd_real>* const diag, const amat::Matrix<int>* const diagperm, const amat::Matrix<acfd_real>* const lower, const amat::Matrix<acfd_real>* const upper,
-			const double omega);
+	BlockJacobi(const BlockSparseMatrix *const matrix);
 
-	void compute_update(amat::Matrix<acfd_real>* const deltau);
+	void apply(const Vector& r, Vector& z) const;
 };
 
-/// Full matrix storage version of the BJ solver
-class BJ_Solver : public IterativeSolver
+/// Block symmetric successive over-relaxation
+/** With the matrix split as D + L + U into its block diagonal and strictly lower and upper parts,
+ * \f[ P = \frac{1}{\omega(2-\omega)} (D + \omega L) D^{-1} (D + \omega U). \f]
+ * P^{-1} r is computed by a [forward substitution](@ref BlockSparseMatrix::lowerSolve), which
+ * solves (D + wL) y = w(2-w) r, followed by a
+ * [backward substitution](@ref BlockSparseMatrix::upperSolve), which solves (D + wU) z = D y.
+ *
+ * With multicolor ordering, elements are colored greedily so that no two face neighbours (by
+ * the mesh's esuel) have the same color. The lower and upper parts are then the couplings to
+ * elements of lower and higher colors, and all elements of one color are updated in parallel in
+ * each sweep. Since the ordering differs from that of the element indices, the preconditioner
+ * differs from the sequential one, and is usually somewhat weaker. Otherwise, the sweeps are
+ * sequential in order of element index.
+ */
+class BlockSSOR : public BlockIterativeSolver
 {
-	const amat::Matrix<acfd_real>* const D;
-	const amat::Matrix<int>* const Dpa;
-	const double w;
-	
-	amat::Matrix<acfd_real> f1;
-	amat::Matrix<acfd_real> f2;
-	acfd_int ielem, jelem, iface;
-	acfd_real s, sum;
-	acfd_real n[NDIM];
-	int jfa;
-	int ivar;
-
 public:
-	BJ_Solver(const int nvars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, 
-			const amat::Matrix<acfd_real>* const diag, const amat::Matrix<int>* const diagperm, const amat::Matrix<acfd_real>* const lower, const amat::Matrix<acfd_real>* const upper,
-			const double omega);
+	/** \param[in] mesh The mesh whose elements are the block rows of the matrix
+	 * \param[in] matrix The matrix, whose off-diagonal blocks must be stored
+	 * \param[in] omega The relaxation factor, in (0,2)
+	 * \param[in] multicolor Whether to use multicolor ordering for parallel sweeps
+	 */
+	BlockSSOR(const UMesh2dh *const mesh, const BlockSparseMatrix *const matrix,
+	          const a_real omega, const bool multicolor);
 
-	void compute_update(amat::Matrix<acfd_real>* const deltau);
-};
+	void apply(const Vector& r, Vector& z) const;
 
-class BJ_Relaxation : public IterativeSolver
-{
-	const amat::Matrix<acfd_real>* const D;
-	const amat::Matrix<int>* const Dpa;
-	const amat::Matrix<acfd_real>* const U;
-	const amat::Matrix<acfd_real>* const L;
-	const double w;
-	
-	amat::Matrix<acfd_real> f1;
-	amat::Matrix<acfd_real> f2;
-	acfd_int ielem, jelem, iface;
-	acfd_real s, sum;
-	acfd_real n[NDIM];
-	int jfa;
-	int ivar;
+	/// Number of colors, or 0 for sequential sweeps
+	int numColors() const { return multicolor ? static_cast<int>(colorstart.size())-1 : 0; }
 
-public:
-	BJ_Relaxation(const int nvars, const UMesh2dh* const mesh, const amat::Matrix<acfd_real>* const residual, 
-			const amat::Matrix<acfd_real>* const diag, const amat::Matrix<int>* const diagperm, const amat::Matrix<acfd_real>* const lower, const amat::Matrix<acfd_real>* const upper,
-			const double omega);
+protected:
+	const a_real w;                             ///< Relaxation factor
+	const bool multicolor;                      ///< Whether multicolor ordering is used
 
-	void compute_update(amat::Matrix<acfd_real>* const deltau);
+	std::vector<int> color;                     ///< Color of each element, for multicolor ordering
+	std::vector<a_int> colorstart;              ///< Start of each color in colorder
+	std::vector<a_int> colorder;                ///< Elements sorted by color
 };
 
 }
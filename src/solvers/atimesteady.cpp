@@ -5,7 +5,12 @@
  */
 
 #include <iostream>
+#include <limits>
+#include <cassert>
+#include <stdexcept>
+#include <Eigen/LU>
 #include "atimesteady.hpp"
+#include "akrylov.hpp"
 
 namespace tadgens {
 
@@ -16,15 +21,10 @@ SteadyBase::SteadyBase(const UMesh2dh *const mesh, SpatialBase *const s,
 	std::cout << " SteadyBase: CFL = " << cfl << std::endl;
 
 	spatial->spatialSetup(u, R, tsl);
+	spatial->initializeUnknowns(u);
 
 	for(a_int iel = 0; iel < m->gnelem(); iel++)
-	{
-		for(int i = 0; i < u[iel].rows(); i++)
-			for(int j = 0; j < u[iel].cols(); j++) {
-				u[iel](i,j) = 1.0;
-				R[iel](i,j) = 0;
-			}
-	}
+		R[iel].setZero();
 }
 
 SteadyExplicit::SteadyExplicit(const UMesh2dh*const mesh, SpatialBase *const s,
@@ -37,7 +37,9 @@ void SteadyExplicit::solve()
 {
 	int step = 0;
 	double relresnorm = 1.0, resnorm0 = 1.0;
-	const std::vector<Matrix>& Mi = spatial->massInv();
+	std::vector<Matrix> dR(m->gnelem());
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		dR[iel].resize(R[iel].rows(), R[iel].cols());
 
 	while((relresnorm > tol && step < maxiter))
 	{
@@ -49,16 +51,19 @@ void SteadyExplicit::solve()
 
 		spatial->update_residual(u, R, tsl);
 
-		// step
+		// step; a lifted residual is already multiplied by the mass inverse
+		if(!spatial->isResidualLifted())
+			spatial->applyMassInverse(R, dR);
+		const std::vector<Matrix>& update = spatial->isResidualLifted() ? R : dR;
 		for(int iel = 0; iel < m->gnelem(); iel++)
 		{
-			u[iel] = u[iel] - cfl*tsl[iel]*R[iel]*Mi[iel];
+			u[iel] = u[iel] - cfl*tsl[iel]*update[iel];
 		}
 
 		//double resnorm = spatial->computeL2Norm(R, 0);
 		double resnorm = 0;
 		for(int iel = 0; iel < m->gnelem(); iel++) {
-			for(int j = 0; j < R[iel].rows(); j++)
+			for(int j = 0; j < R[iel].cols(); j++)
 			{
 				resnorm += R[iel](0,j)*R[iel](0,j);
 			}
@@ -77,44 +82,238 @@ void SteadyExplicit::solve()
 }
 
 SteadyImplicit::SteadyImplicit(const UMesh2dh*const mesh, SpatialBase *const s,
-                                      a_real cflnumber, double toler, int max_iter)
-	: SteadyBase(mesh, s, cflnumber, toler, max_iter)
+                               const a_real cflnumber, const a_real cflmaximum, double toler,
+                               int max_iter, const double lin_toler, const int lin_maxiter,
+                               const char prec_type)
+	: SteadyBase(mesh, s, cflnumber, toler, max_iter), cflmax(cflmaximum), lintol(lin_toler),
+	  linmaxiter(lin_maxiter), prectype(prec_type)
 {
+	std::printf(" SteadyImplicit: Max CFL = %f, linear solver tolerance = %e\n", cflmax, lintol);
+	if(!spatial->hasJacobian()) {
+		std::printf(" SteadyImplicit: ! The residual Jacobian is not available; use SteadyJFNK!\n");
+		throw std::logic_error("SteadyImplicit needs the Jacobian of the residual");
+	}
+	if(prectype != 'j' && prectype != 's') {
+		std::printf(" SteadyImplicit: ! Unknown preconditioner %c; using block Jacobi.\n", prectype);
+		prectype = 'j';
+	}
+
+	mass.resize(m->gnelem());
+	ElementGeometry egeom;
+#pragma omp parallel for default(shared) firstprivate(egeom)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		spatial->computeElemMassMatrix(iel, mass[iel], egeom);
 }
 
 void SteadyImplicit::solve()
 {
-	int step = 0;
-	double relresnorm = 1.0, resnorm0 = 1.0;
-	const std::vector<Matrix>& Mi = spatial->massInv();
+	const int nvars = spatial->numVars();
+	const a_int nelem = m->gnelem();
+	const a_int n = nvars*spatial->numTotalDOFs();
 
-	while((relresnorm > tol && step < maxiter))
+	BlockSparseMatrix jac;
+	spatial->setupJacobianMatrix(jac);
+	BlockIterativeSolver *const prec = prectype == 's' ?
+		static_cast<BlockIterativeSolver*>(new BlockSSOR(m, &jac, 1.0, true)) : new BlockJacobi(&jac);
+	Vector b(n), du(n);
+
+	auto matvec = [&jac](const Vector& x, Vector& y) { jac.apply(x, y); };
+	auto precond = [prec](const Vector& r, Vector& z) { prec->apply(r, z); };
+
+	int step = 0, totallin = 0;
+	double relresnorm = 1.0, resnorm0 = 1.0, curcfl = cfl;
+
+	while(relresnorm > tol && step < maxiter)
 	{
-		for(int iel = 0; iel < m->gnelem(); iel++) {
-			for(int i = 0; i < R[iel].rows(); i++)
-				for(int j = 0; j < R[iel].cols(); j++)
-					R[iel](i,j) = 0.0;
+		for(a_int iel = 0; iel < nelem; iel++)
+			R[iel].setZero();
+		spatial->update_residual(u, R, tsl);
+
+		double resnorm = 0;
+		for(a_int iel = 0; iel < nelem; iel++)
+			resnorm += R[iel].squaredNorm();
+		resnorm = std::sqrt(resnorm);
+		if(step == 0) resnorm0 = resnorm;
+		else relresnorm = resnorm/resnorm0;
+		if(relresnorm <= tol)
+			break;
+
+		// switched evolution relaxation
+		curcfl = std::fmin(cflmax, cfl*resnorm0/resnorm);
+
+		spatial->computeJacobian(u, jac);
+
+#pragma omp parallel for default(shared)
+		for(a_int iel = 0; iel < nelem; iel++)
+		{
+			const int ndofs = static_cast<int>(mass[iel].rows());
+			const a_real idt = 1.0/(curcfl*tsl[iel]);
+			Eigen::Map<Matrix> diag = jac.diagonalBlock(iel);
+			for(int ivar = 0; ivar < nvars; ivar++)
+				diag.block(ivar*ndofs, ivar*ndofs, ndofs, ndofs) += idt*mass[iel];
+
+			b.segment(jac.rowStart(iel), R[iel].size()) = -Eigen::Map<const Vector>(R[iel].data(), R[iel].size());
 		}
+		prec->compute();
 
-		spatial->update_residual(u, R, tsl);
+		du.setZero();
+		a_real linres;
+		const int linits = gmres(matvec, precond, b, du, linmaxiter, linmaxiter, lintol, linres);
+		totallin += linits;
 
-		// step
-		for(int iel = 0; iel < m->gnelem(); iel++)
+		for(a_int iel = 0; iel < nelem; iel++)
+			u[iel] += Eigen::Map<const Matrix>(du.data()+jac.rowStart(iel), u[iel].rows(), u[iel].cols());
+
+		step++;
+		std::printf("  SteadyImplicit: solve: Step %d, CFL %.2e, rel res %e, linear its %d, lin res %.2e\n",
+		            step, curcfl, relresnorm, linits, linres);
+	}
+
+	std::printf(" SteadyImplicit: solve: Total steps %d, linear iterations %d, final rel res = %e\n",
+	            step, totallin, relresnorm);
+	delete prec;
+}
+
+SteadyJFNK::SteadyJFNK(const UMesh2dh*const mesh, SpatialBase *const s,
+                       const a_real cflnumber, const a_real cflmaximum, double toler,
+                       int max_iter, const double lin_toler, const int lin_maxiter)
+	: SteadyBase(mesh, s, cflnumber, toler, max_iter), cflmax(cflmaximum), lintol(lin_toler),
+	  linmaxiter(lin_maxiter)
+{
+	std::printf(" SteadyJFNK: Max CFL = %f, linear solver tolerance = %e\n", cflmax, lintol);
+
+	mass.resize(m->gnelem());
+	ElementGeometry egeom;
+#pragma omp parallel for default(shared) firstprivate(egeom)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		if(spatial->isResidualLifted())
+			mass[iel] = Matrix::Identity(u[iel].cols(), u[iel].cols());
+		else
+			spatial->computeElemMassMatrix(iel, mass[iel], egeom);
+	}
+}
+
+void SteadyJFNK::solve()
+{
+	const bool localjac = spatial->hasJacobian();
+	if(!localjac)
+		std::printf(" SteadyJFNK: solve: Element Jacobians are not available; preconditioning by the"
+		            " mass matrices alone.\n");
+
+	const int nvars = spatial->numVars();
+	const a_int nelem = m->gnelem();
+
+	// only the diagonal blocks are stored
+	BlockSparseMatrix prec;
+	spatial->setupJacobianMatrix(prec, true);
+	BlockJacobi bj(&prec);
+	const a_int n = prec.numRows();
+	Vector b(n), du(n);
+
+	// state and residual perturbed for the finite differences, and unused time steps
+	std::vector<Matrix> up(nelem), Rp(nelem);
+	std::vector<a_real> tslp(nelem);
+	for(a_int iel = 0; iel < nelem; iel++) {
+		up[iel].resize(u[iel].rows(), u[iel].cols());
+		Rp[iel].resize(R[iel].rows(), R[iel].cols());
+	}
+
+	std::vector<a_real> idt(nelem);
+	const a_real sqrteps = std::sqrt(std::numeric_limits<a_real>::epsilon());
+	a_real unorm = 0;
+
+	// y = (M/dt) x + (R(u + eps x) - R(u))/eps
+	auto matvec = [&](const Vector& x, Vector& y) {
+		const a_real xnorm = x.norm();
+		if(xnorm == 0) {
+			y.setZero();
+			return;
+		}
+		const a_real eps = sqrteps*(1.0 + unorm)/xnorm;
+
+#pragma omp parallel for default(shared)
+		for(a_int iel = 0; iel < nelem; iel++) {
+			up[iel] = u[iel] + eps*Eigen::Map<const Matrix>(x.data()+prec.rowStart(iel),
+			                                                u[iel].rows(), u[iel].cols());
+			Rp[iel].setZero();
+		}
+
+		spatial->update_residual(up, Rp, tslp);
+
+#pragma omp parallel for default(shared)
+		for(a_int iel = 0; iel < nelem; iel++)
 		{
-			u[iel] = u[iel] - cfl*tsl[iel]*R[iel]*Mi[iel];
+			const int ndofs = static_cast<int>(mass[iel].rows());
+			const a_int start = prec.rowStart(iel);
+			Eigen::Map<Vector> yl(y.data()+start, nvars*ndofs);
+			yl = (Eigen::Map<const Vector>(Rp[iel].data(), nvars*ndofs)
+			      - Eigen::Map<const Vector>(R[iel].data(), nvars*ndofs))/eps;
+			for(int ivar = 0; ivar < nvars; ivar++)
+				yl.segment(ivar*ndofs, ndofs).noalias() += idt[iel]*mass[iel]*x.segment(start+ivar*ndofs, ndofs);
 		}
+	};
 
-		double resnorm = spatial->computeL2Norm(R, 0);
+	auto precond = [&bj](const Vector& r, Vector& z) { bj.apply(r, z); };
+
+	int step = 0, totallin = 0;
+	double relresnorm = 1.0, resnorm0 = 1.0, curcfl = cfl;
+
+	while(relresnorm > tol && step < maxiter)
+	{
+		for(a_int iel = 0; iel < nelem; iel++)
+			R[iel].setZero();
+		spatial->update_residual(u, R, tsl);
+
+		double resnorm = 0;
+		unorm = 0;
+		for(a_int iel = 0; iel < nelem; iel++) {
+			resnorm += R[iel].squaredNorm();
+			unorm += u[iel].squaredNorm();
+		}
+		resnorm = std::sqrt(resnorm);
+		unorm = std::sqrt(unorm);
 		if(step == 0) resnorm0 = resnorm;
 		else relresnorm = resnorm/resnorm0;
+		if(relresnorm <= tol)
+			break;
+
+		// switched evolution relaxation
+		curcfl = std::fmin(cflmax, cfl*resnorm0/resnorm);
+
+		if(localjac)
+			spatial->computeJacobian(u, prec);
+		else
+			prec.setZero();
+
+#pragma omp parallel for default(shared)
+		for(a_int iel = 0; iel < nelem; iel++)
+		{
+			const int ndofs = static_cast<int>(mass[iel].rows());
+			idt[iel] = 1.0/(curcfl*tsl[iel]);
+			Eigen::Map<Matrix> diag = prec.diagonalBlock(iel);
+			for(int ivar = 0; ivar < nvars; ivar++)
+				diag.block(ivar*ndofs, ivar*ndofs, ndofs, ndofs) += idt[iel]*mass[iel];
+
+			b.segment(prec.rowStart(iel), R[iel].size()) = -Eigen::Map<const Vector>(R[iel].data(), R[iel].size());
+		}
+		bj.compute();
+
+		du.setZero();
+		a_real linres;
+		const int linits = gmres(matvec, precond, b, du, linmaxiter, linmaxiter, lintol, linres);
+		totallin += linits;
+
+		for(a_int iel = 0; iel < nelem; iel++)
+			u[iel] += Eigen::Map<const Matrix>(du.data()+prec.rowStart(iel), u[iel].rows(), u[iel].cols());
 
 		step++;
-		if(step % 50 == 0)
-			std::cout << "  SteadyExplicit: integrate: Step " << step
-				<< ", rel res = " << relresnorm << std::endl;
+		std::printf("  SteadyJFNK: solve: Step %d, CFL %.2e, rel res %e, linear its %d, lin res %.2e\n",
+		            step, curcfl, relresnorm, linits, linres);
 	}
 
-	std::printf(" SteadyExplicit: integrate: Total steps %d, final rel res = %e\n", step, relresnorm);
+	std::printf(" SteadyJFNK: solve: Total steps %d, linear iterations %d, final rel res = %e\n",
+	            step, totallin, relresnorm);
 }
 
 }
@@ -8,6 +8,7 @@
 #define ATIMESTEADY_H
 
 #include "spatial/aspatial.hpp"
+#include "alinalg.hpp"
 
 namespace tadgens {
 
@@ -49,6 +50,8 @@ protected:
 public:
 	SteadyBase(const UMesh2dh*const mesh, SpatialBase* s,
 	           a_real cflnumber, double toler, int max_iter);
+
+	virtual ~SteadyBase() { }
 	
 	/// Read-only access to solution
 	const std::vector<Matrix>& solution() const {
@@ -77,20 +80,84 @@ public:
 };
 
 /// Implicit backward-Euler pseudo-time scheme with local time stepping
+/** Each step solves
+ * \f[ \left(\frac{M_i}{\Delta t_i} + \frac{\partial R}{\partial u}\right) \Delta u = -R(u) \f]
+ * where M_i is the mass matrix and \f$ \Delta t_i \f$ the local time step of element i, by
+ * [GMRES](@ref gmres) preconditioned by [block Jacobi](@ref BlockJacobi) or by one sweep of
+ * [multicolor block SSOR](@ref BlockSSOR).
+ * The [Jacobian](@ref SpatialBase::computeJacobian) of the residual is recomputed every step.
+ * The CFL number is ramped by switched evolution relaxation: it is the initial CFL number times
+ * the ratio of the initial residual norm to the current one, capped at a maximum.
+ * The residual norm is that of all variables.
+ */
 class SteadyImplicit : public SteadyBase
 {
 public:
 	/** \param[in] mesh The mesh context
-	 * \param[in] s The spatial discretization context
-	 * \param[in] cflnumber
+	 * \param[in] s The spatial discretization context, which must [provide](@ref
+	 *   SpatialBase::hasJacobian) the Jacobian of its residual; otherwise, std::logic_error
+	 *   is thrown
+	 * \param[in] cflnumber Initial CFL number
+	 * \param[in] cflmaximum Maximum CFL number
 	 * \param[in] toler Tolerance for the relative residual
 	 * \param[in] max_iter Maximum number of iterations
+	 * \param[in] lin_toler Relative tolerance of the linear solver in each step
+	 * \param[in] lin_maxiter Maximum number of linear solver iterations in each step
+	 * \param[in] prec_type The preconditioner: 'j' for block Jacobi or 's' for multicolor
+	 *   symmetric block Gauss-Seidel (SSOR with relaxation factor 1)
 	 */
 	SteadyImplicit(const UMesh2dh *const mesh, SpatialBase *const s,
-	               const a_real cflnumber, double toler, int max_iter);
+	               const a_real cflnumber, const a_real cflmaximum, double toler, int max_iter,
+	               const double lin_toler = 1e-3, const int lin_maxiter = 100,
+	               const char prec_type = 'j');
 
 	/// Carries out the time stepping process
 	void solve();
+
+protected:
+	double cflmax;                                  ///< Maximum CFL number
+	double lintol;                                  ///< Relative tolerance of linear solves
+	int linmaxiter;                                 ///< Maximum iterations of linear solves
+	char prectype;                                  ///< Preconditioner
+	std::vector<Matrix> mass;                       ///< Mass matrix of each element
+};
+
+/// Jacobian-free Newton-Krylov scheme with pseudo-transient continuation
+/** Each step solves the same system as [SteadyImplicit](@ref SteadyImplicit) by GMRES, but
+ * products with the Jacobian of the residual are approximated by finite differences,
+ * \f[ \frac{\partial R}{\partial u} v \approx \frac{R(u+\epsilon v) - R(u)}{\epsilon}, \f]
+ * at the cost of one residual evaluation per linear iteration. No Jacobian is stored; the
+ * preconditioner is [block Jacobi](@ref BlockJacobi) with the diagonal blocks \f$ M_i/\Delta t_i + \partial R_i/\partial
+ * u_i \f$ alone, which hold the mass matrix and the volume and face contributions of each
+ * element to its own residual. If the spatial discretization does not
+ * [provide](@ref SpatialBase::hasJacobian) Jacobians, the blocks only contain the mass term.
+ * The CFL number is ramped as in SteadyImplicit. For a lifted residual, which is already
+ * multiplied by the inverse mass matrix, the mass matrices are replaced by identities.
+ */
+class SteadyJFNK : public SteadyBase
+{
+public:
+	/** \param[in] mesh The mesh context
+	 * \param[in] s The spatial discretization context
+	 * \param[in] cflnumber Initial CFL number
+	 * \param[in] cflmaximum Maximum CFL number
+	 * \param[in] toler Tolerance for the relative residual
+	 * \param[in] max_iter Maximum number of iterations
+	 * \param[in] lin_toler Relative tolerance of the linear solver in each step
+	 * \param[in] lin_maxiter Maximum number of linear solver iterations in each step
+	 */
+	SteadyJFNK(const UMesh2dh *const mesh, SpatialBase *const s,
+	           const a_real cflnumber, const a_real cflmaximum, double toler, int max_iter,
+	           const double lin_toler = 1e-3, const int lin_maxiter = 100);
+
+	/// Carries out the time stepping process
+	void solve();
+
+protected:
+	double cflmax;                                  ///< Maximum CFL number
+	double lintol;                                  ///< Relative tolerance of linear solves
+	int linmaxiter;                                 ///< Maximum iterations of linear solves
+	std::vector<Matrix> mass;                       ///< Mass matrix of each element
 };
 
 }
@@ -1,322 +1,351 @@
-/** \file anumericalfluxeuler.cpp
- * \brief Implements numerical flux schemes for Euler equations.
- * \author Aditya Kashi
- * \date March 2015
- */
-
-#include "anumericalfluxeuler.hpp"
-
-namespace acfd {
-
-InviscidNumericalFlux::InviscidNumericalFlux(const a_real gamma) : g(gamma)
-{ }
-
-InviscidNumericalFlux::~InviscidNumericalFlux()
-{ }
-
-LocalLaxFriedrichsFlux::LocalLaxFriedrichsFlux(const a_real gamma) : InviscidNumericalFlux(gamma)
-{ }
-
-void LocalLaxFriedrichsFlux::get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux)
-{
-	a_real vni, vnj, ci, cj, eig;
-
-	//calculate presures from u
-	pi = (g-1)*(ul[3] - 0.5*(pow(ul[1],2)+pow(ul[2],2))/ul[0]);
-	pj = (g-1)*(ur[3] - 0.5*(pow(ur[1],2)+pow(ur[2],2))/ur[0]);
-	//calculate speeds of sound
-	ci = sqrt(g*pi/ul[0]);
-	cj = sqrt(g*pj/ur[0]);
-	//calculate normal velocities
-	vni = (ul[1]*n[0] + ul[2]*n[1])/ul[0];
-	vnj = (ur[1]*n[0] + ur[2]*n[1])/ur[0];
-	// max eigenvalue
-	eig = fabs(vni+ci) > fabs(vnj+cj) ? fabs(vni+ci) : fabs(vnj+cj);
-	
-	flux[0] = 0.5*( ul[0]*vni + ur[0]*vnj - eig*(ur[0]-ul[0]) );
-	flux[1] = 0.5*( vni*ul[1]+pi*n[0] + vnj*ur[1]+pj*n[0] - eig*(ur[1]-ul[1]) );
-	flux[2] = 0.5*( vni*ul[2]+pi*n[1] + vnj*ur[2]*pj*n[1] - eig*(ur[2]-ul[2]) );
-	flux[3] = 0.5*( vni*(ul[3]+pi) + vnj*(ur[3]+pj) - eig*(ur[3] - ul[3]) );
-}
-
-VanLeerFlux::VanLeerFlux(const a_real gamma) : InviscidNumericalFlux(gamma)
-{
-}
-
-void VanLeerFlux::get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux)
-{
-	a_real nx, ny, pi, ci, vni, Mni, pj, cj, vnj, Mnj, vmags;
-	a_real fiplus[NVARS], fjminus[NVARS];
-
-	nx = n[0];
-	ny = n[1];
-
-	//calculate presures from u
-	pi = (g-1)*(ul[3] - 0.5*(pow(ul[1],2)+pow(ul[2],2))/ul[0]);
-	pj = (g-1)*(ur[3] - 0.5*(pow(ur[1],2)+pow(ur[2],2))/ur[0]);
-	//calculate speeds of sound
-	ci = sqrt(g*pi/ul[0]);
-	cj = sqrt(g*pj/ur[0]);
-	//calculate normal velocities
-	vni = (ul[1]*nx +ul[2]*ny)/ul[0];
-	vnj = (ur[1]*nx + ur[2]*ny)/ur[0];
-
-	//Normal mach numbers
-	Mni = vni/ci;
-	Mnj = vnj/cj;
-
-	//Calculate split fluxes
-	if(Mni < -1.0)
-		for(int i = 0; i < NVARS; i++)
-			fiplus[i] = 0;
-	else if(Mni > 1.0)
-	{
-		fiplus[0] = ul[0]*vni;
-		fiplus[1] = vni*ul[1] + pi*nx;
-		fiplus[2] = vni*ul[2] + pi*ny;
-		fiplus[3] = vni*(ul[3] + pi);
-	}
-	else
-	{
-		vmags = pow(ul[1]/ul[0], 2) + pow(ul[2]/ul[0], 2);	// square of velocity magnitude
-		fiplus[0] = ul[0]*ci*pow(Mni+1, 2)/4.0;
-		fiplus[1] = fiplus[0] * (ul[1]/ul[0] + nx*(2.0*ci - vni)/g);
-		fiplus[2] = fiplus[0] * (ul[2]/ul[0] + ny*(2.0*ci - vni)/g);
-		fiplus[3] = fiplus[0] * ( (vmags - vni*vni)/2.0 + pow((g-1)*vni+2*ci, 2)/(2*(g*g-1)) );
-	}
-
-	if(Mnj > 1.0)
-		for(int i = 0; i < NVARS; i++)
-			fjminus[i] = 0;
-	else if(Mnj < -1.0)
-	{
-		fjminus[0] = ur[0]*vnj;
-		fjminus[1] = vnj*ur[1] + pj*nx;
-		fjminus[2] = vnj*ur[2] + pj*ny;
-		fjminus[3] = vnj*(ur[3] + pj);
-	}
-	else
-	{
-		vmags = pow(ur[1]/ur[0], 2) + pow(ur[2]/ur[0], 2);	// square of velocity magnitude
-		fjminus[0] = -ur[0]*cj*pow(Mnj-1, 2)/4.0;
-		fjminus[1] = fjminus[0] * (ur[1]/ur[0] + nx*(-2.0*cj - vnj)/g);
-		fjminus[2] = fjminus[0] * (ur[2]/ur[0] + ny*(-2.0*cj - vnj)/g);
-		fjminus[3] = fjminus[0] * ( (vmags - vnj*vnj)/2.0 + pow((g-1)*vnj-2*cj, 2)/(2*(g*g-1)) );
-	}
-
-	//Update the flux vector
-	for(int i = 0; i < NVARS; i++)
-		flux[i] = fiplus[i] + fjminus[i];
-}
-
-
-RoeFlux::RoeFlux(const a_real gamma) : InviscidNumericalFlux(gamma)
-{ }
-
-void RoeFlux::get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux)
-{
-	a_real Hi, Hj, ci, cj, pi, pj, vxi, vxj, vyi, vyj, vmag2i, vmag2j, vni, vnj;
-	int ivar;
-
-	vxi = ul[1]/ul[0]; vyi = ul[2]/ul[0];
-	vxj = ur[1]/ur[0]; vyj = ur[2]/ur[0];
-	vni = vxi*n[0] + vyi*n[1];
-	vnj = vxj*n[0] + vyj*n[1];
-	vmag2i = vxi*vxi + vyi*vyi;
-	vmag2j = vxj*vxj + vyj*vyj;
-	// pressures
-	pi = (g-1.0)*(ul[3] - 0.5*ul[0]*vmag2i);
-	pj = (g-1.0)*(ur[3] - 0.5*ur[0]*vmag2j);
-	// speeds of sound
-	ci = sqrt(g*pi/ul[0]);
-	cj = sqrt(g*pj/ur[0]);
-	// enthalpies  ( NOT E + p/rho = u(3)/u(0) + p/u(0) )
-	Hi = g/(g-1.0)* pi/ul[0] + 0.5*vmag2i;
-	Hj = g/(g-1.0)* pj/ur[0] + 0.5*vmag2j;
-
-	// compute Roe-averages
-	
-	a_real Rij, rhoij, vxij, vyij, Hij, cij, vm2ij, vnij;
-	Rij = sqrt(ur[0]/ul[0]);
-	rhoij = Rij*ul[0];
-	vxij = (Rij*vxj + vxi)/(Rij + 1.0);
-	vyij = (Rij*vyj + vyi)/(Rij + 1.0);
-	Hij = (Rij*Hj + Hi)/(Rij + 1.0);
-	vm2ij = vxij*vxij + vyij*vyij;
-	vnij = vxij*n[0] + vyij*n[1];
-	cij = sqrt( (g-1.0)*(Hij - vm2ij*0.5) );
-
-	// eigenvalues
-	a_real l[4];
-	l[0] = vnij; l[1] = vnij; l[2] = vnij + cij; l[3] = vnij - cij;
-
-	// Harten-Hyman entropy fix
-	a_real eps = 0;
-	if(eps < l[0]-vni) eps = l[0]-vni;
-	if(eps < vnj-l[0]) eps = vnj-l[0];
-	if(fabs(l[0]) < eps) l[0] = eps;
-	if(fabs(l[1]) < eps) l[1] = eps;
-
-	eps = 0;
-	if(eps < l[2]-(vni+ci)) eps = l[2]-(vni+ci);
-	if(eps < vnj+cj - l[2]) eps = vnj+cj - l[2];
-	if(fabs(l[2]) < eps) l[2] = eps;
-
-	eps = 0;
-	if(eps < l[3] - (vni-ci)) eps = l[3] - (vni-ci);
-	if(eps < vnj-cj - l[3]) eps = vnj-cj - l[3];
-	if(fabs(l[3]) < eps) l[3] = eps;
-
-	// eigenvectors (column vectors of r below)
-	a_real r[4][4];
-	
-	// according to Dr Luo's notes
-	r[0][0] = 1.0;		r[0][1] = 0;							r[0][2] = 1.0;				r[0][3] = 1.0;
-	r[1][0] = vxij;		r[1][1] = cij*n[1];						r[1][2] = vxij + cij*n[0];	r[1][3] = vxij - cij*n[0];
-	r[2][0] = vyij;		r[2][1] = -cij*n[0];					r[2][2] = vyij + cij*n[1];	r[2][3] = vyij - cij*n[1];
-	r[3][0]= vm2ij*0.5;	r[3][1] = cij*(vxij*n[1]-vyij*n[0]);	r[3][2] = Hij + cij*vnij;	r[3][3] = Hij - cij*vnij;
-
-	// according to Fink (just a hack to make the overall flux equal the Roe flux in Fink's paper;
-	// the second eigenvector is obviously not what is given below
-	/*r(0,0) = 1.0;		r(0,2) = 1.0;				r(0,3) = 1.0;
-	r(1,0) = vxij;		r(1,2) = vxij + cij*n[0];	r(1,3) = vxij - cij*n[0];
-	r(2,0) = vyij;		r(2,2) = vyij + cij*n[1];	r(2,3) = vyij - cij*n[1];
-	r(3,0)= vm2ij*0.5;	r(3,2) = Hij + cij*vnij;	r(3,3) = Hij - cij*vnij;
-	
-	r(0,1) = 0.0;
-	r(1,1) = (vxj-vxi) - n[0]*(vnj-vni);
-	r(2,1) = (vyj-vyi) - n[1]*(vnj-vni);
-	r(3,1) = vxij*(vxj-vxi) + vyij*(vyj-vyi) - vnij*(vnj-vni);*/
-	
-	for(ivar = 0; ivar < 4; ivar++)
-	{
-		r[ivar][2] *= rhoij/(2.0*cij);
-		r[ivar][3] *= rhoij/(2.0*cij);
-	}
-
-	// R^(-1)(qR-qL)
-	a_real dw[4];
-	dw[0] = (ur[0]-ul[0]) - (pj-pi)/(cij*cij);
-	dw[1] = (vxj-vxi)*n[1] - (vyj-vyi)*n[0];			// Dr Luo
-	//dw(1) = rhoij;										// hack for conformance with Fink
-	dw[2] = vnj-vni + (pj-pi)/(rhoij*cij);
-	dw[3] = -(vnj-vni) + (pj-pi)/(rhoij*cij);
-
-	// get one-sided flux vectors
-	a_real fi[4], fj[4];
-	fi[0] = ul[0]*vni;						fj[0] = ur[0]*vnj;
-	fi[1] = ul[0]*vni*vxi + pi*n[0];		fj[1] = ur[0]*vnj*vxj + pj*n[0];
-	fj[2] = ul[0]*vni*vyi + pi*n[1];		fj[2] = ur[0]*vnj*vyj + pj*n[1];
-	fj[3] = vni*(ul[3] + pi);				fj[3] = vnj*(ur[3] + pj);
-
-	// finally compute fluxes
-	a_real sum; int j;
-	for(ivar = 0; ivar < NVARS; ivar++)
-	{
-		sum = 0;
-		for(j = 0; j < NVARS; j++)
-			sum += fabs(l[j])*dw[j]*r[ivar][j];
-		flux[ivar] = 0.5*(fi[ivar]+fj[ivar] - sum);
-	}
-}
-
-HLLCFlux::HLLCFlux(const a_real gamma) : InviscidNumericalFlux(gamma)
-{
-}
-
-/** Currently, the estimated signal speeds are the classical estimates, not the corrected ones given by Remaki et. al.
- */
-void HLLCFlux::get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux)
-{
-	a_real Hi, Hj, ci, cj, pi, pj, vxi, vxj, vyi, vyj, vmag2i, vmag2j, vni, vnj, pstar;
-	a_real utemp[NVARS];
-	int ivar;
-
-	vxi = ul[1]/ul[0]; vyi = ul[2]/ul[0];
-	vxj = ur[1]/ur[0]; vyj = ur[2]/ur[0];
-	vni = vxi*n[0] + vyi*n[1];
-	vnj = vxj*n[0] + vyj*n[1];
-	vmag2i = vxi*vxi + vyi*vyi;
-	vmag2j = vxj*vxj + vyj*vyj;
-	// pressures
-	pi = (g-1.0)*(ul[3] - 0.5*ul[0]*vmag2i);
-	pj = (g-1.0)*(ur[3] - 0.5*ur[0]*vmag2j);
-	// speeds of sound
-	ci = sqrt(g*pi/ul[0]);
-	cj = sqrt(g*pj/ur[0]);
-	// enthalpies (E + p/rho = u(3)/u(0) + p/u(0) (actually specific enthalpy := enthalpy per unit mass)
-	Hi = (ul[3] + pi)/ul[0];
-	Hj = (ur[3] + pj)/ur[0];
-
-	// compute Roe-averages
-	a_real Rij, rhoij, vxij, vyij, Hij, cij, vm2ij, vnij;
-	Rij = sqrt(ur[0]/ul[0]);
-	rhoij = Rij*ul[0];
-	vxij = (Rij*vxj + vxi)/(Rij + 1.0);
-	vyij = (Rij*vyj + vyi)/(Rij + 1.0);
-	Hij = (Rij*Hj + Hi)/(Rij + 1.0);
-	vm2ij = vxij*vxij + vyij*vyij;
-	vnij = vxij*n[0] + vyij*n[1];
-	cij = sqrt( (g-1.0)*(Hij - vm2ij*0.5) );
-
-	// estimate signal speeds (classical; not Remaki corrected)
-	a_real sr, sl, sm;
-	sl = vni - ci;
-	if (sl > vnij-cij)
-		sl = vnij-cij;
-	sr = vnj+cj;
-	if(sr < vnij+cij)
-		sr = vnij+cij;
-	sm = ( ur[0]*vnj*(sr-vnj) - ul[0]*vni*(sl-vni) + pi-pj ) / ( ur[0]*(sr-vnj) - ul[0]*(sl-vni) );
-
-	// compute fluxes
-	
-	if(sl > 0)
-	{
-		flux[0] = vni*ul[0];
-		flux[1] = vni*ul[1] + pi*n[0];
-		flux[2] = vni*ul[2] + pi*n[1];
-		flux[3] = vni*(ul[3] + pi);
-	}
-	else if(sl <= 0 && sm > 0)
-	{
-		flux[0] = vni*ul[0];
-		flux[1] = vni*ul[1] + pi*n[0];
-		flux[2] = vni*ul[2] + pi*n[1];
-		flux[3] = vni*(ul[3] + pi);
-
-		pstar = ul[0]*(vni-sl)*(vni-sm) + pi;
-		utemp[0] = ul[0] * (sl - vni)/(sl-sm);
-		utemp[1] = ( (sl-vni)*ul[1] + (pstar-pi)*n[0] )/(sl-sm);
-		utemp[2] = ( (sl-vni)*ul[2] + (pstar-pi)*n[1] )/(sl-sm);
-		utemp[3] = ( (sl-vni)*ul[3] - pi*vni + pstar*sm )/(sl-sm);
-
-		for(ivar = 0; ivar < NVARS; ivar++)
-			flux[ivar] += sl * ( utemp[ivar] - ul[ivar]);
-	}
-	else if(sm <= 0 && sr >= 0)
-	{
-		flux[0] = vnj*ur[0];
-		flux[1] = vnj*ur[1] + pj*n[0];
-		flux[2] = vnj*ur[2] + pj*n[1];
-		flux[3] = vnj*(ur[3] + pj);
-
-		pstar = ur[0]*(vnj-sr)*(vnj-sm) + pj;
-		utemp[0] = ur[0] * (sr - vnj)/(sr-sm);
-		utemp[1] = ( (sr-vnj)*ur[1] + (pstar-pj)*n[0] )/(sr-sm);
-		utemp[2] = ( (sr-vnj)*ur[2] + (pstar-pj)*n[1] )/(sr-sm);
-		utemp[3] = ( (sr-vnj)*ur[3] - pj*vnj + pstar*sm )/(sr-sm);
-
-		for(ivar = 0; ivar < NVARS; ivar++)
-			flux[ivar] += sr * ( utemp[ivar] - ur[ivar]);
-	}
-	else
-	{
-		flux[0] = vnj*ur[0];
-		flux[1] = vnj*ur[1] + pj*n[0];
-		flux[2] = vnj*ur[2] + pj*n[1];
-		flux[3] = vnj*(ur[3] + pj);
-	}
-}
-
-} // end namespace acfd
+/** \file anumericalfluxeuler.cpp
+ * \brief Implements numerical flux schemes for Euler equations.
+ * \author Aditya Kashi
+ * \date March 2015
+ */
+
+#include <cmath>
+#include <vector>
+#include "anumericalfluxeuler.hpp"
+#include "utilities/adual.hpp"
+
+namespace tadgens {
+
+/// Larger of two numbers, by selection
+/** Unlike std::fmax, which must return the other argument if one is NaN, this compiles to a
+ * comparison and a blend in vectorized loops. For [dual numbers](@ref Dual), the derivatives
+ * of the selected argument are taken, as by their fmax.
+ */
+template <typename scalar>
+static inline scalar maxsel(const scalar& a, const scalar& b)
+{
+	return a >= b ? a : b;
+}
+
+/// Smaller of two numbers, by selection
+template <typename scalar>
+static inline scalar minsel(const scalar& a, const scalar& b)
+{
+	return a <= b ? a : b;
+}
+
+InviscidNumericalFlux::InviscidNumericalFlux(const a_real gamma) : g(gamma)
+{ }
+
+InviscidNumericalFlux::~InviscidNumericalFlux()
+{ }
+
+/** Each component of the state is perturbed at all points at once, by a step relative to its size.
+ */
+void InviscidNumericalFlux::get_jacobians(const int npts, const a_real *const ul,
+		const a_real *const ur, const a_real* const n, a_real *const dfdl, a_real *const dfdr) const
+{
+	const int nv = 4;
+	const a_real eps = 1.0e-7;
+	std::vector<a_real> flux(nv*npts), fluxp(nv*npts), up(nv*npts), h(npts);
+	get_fluxes(npts, ul, ur, n, &flux[0]);
+
+	for(int side = 0; side < 2; side++)
+	{
+		const a_real *const u = side == 0 ? ul : ur;
+		a_real *const dfdu = side == 0 ? dfdl : dfdr;
+		for(int j = 0; j < nv; j++)
+		{
+			for(int k = 0; k < nv*npts; k++)
+				up[k] = u[k];
+			for(int ip = 0; ip < npts; ip++) {
+				h[ip] = eps*std::fmax(std::fabs(u[j*npts+ip]), 1.0);
+				up[j*npts+ip] += h[ip];
+			}
+			get_fluxes(npts, side == 0 ? &up[0] : ul, side == 0 ? ur : &up[0], n, &fluxp[0]);
+			for(int i = 0; i < nv; i++)
+				for(int ip = 0; ip < npts; ip++)
+					dfdu[(i*nv+j)*npts+ip] = (fluxp[i*npts+ip] - flux[i*npts+ip])/h[ip];
+		}
+	}
+}
+
+/** The points are processed in a vectorizable loop, which the flux at one point is inlined into.
+ * The states are read from and the fluxes written to the arrays directly, with a stride of npts.
+ */
+template <typename Flux>
+void DifferentiableNumericalFlux<Flux>::get_fluxes(const int npts, const a_real *const __restrict__ ul,
+		const a_real *const __restrict__ ur, const a_real* const __restrict__ n,
+		a_real *const __restrict__ flux) const
+{
+	const Flux& f = static_cast<const Flux&>(*this);
+#pragma omp simd
+	for(int ip = 0; ip < npts; ip++)
+		f.compute_flux(ul+ip, ur+ip, npts, n[ip], n[npts+ip], flux+ip);
+}
+
+/** The left states are seeded with derivative directions 0 to 3 and the right states with 4 to 7,
+ * so that one evaluation of the flux in dual numbers gives both Jacobians.
+ */
+template <typename Flux>
+void DifferentiableNumericalFlux<Flux>::get_jacobians(const int npts,
+		const a_real *const __restrict__ ul, const a_real *const __restrict__ ur,
+		const a_real* const __restrict__ n, a_real *const __restrict__ dfdl,
+		a_real *const __restrict__ dfdr) const
+{
+	const Flux& f = static_cast<const Flux&>(*this);
+	for(int ip = 0; ip < npts; ip++)
+	{
+		Dual<8> uli[4], uri[4], fi[4];
+		for(int j = 0; j < 4; j++) {
+			uli[j] = Dual<8>(ul[j*npts+ip], j);
+			uri[j] = Dual<8>(ur[j*npts+ip], 4+j);
+		}
+		f.compute_flux(uli, uri, 1, n[ip], n[npts+ip], fi);
+		for(int i = 0; i < 4; i++)
+			for(int j = 0; j < 4; j++) {
+				dfdl[(i*4+j)*npts+ip] = fi[i].d[j];
+				dfdr[(i*4+j)*npts+ip] = fi[i].d[4+j];
+			}
+	}
+}
+
+LocalLaxFriedrichsFlux::LocalLaxFriedrichsFlux(const a_real gamma)
+	: DifferentiableNumericalFlux<LocalLaxFriedrichsFlux>(gamma)
+{ }
+
+template <typename scalar>
+inline void LocalLaxFriedrichsFlux::compute_flux(const scalar *const ul, const scalar *const ur,
+		const int stride, const a_real nx, const a_real ny, scalar *const flux) const
+{
+	using std::sqrt; using std::fabs;
+	const scalar rhoi = ul[0], rhovxi = ul[stride], rhovyi = ul[2*stride], rhoEi = ul[3*stride];
+	const scalar rhoj = ur[0], rhovxj = ur[stride], rhovyj = ur[2*stride], rhoEj = ur[3*stride];
+
+	//calculate presures from u
+	const scalar pi = (g-1)*(rhoEi - 0.5*(rhovxi*rhovxi + rhovyi*rhovyi)/rhoi);
+	const scalar pj = (g-1)*(rhoEj - 0.5*(rhovxj*rhovxj + rhovyj*rhovyj)/rhoj);
+	//calculate speeds of sound
+	const scalar ci = sqrt(g*pi/rhoi);
+	const scalar cj = sqrt(g*pj/rhoj);
+	//calculate normal velocities
+	const scalar vni = (rhovxi*nx + rhovyi*ny)/rhoi;
+	const scalar vnj = (rhovxj*nx + rhovyj*ny)/rhoj;
+	// max eigenvalue
+	const scalar eig = maxsel(fabs(vni)+ci, fabs(vnj)+cj);
+
+	flux[0] = 0.5*( rhoi*vni + rhoj*vnj - eig*(rhoj-rhoi) );
+	flux[stride] = 0.5*( vni*rhovxi+pi*nx + vnj*rhovxj+pj*nx - eig*(rhovxj-rhovxi) );
+	flux[2*stride] = 0.5*( vni*rhovyi+pi*ny + vnj*rhovyj+pj*ny - eig*(rhovyj-rhovyi) );
+	flux[3*stride] = 0.5*( vni*(rhoEi+pi) + vnj*(rhoEj+pj) - eig*(rhoEj-rhoEi) );
+}
+
+VanLeerFlux::VanLeerFlux(const a_real gamma) : DifferentiableNumericalFlux<VanLeerFlux>(gamma)
+{
+}
+
+/** Both the subsonic and the supersonic split fluxes are computed on each side, and the one that
+ * applies is selected by weights of 0 or 1, so that the compiler need not branch on the regime.
+ */
+template <typename scalar>
+inline void VanLeerFlux::compute_flux(const scalar *const ul, const scalar *const ur,
+		const int stride, const a_real nx, const a_real ny, scalar *const flux) const
+{
+	using std::sqrt;
+	const scalar rhoi = ul[0], rhovxi = ul[stride], rhovyi = ul[2*stride], rhoEi = ul[3*stride];
+	const scalar rhoj = ur[0], rhovxj = ur[stride], rhovyj = ur[2*stride], rhoEj = ur[3*stride];
+	const scalar vxi = rhovxi/rhoi, vyi = rhovyi/rhoi, vxj = rhovxj/rhoj, vyj = rhovyj/rhoj;
+
+	//calculate presures from u
+	const scalar pi = (g-1)*(rhoEi - 0.5*rhoi*(vxi*vxi + vyi*vyi));
+	const scalar pj = (g-1)*(rhoEj - 0.5*rhoj*(vxj*vxj + vyj*vyj));
+	//calculate speeds of sound
+	const scalar ci = sqrt(g*pi/rhoi);
+	const scalar cj = sqrt(g*pj/rhoj);
+	//calculate normal velocities
+	const scalar vni = vxi*nx + vyi*ny;
+	const scalar vnj = vxj*nx + vyj*ny;
+
+	//Normal mach numbers
+	const scalar Mni = vni/ci;
+	const scalar Mnj = vnj/cj;
+
+	// subsonic split fluxes
+	const scalar vmagsi = vxi*vxi + vyi*vyi, vmagsj = vxj*vxj + vyj*vyj;
+	const scalar fp0 = rhoi*ci*(Mni+1)*(Mni+1)/4.0;
+	const scalar fp1 = fp0 * (vxi + nx*(2.0*ci - vni)/g);
+	const scalar fp2 = fp0 * (vyi + ny*(2.0*ci - vni)/g);
+	const scalar fp3 = fp0 * ( (vmagsi - vni*vni)/2.0
+	                           + ((g-1)*vni+2*ci)*((g-1)*vni+2*ci)/(2*(g*g-1)) );
+	const scalar fm0 = -rhoj*cj*(Mnj-1)*(Mnj-1)/4.0;
+	const scalar fm1 = fm0 * (vxj + nx*(-2.0*cj - vnj)/g);
+	const scalar fm2 = fm0 * (vyj + ny*(-2.0*cj - vnj)/g);
+	const scalar fm3 = fm0 * ( (vmagsj - vnj*vnj)/2.0
+	                           + ((g-1)*vnj-2*cj)*((g-1)*vnj-2*cj)/(2*(g*g-1)) );
+
+	// full fluxes, for supersonic flow
+	const scalar gi0 = rhoi*vni, gi1 = vni*rhovxi + pi*nx, gi2 = vni*rhovyi + pi*ny,
+	      gi3 = vni*(rhoEi + pi);
+	const scalar gj0 = rhoj*vnj, gj1 = vnj*rhovxj + pj*nx, gj2 = vnj*rhovyj + pj*ny,
+	      gj3 = vnj*(rhoEj + pj);
+
+	// weights selecting between zero, the full flux and the subsonic split flux
+	const a_real wif = Mni > 1.0 ? 1.0 : 0.0, wis = (Mni >= -1.0 ? 1.0 : 0.0) - wif;
+	const a_real wjf = Mnj < -1.0 ? 1.0 : 0.0, wjs = (Mnj <= 1.0 ? 1.0 : 0.0) - wjf;
+
+	flux[0] = wif*gi0 + wis*fp0 + wjf*gj0 + wjs*fm0;
+	flux[stride] = wif*gi1 + wis*fp1 + wjf*gj1 + wjs*fm1;
+	flux[2*stride] = wif*gi2 + wis*fp2 + wjf*gj2 + wjs*fm2;
+	flux[3*stride] = wif*gi3 + wis*fp3 + wjf*gj3 + wjs*fm3;
+}
+
+
+RoeFlux::RoeFlux(const a_real gamma) : DifferentiableNumericalFlux<RoeFlux>(gamma)
+{ }
+
+template <typename scalar>
+inline void RoeFlux::compute_flux(const scalar *const ul, const scalar *const ur,
+		const int stride, const a_real nx, const a_real ny, scalar *const flux) const
+{
+	using std::sqrt; using std::fabs;
+	const scalar rhoi = ul[0], rhoEi = ul[3*stride];
+	const scalar rhoj = ur[0], rhoEj = ur[3*stride];
+
+	const scalar vxi = ul[stride]/rhoi, vyi = ul[2*stride]/rhoi;
+	const scalar vxj = ur[stride]/rhoj, vyj = ur[2*stride]/rhoj;
+	const scalar vni = vxi*nx + vyi*ny;
+	const scalar vnj = vxj*nx + vyj*ny;
+	const scalar vmag2i = vxi*vxi + vyi*vyi;
+	const scalar vmag2j = vxj*vxj + vyj*vyj;
+	// pressures
+	const scalar pi = (g-1.0)*(rhoEi - 0.5*rhoi*vmag2i);
+	const scalar pj = (g-1.0)*(rhoEj - 0.5*rhoj*vmag2j);
+	// speeds of sound
+	const scalar ci = sqrt(g*pi/rhoi);
+	const scalar cj = sqrt(g*pj/rhoj);
+	// enthalpies  ( NOT E + p/rho = u(3)/u(0) + p/u(0) )
+	const scalar Hi = g/(g-1.0)* pi/rhoi + 0.5*vmag2i;
+	const scalar Hj = g/(g-1.0)* pj/rhoj + 0.5*vmag2j;
+
+	// compute Roe-averages
+	const scalar Rij = sqrt(rhoj/rhoi);
+	const scalar rhoij = Rij*rhoi;
+	const scalar vxij = (Rij*vxj + vxi)/(Rij + 1.0);
+	const scalar vyij = (Rij*vyj + vyi)/(Rij + 1.0);
+	const scalar Hij = (Rij*Hj + Hi)/(Rij + 1.0);
+	const scalar vm2ij = vxij*vxij + vyij*vyij;
+	const scalar vnij = vxij*nx + vyij*ny;
+	const scalar cij = sqrt( (g-1.0)*(Hij - vm2ij*0.5) );
+
+	// magnitudes of eigenvalues, with the Harten-Hyman entropy fix
+	const scalar l0 = vnij, l2 = vnij + cij, l3 = vnij - cij;
+	const scalar zero = 0;
+	const scalar eps0 = maxsel(zero, maxsel(l0-vni, vnj-l0));
+	const scalar eps2 = maxsel(zero, maxsel(l2-(vni+ci), vnj+cj-l2));
+	const scalar eps3 = maxsel(zero, maxsel(l3-(vni-ci), vnj-cj-l3));
+	const scalar al0 = maxsel(fabs(l0), eps0);
+	const scalar al2 = maxsel(fabs(l2), eps2);
+	const scalar al3 = maxsel(fabs(l3), eps3);
+
+	// R^(-1)(qR-qL), times the eigenvalue magnitudes
+	const scalar a0 = al0*((rhoj-rhoi) - (pj-pi)/(cij*cij));
+	const scalar a1 = al0*((vxj-vxi)*ny - (vyj-vyi)*nx);
+	const scalar a2 = al2*(vnj-vni + (pj-pi)/(rhoij*cij)) * rhoij/(2.0*cij);
+	const scalar a3 = al3*(-(vnj-vni) + (pj-pi)/(rhoij*cij)) * rhoij/(2.0*cij);
+
+	// dissipation: sum of eigenvectors (according to Dr Luo's notes) times the above
+	const scalar d0 = a0 + a2 + a3;
+	const scalar d1 = a0*vxij + a1*rhoij*ny + a2*(vxij + cij*nx) + a3*(vxij - cij*nx);
+	const scalar d2 = a0*vyij - a1*rhoij*nx + a2*(vyij + cij*ny) + a3*(vyij - cij*ny);
+	const scalar d3 = a0*vm2ij*0.5 + a1*rhoij*(vxij*ny-vyij*nx) + a2*(Hij + cij*vnij)
+		+ a3*(Hij - cij*vnij);
+
+	// one-sided flux vectors, then the fluxes
+	flux[0] = 0.5*(rhoi*vni + rhoj*vnj - d0);
+	flux[stride] = 0.5*(rhoi*vni*vxi + pi*nx + rhoj*vnj*vxj + pj*nx - d1);
+	flux[2*stride] = 0.5*(rhoi*vni*vyi + pi*ny + rhoj*vnj*vyj + pj*ny - d2);
+	flux[3*stride] = 0.5*(vni*(rhoEi + pi) + vnj*(rhoEj + pj) - d3);
+}
+
+HLLCFlux::HLLCFlux(const a_real gamma) : DifferentiableNumericalFlux<HLLCFlux>(gamma)
+{
+}
+
+/** Currently, the estimated signal speeds are the classical estimates, not the corrected ones given by Remaki et. al.
+ * The fluxes of both star states are computed, and the one that applies is selected by weights of
+ * 0 or 1, so that the compiler need not branch on the wave pattern.
+ */
+template <typename scalar>
+inline void HLLCFlux::compute_flux(const scalar *const ul, const scalar *const ur,
+		const int stride, const a_real nx, const a_real ny, scalar *const flux) const
+{
+	using std::sqrt;
+	const scalar rhoi = ul[0], rhovxi = ul[stride], rhovyi = ul[2*stride], rhoEi = ul[3*stride];
+	const scalar rhoj = ur[0], rhovxj = ur[stride], rhovyj = ur[2*stride], rhoEj = ur[3*stride];
+
+	const scalar vxi = rhovxi/rhoi, vyi = rhovyi/rhoi;
+	const scalar vxj = rhovxj/rhoj, vyj = rhovyj/rhoj;
+	const scalar vni = vxi*nx + vyi*ny;
+	const scalar vnj = vxj*nx + vyj*ny;
+	const scalar vmag2i = vxi*vxi + vyi*vyi;
+	const scalar vmag2j = vxj*vxj + vyj*vyj;
+	// pressures
+	const scalar pi = (g-1.0)*(rhoEi - 0.5*rhoi*vmag2i);
+	const scalar pj = (g-1.0)*(rhoEj - 0.5*rhoj*vmag2j);
+	// speeds of sound
+	const scalar ci = sqrt(g*pi/rhoi);
+	const scalar cj = sqrt(g*pj/rhoj);
+	// enthalpies (E + p/rho = u(3)/u(0) + p/u(0) (actually specific enthalpy := enthalpy per unit mass)
+	const scalar Hi = (rhoEi + pi)/rhoi;
+	const scalar Hj = (rhoEj + pj)/rhoj;
+
+	// compute Roe-averages
+	const scalar Rij = sqrt(rhoj/rhoi);
+	const scalar vxij = (Rij*vxj + vxi)/(Rij + 1.0);
+	const scalar vyij = (Rij*vyj + vyi)/(Rij + 1.0);
+	const scalar Hij = (Rij*Hj + Hi)/(Rij + 1.0);
+	const scalar vm2ij = vxij*vxij + vyij*vyij;
+	const scalar vnij = vxij*nx + vyij*ny;
+	const scalar cij = sqrt( (g-1.0)*(Hij - vm2ij*0.5) );
+
+	// estimate signal speeds (classical; not Remaki corrected)
+	const scalar sl = minsel(vni - ci, vnij - cij);
+	const scalar sr = maxsel(vnj + cj, vnij + cij);
+	const scalar sm = ( rhoj*vnj*(sr-vnj) - rhoi*vni*(sl-vni) + pi-pj )
+		/ ( rhoj*(sr-vnj) - rhoi*(sl-vni) );
+
+	// one-sided physical fluxes
+	const scalar fi[] = {vni*rhoi, vni*rhovxi + pi*nx, vni*rhovyi + pi*ny, vni*(rhoEi + pi)};
+	const scalar fj[] = {vnj*rhoj, vnj*rhovxj + pj*nx, vnj*rhovyj + pj*ny, vnj*(rhoEj + pj)};
+
+	// star states
+	const scalar pstari = rhoi*(vni-sl)*(vni-sm) + pi;
+	const scalar di = 1.0/(sl-sm);
+	const scalar ustari[] = {rhoi*(sl - vni)*di,
+	                         ( (sl-vni)*rhovxi + (pstari-pi)*nx )*di,
+	                         ( (sl-vni)*rhovyi + (pstari-pi)*ny )*di,
+	                         ( (sl-vni)*rhoEi - pi*vni + pstari*sm )*di};
+	const scalar pstarj = rhoj*(vnj-sr)*(vnj-sm) + pj;
+	const scalar dj = 1.0/(sr-sm);
+	const scalar ustarj[] = {rhoj*(sr - vnj)*dj,
+	                         ( (sr-vnj)*rhovxj + (pstarj-pj)*nx )*dj,
+	                         ( (sr-vnj)*rhovyj + (pstarj-pj)*ny )*dj,
+	                         ( (sr-vnj)*rhoEj - pj*vnj + pstarj*sm )*dj};
+
+	// weights of 0 or 1 selecting the region of the wave pattern containing the face
+	const a_real wl = sl > 0 ? 1.0 : 0.0;
+	const a_real wsl = (1.0-wl)*(sm > 0 ? 1.0 : 0.0);
+	const a_real wsr = (1.0-wl-wsl)*(sr >= 0 ? 1.0 : 0.0);
+	const a_real wr = 1.0-wl-wsl-wsr;
+
+	const scalar ui[] = {rhoi, rhovxi, rhovyi, rhoEi};
+	const scalar uj[] = {rhoj, rhovxj, rhovyj, rhoEj};
+	for(int ivar = 0; ivar < 4; ivar++)
+	{
+		const scalar fstari = fi[ivar] + sl*(ustari[ivar] - ui[ivar]);
+		const scalar fstarj = fj[ivar] + sr*(ustarj[ivar] - uj[ivar]);
+		flux[ivar*stride] = wl*fi[ivar] + wsl*fstari + wsr*fstarj + wr*fj[ivar];
+	}
+}
+
+template class DifferentiableNumericalFlux<LocalLaxFriedrichsFlux>;
+template class DifferentiableNumericalFlux<VanLeerFlux>;
+template class DifferentiableNumericalFlux<RoeFlux>;
+template class DifferentiableNumericalFlux<HLLCFlux>;
+
+} // end namespace tadgens
@@ -1,79 +1,157 @@
-/** \file anumericalfluxeuler.hpp
- * \brief Numerical flux schemes for Euler equations.
- * \author Aditya Kashi
- * \date March 2015
- */
-
-#ifndef __ANUMERICALFLUXEULER_H
-
-#ifndef __ACONSTANTS_H
-#include <aconstants.hpp>
-#endif
-
-#ifndef __AARRAY2D_H
-#include <aarray2d.hpp>
-#endif
-
-#define __ANUMERICALFLUXEULER_H 1
-
-namespace acfd {
-
-/// Abstract class from which to derive all inviscid numerical flux classes
-/** The class is such that given the left and right states and a face normal, the numerical flux is computed.
- */
-class InviscidNumericalFlux
-{
-protected:
-	const a_real g;			///< Adiabatic index
-
-public:
-	/// Sets up data for the inviscid flux scheme
-	InviscidNumericalFlux(const a_real gamma);
-
-	/** Computes flux across a face with
-	 * \param[in] uleft is the vector of left states for the face
-	 * \param[in] uright is the vector of right states for the face
-	 * \param[in] n is the normal vector to the face
-	 * \param[in|out] flux contains the computed flux
-	 */
-	virtual void get_flux(const a_real *const uleft, const a_real *const uright, const a_real* const n, a_real *const flux) = 0;
-	virtual ~InviscidNumericalFlux();
-};
-
-/// Local Lax-Friedrichs flux, also known as scalar dissipation
-class LocalLaxFriedrichsFlux : public InviscidNumericalFlux
-{
-public:
-	LocalLaxFriedrichsFlux(const a_real gamma);
-	void get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux);
-};
-
-/// Given left and right states at each face, the Van-Leer flux-vector-splitting is calculated at each face
-class VanLeerFlux : public InviscidNumericalFlux
-{
-public:
-	VanLeerFlux(const a_real gamma);
-	void get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux);
-};
-
-/// Roe flux-difference splitting Riemann solver for the Euler equations
-class RoeFlux : public InviscidNumericalFlux
-{
-public:
-	RoeFlux(const a_real gamma);
-	void get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux);
-};
-
-/// Harten Lax Van-Leer numerical flux with contact restoration by Toro
-/** From Remaki et. al., "Aerodynamic computations using FVM and HLLC".
- */
-class HLLCFlux : public InviscidNumericalFlux
-{
-public:
-	HLLCFlux(const a_real gamma);
-	void get_flux(const a_real *const ul, const a_real *const ur, const a_real* const n, a_real *const flux);
-};
-
-} // end namespace acfd
-
-#endif
+/** \file anumericalfluxeuler.hpp
+ * \brief Numerical flux schemes for Euler equations.
+ * \author Aditya Kashi
+ * \date March 2015
+ */
+
+#ifndef ANUMERICALFLUXEULER_H
+#define ANUMERICALFLUXEULER_H 1
+
+#include "aconstants.hpp"
+
+namespace tadgens {
+
+/// Abstract class from which to derive all inviscid numerical flux classes
+/** The class is such that given the left and right states and a face normal, the numerical flux is computed.
+ *
+ * Fluxes are computed for a batch of points, such as all the quadrature points of a face, in one
+ * call. The states, normals and fluxes are in structure-of-arrays layout, as for [PDEs](@ref PDE):
+ * component k at point ip is at index k*npts + ip. Implementations loop over the points in a
+ * vectorizable loop, with the choices between wave patterns made by selection instead of branches.
+ */
+class InviscidNumericalFlux
+{
+protected:
+	const a_real g;			///< Adiabatic index
+
+public:
+	/// Sets up data for the inviscid flux scheme
+	InviscidNumericalFlux(const a_real gamma);
+
+	/** Computes flux across a face with
+	 * \param[in] uleft is the vector of left states for the face
+	 * \param[in] uright is the vector of right states for the face
+	 * \param[in] n is the normal vector to the face
+	 * \param[in|out] flux contains the computed flux
+	 */
+	void get_flux(const a_real *const uleft, const a_real *const uright, const a_real* const n,
+	              a_real *const flux) const
+	{
+		get_fluxes(1, uleft, uright, n, flux);
+	}
+
+	/** Computes fluxes at a batch of points with
+	 * \param[in] npts is the number of points
+	 * \param[in] uleft are the left states (4 x npts)
+	 * \param[in] uright are the right states (4 x npts)
+	 * \param[in] n are the unit normal vectors (2 x npts)
+	 * \param[in|out] flux contains the computed fluxes (4 x npts)
+	 */
+	virtual void get_fluxes(const int npts, const a_real *const uleft, const a_real *const uright,
+	                        const a_real* const n, a_real *const flux) const = 0;
+
+	/** Computes the derivatives of the fluxes at a batch of points w.r.t. the left and right states
+	 * \param[in] npts is the number of points
+	 * \param[in] uleft are the left states (4 x npts)
+	 * \param[in] uright are the right states (4 x npts)
+	 * \param[in] n are the unit normal vectors (2 x npts)
+	 * \param[in|out] dfdl Derivatives w.r.t. the left states: that of flux component i w.r.t.
+	 *   state component j at point ip is at index (i*4+j)*npts + ip
+	 * \param[in|out] dfdr Derivatives w.r.t. the right states, in the same layout
+	 *
+	 * The implementation in this base class uses forward differences of [get_fluxes](@ref get_fluxes).
+	 */
+	virtual void get_jacobians(const int npts, const a_real *const uleft, const a_real *const uright,
+	                           const a_real* const n, a_real *const dfdl, a_real *const dfdr) const;
+
+	virtual ~InviscidNumericalFlux();
+};
+
+/// Base for numerical fluxes whose flux at one point is written for a generic scalar type
+/** The derived class Flux provides
+ * \code
+ * template <typename scalar>
+ * void compute_flux(const scalar *const ul, const scalar *const ur, const int stride,
+ *                   const a_real nx, const a_real ny, scalar *const flux) const;
+ * \endcode
+ * which computes the flux at one point from the left and right states, both with 4 components,
+ * and the unit normal (nx,ny). Component k of the states and of the flux is at index k*stride, so
+ * that the batched loop reads and writes the structure-of-arrays data in place. It is instantiated with a_real for [get_fluxes](@ref get_fluxes), and with
+ * [dual numbers](@ref Dual) for [get_jacobians](@ref get_jacobians), so the Jacobians are exact
+ * derivatives of the flux that is actually computed, obtained by forward-mode automatic
+ * differentiation. The derivatives w.r.t. both states are carried together, so the Jacobians cost
+ * a single evaluation with 8 derivative components.
+ *
+ * The members are defined, and explicitly instantiated for the fluxes below, in the implementation
+ * file.
+ */
+template <typename Flux>
+class DifferentiableNumericalFlux : public InviscidNumericalFlux
+{
+public:
+	DifferentiableNumericalFlux(const a_real gamma) : InviscidNumericalFlux(gamma)
+	{ }
+
+	void get_fluxes(const int npts, const a_real *const ul, const a_real *const ur,
+	                const a_real* const n, a_real *const flux) const;
+
+	/// Exact Jacobians by automatic differentiation
+	void get_jacobians(const int npts, const a_real *const ul, const a_real *const ur,
+	                   const a_real* const n, a_real *const dfdl, a_real *const dfdr) const;
+};
+
+/// Local Lax-Friedrichs flux, also known as scalar dissipation
+class LocalLaxFriedrichsFlux : public DifferentiableNumericalFlux<LocalLaxFriedrichsFlux>
+{
+public:
+	LocalLaxFriedrichsFlux(const a_real gamma);
+
+	/// Computes the flux at one point
+	template <typename scalar>
+	void compute_flux(const scalar *const ul, const scalar *const ur, const int stride,
+	                  const a_real nx, const a_real ny, scalar *const flux) const;
+};
+
+/// Given left and right states at each face, the Van-Leer flux-vector-splitting is calculated at each face
+class VanLeerFlux : public DifferentiableNumericalFlux<VanLeerFlux>
+{
+public:
+	VanLeerFlux(const a_real gamma);
+
+	/// Computes the flux at one point
+	template <typename scalar>
+	void compute_flux(const scalar *const ul, const scalar *const ur, const int stride,
+	                  const a_real nx, const a_real ny, scalar *const flux) const;
+};
+
+/// Roe flux-difference splitting Riemann solver for the Euler equations
+/** The Jacobians include the derivatives of the Roe averages and of the entropy fix.
+ */
+class RoeFlux : public DifferentiableNumericalFlux<RoeFlux>
+{
+public:
+	RoeFlux(const a_real gamma);
+
+	/// Computes the flux at one point
+	template <typename scalar>
+	void compute_flux(const scalar *const ul, const scalar *const ur, const int stride,
+	                  const a_real nx, const a_real ny, scalar *const flux) const;
+};
+
+/// Harten Lax Van-Leer numerical flux with contact restoration by Toro
+/** From Remaki et. al., "Aerodynamic computations using FVM and HLLC".
+ */
+class HLLCFlux : public DifferentiableNumericalFlux<HLLCFlux>
+{
+public:
+	HLLCFlux(const a_real gamma);
+
+	/// Computes the flux at one point
+	template <typename scalar>
+	void compute_flux(const scalar *const ul, const scalar *const ur, const int stride,
+	                  const a_real nx, const a_real ny, scalar *const flux) const;
+};
+
+} // end namespace tadgens
+
+#endif
@@ -5,20 +5,34 @@
  */
 
 #include <iostream>
+#include <map>
+#include <cmath>
 #include <Eigen/LU>
 #include "aspatial.hpp"
 
 namespace tadgens {
 
 SpatialBase::SpatialBase(const UMesh2dh* mesh, const int _p_degree, char basistype)
-	: m(mesh), p_degree(_p_degree), basis_type(basistype)
+	: m(mesh), massinv_type('s'), faceassembly_type('a'), orthotaylor{false}, p_degree(_p_degree), basis_type(basistype)
 {
 	std::cout << " SpatialBase: Setting up spatal integrator for FE polynomial degree " << p_degree
 	          << std::endl;
 
-	// set quadrature strength
-	//int dom_quaddegree = 2*p_degree + m->degree()-1;
-	//int boun_quaddegree = 2*p_degree + m->degree()-1;
+	if(basis_type == 's' && p_degree == 0) {
+		std::cout << " SpatialBase: ! Spectral elements need degree at least 1; using Lagrange basis.\n";
+		basis_type = 'l';
+	}
+	if(basis_type == 'e' && p_degree > 3) {
+		std::cout << " SpatialBase: ! Serendipity elements are available only up to degree 3; using Bernstein basis.\n";
+		basis_type = 'b';
+	}
+	if(basis_type == 'l' && p_degree > 3) {
+		std::cout << " SpatialBase: ! Lagrange elements are available only up to degree 3; using Bernstein basis.\n";
+		basis_type = 'b';
+	}
+
+	// set quadrature strength for affine elements; curved elements get stronger domain rules
+	// in their own element blocks
 	int dom_quaddegree = 2*p_degree;
 	int boun_quaddegree = 2*p_degree;
 	if(dom_quaddegree == 0) dom_quaddegree = 1;
@@ -26,25 +40,63 @@ SpatialBase::SpatialBase(const UMesh2dh* mesh, const int _p_degree, char basisty
 	std::cout << " SpatialBase: Quadrature strengths for domain and boundary integrals set at "
 	          << dom_quaddegree << ", " << boun_quaddegree << std::endl;
 
-	dtquad = new Quadrature2DTriangle();
+	// Bernstein elements need a collapsed rule on triangles for sum factorization
+	dtquad = basis_type == 'b' ? new Quadrature2DTriangleCollapsed() : new Quadrature2DTriangle();
 	dtquad->initialize(dom_quaddegree);
-	dsquad = new Quadrature2DSquare();
-	dsquad->initialize(dom_quaddegree);
 	bquad = new Quadrature1D();
 	bquad->initialize(boun_quaddegree);
+	bgllquad = nullptr;
+	if(basis_type == 's') {
+		// collocate quadrature points with the p+1 Gauss-Lobatto nodes in each direction, in
+		// spectral elements and on faces not shared with other elements
+		dsquad = new Quadrature2DSquareGLL();
+		dsquad->initialize(2*p_degree-1);
+		bgllquad = new Quadrature1DGLL();
+		bgllquad->initialize(2*p_degree-1);
+	}
+	else {
+		dsquad = new Quadrature2DSquare();
+		dsquad->initialize(dom_quaddegree);
+	}
 
 	map2d = new LagrangeMapping2D[m->gnelem()];
 	elems = new Element*[m->gnelem()];
-	if(basistype == 't') {
+	if(basis_type == 't') {
 		std::cout << " SpatialBase: Using Taylor basis functions.\n";
+#pragma omp parallel for default(shared)
 		for(int iel = 0; iel < m->gnelem(); iel++) {
 			elems[iel] = new TaylorElement();
 		}
 	}
+	else if(basis_type == 's') {
+		std::cout << " SpatialBase: Using spectral elements on quads and Lagrange elements on triangles.\n";
+#pragma omp parallel for default(shared)
+		for(int iel = 0; iel < m->gnelem(); iel++) {
+			if(m->gnfael(iel) == 4)
+				elems[iel] = new SpectralElement();
+			else
+				elems[iel] = new LagrangeElement();
+		}
+	}
+	else if(basis_type == 'e') {
+		std::cout << " SpatialBase: Using serendipity elements on quads and Lagrange elements on triangles.\n";
+#pragma omp parallel for default(shared)
+		for(int iel = 0; iel < m->gnelem(); iel++) {
+			elems[iel] = new SerendipityElement();
+		}
+	}
+	else if(basis_type == 'b') {
+		std::cout << " SpatialBase: Using Bernstein-Bezier elements.\n";
+#pragma omp parallel for default(shared)
+		for(int iel = 0; iel < m->gnelem(); iel++) {
+			elems[iel] = new BernsteinElement();
+		}
+	}
 	else {
 		/*elems[0] = new LagrangeElement();
 		for(int iel = 1; iel < m->gnelem(); iel++)
 			elems[iel] = elems[0];*/
+#pragma omp parallel for default(shared)
 		for(int iel = 0; iel < m->gnelem(); iel++) {
 			elems[iel] = new LagrangeElement();
 		}
@@ -58,9 +110,13 @@ SpatialBase::SpatialBase(const UMesh2dh* mesh, const int _p_degree, char basisty
 
 SpatialBase::~SpatialBase()
 {
+	for(size_t ib = 0; ib < blocks.size(); ib++)
+		if(blocks[ib].ownsquad)
+			delete blocks[ib].quad;
 	delete dtquad;
 	delete dsquad;
 	delete bquad;
+	delete bgllquad;
 	delete [] map2d;
 	delete [] map1d;
 	delete [] faces;
@@ -70,55 +126,387 @@ SpatialBase::~SpatialBase()
 	delete dummyelem;
 }
 
-void SpatialBase::computeFEData()
+void SpatialBase::setMassInverseType(const char mitype)
 {
-	minv.resize(m->gnelem());
-	ntotaldofs = 0;
+	if(mitype != 's' && mitype != 'f') {
+		std::printf(" SpatialBase: setMassInverseType: ! Unknown type %c, using stored inverses.\n",
+		            mitype);
+		massinv_type = 's';
+		return;
+	}
+	if(mitype == 'f' && basis_type == 't')
+		std::printf(" SpatialBase: setMassInverseType: Matrix-free mass inverse is only available"
+		            " for Lagrange elements; stored inverses will be used.\n");
+	massinv_type = mitype;
+}
 
-	// loop over elements to setup maps and elements and compute mass matrices
-	for(int iel = 0; iel < m->gnelem(); iel++)
+void SpatialBase::setFaceAssemblyType(const char fatype)
+{
+	if(fatype != 'a' && fatype != 'g' && fatype != 'c') {
+		std::printf(" SpatialBase: setFaceAssemblyType: ! Unknown type %c, using atomic updates.\n",
+		            fatype);
+		faceassembly_type = 'a';
+		return;
+	}
+	faceassembly_type = fatype;
+}
+
+void SpatialBase::computeFaceColoring()
+{
+	// colors already used by faces of each element, as bits
+	std::vector<unsigned int> used(m->gnelem(), 0);
+	facecolors.clear();
+	for(a_int iface = 0; iface < m->gnaface(); iface++)
+	{
+		const a_int lelem = m->gintfac(iface,0);
+		unsigned int taken = used[lelem];
+		if(iface >= m->gnbface())
+			taken |= used[m->gintfac(iface,1)];
+
+		int icolor = 0;
+		while(taken & (1u << icolor))
+			icolor++;
+		if(icolor == static_cast<int>(facecolors.size()))
+			facecolors.push_back(std::vector<a_int>());
+		facecolors[icolor].push_back(iface);
+
+		used[lelem] |= 1u << icolor;
+		if(iface >= m->gnbface())
+			used[m->gintfac(iface,1)] |= 1u << icolor;
+	}
+}
+
+void SpatialBase::setOrthonormalBasis(const bool ortho)
+{
+	if(ortho && basis_type != 't')
+		std::printf(" SpatialBase: setOrthonormalBasis: Only Taylor bases can be orthonormalized.\n");
+	orthotaylor = ortho && basis_type == 't';
+}
+
+/// Computes the inverse of the mass matrix of a reference element from basis function values
+static void computeReferenceMassInverse(const Quadrature2D *const quad, const BasisSet& bset,
+                                        Matrix& massinv)
+{
+	const Matrix& bas = bset.basis[0];
+	const amat::Array2d<a_real>& wts = quad->weights();
+	Matrix mass = Matrix::Zero(bas.cols(), bas.cols());
+	for(int ig = 0; ig < quad->numGauss(); ig++)
+		for(int idof = 0; idof < bas.cols(); idof++)
+			for(int jdof = 0; jdof < bas.cols(); jdof++)
+				mass(idof,jdof) += bas(ig,idof)*bas(ig,jdof)*wts(ig);
+	massinv = mass.inverse();
+}
+
+/// Computes the reference basis tables of a quadrature rule for the type of basis
+static void computeReferenceBasisSet(const char basis_type, const Quadrature2D *const quad,
+                                     const int degree, BasisSet& bset)
+{
+	if(basis_type == 'e')
+		computeSerendipityReferenceBasisSet(quad, degree, bset);
+	else if(basis_type == 'b')
+		computeBernsteinReferenceBasisSet(quad, degree, bset);
+	else
+		computeLagrangeReferenceBasisSet(quad, degree, bset);
+}
+
+int SpatialBase::elementQuadratureDegree(const a_int iel, bool& capped) const
+{
+	capped = false;
+	const Shape shape = m->gnfael(iel) == 4 ? QUADRANGLE : TRIANGLE;
+	int qdeg = shape == QUADRANGLE ? dsquad->getNumPoly() : dtquad->getNumPoly();
+
+	// collocated spectral elements need their GLL rule
+	if(basis_type == 's' && shape == QUADRANGLE)
+		return qdeg;
+
+	if(!map2d[iel].detectAffine())
+		qdeg += shape == QUADRANGLE ? 2*map2d[iel].getDegree()-1 : 2*(map2d[iel].getDegree()-1);
+	if(hasNonlinearFlux())
+		qdeg += p_degree;
+
+	// Gauss rules on quads and collapsed rules for Bernstein triangles exist for any strength
+	if(shape == QUADRANGLE || basis_type == 'b')
+		return qdeg;
+	const int maxdeg = 6;
+	capped = qdeg > maxdeg;
+	return capped ? maxdeg : qdeg;
+}
+
+void SpatialBase::setupElementBlocks()
+{
+	elemblock.resize(m->gnelem());
+	a_int ncurved = 0, ncapped = 0;
+
+#pragma omp parallel for default(shared) reduction(+:ncurved,ncapped)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
 		Matrix phynodes(NDIM,m->gnnode(iel));
 		for(int i = 0; i < m->gnnode(iel); i++)
 			for(int j = 0; j < NDIM; j++)
 				phynodes(j,i) = m->gcoords(m->ginpoel(iel,i),j);
 
-		if(m->gnnode(iel) == 4 || m->gnnode(iel) == 9 || m->gnnode(iel) == 16)
+		if(m->gnfael(iel) == 4)
 			map2d[iel].setAll(m->degree(), phynodes, dsquad);
-		else {
+		else
 			map2d[iel].setAll(m->degree(), phynodes, dtquad);
+
+		// elements with straight sides need no more than a (bi)linear map
+		if(m->degree() > 1 && !map2d[iel].reduceDegree())
+			ncurved++;
+
+		// temporarily store the quadrature strength
+		bool capped;
+		elemblock[iel] = elementQuadratureDegree(iel, capped);
+		if(capped)
+			ncapped++;
+	}
+	if(ncapped > 0)
+		std::printf(" SpatialBase: setupElementBlocks: ! %d triangles need a stronger quadrature rule"
+		            " than the strongest available (6); they are under-integrated.\n", ncapped);
+
+	// one block for each combination of shape and strength, in order of first appearance
+	blocks.clear();
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		const Shape shape = m->gnfael(iel) == 4 ? QUADRANGLE : TRIANGLE;
+		const int qdeg = elemblock[iel];
+		size_t ib = 0;
+		while(ib < blocks.size() && (blocks[ib].shape != shape || blocks[ib].quaddegree != qdeg))
+			ib++;
+		if(ib == blocks.size())
+		{
+			ElementBlock blk;
+			blk.shape = shape; blk.quaddegree = qdeg; blk.bset = nullptr;
+			Quadrature2D *const basequad = shape == QUADRANGLE ? static_cast<Quadrature2D*>(dsquad)
+				: static_cast<Quadrature2D*>(dtquad);
+			blk.ownsquad = qdeg != basequad->getNumPoly();
+			if(blk.ownsquad) {
+				blk.quad = shape == QUADRANGLE ? static_cast<Quadrature2D*>(new Quadrature2DSquare())
+					: basis_type == 'b' ? static_cast<Quadrature2D*>(new Quadrature2DTriangleCollapsed())
+					: static_cast<Quadrature2D*>(new Quadrature2DTriangle());
+				blk.quad->initialize(qdeg);
+			}
+			else
+				blk.quad = basequad;
+			blocks.push_back(blk);
+		}
+		blocks[ib].elements.push_back(iel);
+		elemblock[iel] = static_cast<int>(ib);
+	}
+
+	for(size_t ib = 0; ib < blocks.size(); ib++) {
+		std::printf(" SpatialBase: setupElementBlocks: Block %d: %s, quadrature strength %d, %d elements\n",
+		            (int)ib, blocks[ib].shape == QUADRANGLE ? "quads" : "triangles",
+		            blocks[ib].quaddegree, (int)blocks[ib].elements.size());
+		if(blocks[ib].ownsquad)
+			for(size_t i = 0; i < blocks[ib].elements.size(); i++) {
+				const a_int iel = blocks[ib].elements[i];
+				map2d[iel].setAll(map2d[iel].getDegree(), map2d[iel].getPhyNodes(), blocks[ib].quad);
+			}
+	}
+	if(m->degree() > 1)
+		std::printf(" SpatialBase: setupElementBlocks: %d of %d elements need curved maps\n",
+		            ncurved, m->gnelem());
+}
+
+/** The first element with a given key in each block is the representative.
+ */
+a_int SpatialBase::findCongruentElements()
+{
+	congruent.resize(m->gnelem());
+
+	a_real maxcoord = 0;
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		maxcoord = std::max(maxcoord, map2d[iel].getPhyNodes().cwiseAbs().maxCoeff());
+	const a_real tol = SMALL_NUMBER*maxcoord;
+
+	std::map<std::vector<long long>, a_int> reps;
+	a_int ncong = 0;
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		const Matrix& nodes = map2d[iel].getPhyNodes();
+		std::vector<long long> key(2 + NDIM*(nodes.cols()-1));
+		key[0] = elemblock[iel];
+		key[1] = nodes.cols();
+		for(int inode = 1; inode < nodes.cols(); inode++)
+			for(int idim = 0; idim < NDIM; idim++)
+				key[2+(inode-1)*NDIM+idim] = std::llround((nodes(idim,inode)-nodes(idim,0))/tol);
+
+		const auto it = reps.find(key);
+		if(it == reps.end()) {
+			reps[key] = iel;
+			congruent[iel] = iel;
+		}
+		else {
+			congruent[iel] = it->second;
+			ncong++;
 		}
+	}
+	return ncong;
+}
+
+void SpatialBase::computeFEData()
+{
+	minv.resize(m->gnelem());
+	dofstart.resize(m->gnelem()+1);
+
+	setupElementBlocks();
+
+	// basis values and reference gradients are the same for all referential elements of a given shape
+	// and quadrature rule
+	if(basis_type != 't')
+		computeReferenceBasisSet(basis_type, dtquad, p_degree, tribset);
+	if(basis_type == 'l' || basis_type == 'e' || basis_type == 'b')
+		computeReferenceBasisSet(basis_type, dsquad, p_degree, quadbset);
+	blockbsets.resize(blocks.size());
+	for(size_t ib = 0; ib < blocks.size(); ib++)
+	{
+		if(basis_type == 't' || (basis_type == 's' && blocks[ib].shape == QUADRANGLE))
+			continue;
+		if(!blocks[ib].ownsquad)
+			blocks[ib].bset = blocks[ib].shape == QUADRANGLE ? &quadbset : &tribset;
+		else {
+			computeReferenceBasisSet(basis_type, blocks[ib].quad, p_degree, blockbsets[ib]);
+			blocks[ib].bset = &blockbsets[ib];
+		}
+	}
 
-		elems[iel]->initialize(p_degree, &map2d[iel]);
-		ntotaldofs += elems[iel]->getNumDOFs();
+	// Bernstein elements of a block share the 1D tables of its rule
+	std::vector<char> hastables(blocks.size(), 0);
+	if(basis_type == 'b') {
+		blockbtables.resize(blocks.size());
+		for(size_t ib = 0; ib < blocks.size(); ib++)
+			hastables[ib] = computeBernsteinTables(blocks[ib].quad, p_degree, blockbtables[ib]);
+	}
 
-		// allocate mass matrix
-		minv[iel] = Matrix::Zero(elems[iel]->getNumDOFs(), elems[iel]->getNumDOFs());
+	const bool matrixfree = (massinv_type == 'f' && basis_type != 't');
+	if(matrixfree) {
+		computeReferenceMassInverse(dtquad, tribset, trimassinvref);
+		if(basis_type == 'l' || basis_type == 'e' || basis_type == 'b')
+			computeReferenceMassInverse(dsquad, quadbset, quadmassinvref);
+		std::printf(" SpatialBase: computeFEData: Mass matrix inverses will be applied matrix-free\n");
+	}
 
-		// compute mass matrix
-		for(int ig = 0; ig < map2d[iel].getQuadrature()->numGauss(); ig++)
+	const a_int ncongruent = findCongruentElements();
+
+	// the elements of a block share the quadrature rule, so Taylor elements are set up in batches
+	// whose basis tables are computed together
+	const int batchsize = 16;
+	if(basis_type == 't')
+		for(size_t ib = 0; ib < blocks.size(); ib++)
 		{
-			const a_real weightandjdet = map2d[iel].jacDet()[ig] * map2d[iel].getQuadrature()->weights()(ig);
-			for(int idof = 0; idof < elems[iel]->getNumDOFs(); idof++)
-				for(int jdof = 0; jdof < elems[iel]->getNumDOFs(); jdof++)
-					minv[iel](idof,jdof) += elems[iel]->bFunc()(ig,idof)*elems[iel]->bFunc()(ig,jdof)
-						* weightandjdet;
+			const std::vector<a_int>& elist = blocks[ib].elements;
+			const int nbatches = (static_cast<int>(elist.size()) + batchsize-1)/batchsize;
+#pragma omp parallel for default(shared)
+			for(int ibatch = 0; ibatch < nbatches; ibatch++)
+			{
+				const int start = ibatch*batchsize;
+				const int nbatch = std::min(batchsize, static_cast<int>(elist.size())-start);
+				TaylorElement* telems[batchsize];
+				GeomMapping2D* tmaps[batchsize];
+				for(int i = 0; i < nbatch; i++) {
+					telems[i] = static_cast<TaylorElement*>(elems[elist[start+i]]);
+					telems[i]->setOrthonormalize(orthotaylor);
+					tmaps[i] = &map2d[elist[start+i]];
+				}
+				TaylorElement::initializeBatch(p_degree, nbatch, telems, tmaps);
+			}
 		}
 
-		minv[iel] = minv[iel].inverse().eval();
+	// loop over elements to setup elements and compute mass matrices; maps are already set
+#pragma omp parallel for default(shared)
+	for(int iel = 0; iel < m->gnelem(); iel++)
+	{
+		if(basis_type != 't') {
+			if(blocks[elemblock[iel]].bset)
+				elems[iel]->setBasisSet(blocks[elemblock[iel]].bset);
+			if(basis_type == 'b' && hastables[elemblock[iel]])
+				static_cast<BernsteinElement*>(elems[iel])->setTables(&blockbtables[elemblock[iel]]);
+
+			elems[iel]->initialize(p_degree, &map2d[iel]);
+		}
+		dofstart[iel+1] = elems[iel]->getNumDOFs();
+
+		// the mass matrix of collocated elements is diagonal and is applied directly,
+		// while that of orthonormal bases is the identity
+		if(!matrixfree && !elems[iel]->isCollocated() && !elems[iel]->hasOrthonormalBasis()
+		   && congruent[iel] == iel)
+		{
+			// allocate mass matrix
+			minv[iel] = Matrix::Zero(elems[iel]->getNumDOFs(), elems[iel]->getNumDOFs());
+
+			// compute mass matrix
+			for(int ig = 0; ig < map2d[iel].getQuadrature()->numGauss(); ig++)
+			{
+				const a_real weightandjdet = map2d[iel].jacDet(ig) * map2d[iel].getQuadrature()->weights()(ig);
+				for(int idof = 0; idof < elems[iel]->getNumDOFs(); idof++)
+					for(int jdof = 0; jdof < elems[iel]->getNumDOFs(); jdof++)
+						minv[iel](idof,jdof) += elems[iel]->bFunc()(ig,idof)*elems[iel]->bFunc()(ig,jdof)
+							* weightandjdet;
+			}
+
+			minv[iel] = minv[iel].inverse().eval();
+		}
 
 		/** \note Computation of physical coordinates of domain quadrature points
 		 * is required separately for Lagrange elements
 		 * only for the purpose of computing source term contributions and errors.
 		 */
-		if(basis_type == 'l')
+		if(basis_type != 't')
 			map2d[iel].computePhysicalCoordsOfDomainQuadraturePoints();
 	}
+
+	// elements congruent to an earlier one use its basis data and Jacobians
+	double sharedbytes = 0;
+#pragma omp parallel for default(shared) reduction(+:sharedbytes)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		if(congruent[iel] != iel) {
+			sharedbytes += static_cast<double>(elems[iel]->shareDataWith(elems[congruent[iel]]));
+			sharedbytes += static_cast<double>(map2d[iel].shareJacobiansWith(&map2d[congruent[iel]]));
+		}
+	std::printf(" SpatialBase: computeFEData: %d elements share FE data with a congruent element,"
+	            " saving about %.2f MB\n", ncongruent, sharedbytes/1048576.0);
+
+	/* Batch stored mass inverses of blocks so that they can be applied block-wise. Blocks with
+	 * many congruent elements are not batched, since that would store their shared inverses
+	 * once per element again.
+	 */
+	blockminv.resize(blocks.size());
+	for(size_t ib = 0; ib < blocks.size(); ib++)
+	{
+		const std::vector<a_int>& elist = blocks[ib].elements;
+		std::vector<a_int> reps(elist.size());
+		a_int nunique = 0;
+		bool allstored = elist.size() > 0;
+		for(size_t i = 0; i < elist.size(); i++) {
+			reps[i] = congruent[elist[i]];
+			if(reps[i] == elist[i])
+				nunique++;
+			if(minv[reps[i]].size() == 0)
+				allstored = false;
+		}
+		if(allstored && 2*nunique > static_cast<a_int>(elist.size()))
+			blockminv[ib].gather(minv, reps);
+	}
+
+	dofstart[0] = 0;
+	for(int iel = 0; iel < m->gnelem(); iel++)
+		dofstart[iel+1] += dofstart[iel];
+	ntotaldofs = dofstart[m->gnelem()];
 	std::printf(" SpatialBase: computeFEData: Total number of DOFs = %d\n", ntotaldofs);
 
 	dummyelem->initialize(p_degree, &map2d[0]);
 
+	// face basis values of referential elements are computed once for each shape
+	for(int iel = 0; iel < m->gnelem(); iel++) {
+		const Quadrature1D *const fquad = faceQuadrature(iel, iel);
+		if(elems[iel]->getType() == REFERENTIAL
+		   && !ftraces.has(map2d[iel].getShape(), elems[iel]->getDegree(), fquad))
+			ftraces.addShape(elems[iel], fquad);
+	}
+
 	// loop over faces
+#pragma omp parallel for default(shared)
 	for(int iface = 0; iface < m->gnbface(); iface++)
 	{
 		const int lelem = m->gintfac(iface,0);
@@ -127,13 +515,15 @@ void SpatialBase::computeFEData()
 			for(int j = 0; j < NDIM; j++)
 				phynodes(j,i) = m->gcoords(m->gintfac(iface,2+i),j);
 
-		map1d[iface].setAll(m->degree(), phynodes, bquad);
+		map1d[iface].setAll(m->degree(), phynodes, faceQuadrature(lelem, lelem));
+		map1d[iface].reduceDegree();
 		map1d[iface].computeAll();
 
 		faces[iface].initialize(elems[lelem], dummyelem, &map1d[iface],
-		                        m->gfacelocalnum(iface,0), m->gfacelocalnum(iface,1));
+		                        m->gfacelocalnum(iface,0), m->gfacelocalnum(iface,1), &ftraces);
 	}
 
+#pragma omp parallel for default(shared)
 	for(int iface = m->gnbface(); iface < m->gnaface(); iface++)
 	{
 		const int lelem = m->gintfac(iface,0);
@@ -143,16 +533,26 @@ void SpatialBase::computeFEData()
 			for(int j = 0; j < NDIM; j++)
 				phynodes(j,i) = m->gcoords(m->gintfac(iface,2+i),j);
 
-		map1d[iface].setAll(m->degree(), phynodes, bquad);
+		map1d[iface].setAll(m->degree(), phynodes, faceQuadrature(lelem, relem));
+		map1d[iface].reduceDegree();
 		map1d[iface].computeAll();
 
 		faces[iface].initialize(elems[lelem], elems[relem], &map1d[iface],
-		                        m->gfacelocalnum(iface,0), m->gfacelocalnum(iface,1));
+		                        m->gfacelocalnum(iface,0), m->gfacelocalnum(iface,1), &ftraces);
 		/*std::cout << "  SpatialBase: facelocalnum: L elem " << lelem+m->gnface()+1 << ", R elem "
 		  << relem+m->gnface()+1
 		  << ": " << m->gfacelocalnum(iface,0) << ", " << m->gfacelocalnum(iface,1) << std::endl;*/
 	}
 
+	// data for the face assembly
+	if(faceassembly_type == 'g')
+		faceterms.resize(2*m->gnaface());
+	else if(faceassembly_type == 'c') {
+		computeFaceColoring();
+		std::printf(" SpatialBase: computeFEData: Faces are sorted into %d colors\n",
+		            static_cast<int>(facecolors.size()));
+	}
+
 	std::cout << " SpatialBase: computeFEData: Mesh degree = " << m->degree()
 	          << ", geom map degee = " << map2d[0].getDegree()
 	          << ", element degree = " << elems[0]->getDegree() << std::endl;
@@ -168,7 +568,7 @@ void SpatialBase::spatialSetup(std::vector<Matrix>& u, std::vector<Matrix>& res,
 	res.resize(m->gnelem());
 	mets.resize(m->gnelem());
 
-	const int nvars = 1;
+	const int nvars = numVars();
 
 	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
@@ -177,6 +577,220 @@ void SpatialBase::spatialSetup(std::vector<Matrix>& u, std::vector<Matrix>& res,
 	}
 }
 
+void SpatialBase::initializeUnknowns(std::vector<Matrix>& u) const
+{
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		u[iel].setOnes();
+}
+
+void SpatialBase::applyElemMassInverse(const a_int iel, const Matrix& __restrict__ r,
+                                       Matrix& __restrict__ mr, ElementGeometry& egeom) const
+{
+	const Matrix& mi = minv[congruent[iel]];
+	if(mi.size() > 0) {
+		mr.noalias() = r*mi;
+		return;
+	}
+
+	if(elems[iel]->hasOrthonormalBasis()) {
+		mr = r;
+		return;
+	}
+
+	if(elems[iel]->isCollocated()) {
+		const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+		egeom.evaluate(map2d[iel], false);
+		mr = r;
+		for(int k = 0; k < mr.cols(); k++)
+			mr.col(k) *= 1.0/(wts(k)*egeom.jacDet(k));
+		return;
+	}
+
+	const Matrix& refminv = map2d[iel].getShape() == QUADRANGLE ? quadmassinvref : trimassinvref;
+
+	if(map2d[iel].isAffine()) {
+		mr.noalias() = r*refminv;
+		mr *= 1.0/map2d[iel].jacDet(0);
+		return;
+	}
+
+	// weight-adjusted inverse
+	const Matrix& bas = elems[iel]->bFunc();
+	const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+	egeom.evaluate(map2d[iel], false);
+	Matrix qvals = r*refminv*bas.transpose();
+	for(int ig = 0; ig < qvals.cols(); ig++)
+		qvals.col(ig) *= wts(ig)/egeom.jacDet(ig);
+	mr.noalias() = qvals*bas*refminv;
+}
+
+void SpatialBase::releaseGeometricData()
+{
+	a_int ngrads = 0;
+	double nbytes = 0;
+#pragma omp parallel for default(shared) reduction(+:ngrads,nbytes)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		nbytes += static_cast<double>(map2d[iel].releaseQuadratureData());
+		const size_t gradbytes = elems[iel]->releasePhysicalGradients();
+		if(gradbytes > 0) {
+			ngrads++;
+			nbytes += static_cast<double>(gradbytes);
+		}
+	}
+
+#pragma omp parallel for default(shared) reduction(+:nbytes)
+	for(a_int iface = 0; iface < m->gnaface(); iface++)
+		nbytes += static_cast<double>(map1d[iface].releaseQuadratureData());
+
+	std::printf(" SpatialBase: releaseGeometricData: Geometric data at quadrature points will be"
+	            " recomputed; basis gradients of %d elements were released, about %.2f MB in all\n",
+	            ngrads, nbytes/1048576.0);
+}
+
+void SpatialBase::computeLiftedOperators()
+{
+	liftvol.resize(m->gnelem()*(NDIM+1));
+	liftface.resize(2*m->gnaface());
+
+#pragma omp parallel for default(shared)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		const int ng = map2d[iel].getQuadrature()->numGauss();
+		const int ndofs = elems[iel]->getNumDOFs();
+		const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+		const Matrix& bas = elems[iel]->bFunc();
+		const std::vector<Matrix>& bgrads = elems[iel]->bGrad();
+
+		Matrix wb(ng, ndofs);
+		for(int idim = 0; idim < NDIM; idim++) {
+			for(int ig = 0; ig < ng; ig++)
+				for(int idof = 0; idof < ndofs; idof++)
+					wb(ig,idof) = bgrads[ig](idof,idim) * wts(ig) * map2d[iel].jacDet(ig);
+			applyElemMassInverse(iel, wb, liftvol[iel*(NDIM+1)+idim]);
+		}
+
+		for(int ig = 0; ig < ng; ig++)
+			wb.row(ig) = bas.row(ig) * (wts(ig) * map2d[iel].jacDet(ig));
+		applyElemMassInverse(iel, wb, liftvol[iel*(NDIM+1)+NDIM]);
+	}
+
+#pragma omp parallel for default(shared)
+	for(a_int iface = 0; iface < m->gnaface(); iface++)
+	{
+		const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
+		const std::vector<a_real>& sp = map1d[iface].speed();
+
+		Matrix wb = faces[iface].leftBasis();
+		for(int ig = 0; ig < wb.rows(); ig++)
+			wb.row(ig) *= wts(ig)*sp[ig];
+		applyElemMassInverse(m->gintfac(iface,0), wb, liftface[2*iface]);
+
+		if(iface >= m->gnbface()) {
+			wb = faces[iface].rightBasis();
+			for(int ig = 0; ig < wb.rows(); ig++)
+				wb.row(ig) *= wts(ig)*sp[ig];
+			applyElemMassInverse(m->gintfac(iface,1), wb, liftface[2*iface+1]);
+		}
+	}
+}
+
+void SpatialBase::applyMassInverse(const std::vector<Matrix>& r, std::vector<Matrix>& mr) const
+{
+	BatchedMatrices rb, mrb;
+	for(size_t ib = 0; ib < blocks.size(); ib++)
+	{
+		const std::vector<a_int>& elist = blocks[ib].elements;
+		if(blockminv[ib].batchSize() > 0)
+		{
+			rb.gather(r, elist);
+			mrb.resize(rb.batchSize(), rb.rows(), rb.cols());
+			batchedGemm(1.0, rb, blockminv[ib], 0.0, mrb);
+			mrb.scatter(mr, elist);
+		}
+		else
+		{
+			ElementGeometry egeom;
+#pragma omp parallel for default(shared) firstprivate(egeom)
+			for(size_t i = 0; i < elist.size(); i++)
+				applyElemMassInverse(elist[i], r[elist[i]], mr[elist[i]], egeom);
+		}
+	}
+}
+
+void SpatialBase::setupJacobianMatrix(BlockSparseMatrix& jac, const bool diagonalonly) const
+{
+	std::vector<int> blocksizes(m->gnelem());
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+		blocksizes[iel] = numVars()*elems[iel]->getNumDOFs();
+	jac.setStructure(m, blocksizes, diagonalonly);
+}
+
+void SpatialBase::computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac)
+{
+	std::printf(" SpatialBase: computeJacobian: ! The Jacobian is not available for this discretization!\n");
+}
+
+void SpatialBase::computeElemMassMatrix(const a_int iel, Matrix& mass, ElementGeometry& egeom) const
+{
+	const int ng = map2d[iel].getQuadrature()->numGauss();
+	const int ndofs = elems[iel]->getNumDOFs();
+	const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+	egeom.evaluate(map2d[iel], false);
+
+	mass = Matrix::Zero(ndofs, ndofs);
+	if(elems[iel]->isCollocated()) {
+		for(int ig = 0; ig < ng; ig++)
+			mass(ig,ig) = wts(ig)*egeom.jacDet(ig);
+		return;
+	}
+
+	const Matrix& bas = elems[iel]->bFunc();
+	for(int ig = 0; ig < ng; ig++)
+	{
+		const a_real weightandjdet = wts(ig)*egeom.jacDet(ig);
+		for(int idof = 0; idof < ndofs; idof++)
+			for(int jdof = 0; jdof < ndofs; jdof++)
+				mass(idof,jdof) += bas(ig,idof)*bas(ig,jdof)*weightandjdet;
+	}
+}
+
+void SpatialBase::getFaceBasis(const a_int iface, const int side, Matrix& basis) const
+{
+	const std::vector<int> *const nodes = side == 0 ? faces[iface].leftNodes()
+		: faces[iface].rightNodes();
+	if(!nodes) {
+		basis = side == 0 ? faces[iface].leftBasis() : faces[iface].rightBasis();
+		return;
+	}
+
+	const int ng = map1d[iface].getQuadrature()->numGauss();
+	basis.setZero(ng, elems[m->gintfac(iface,side)]->getNumDOFs());
+	for(int ig = 0; ig < ng; ig++)
+		basis(ig,(*nodes)[ig]) = 1.0;
+}
+
+void SpatialBase::addFaceJacobianBlock(const int nvars, const Matrix& dfdu, const a_real *const wts,
+                                       const Matrix& tbasis, const Matrix& sbasis, Matrix& jac) const
+{
+	const int ng = static_cast<int>(tbasis.rows());
+	const int ntdofs = static_cast<int>(tbasis.cols()), nsdofs = static_cast<int>(sbasis.cols());
+
+	for(int ig = 0; ig < ng; ig++)
+		for(int ivar = 0; ivar < nvars; ivar++)
+			for(int jvar = 0; jvar < nvars; jvar++)
+			{
+				const a_real c = dfdu(ivar*nvars+jvar, ig)*wts[ig];
+				if(c == 0)
+					continue;
+				for(int k = 0; k < ntdofs; k++) {
+					const a_real ck = c*tbasis(ig,k);
+					for(int l = 0; l < nsdofs; l++)
+						jac(ivar*ntdofs+k, jvar*nsdofs+l) += ck*sbasis(ig,l);
+				}
+			}
+}
+
 a_real SpatialBase::computeElemL2Norm2(const int ielem, const Vector& __restrict__ ug) const
 {
 	const int ndofs = elems[ielem]->getNumDOFs();
@@ -186,6 +800,8 @@ a_real SpatialBase::computeElemL2Norm2(const int ielem, const Vector& __restrict
 	const GeomMapping2D* gmap = elems[ielem]->getGeometricMapping();
 	const int ng = gmap->getQuadrature()->numGauss();
 	const amat::Array2d<a_real>& wts = gmap->getQuadrature()->weights();
+	ElementGeometry egeom;
+	egeom.evaluate(*gmap, false);
 
 	for(int ig = 0; ig < ng; ig++)
 	{
@@ -193,7 +809,7 @@ a_real SpatialBase::computeElemL2Norm2(const int ielem, const Vector& __restrict
 		for(int j = 0; j < ndofs; j++) {
 			lu += ug(j)*bfunc(ig,j);
 		}
-		l2error += lu*lu * wts(ig) * gmap->jacDet()[ig];
+		l2error += lu*lu * wts(ig) * egeom.jacDet(ig);
 	}
 
 	return l2error;
@@ -202,6 +818,7 @@ a_real SpatialBase::computeElemL2Norm2(const int ielem, const Vector& __restrict
 a_real SpatialBase::computeL2Norm(const std::vector<Matrix> w, const int comp) const
 {
 	a_real l2norm = 0;
+	ElementGeometry egeom;
 	for(int ielem = 0; ielem < m->gnelem(); ielem++)
 	{
 		const GeomMapping2D* gmap = elems[ielem]->getGeometricMapping();
@@ -209,10 +826,11 @@ a_real SpatialBase::computeL2Norm(const std::vector<Matrix> w, const int comp) c
 		const amat::Array2d<a_real>& wts = gmap->getQuadrature()->weights();
 		Vector vals(ng);
 		elems[ielem]->interpolateComponent(comp,w[ielem],vals);
+		egeom.evaluate(*gmap, false);
 
 		for(int ig = 0; ig < ng; ig++)
 		{
-			l2norm += vals(ig)*vals(ig) * wts(ig) * gmap->jacDet()[ig];
+			l2norm += vals(ig)*vals(ig) * wts(ig) * egeom.jacDet(ig);
 		}
 	}
 
@@ -229,7 +847,9 @@ a_real SpatialBase::computeElemL2Error2(const int ielem, const int comp,
 	const GeomMapping2D* gmap = elems[ielem]->getGeometricMapping();
 	const int ng = gmap->getQuadrature()->numGauss();
 	const amat::Array2d<a_real>& wts = gmap->getQuadrature()->weights();
-	const Matrix& qp = gmap->map();
+	ElementGeometry egeom;
+	egeom.evaluate(*gmap);
+	const Matrix& qp = egeom.map();
 
 	// TODO: Use interpolateAll here
 	for(int ig = 0; ig < ng; ig++)
@@ -239,7 +859,7 @@ a_real SpatialBase::computeElemL2Error2(const int ielem, const int comp,
 			lu += ug(comp,j)*bfunc(ig,j);
 		}
 		const a_real coords[] = {qp(ig,0),qp(ig,1)};
-		l2error += std::pow(lu-exact_solution(coords,time),2) * wts(ig) * gmap->jacDet()[ig];
+		l2error += std::pow(lu-exact_solution(coords,time),2) * wts(ig) * egeom.jacDet(ig);
 	}
 
 	return l2error;
@@ -258,7 +878,7 @@ a_real SpatialBase::computeL2Error(const double time, const std::vector<Matrix>&
 void SpatialBase::setInitialConditionNodal(const int comp, double (**const init)(a_real, a_real),
                                            std::vector<Matrix>& u)
 {
-	if(basis_type != 'l') {
+	if(basis_type != 'l' && basis_type != 'e') {
 		printf("!  SpatialBase: setInitialConditionNodal: Not nodal basis!\n");
 		return;
 	}
@@ -297,6 +917,13 @@ void SpatialBase::setInitialConditionModal(const int comp, double (**const init)
 			u[iel](comp,4) = init[4](xc,yc)*2*dy*dy;
 			u[iel](comp,5) = init[5](xc,yc)*dx*dy;
 		}
+
+		if(elem->hasOrthonormalBasis()) {
+			const Matrix coeffs = u[iel].row(comp);
+			Matrix dofs;
+			elem->getDOFsFromTaylorCoeffs(coeffs, dofs);
+			u[iel].row(comp) = dofs;
+		}
 	}
 }
 
@@ -11,9 +11,23 @@
 #include "utilities/aarray2d.hpp"
 #include "mesh/amesh2dh.hpp"
 #include "fem/aelements.hpp"
+#include "fem/abernstein.hpp"
+#include "fem/abatchedlinalg.hpp"
+#include "solvers/ablockmatrix.hpp"
 
 namespace tadgens {
 
+/// A set of elements of the same shape that use the same domain quadrature rule
+struct ElementBlock
+{
+	Shape shape;                          ///< Shape of the elements
+	int quaddegree;                       ///< Strength of the quadrature rule
+	Quadrature2D* quad;                   ///< Domain quadrature rule
+	bool ownsquad;                        ///< Whether quad was allocated for this block
+	const BasisSet* bset;                 ///< Shared Lagrange basis tables for the rule, if any
+	std::vector<a_int> elements;          ///< Indices of the elements in the block
+};
+
 /// Base class for spatial discretization and integration of weak forms of PDEs
 /**
  * Provides residual computation, and potentially residual Jacobian evaluation, interface for all solvers.
@@ -27,26 +41,224 @@ protected:
 	const UMesh2dh* m;
 
 	std::vector<Matrix> minv;             ///< Inverse of mass matrix for each variable of each element
+
+	/// For each element, the element whose FE data it shares, which is itself if it has no
+	/// congruent predecessor \sa findCongruentElements
+	std::vector<a_int> congruent;
+	char massinv_type;                    ///< Stored mass inverses ('s') or matrix-free application ('f')
+	char faceassembly_type;               ///< How face terms are [added](@ref assembleFaceTerms) to residuals
+	bool orthotaylor;                     ///< Whether Taylor bases are orthonormalized
 	int p_degree;                         ///< Polynomial degree of trial/test functions
 	a_int ntotaldofs;                     ///< Total number of DOFs in the discretization per physical variable)
-	char basis_type;                      ///< Type of basis to use - Lagrange ('l') or Taylor ('t')
+	std::vector<a_int> dofstart;          ///< Index of the first DOF of each element in a global numbering
+	/// Type of basis to use - Lagrange ('l'), Taylor ('t'), spectral elements on quads ('s'),
+	/// serendipity elements on quads ('e') or Bernstein-Bezier elements ('b')
+	char basis_type;
 	bool reconstruct;                     ///< Use reconstruction or not
 
-	Quadrature2DTriangle* dtquad;				///< Domain quadrature context
-	Quadrature2DSquare* dsquad;					///< Domain quadrature context
-	Quadrature1D* bquad;						///< Boundary quadrature context
+	Quadrature2DTriangle* dtquad;				///< Domain quadrature context for affine triangles
+	Quadrature2DSquare* dsquad;					///< Domain quadrature context for affine quads
+	Quadrature1D* bquad;						///< Face quadrature context
+	/// Gauss-Lobatto face quadrature collocated with spectral elements, if they are used
+	Quadrature1DGLL* bgllquad;
 	LagrangeMapping2D* map2d;					///< Array containing geometric mapping data for each element
 	LagrangeMapping1D* map1d;					///< Array containing geometric mapping data for each face
 	Element** elems;							///< List of finite elements
 	Element* dummyelem;							///< Empty element used for ghost elements
 	FaceElement* faces;							///< List of face elements
 
+	BasisSet tribset;							///< Reference basis tables for Lagrange triangles with dtquad
+	BasisSet quadbset;							///< Reference basis tables for Lagrange or serendipity quads with dsquad
+
+	/// Groups of elements by shape and [domain quadrature strength](@ref elementQuadratureDegree)
+	std::vector<ElementBlock> blocks;
+	std::vector<BasisSet> blockbsets;           ///< Basis tables of blocks that do not use dtquad or dsquad
+	std::vector<BernsteinTables> blockbtables;  ///< 1D tables for sum factorization for Bernstein elements
+	std::vector<int> elemblock;                 ///< Index of the block of each element
+
+	/// Stored mass inverses of the elements of each block, batched for [application](@ref applyMassInverse)
+	/** Empty for blocks in which any element does not have a stored mass inverse.
+	 */
+	std::vector<BatchedMatrices> blockminv;
+	Matrix trimassinvref;						///< Inverse mass matrix of the reference triangle
+	Matrix quadmassinvref;						///< Inverse mass matrix of the reference square
+	FaceTraceTables ftraces;					///< Basis values on faces shared by referential elements
+
+	/// Lifted face operators \f$ W B M^{-1} \f$ (nquad x ndofs) for each face and side
+	/** Stored at index 2*iface+side, where side is 0 for the left element and 1 for the right.
+	 * W holds the quadrature weights times the face speed, and M is the mass matrix of the element
+	 * on that side. Only computed if required by a subclass. \sa computeLiftedOperators
+	 */
+	std::vector<Matrix> liftface;
+
+	/// Lifted volume operators (nquad x ndofs) for each element
+	/** Stored at index iel*(NDIM+1)+k: for k < NDIM, the derivatives of the basis functions in
+	 * direction k; for k = NDIM, the basis functions themselves. Each is multiplied by the quadrature
+	 * weights and Jacobian determinants from the left, and by the inverse mass matrix from the right.
+	 */
+	std::vector<Matrix> liftvol;
+
 	amat::Array2d<a_real> scalars;				///< Holds scalar variables for each mesh point
 	amat::Array2d<a_real> velocities;			///< Holds velocity components for each mesh point
 
 	/// Sets up geometric maps, elements and mass matrices 
 	void computeFEData();
+
+	/// Contributions of each face to the residuals of its left (index 2*iface) and right
+	/// (2*iface+1) elements, used by the gather mode of [face assembly](@ref assembleFaceTerms)
+	std::vector<Matrix> faceterms;
+
+	/// Faces grouped such that no two faces of a group share an element
+	std::vector<std::vector<a_int>> facecolors;
+
+	/// Sorts all faces into [colors](@ref facecolors) greedily, in order of face index
+	/** Since an element has at most 4 faces, at most 7 colors are needed.
+	 */
+	void computeFaceColoring();
+
+	/// Computes contributions of all faces by a kernel and adds them to the element residuals
+	/** The kernel is called as kernel(iface, lterm, rterm) for each face, with lterm and rterm
+	 * zeroed and sized like the residuals of the left and right elements. It must add to them the
+	 * contributions of the face to those residuals; rterm is empty for boundary faces.
+	 * The kernel object is copied to each thread, so it may hold workspaces.
+	 *
+	 * The [assembly type](@ref setFaceAssemblyType) determines how the terms reach the residuals:
+	 *  - 'a': by atomic updates, directly after each face is computed,
+	 *  - 'g': faces write to their own [buffers](@ref faceterms), after which each element sums
+	 *    the terms of its faces in local face order; the result does not depend on the number of
+	 *    threads or the schedule,
+	 *  - 'c': faces of one [color](@ref facecolors) at a time are computed in parallel and added
+	 *    directly, since they do not share elements.
+	 */
+	template <typename FaceKernel>
+	void assembleFaceTerms(FaceKernel kernel, std::vector<Matrix>& res);
+
+	/// Adds the integrals of the convective flux of a [PDE](@ref PDE) dotted with the gradients
+	/// of the basis functions over an element to term
+	/** The state is interpolated to all quadrature points of the element and the fluxes are
+	 * computed for all of them in one call to the PDE. If physical gradients of the basis are not
+	 * stored, the fluxes are transformed to reference space instead.
+	 * \param[in] u DOFs of the element (nvars x ndofs)
+	 * \param[in] egeom Geometry of the element, already [evaluated](@ref ElementGeometry::evaluate)
+	 * \param[in|out] term Pre-allocated (nvars x ndofs)
+	 */
+	template <typename Physics>
+	void addConvectiveVolumeTerm(const Physics& pde, const a_int iel, const Matrix& u,
+	                             const ElementGeometry& egeom, Matrix& term) const;
+
+	/// Computes the Jacobian blocks of all faces by a kernel and adds them to the Jacobian
+	/** The kernel is called as kernel(iface, jll, jlr, jrl, jrr) for each face, with the blocks
+	 * zeroed and sized for the elements involved: jll is the derivative of the face's contribution
+	 * to the residual of the left element w.r.t. the left element's DOFs, jlr that w.r.t. the right
+	 * element's DOFs, and so on. Only jll is sized for boundary faces. The ordering of DOFs is that
+	 * of [computeJacobian](@ref computeJacobian).
+	 * Faces are computed in parallel into their own blocks; the off-diagonal ones are copied into
+	 * the matrix directly, since no other face couples the same two elements, unless the matrix is
+	 * [block-diagonal](@ref BlockSparseMatrix::isBlockDiagonal). The diagonal ones are then
+	 * gathered by each element in local face order, as in the gather mode of [face
+	 * assembly](@ref assembleFaceTerms).
+	 * The kernel object is copied to each thread, so it may hold workspaces.
+	 */
+	template <typename FaceJacobianKernel>
+	void assembleFaceJacobians(FaceJacobianKernel kernel, BlockSparseMatrix& jac);
+
+	/// Adds the derivatives of the [convective volume term](@ref addConvectiveVolumeTerm) of an
+	/// element w.r.t. its DOFs to jac
+	/** The flux Jacobians along the coordinate directions at all quadrature points are computed
+	 * in one call to the PDE for each direction.
+	 * \param[in|out] jac Pre-allocated (nvars*ndofs x nvars*ndofs)
+	 */
+	template <typename Physics>
+	void addConvectiveVolumeJacobian(const Physics& pde, const a_int iel, const Matrix& u,
+	                                 const ElementGeometry& egeom, Matrix& jac) const;
+
+	/// Adds the derivatives of face integrals of a flux, tested by the basis functions of one
+	/// element w.r.t. the DOFs of another, to a Jacobian block
+	/** Adds \f$ \sum_g w_g \frac{\partial F_i}{\partial u_j}(x_g) B^t_k(x_g) B^s_l(x_g) \f$ to
+	 * jac(i*ndofs_t+k, j*ndofs_s+l), where t is the element whose residual is differentiated and
+	 * s the one whose DOFs are the independent variables.
+	 * \param[in] dfdu Flux derivatives at the quadrature points (nvars*nvars x nquad), in the
+	 *   structure-of-arrays layout of [PDE](@ref PDE) Jacobians
+	 * \param[in] wts Quadrature weights times the speed of the face, including any sign
+	 * \param[in] tbasis Basis values of element t at the quadrature points (nquad x ndofs_t)
+	 * \param[in] sbasis Basis values of element s at the quadrature points (nquad x ndofs_s)
+	 */
+	void addFaceJacobianBlock(const int nvars, const Matrix& dfdu, const a_real *const wts,
+	                          const Matrix& tbasis, const Matrix& sbasis, Matrix& jac) const;
+
+	/// Values of the basis functions of the left (side 0) or right (side 1) element of a face
+	/// at the face quadrature points (nquad x ndofs)
+	/** This also works for collocated elements, whose face values are node values.
+	 */
+	void getFaceBasis(const a_int iface, const int side, Matrix& basis) const;
+
+	/// The Bernstein element iel if it can use [sum factorization](@ref BernsteinElement::evaluate),
+	/// otherwise null
+	const BernsteinElement* bernsteinElement(const a_int iel) const {
+		if(basis_type != 'b')
+			return nullptr;
+		const BernsteinElement *const el = static_cast<const BernsteinElement*>(elems[iel]);
+		return el->hasTables() ? el : nullptr;
+	}
+
+	/// Whether the PDE's fluxes are nonlinear functions of the unknowns
+	/** If so, [domain quadrature](@ref elementQuadratureDegree) is strengthened by p_degree
+	 * to reduce aliasing errors. The implementation in this base class returns false.
+	 */
+	virtual bool hasNonlinearFlux() const { return false; }
+
+	/// Quadrature rule for a face between two elements, or on the boundary if both are the same
+	/** This is the Gauss-Lobatto rule collocated with the nodes of spectral elements if both
+	 * elements are spectral, and the Gauss rule [bquad](@ref bquad) otherwise. The Gauss-Lobatto
+	 * rule with p+1 points is exact only up to degree 2p-1, which is enough for faces between
+	 * spectral elements, whose nodal values are used directly, but not for triangle faces.
+	 */
+	const Quadrature1D* faceQuadrature(const a_int lelem, const a_int relem) const {
+		return basis_type == 's' && m->gnfael(lelem) == 4 && m->gnfael(relem) == 4 ?
+			bgllquad : bquad;
+	}
+
+	/// Strength of the domain quadrature rule to use for an element
+	/** Affine elements with linear fluxes use 2p, which integrates the mass matrix exactly.
+	 * On other elements, the Jacobian determinant is not constant: for a geometric map of degree q,
+	 * it has degree 2(q-1) on triangles and 2q-1 on quads, and that is added. 
+	 * For nonlinear fluxes, p is added too. Gauss rules on quads, and the collapsed rules of
+	 * Bernstein triangles, are computed for any strength; otherwise, on triangles, the result is
+	 * capped at 6, the strongest tabulated rule.
+	 * \param[in] iel The element, whose geometric map must be set up
+	 * \param[out] capped Whether the strength was capped, so that the element is under-integrated
+	 */
+	int elementQuadratureDegree(const a_int iel, bool& capped) const;
+
+	/// Sorts elements into [blocks](@ref blocks) by shape and quadrature strength and
+	/// sets the geometric maps of elements
+	void setupElementBlocks();
+
+	/// Detects elements that are translates of an earlier element in the same block
+	/** The edge vectors from the first node of each element to its other nodes are rounded to
+	 * a tolerance relative to the size of the domain and used as keys of a map. Elements with the same
+	 * key have the same Jacobians, basis values and gradients at quadrature points and mass matrix,
+	 * so only the first of them (the representative) keeps these. Sets [congruent](@ref congruent).
+	 * \return The number of elements that are not representatives
+	 */
+	a_int findCongruentElements();
 	
+	/// Frees geometric data at quadrature points that can be recomputed from node coordinates
+	/** This releases the quadrature point data of the [element](@ref GeomMapping2D::releaseQuadratureData)
+	 * and [face](@ref GeomMapping1D::releaseQuadratureData) mappings and the physical basis gradients
+	 * of elements that have shared reference tables. Call at the end of setup; kernels used
+	 * afterwards must obtain geometric data through \ref ElementGeometry and \ref FaceGeometry
+	 * and must handle elements with empty [basis gradients](@ref Element::bGrad).
+	 */
+	void releaseGeometricData();
+
+	/// Precomputes the [lifted face](@ref liftface) and [volume](@ref liftvol) operators
+	/** With these, the contribution of fluxes at the quadrature points to the mass-inverse-multiplied
+	 * residual is a single small matrix product per face side or element.
+	 * Call after computeFEData.
+	 */
+	void computeLiftedOperators();
+
 	/// Computes the L2 error in a FE function on an element
 	/** \param[in] comp The index of the row of ug whose error is to be computed
 	 */
@@ -66,6 +278,8 @@ public:
 	/// Constructor
 	/** \param[in] mesh is the mesh context
 	 * \param _p_degree is the polynomial degree for FE basis functions
+	 * \param basistype is the [type of basis](@ref basis_type); Lagrange and serendipity elements
+	 *   above degree 3 are replaced by Bernstein elements, which are available for any degree
 	 */
 	SpatialBase(const UMesh2dh* mesh, const int _p_degree, char basistype);
 
@@ -78,16 +292,113 @@ public:
 	virtual void spatialSetup(std::vector<Matrix>& u, std::vector<Matrix>& res,
 	                          std::vector<a_real>& mets);
 
+	/// Number of physical variables, which is the number of rows of the DOF matrix of each element
+	/** The implementation in this base class returns 1.
+	 */
+	virtual int numVars() const { return 1; }
+
+	/// Sets the unknowns to the state from which a pseudo-time iteration starts
+	/** The implementation in this base class sets all DOFs to 1.
+	 */
+	virtual void initializeUnknowns(std::vector<Matrix>& u) const;
+
 	/// Computes L2 norm of the the specified component of some vector quantity w
 	a_real computeL2Norm(const std::vector<Matrix> w, const int comp) const;
 
+	/// Selects how the inverse of the mass matrix is applied; must be called before spatialSetup
+	/** With 's' (the default), the inverse mass matrix of each element is computed and stored.
+	 * With 'f', nothing is stored for Lagrange elements: affine elements use the inverse mass matrix
+	 * of the reference element scaled by the inverse Jacobian determinant (exact), while curved
+	 * elements use the weight-adjusted approximation
+	 * \f$ M^{-1} \approx \hat{M}^{-1} \hat{M}_{1/J} \hat{M}^{-1} \f$, where
+	 * \f$ \hat{M}_{1/J} \f$ is the reference mass matrix weighted by the inverse Jacobian determinant.
+	 * Taylor elements always use stored inverses, and the diagonal mass matrices of
+	 * [collocated](@ref Element::isCollocated) elements are never stored.
+	 */
+	void setMassInverseType(const char mitype);
+
+	/// Selects orthonormalized Taylor basis functions; must be called before spatialSetup
+	/** See TaylorElement::setOrthonormalize. The DOFs are then coefficients of the orthonormal
+	 * basis functions, and the mass matrices are not stored. Only has an effect for Taylor elements.
+	 */
+	void setOrthonormalBasis(const bool ortho);
+
+	/// Selects how [face terms are added](@ref assembleFaceTerms) to element residuals;
+	/// must be called before spatialSetup
+	/** 'a' for atomic updates (the default), 'g' for a face phase followed by a gather phase
+	 * over elements, or 'c' for face coloring.
+	 */
+	void setFaceAssemblyType(const char fatype);
+
 	/// Inverse of mass matrix
+	/** \warning Entries are empty for elements whose mass inverse is applied matrix-free,
+	 * and for elements that share the mass matrix of a [congruent element](@ref congruentElement).
+	 * Use [applyMassInverse](@ref applyMassInverse) instead.
+	 */
 	const std::vector<Matrix>& massInv() const {
 		return minv;
 	}
 
+	/// Multiplies the residual (nvars x ndofs) of an element by the inverse of its mass matrix
+	/** Since the mass matrix is symmetric, this computes mr = r M^{-1}.
+	 */
+	void applyElemMassInverse(const a_int iel, const Matrix& r, Matrix& mr) const {
+		ElementGeometry egeom;
+		applyElemMassInverse(iel, r, mr, egeom);
+	}
+
+	/// Multiplies the residual of an element by its inverse mass matrix, using a workspace for
+	/// recomputed geometric data if needed \sa releaseGeometricData
+	void applyElemMassInverse(const a_int iel, const Matrix& r, Matrix& mr, ElementGeometry& egeom) const;
+
+	/// Multiplies the residuals of all elements by the inverses of their mass matrices
+	/** Blocks of elements with stored mass inverses are processed together by a batched product.
+	 */
+	void applyMassInverse(const std::vector<Matrix>& r, std::vector<Matrix>& mr) const;
+
+	/// Whether [update_residual](@ref update_residual) returns the residual already multiplied by
+	/// the inverse mass matrix
+	/** In that case, solvers must not [apply the mass inverse](@ref applyMassInverse) again.
+	 */
+	virtual bool isResidualLifted() const { return false; }
+
+	/// Whether the [Jacobian](@ref computeJacobian) of the residual can be computed
+	/** The implementation in this base class returns false.
+	 */
+	virtual bool hasJacobian() const { return false; }
+
+	/// Sets up the [block-sparse](@ref BlockSparseMatrix) structure of the Jacobian, with one block
+	/// row of size nvars*ndofs per element
+	/** \param[in] diagonalonly If true, only the diagonal blocks are set up; then
+	 *   [computeJacobian](@ref computeJacobian) only computes those.
+	 */
+	void setupJacobianMatrix(BlockSparseMatrix& jac, const bool diagonalonly = false) const;
+
+	/// Computes the derivatives of the [residual](@ref update_residual) w.r.t. the DOFs, in blocks
+	/// coupling pairs of elements
+	/** Within an element, the DOF of variable ivar and basis function idof is at position
+	 * ivar*ndofs + idof, which is the order in which the DOF matrix of the element is stored.
+	 * \param[in] u The DOFs at which the Jacobian is evaluated
+	 * \param[out] jac The Jacobian; its [structure](@ref setupJacobianMatrix) is set up if it has
+	 *   not been already
+	 *
+	 * The implementation in this base class only reports that the Jacobian is not available.
+	 */
+	virtual void computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac);
+
+	/// Computes the mass matrix (ndofs x ndofs) of an element by its domain quadrature rule
+	void computeElemMassMatrix(const a_int iel, Matrix& mass, ElementGeometry& egeom) const;
+
 	a_int numTotalDOFs() const { return ntotaldofs; }
 
+	/// The element whose mass matrix and other FE data element iel shares, possibly iel itself
+	a_int congruentElement(const a_int iel) const { return congruent[iel]; }
+
+	/// Index of the first DOF of element iel when all elements' DOFs are numbered consecutively
+	/** Has nelem+1 entries; the last one is the total number of DOFs.
+	 */
+	a_int dofStart(const a_int iel) const { return dofstart[iel]; }
+
 	/// Calls functions to add contribution to the RHS, and also compute max time steps
 	virtual void update_residual(const std::vector<Matrix>& u, 
 	                             std::vector<Matrix>& res, 
@@ -116,5 +427,245 @@ public:
 	                               std::vector<Matrix>& u);
 };
 
+template <typename FaceKernel>
+void SpatialBase::assembleFaceTerms(FaceKernel kernel, std::vector<Matrix>& res)
+{
+	if(faceassembly_type == 'g')
+	{
+		// face phase: each face writes only to its own buffers
+#pragma omp parallel for default(shared) firstprivate(kernel)
+		for(a_int iface = 0; iface < m->gnaface(); iface++)
+		{
+			const a_int lelem = m->gintfac(iface,0);
+			Matrix& lterm = faceterms[2*iface];
+			Matrix& rterm = faceterms[2*iface+1];
+			lterm.setZero(res[lelem].rows(), res[lelem].cols());
+			if(iface >= m->gnbface()) {
+				const a_int relem = m->gintfac(iface,1);
+				rterm.setZero(res[relem].rows(), res[relem].cols());
+			}
+			kernel(iface, lterm, rterm);
+		}
+
+		// gather phase: each element is only written by the thread that owns it
+#pragma omp parallel for default(shared)
+		for(a_int iel = 0; iel < m->gnelem(); iel++)
+			for(int ifa = 0; ifa < m->gnfael(iel); ifa++) {
+				const a_int iface = m->gelemface(iel,ifa);
+				res[iel] += faceterms[2*iface + (m->gintfac(iface,0) == iel ? 0 : 1)];
+			}
+	}
+	else if(faceassembly_type == 'c')
+	{
+#pragma omp parallel default(shared) firstprivate(kernel)
+		{
+			Matrix lterm, rterm;
+			for(size_t icolor = 0; icolor < facecolors.size(); icolor++)
+			{
+				const std::vector<a_int>& cfaces = facecolors[icolor];
+				// the implied barrier at the end separates colors
+#pragma omp for
+				for(size_t i = 0; i < cfaces.size(); i++)
+				{
+					const a_int iface = cfaces[i];
+					const a_int lelem = m->gintfac(iface,0);
+					lterm.setZero(res[lelem].rows(), res[lelem].cols());
+					if(iface < m->gnbface()) {
+						rterm.resize(0,0);
+						kernel(iface, lterm, rterm);
+						res[lelem] += lterm;
+						continue;
+					}
+					const a_int relem = m->gintfac(iface,1);
+					rterm.setZero(res[relem].rows(), res[relem].cols());
+					kernel(iface, lterm, rterm);
+					res[lelem] += lterm;
+					res[relem] += rterm;
+				}
+			}
+		}
+	}
+	else
+	{
+#pragma omp parallel default(shared) firstprivate(kernel)
+		{
+			Matrix lterm, rterm;
+#pragma omp for
+			for(a_int iface = 0; iface < m->gnaface(); iface++)
+			{
+				const a_int lelem = m->gintfac(iface,0);
+				lterm.setZero(res[lelem].rows(), res[lelem].cols());
+				if(iface < m->gnbface())
+					rterm.resize(0,0);
+				else
+					rterm.setZero(res[m->gintfac(iface,1)].rows(), res[m->gintfac(iface,1)].cols());
+				kernel(iface, lterm, rterm);
+
+				for(int i = 0; i < lterm.rows(); i++)
+					for(int j = 0; j < lterm.cols(); j++)
+#pragma omp atomic update
+						res[lelem](i,j) += lterm(i,j);
+				if(iface < m->gnbface())
+					continue;
+				const a_int relem = m->gintfac(iface,1);
+				for(int i = 0; i < rterm.rows(); i++)
+					for(int j = 0; j < rterm.cols(); j++)
+#pragma omp atomic update
+						res[relem](i,j) += rterm(i,j);
+			}
+		}
+	}
+}
+
+template <typename Physics>
+void SpatialBase::addConvectiveVolumeTerm(const Physics& pde, const a_int iel, const Matrix& u,
+                                          const ElementGeometry& egeom, Matrix& term) const
+{
+	constexpr int nv = Physics::nvars;
+	const int ng = map2d[iel].getQuadrature()->numGauss();
+	const int ndofs = elems[iel]->getNumDOFs();
+	const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+	const std::vector<Matrix>& bgrads = elems[iel]->bGrad();
+	const bool refgrads = bgrads.size() == 0;
+	const std::vector<Matrix>& grads = refgrads ? elems[iel]->getBasisSet()->basisGrad[0] : bgrads;
+
+	// states and fluxes at the quadrature points in structure-of-arrays layout
+	Matrix uinterp(ng, nv);
+	elems[iel]->interpolateAll(u, uinterp);
+	const Matrix uq = uinterp.transpose();
+	Matrix flux(NDIM*nv, ng);
+	pde.convFlux(ng, uq.data(), flux.data());
+
+	for(int ig = 0; ig < ng; ig++)
+	{
+		const a_real weightjacdet = wts(ig)*egeom.jacDet(ig);
+		a_real f[NDIM][nv];
+		for(int idim = 0; idim < NDIM; idim++)
+			for(int ivar = 0; ivar < nv; ivar++)
+				f[idim][ivar] = flux(idim*nv+ivar, ig)*weightjacdet;
+
+		if(refgrads) {
+			const MatrixDim& jinv = egeom.jacInv(ig);
+			for(int ivar = 0; ivar < nv; ivar++) {
+				const a_real fx = f[0][ivar], fy = f[1][ivar];
+				f[0][ivar] = jinv(0,0)*fx + jinv(0,1)*fy;
+				f[1][ivar] = jinv(1,0)*fx + jinv(1,1)*fy;
+			}
+		}
+
+		for(int ivar = 0; ivar < nv; ivar++)
+			for(int idof = 0; idof < ndofs; idof++)
+				term(ivar,idof) += f[0][ivar]*grads[ig](idof,0) + f[1][ivar]*grads[ig](idof,1);
+	}
+}
+
+template <typename FaceJacobianKernel>
+void SpatialBase::assembleFaceJacobians(FaceJacobianKernel kernel, BlockSparseMatrix& jac)
+{
+	const int nvars = numVars();
+	const bool diagonalonly = jac.isBlockDiagonal();
+	std::vector<Matrix> facediag(2*m->gnaface());
+	Matrix jlr, jrl;
+
+	// face phase: each face writes only to its own blocks
+#pragma omp parallel for default(shared) firstprivate(kernel, jlr, jrl)
+	for(a_int iface = 0; iface < m->gnaface(); iface++)
+	{
+		const a_int lelem = m->gintfac(iface,0);
+		const int nl = nvars*elems[lelem]->getNumDOFs();
+		Matrix& jll = facediag[2*iface];
+		Matrix& jrr = facediag[2*iface+1];
+		jll.setZero(nl, nl);
+		if(iface < m->gnbface()) {
+			jrr.resize(0,0);
+			jlr.resize(0,0);
+			jrl.resize(0,0);
+			kernel(iface, jll, jlr, jrl, jrr);
+		}
+		else {
+			const a_int relem = m->gintfac(iface,1);
+			const int nr = nvars*elems[relem]->getNumDOFs();
+			jrr.setZero(nr, nr);
+			jlr.setZero(nl, nr);
+			jrl.setZero(nr, nl);
+			kernel(iface, jll, jlr, jrl, jrr);
+			if(!diagonalonly) {
+				jac.block(lelem, relem) += jlr;
+				jac.block(relem, lelem) += jrl;
+			}
+		}
+	}
+
+	// gather phase: each element is only written by the thread that owns it
+#pragma omp parallel for default(shared)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		Eigen::Map<Matrix> diag = jac.diagonalBlock(iel);
+		for(int ifa = 0; ifa < m->gnfael(iel); ifa++) {
+			const a_int iface = m->gelemface(iel,ifa);
+			diag += facediag[2*iface + (m->gintfac(iface,0) == iel ? 0 : 1)];
+		}
+	}
+}
+
+template <typename Physics>
+void SpatialBase::addConvectiveVolumeJacobian(const Physics& pde, const a_int iel, const Matrix& u,
+                                              const ElementGeometry& egeom, Matrix& jac) const
+{
+	constexpr int nv = Physics::nvars;
+	const int ng = map2d[iel].getQuadrature()->numGauss();
+	const int ndofs = elems[iel]->getNumDOFs();
+	const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+	const std::vector<Matrix>& bgrads = elems[iel]->bGrad();
+	const bool refgrads = bgrads.size() == 0;
+	const std::vector<Matrix>& grads = refgrads ? elems[iel]->getBasisSet()->basisGrad[0] : bgrads;
+	const bool colloc = elems[iel]->isCollocated();
+	const Matrix& bas = elems[iel]->bFunc();
+
+	// flux Jacobians along x and y at the quadrature points in structure-of-arrays layout
+	Matrix uinterp(ng, nv);
+	elems[iel]->interpolateAll(u, uinterp);
+	const Matrix uq = uinterp.transpose();
+	Matrix dirs = Matrix::Zero(NDIM, ng);
+	Matrix dfdu[NDIM];
+	for(int idim = 0; idim < NDIM; idim++) {
+		dirs.setZero();
+		dirs.row(idim).setOnes();
+		dfdu[idim].resize(nv*nv, ng);
+		pde.dConvFlux_du(ng, uq.data(), dirs.data(), dfdu[idim].data());
+	}
+
+	Matrix pgrad(ndofs, NDIM);
+	for(int ig = 0; ig < ng; ig++)
+	{
+		const a_real weightjacdet = wts(ig)*egeom.jacDet(ig);
+		if(refgrads) {
+			const MatrixDim& jinv = egeom.jacInv(ig);
+			for(int idof = 0; idof < ndofs; idof++)
+				for(int idim = 0; idim < NDIM; idim++)
+					pgrad(idof,idim) = jinv(0,idim)*grads[ig](idof,0) + jinv(1,idim)*grads[ig](idof,1);
+		}
+		else
+			pgrad = grads[ig];
+
+		for(int ivar = 0; ivar < nv; ivar++)
+			for(int jvar = 0; jvar < nv; jvar++)
+			{
+				const a_real ax = dfdu[0](ivar*nv+jvar, ig)*weightjacdet;
+				const a_real ay = dfdu[1](ivar*nv+jvar, ig)*weightjacdet;
+				for(int idof = 0; idof < ndofs; idof++)
+				{
+					const a_real c = ax*pgrad(idof,0) + ay*pgrad(idof,1);
+					// for collocated elements, only the node at this point depends on the state here
+					if(colloc)
+						jac(ivar*ndofs+idof, jvar*ndofs+ig) += c;
+					else
+						for(int jdof = 0; jdof < ndofs; jdof++)
+							jac(ivar*ndofs+idof, jvar*ndofs+jdof) += c*bas(ig,jdof);
+				}
+			}
+	}
+}
+
 }	// end namespace
 #endif
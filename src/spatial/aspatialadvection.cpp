@@ -12,26 +12,265 @@ namespace tadgens {
 
 LinearAdvection::LinearAdvection(const UMesh2dh* mesh, const int _p_degree, const char basis, 
                                  const int inoutflag, const int extrapflag)
-	: SpatialBase(mesh, _p_degree, basis), inoutflow_flag(inoutflag), 
-	  extrapolation_flag(extrapflag), nvars{1}, aa{1.59/2}, bb{1.81}, dd{1.0}, ee{1.2}
+	: SpatialBase(mesh, _p_degree, basis), a{{std::exp(1.0)/2.0, -std::atan(1.0)}}, physics(a.data()),
+	  inoutflow_flag(inoutflag), extrapolation_flag(extrapflag), nvars{1}, aa{1.59/2}, bb{1.81}, dd{1.0}, ee{1.2}, lifted{false}, quadfree{false}, recomputegeom{false}
 	  //aa{0}, bb{2*PI}, dd{PI/2.0}, ee{0}
 {
-	a[0] = std::exp(1.0)/2.0; a[1] = -std::atan(1.0);
 	//a[0] = 1; a[1] = 1;
 	
 	std::cout << " LinearAdvection: Velocity is (" << a[0] << ", " << a[1] << ")\n";
 	amag = std::sqrt(a[0]*a[0]+a[1]*a[1]);
 }
 
-void LinearAdvection::computeBoundaryState(const int iface, const Matrix& instate, 
+void LinearAdvection::spatialSetup(std::vector<Matrix>& u, std::vector<Matrix>& res,
+                                   std::vector<a_real>& mets)
+{
+	SpatialBase::spatialSetup(u, res, mets);
+	if(lifted && quadfree) {
+		std::printf(" LinearAdvection: spatialSetup: ! The quadrature-free mode cannot be used with"
+		            " the lifted residual; it is disabled.\n");
+		quadfree = false;
+	}
+	if(lifted)
+		computeLiftedOperators();
+	if(quadfree)
+		setupQuadratureFree();
+	setupBatchedVolume();
+	if(recomputegeom)
+		releaseGeometricData();
+}
+
+const Matrix& LinearAdvection::getFaceMatrix(const Shape xshape, const int xlfn, const int xside,
+                                             const Shape yshape, const int ylfn, const int yside)
+{
+	Matrix& K = qffacemats[traceIndex(xshape,xlfn,xside)*NTRACES + traceIndex(yshape,ylfn,yside)];
+	if(K.size() == 0)
+	{
+		const Matrix& bx = ftraces.basis(xshape, xlfn, xside);
+		const Matrix& by = ftraces.basis(yshape, ylfn, yside);
+		const amat::Array2d<a_real>& wts = bquad->weights();
+		Matrix wby = by;
+		for(int ig = 0; ig < wby.rows(); ig++)
+			wby.row(ig) *= wts(ig);
+		K = bx.transpose()*wby;
+	}
+	return K;
+}
+
+void LinearAdvection::setupQuadratureFree()
+{
+	qfelems.assign(m->gnelem(), 0);
+	qffaces.assign(m->gnaface(), QFFace{false, true, 0.0, nullptr, nullptr});
+	qfsource.resize(m->gnelem());
+	qfvolmats.resize(3*NDIM);
+	qffacemats.assign(NTRACES*NTRACES, Matrix());
+
+	if(basis_type != 'l') {
+		std::printf(" LinearAdvection: setupQuadratureFree: ! Only available for Lagrange elements.\n");
+		return;
+	}
+
+	// reference volume matrices
+	for(int ishape = TRIANGLE; ishape <= QUADRANGLE; ishape++)
+	{
+		const BasisSet& bs = ishape == TRIANGLE ? tribset : quadbset;
+		const Quadrature2D *const quad = ishape == TRIANGLE ? static_cast<Quadrature2D*>(dtquad)
+			: static_cast<Quadrature2D*>(dsquad);
+		const Matrix& bas = bs.basis[0];
+		const std::vector<Matrix>& rgrads = bs.basisGrad[0];
+		const amat::Array2d<a_real>& wts = quad->weights();
+		for(int idim = 0; idim < NDIM; idim++) {
+			Matrix& S = qfvolmats[ishape*NDIM+idim];
+			S = Matrix::Zero(bas.cols(), bas.cols());
+			for(int ig = 0; ig < quad->numGauss(); ig++)
+				for(int j = 0; j < bas.cols(); j++)
+					for(int i = 0; i < bas.cols(); i++)
+						S(j,i) += bas(ig,j)*rgrads[ig](i,idim)*wts(ig);
+		}
+	}
+
+	// elements, and their source term contributions
+	a_int nqfelems = 0;
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
+	{
+		if(!map2d[iel].isAffine() || !elems[iel]->getBasisSet())
+			continue;
+		qfelems[iel] = 1;
+		nqfelems++;
+
+		const int ndofs = elems[iel]->getNumDOFs();
+		const Matrix& bas = elems[iel]->bFunc();
+		const Matrix& pts = map2d[iel].map();
+		const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+		qfsource[iel] = Matrix::Zero(nvars, ndofs);
+		for(int ig = 0; ig < map2d[iel].getQuadrature()->numGauss(); ig++)
+		{
+			const a_real ptcoords[] = {pts(ig,0), pts(ig,1)};
+			const a_real sw = source_term(ptcoords,0) * wts(ig) * map2d[iel].jacDet(0);
+			for(int idof = 0; idof < ndofs; idof++)
+				qfsource[iel](0,idof) += sw * bas(ig,idof);
+		}
+	}
+
+	// interior faces that are straight and shared by referential elements with shared traces
+	a_int nqffaces = 0;
+	for(a_int iface = m->gnbface(); iface < m->gnaface(); iface++)
+	{
+		const a_int lelem = m->gintfac(iface,0), relem = m->gintfac(iface,1);
+		const Shape lshape = map2d[lelem].getShape(), rshape = map2d[relem].getShape();
+		if(elems[lelem]->getType() != REFERENTIAL || elems[relem]->getType() != REFERENTIAL
+		   || !ftraces.has(lshape, elems[lelem]->getDegree(), map1d[iface].getQuadrature())
+		   || !ftraces.has(rshape, elems[relem]->getDegree(), map1d[iface].getQuadrature()))
+			continue;
+
+		const std::vector<Vector>& n = map1d[iface].normal();
+		const std::vector<a_real>& sp = map1d[iface].speed();
+		bool straight = true;
+		for(size_t ig = 1; ig < n.size(); ig++)
+			if(std::fabs(n[ig][0]-n[0][0]) > SMALL_NUMBER || std::fabs(n[ig][1]-n[0][1]) > SMALL_NUMBER
+			   || std::fabs(sp[ig]-sp[0]) > SMALL_NUMBER*sp[0])
+				straight = false;
+		if(!straight)
+			continue;
+
+		const int llfn = m->gfacelocalnum(iface,0), rlfn = m->gfacelocalnum(iface,1);
+		QFFace& qf = qffaces[iface];
+		qf.active = true;
+		const a_real adotn = a[0]*n[0][0] + a[1]*n[0][1];
+		qf.coeff = adotn*sp[0];
+		qf.upwindleft = adotn >= 0;
+		if(qf.upwindleft) {
+			qf.toleft = &getFaceMatrix(lshape, llfn, 0, lshape, llfn, 0);
+			qf.toright = &getFaceMatrix(lshape, llfn, 0, rshape, rlfn, 1);
+		}
+		else {
+			qf.toleft = &getFaceMatrix(rshape, rlfn, 1, lshape, llfn, 0);
+			qf.toright = &getFaceMatrix(rshape, rlfn, 1, rshape, rlfn, 1);
+		}
+		nqffaces++;
+	}
+
+	std::printf(" LinearAdvection: setupQuadratureFree: %d elements and %d interior faces"
+	            " are quadrature-free\n", nqfelems, nqffaces);
+}
+
+void LinearAdvection::setupBatchedVolume()
+{
+	vbatched.assign(m->gnelem(), 0);
+	vbelems.assign(blocks.size(), std::vector<a_int>());
+	vbbasisT.resize(blocks.size());
+	vbgrads.resize(blocks.size());
+	vbcoeffs.resize(blocks.size());
+	vbsource.resize(blocks.size());
+	if(lifted || p_degree == 0)
+		return;
+
+	a_int nbatched = 0;
+	for(size_t ib = 0; ib < blocks.size(); ib++)
+	{
+		if(!blocks[ib].bset)
+			continue;
+		std::vector<a_int>& elist = vbelems[ib];
+		for(size_t i = 0; i < blocks[ib].elements.size(); i++) {
+			const a_int iel = blocks[ib].elements[i];
+			if(map2d[iel].isAffine() && elems[iel]->getBasisSet() && !(quadfree && qfelems[iel])
+			   && !bernsteinElement(iel)) {
+				elist.push_back(iel);
+				vbatched[iel] = 1;
+			}
+		}
+		if(elist.size() == 0)
+			continue;
+		nbatched += static_cast<a_int>(elist.size());
+
+		const int nb = static_cast<int>(elist.size());
+		const Matrix& bas = blocks[ib].bset->basis[0];
+		const std::vector<Matrix>& rgrads = blocks[ib].bset->basisGrad[0];
+		const int ng = static_cast<int>(bas.rows()), ndofs = static_cast<int>(bas.cols());
+		const amat::Array2d<a_real>& wts = blocks[ib].quad->weights();
+
+		vbbasisT[ib] = bas.transpose();
+		vbgrads[ib].resize(ng, NDIM*ndofs);
+		for(int ig = 0; ig < ng; ig++)
+			for(int idim = 0; idim < NDIM; idim++)
+				for(int idof = 0; idof < ndofs; idof++)
+					vbgrads[ib](ig,idim*ndofs+idof) = wts(ig)*rgrads[ig](idof,idim);
+
+		vbcoeffs[ib].resize(NDIM*nb);
+		vbsource[ib].resize(nb, nvars, ndofs);
+		vbsource[ib].setZero();
+
+#pragma omp parallel for default(shared)
+		for(int k = 0; k < nb; k++)
+		{
+			const a_int iel = elist[k];
+			const MatrixDim& jinv = map2d[iel].jacInv(0);
+			const a_real jdet = map2d[iel].jacDet(0);
+			for(int idim = 0; idim < NDIM; idim++)
+				vbcoeffs[ib][idim*nb+k] = jdet*(jinv(idim,0)*a[0] + jinv(idim,1)*a[1]);
+
+			const Matrix& pts = map2d[iel].map();
+			for(int ig = 0; ig < ng; ig++)
+			{
+				const a_real ptcoords[] = {pts(ig,0), pts(ig,1)};
+				const a_real sw = source_term(ptcoords,0) * wts(ig) * jdet;
+				for(int idof = 0; idof < ndofs; idof++)
+					vbsource[ib](k,0,idof) += sw * bas(ig,idof);
+			}
+		}
+	}
+
+	std::printf(" LinearAdvection: setupBatchedVolume: Volume terms of %d elements are batched\n",
+	            nbatched);
+}
+
+void LinearAdvection::computeBatchedVolumeTerms(const std::vector<Matrix>& u,
+                                                std::vector<Matrix>& res) const
+{
+	BatchedMatrices ub, uq, fb, term;
+	for(size_t ib = 0; ib < vbelems.size(); ib++)
+	{
+		const std::vector<a_int>& elist = vbelems[ib];
+		if(elist.size() == 0)
+			continue;
+		const int nb = static_cast<int>(elist.size());
+		const int ng = static_cast<int>(vbbasisT[ib].cols()), ndofs = static_cast<int>(vbbasisT[ib].rows());
+
+		// interpolate to quadrature points and integrate against weighted reference gradients
+		ub.gather(u, elist);
+		uq.resize(nb, nvars, ng);
+		batchedGemmSharedRight(1.0, ub, vbbasisT[ib], 0.0, uq);
+		fb.resize(nb, nvars, NDIM*ndofs);
+		batchedGemmSharedRight(1.0, uq, vbgrads[ib], 0.0, fb);
+
+		// combine directions with the element-wise coefficients, and add the source term
+		term = vbsource[ib];
+		const a_real *const cx = &vbcoeffs[ib][0];
+		const a_real *const cy = &vbcoeffs[ib][nb];
+		for(int ivar = 0; ivar < nvars; ivar++)
+			for(int idof = 0; idof < ndofs; idof++)
+			{
+				a_real *const t = term.slice(ivar,idof);
+				const a_real *const fx = fb.slice(ivar,idof);
+				const a_real *const fy = fb.slice(ivar,ndofs+idof);
+#pragma omp simd
+				for(int k = 0; k < nb; k++)
+					t[k] += cx[k]*fx[k] + cy[k]*fy[k];
+			}
+
+		term.scatterAdd(-1.0, res, elist);
+	}
+}
+
+void LinearAdvection::computeBoundaryState(const FaceGeometry& fgeom, const Matrix& instate,
                                            Matrix& bstate)
 {
 	// if(m->gintfacbtags(iface, 0) == inoutflow_flag)
 	// {
 		// compute normal velocity and decide whether to extrapolate 
 		// or impose specified boundary value at each quadrature point
-		const std::vector<Vector>& n = map1d[iface].normal();
-		const Matrix& phypoints = map1d[iface].map();
+		const std::vector<Vector>& n = fgeom.normal();
+		const Matrix& phypoints = fgeom.map();
 		for(size_t ig = 0; ig < n.size(); ig++)
 		{
 			const a_real phycoords[] = {phypoints(ig,0), phypoints(ig,1)};
@@ -53,111 +292,296 @@ void LinearAdvection::computeNumericalFlux(const a_real* const uleft, const a_re
                                            const a_real* const n,
                                            a_real* const flux)
 {
-	const a_real adotn = a[0]*n[0]+a[1]*n[1];
-	if(adotn >= 0)
-		flux[0] = adotn*uleft[0];
-	else
-		flux[0] = adotn*uright[0];
+	a_real adotn;
+	physics.dConvFlux_du(1, uleft, n, &adotn);
+	physics.normalConvFlux(1, adotn >= 0 ? uleft : uright, n, flux);
 }
 
-void LinearAdvection::update_residual(const std::vector<Matrix>& u, std::vector<Matrix>& res,
-                                      std::vector<a_real>& mets)
+void LinearAdvection::computeNumericalFluxJacobian(const a_real* const uleft,
+                                                   const a_real* const uright, const a_real* const n,
+                                                   a_real* const dfdl, a_real* const dfdr) const
 {
-#pragma omp parallel for default(shared)
-	for(a_int iface = 0; iface < m->gnbface(); iface++)
+	a_real adotn;
+	physics.dConvFlux_du(1, uleft, n, &adotn);
+	*dfdl = adotn >= 0 ? adotn : 0;
+	*dfdr = adotn >= 0 ? 0 : adotn;
+}
+
+void LinearAdvection::computeFaceJacobian(const a_int iface, FaceGeometry& fgeom, Matrix& jll,
+                                          Matrix& jlr, Matrix& jrl, Matrix& jrr) const
+{
+	const int ng = map1d[iface].getQuadrature()->numGauss();
+	const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
+	fgeom.evaluate(map1d[iface]);
+	const std::vector<Vector>& n = fgeom.normal();
+	const bool boundary = iface < m->gnbface();
+
+	Matrix dfdl(nvars*nvars, ng), dfdr(nvars*nvars, ng);
+	std::vector<a_real> wsp(ng), mwsp(ng);
+	// the flux is linear, so its derivatives do not depend on the states
+	const a_real dummy = 0;
+	for(int ig = 0; ig < ng; ig++) {
+		computeNumericalFluxJacobian(&dummy, &dummy, &n[ig](0), &dfdl(0,ig), &dfdr(0,ig));
+		wsp[ig] = wts(ig)*fgeom.speed()[ig];
+		mwsp[ig] = -wsp[ig];
+	}
+
+	Matrix lbasis;
+	getFaceBasis(iface, 0, lbasis);
+	addFaceJacobianBlock(nvars, dfdl, &wsp[0], lbasis, lbasis, jll);
+	if(boundary)
+		return;
+
+	Matrix rbasis;
+	getFaceBasis(iface, 1, rbasis);
+	addFaceJacobianBlock(nvars, dfdr, &wsp[0], lbasis, rbasis, jlr);
+	addFaceJacobianBlock(nvars, dfdl, &mwsp[0], rbasis, lbasis, jrl);
+	addFaceJacobianBlock(nvars, dfdr, &mwsp[0], rbasis, rbasis, jrr);
+}
+
+void LinearAdvection::computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac)
+{
+	if(lifted) {
+		std::printf(" LinearAdvection: computeJacobian: ! Not available for the lifted residual!\n");
+		return;
+	}
+
+	FaceGeometry fgeom;
+	ElementGeometry egeom;
+	if(jac.numBlockRows() != m->gnelem())
+		setupJacobianMatrix(jac);
+	jac.setZero();
+
+	if(p_degree > 0) {
+#pragma omp parallel for default(shared) firstprivate(egeom)
+		for(a_int iel = 0; iel < m->gnelem(); iel++)
+		{
+			const int n = nvars*elems[iel]->getNumDOFs();
+			egeom.evaluate(map2d[iel], false);
+			Matrix vjac = Matrix::Zero(n, n);
+			addConvectiveVolumeJacobian(physics, iel, u[iel], egeom, vjac);
+			jac.diagonalBlock(iel) -= vjac;
+		}
+	}
+
+	assembleFaceJacobians([this, fgeom](const a_int iface, Matrix& jll, Matrix& jlr, Matrix& jrl,
+	                                    Matrix& jrr) mutable {
+			computeFaceJacobian(iface, fgeom, jll, jlr, jrl, jrr);
+		}, jac);
+}
+
+void LinearAdvection::computeFaceTerms(const a_int iface, const std::vector<Matrix>& u,
+                                       FaceGeometry& fgeom, Matrix& lterm, Matrix& rterm)
+{
+	const a_int lelem = m->gintfac(iface,0);
+
+	if(iface < m->gnbface())
 	{
-		a_int lelem = m->gintfac(iface,0);
-		int ng = map1d[iface].getQuadrature()->numGauss();
-		const std::vector<Vector>& n = map1d[iface].normal();
+		const int ng = map1d[iface].getQuadrature()->numGauss();
+		fgeom.evaluate(map1d[iface]);
+		const std::vector<Vector>& n = fgeom.normal();
 		const Matrix& lbasis = faces[iface].leftBasis();
+		const std::vector<int> *const lnodes = faces[iface].leftNodes();
 
 		Matrix linterps(ng,nvars), rinterps(ng,nvars);
 		Matrix fluxes(ng,nvars);
 
 		faces[iface].interpolateAll_left(u[lelem], linterps);
-		computeBoundaryState(iface, linterps, rinterps);
+		computeBoundaryState(fgeom, linterps, rinterps);
+
+		if(lifted) {
+			for(int ig = 0; ig < ng; ig++)
+				computeNumericalFlux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
+			lterm.noalias() += fluxes.transpose()*liftface[2*iface];
+			return;
+		}
 
-#pragma omp simd
 		for(int ig = 0; ig < ng; ig++)
 		{
-			const a_real weightandsp = map1d[iface].getQuadrature()->weights()(ig) * map1d[iface].speed()[ig];
+			const a_real weightandsp = map1d[iface].getQuadrature()->weights()(ig) * fgeom.speed()[ig];
 
 			computeNumericalFlux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
 
+			// the face values are node values; the flux only goes to that node
+			if(lnodes) {
+				for(int ivar = 0; ivar < nvars; ivar++)
+					lterm(ivar,(*lnodes)[ig]) += fluxes(ig,ivar) * weightandsp;
+				continue;
+			}
+
 			for(int ivar = 0; ivar < nvars; ivar++) {
 				for(int idof = 0; idof < elems[lelem]->getNumDOFs(); idof++)
-					res[lelem](ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * weightandsp;
+					lterm(ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * weightandsp;
 			}
 		}
+		return;
 	}
-	
-#pragma omp parallel for default(shared)
-	for(a_int iface = m->gnbface(); iface < m->gnaface(); iface++)
+
+	const a_int relem = m->gintfac(iface,1);
+
+	if(quadfree && qffaces[iface].active)
 	{
-		const a_int lelem = m->gintfac(iface,0);
-		const a_int relem = m->gintfac(iface,1);
-		const int ng = map1d[iface].getQuadrature()->numGauss();
-		const std::vector<Vector>& n = map1d[iface].normal();
-		const Matrix& lbasis = faces[iface].leftBasis();
-		const Matrix& rbasis = faces[iface].rightBasis();
+		const QFFace& qf = qffaces[iface];
+		const Matrix& uup = qf.upwindleft ? u[lelem] : u[relem];
+		lterm.noalias() += qf.coeff * uup * (*qf.toleft);
+		rterm.noalias() -= qf.coeff * uup * (*qf.toright);
+		return;
+	}
 
-		Matrix linterps(ng,nvars), rinterps(ng,nvars);
-		Matrix fluxes(ng,nvars);
-		
-		faces[iface].interpolateAll_left(u[lelem], linterps);
-		faces[iface].interpolateAll_right(u[relem], rinterps);
+	const int ng = map1d[iface].getQuadrature()->numGauss();
+	fgeom.evaluate(map1d[iface]);
+	const std::vector<Vector>& n = fgeom.normal();
+	const Matrix& lbasis = faces[iface].leftBasis();
+	const Matrix& rbasis = faces[iface].rightBasis();
+	const std::vector<int> *const lnodes = faces[iface].leftNodes();
+	const std::vector<int> *const rnodes = faces[iface].rightNodes();
 
-		for(int ig = 0; ig < ng; ig++)
-		{
-			const a_real wtandsp = map1d[iface].getQuadrature()->weights()(ig) * map1d[iface].speed()[ig];
+	Matrix linterps(ng,nvars), rinterps(ng,nvars);
+	Matrix fluxes(ng,nvars);
+
+	faces[iface].interpolateAll_left(u[lelem], linterps);
+	faces[iface].interpolateAll_right(u[relem], rinterps);
 
+	if(lifted)
+	{
+		for(int ig = 0; ig < ng; ig++)
 			computeNumericalFlux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
+		lterm.noalias() += fluxes.transpose()*liftface[2*iface];
+		rterm.noalias() -= fluxes.transpose()*liftface[2*iface+1];
+		return;
+	}
 
-			for(int ivar = 0; ivar < nvars; ivar++)
-			{
+	for(int ig = 0; ig < ng; ig++)
+	{
+		const a_real wtandsp = map1d[iface].getQuadrature()->weights()(ig) * fgeom.speed()[ig];
+
+		computeNumericalFlux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
+
+		for(int ivar = 0; ivar < nvars; ivar++)
+		{
+			if(lnodes)
+				lterm(ivar,(*lnodes)[ig]) += fluxes(ig,ivar) * wtandsp;
+			else
 				for(int idof = 0; idof < elems[lelem]->getNumDOFs(); idof++)
-#pragma omp atomic update
-					res[lelem](ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * wtandsp;
+					lterm(ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * wtandsp;
 
+			if(rnodes)
+				rterm(ivar,(*rnodes)[ig]) -= fluxes(ig,ivar) * wtandsp;
+			else
 				for(int idof = 0; idof < elems[relem]->getNumDOFs(); idof++)
-#pragma omp atomic update
-					res[relem](ivar,idof) -= fluxes(ig,ivar) * rbasis(ig,idof) * wtandsp;
-			}
+					rterm(ivar,idof) -= fluxes(ig,ivar) * rbasis(ig,idof) * wtandsp;
 		}
 	}
+}
 
-#pragma omp parallel for default(shared)
+void LinearAdvection::update_residual(const std::vector<Matrix>& u, std::vector<Matrix>& res,
+                                      std::vector<a_real>& mets)
+{
+	// workspaces for geometric data, in case it is not stored
+	FaceGeometry fgeom;
+	ElementGeometry egeom;
+
+	assembleFaceTerms([this, &u, fgeom](const a_int iface, Matrix& lterm, Matrix& rterm) mutable {
+			computeFaceTerms(iface, u, fgeom, lterm, rterm);
+		}, res);
+
+#pragma omp parallel for default(shared) firstprivate(egeom)
 	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
-		if(p_degree > 0)
+		if(p_degree > 0 && lifted)
+		{
+			// fluxes and source values at quadrature points, times the lifted volume operators
+			const int ng = map2d[iel].getQuadrature()->numGauss();
+			egeom.evaluate(map2d[iel]);
+			const Matrix& pts = egeom.map();
+			const int ndofs = elems[iel]->getNumDOFs();
+			const Matrix *const lops = &liftvol[iel*(NDIM+1)];
+
+			Matrix uinterp(ng, nvars);
+			elems[iel]->interpolateAll(u[iel], uinterp);
+			const Matrix uq = uinterp.transpose();
+			Matrix flux(NDIM*nvars, ng);
+			physics.convFlux(ng, uq.data(), flux.data());
+
+			for(int ig = 0; ig < ng; ig++)
+			{
+				const a_real ptcoords[] = {pts(ig,0), pts(ig,1)};
+				const a_real src = source_term(ptcoords,0);
+				for(int ivar = 0; ivar < nvars; ivar++) {
+					const a_real xflux = flux(ivar,ig), yflux = flux(nvars+ivar,ig);
+					for(int idof = 0; idof < ndofs; idof++)
+						res[iel](ivar,idof) -= xflux*lops[0](ig,idof) + yflux*lops[1](ig,idof);
+				}
+				for(int idof = 0; idof < ndofs; idof++)
+					res[iel](0,idof) -= src*lops[NDIM](ig,idof);
+			}
+		}
+		else if(p_degree > 0 && quadfree && qfelems[iel])
+		{
+			// reference volume matrices, with the velocity transformed to reference space
+			const MatrixDim& jinv = map2d[iel].jacInv(0);
+			const a_real ahat[NDIM] = {jinv(0,0)*a[0] + jinv(0,1)*a[1],
+			                           jinv(1,0)*a[0] + jinv(1,1)*a[1]};
+			const int ishape = map2d[iel].getShape();
+			res[iel] -= map2d[iel].jacDet(0) * (ahat[0]*(u[iel]*qfvolmats[ishape*NDIM])
+			                                    + ahat[1]*(u[iel]*qfvolmats[ishape*NDIM+1]));
+			res[iel] -= qfsource[iel];
+		}
+		else if(p_degree > 0 && bernsteinElement(iel))
+		{
+			// sum-factorized evaluation and integration, with fluxes transformed to reference space
+			const BernsteinElement *const bel = bernsteinElement(iel);
+			const int ng = map2d[iel].getQuadrature()->numGauss();
+			const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+			egeom.evaluate(map2d[iel]);
+			const Matrix& pts = egeom.map();
+
+			Matrix uinterp(ng, nvars), gx(ng, nvars), gy(ng, nvars), src(ng, nvars);
+			bel->evaluate(u[iel], uinterp);
+			const Matrix uq = uinterp.transpose();
+			Matrix flux(NDIM*nvars, ng);
+			physics.convFlux(ng, uq.data(), flux.data());
+			for(int ig = 0; ig < ng; ig++)
+			{
+				const a_real weightjacdet = egeom.jacDet(ig) * wts(ig);
+				const MatrixDim& jinv = egeom.jacInv(ig);
+				for(int ivar = 0; ivar < nvars; ivar++) {
+					const a_real fx = flux(ivar,ig), fy = flux(nvars+ivar,ig);
+					gx(ig,ivar) = (jinv(0,0)*fx + jinv(0,1)*fy)*weightjacdet;
+					gy(ig,ivar) = (jinv(1,0)*fx + jinv(1,1)*fy)*weightjacdet;
+				}
+				const a_real ptcoords[] = {pts(ig,0), pts(ig,1)};
+				src(ig,0) = source_term(ptcoords,0) * weightjacdet;
+			}
+
+			Matrix term = Matrix::Zero(nvars, elems[iel]->getNumDOFs());
+			bel->addGradientMoments(gx, gy, term);
+			bel->addMoments(src, term);
+			res[iel] -= term;
+		}
+		else if(p_degree > 0 && !vbatched[iel])
 		{
 			const int ng = map2d[iel].getQuadrature()->numGauss();
 			const int ndofs = elems[iel]->getNumDOFs();
-			const std::vector<Matrix>& bgrads = elems[iel]->bGrad();
 			const Matrix& bas = elems[iel]->bFunc();
-			const Matrix& pts = elems[iel]->getGeometricMapping()->map();
+			egeom.evaluate(map2d[iel]);
+			const Matrix& pts = egeom.map();
 
-			Matrix xflux(ng, nvars), yflux(ng, nvars);
-			elems[iel]->interpolateAll(u[iel], xflux);
-			yflux = a[1]*xflux;
-			xflux = a[0]*xflux;
 			Matrix term = Matrix::Zero(nvars, ndofs);
+			addConvectiveVolumeTerm(physics, iel, u[iel], egeom, term);
 
 			for(int ig = 0; ig < ng; ig++)
 			{
-				const a_real weightjacdet = map2d[iel].jacDet()[ig]
+				const a_real weightjacdet = egeom.jacDet(ig)
 					* map2d[iel].getQuadrature()->weights()(ig);
 
-				// add flux
-				for(int ivar = 0; ivar < nvars; ivar++)
-					for(int idof = 0; idof < ndofs; idof++)
-						term(ivar,idof) += (xflux(ig,ivar)*bgrads[ig](idof,0)
-						                    + yflux(ig,ivar)*bgrads[ig](idof,1)) * weightjacdet;
-
-				// add source term
+				// add source term; for collocated elements, only the node at this point is tested
 				const a_real ptcoords[] = {pts(ig,0), pts(ig,1)};
-				for(int idof = 0; idof < ndofs; idof++)
-					term(0,idof) += source_term(ptcoords,0) * bas(ig,idof) * weightjacdet;
+				if(elems[iel]->isCollocated())
+					term(0,ig) += source_term(ptcoords,0) * weightjacdet;
+				else
+					for(int idof = 0; idof < ndofs; idof++)
+						term(0,idof) += source_term(ptcoords,0) * bas(ig,idof) * weightjacdet;
 			}
 
 			res[iel] -= term;
@@ -172,6 +596,10 @@ void LinearAdvection::update_residual(const std::vector<Matrix>& u, std::vector<
 
 		mets[iel] = std::sqrt(hsize)/amag;
 	}
+
+	// volume terms of affine elements with shared basis tables
+	if(p_degree > 0)
+		computeBatchedVolumeTerms(u, res);
 }
 
 // very crude
@@ -183,7 +611,7 @@ void LinearAdvection::postprocess(const std::vector<Matrix>& u)
 
 	for(int iel = 0; iel < m->gnelem(); iel++)
 	{
-		if(basis_type == 'l')
+		if(basis_type == 'l' || basis_type == 'e' || (basis_type == 's' && m->gnfael(iel) == 3))
 		{
 			//int ndofs = elems[iel]->getNumDOFs();
 			for(int ino = 0; ino < m->gnfael(iel); ino++) {
@@ -207,12 +635,52 @@ void LinearAdvection::postprocess(const std::vector<Matrix>& u)
 			}
 		}
 		
+		else if(basis_type == 's' && m->gnfael(iel) == 4)
+		{
+			// vertices of the reference square are at nodes (0,0), (n-1,0), (n-1,n-1) and (0,n-1)
+			const int n = p_degree+1;
+			const int corners[] = {0, (n-1)*n, n*n-1, n-1};
+			for(int ino = 0; ino < m->gnnode(iel); ino++) {
+				if(ino < 4)
+					output(m->ginpoel(iel,ino)) += u[iel](0,corners[ino]);
+				else if(ino < 8)
+					output(m->ginpoel(iel,ino)) += (u[iel](0,corners[ino-4])
+					                                + u[iel](0,corners[(ino-3) % 4]))/2.0;
+				else
+					output(m->ginpoel(iel,ino)) += (u[iel](0,corners[0]) + u[iel](0,corners[1])
+					                                + u[iel](0,corners[2]) + u[iel](0,corners[3]))/4.0;
+				surelems[m->ginpoel(iel,ino)] += 1;
+			}
+		}
+
+		else if(basis_type == 'b')
+		{
+			// only vertex coefficients are values; others are averaged from the vertices
+			const BernsteinElement *const bel = static_cast<const BernsteinElement*>(elems[iel]);
+			const int nv = m->gnfael(iel);
+			for(int ino = 0; ino < m->gnnode(iel); ino++) {
+				if(ino < nv)
+					output(m->ginpoel(iel,ino)) += u[iel](0,bel->vertexDOF(ino));
+				else if(ino < 2*nv)
+					output(m->ginpoel(iel,ino)) += (u[iel](0,bel->vertexDOF(ino-nv))
+					                                + u[iel](0,bel->vertexDOF((ino-nv+1) % nv)))/2.0;
+				else {
+					for(int jno = 0; jno < nv; jno++)
+						output(m->ginpoel(iel,ino)) += u[iel](0,bel->vertexDOF(jno))/nv;
+				}
+				surelems[m->ginpoel(iel,ino)] += 1;
+			}
+		}
+
 		// for Taylor, use only average values
-		else
+		else {
+			Matrix coeffs;
+			static_cast<const TaylorElement*>(elems[iel])->getTaylorCoeffs(u[iel], coeffs);
 			for(int ino = 0; ino < m->gnnode(iel); ino++) {
-				output(m->ginpoel(iel,ino)) += u[iel](0,0);
+				output(m->ginpoel(iel,ino)) += coeffs(0,0);
 				surelems[m->ginpoel(iel,ino)] += 1;
 			}
+		}
 	}
 	for(int ip = 0; ip < m->gnpoin(); ip++)
 		output(ip) /= (a_real)surelems[ip];
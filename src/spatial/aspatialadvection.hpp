@@ -8,6 +8,7 @@
 #define ASPATIALADVECTION_H
 
 #include "aspatial.hpp"
+#include "pde/linearadvection.hpp"
 
 namespace tadgens {
 
@@ -23,9 +24,59 @@ public:
 	LinearAdvection(const UMesh2dh* mesh, const int _p_degree, const char basis,
 	                const int inoutflag, const int extrapflag);
 
+	/// Selects the quadrature-free residual for affine Lagrange elements; call before spatialSetup
+	/** Since the flux is linear, the volume integral on an affine element and the upwind flux
+	 * integral on a straight interior face between referential elements can be written in terms of
+	 * constant reference matrices (Atkins and Shu, 1998). These are applied directly to the DOFs,
+	 * instead of interpolating to quadrature points. The source term contribution on such elements
+	 * is computed once during setup. Boundary faces and other elements still use quadrature.
+	 */
+	void setQuadratureFree(const bool qf) {
+		quadfree = qf;
+	}
+
+	/// Selects the lifted (strong-form update) residual; call before spatialSetup
+	/** The face and volume contributions are assembled directly into \f$ M^{-1} R \f$ using the
+	 * [lifted operators](@ref SpatialBase::computeLiftedOperators), so that solvers need not apply
+	 * the inverse mass matrix. This cannot be combined with the quadrature-free mode.
+	 */
+	void setLiftedResidual(const bool lift) {
+		lifted = lift;
+	}
+
+	bool isResidualLifted() const {
+		return lifted;
+	}
+
+	/// Selects recomputation of geometric quantities at quadrature points; call before spatialSetup
+	/** After setup, the Jacobians, their determinants and physical coordinates at quadrature points
+	 * of non-affine elements and of faces, and physical basis gradients of Lagrange elements, are
+	 * [released](@ref SpatialBase::releaseGeometricData). The residual kernels then recompute what
+	 * they need from the node coordinates of each element and face.
+	 */
+	void setRecomputeGeometry(const bool recompute) {
+		recomputegeom = recompute;
+	}
+
+	/// Calls the base class' setup, and precomputes data for the quadrature-free mode if required,
+	/// and for the [batched volume terms](@ref computeBatchedVolumeTerms)
+	void spatialSetup(std::vector<Matrix>& u, std::vector<Matrix>& res, std::vector<a_real>& mets);
+
 	/// Adds face contributions and computes domain contribution to the [right hand side](@ref residual)
 	void update_residual(const std::vector<Matrix>& u, std::vector<Matrix>& res, std::vector<a_real>& mets);
 
+	/// The Jacobian is available unless the residual is [lifted](@ref setLiftedResidual)
+	bool hasJacobian() const {
+		return !lifted;
+	}
+
+	/// Computes the residual Jacobian from the derivatives of the upwind flux
+	/** Since the fluxes are linear, the Jacobian does not depend on u. The volume and face
+	 * integrals are computed by quadrature in all modes, which gives the same result as the
+	 * quadrature-free and batched residuals.
+	 */
+	void computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac);
+
 	/// Compute quantities to export
 	void postprocess(const std::vector<Matrix>& u);
 
@@ -40,6 +91,7 @@ public:
 protected:
 	std::array<a_real,NDIM> a;              ///< Advection velocity
 	a_real amag;							///< Magnitude of advection velocity
+	const LinearAdvectionPDE physics;       ///< Flux functions
 
 	int inoutflow_flag;						///< Boundary flag at faces where inflow or outflow is required
 	int extrapolation_flag;					///< Boundary flag for extrapolation condition
@@ -49,15 +101,95 @@ protected:
 
 	const a_real aa,bb,dd,ee;               ///< Coeffs of exact solution
 
+	/// Data needed for the quadrature-free computation of the flux through an interior face
+	struct QFFace {
+		bool active;                        ///< Whether the face is treated quadrature-free
+		bool upwindleft;                    ///< Whether the left element is upwind
+		a_real coeff;                       ///< Normal velocity times speed of the face
+		const Matrix* toleft;               ///< Maps upwind DOFs to the left element's residual
+		const Matrix* toright;              ///< Maps upwind DOFs to the right element's residual
+	};
+
+	bool lifted;                            ///< Whether the residual is computed in lifted form
+	bool quadfree;                          ///< Whether the quadrature-free mode is in use
+	bool recomputegeom;                     ///< Whether geometric data is recomputed in kernels
+	std::vector<char> qfelems;              ///< Elements whose volume terms are quadrature-free
+	std::vector<QFFace> qffaces;            ///< Quadrature-free data for each face
+	std::vector<Matrix> qfsource;           ///< Source term contributions of quadrature-free elements
+
+	/// Reference matrices \f$ S_d(j,i) = \int \hat{B}_j \partial_{\xi_d} \hat{B}_i \f$
+	/** Stored for each shape and each direction d, at index shape*NDIM+d
+	 */
+	std::vector<Matrix> qfvolmats;
+
+	/// Face matrices \f$ K(j,i) = \int_f B^X_j B^Y_i \f$ between traces X and Y, indexed by
+	/// [traceIndex](@ref traceIndex)(X)*NTRACES + traceIndex(Y)
+	std::vector<Matrix> qffacemats;
+
+	/// Number of possible (shape, local face, side) combinations
+	static constexpr int NTRACES = 3*4*2;
+
+	/// Index of the trace of a shape's basis on its local face lfn from side (0 left, 1 right)
+	static int traceIndex(const Shape shape, const int lfn, const int side) {
+		return (shape*4 + lfn)*2 + side;
+	}
+
+	/// Computes (if not done already) and returns the face matrix between traces X and Y
+	const Matrix& getFaceMatrix(const Shape xshape, const int xlfn, const int xside,
+	                            const Shape yshape, const int ylfn, const int yside);
+
+	/// Precomputes reference matrices and per-element and per-face data for the quadrature-free mode
+	void setupQuadratureFree();
+
+	std::vector<char> vbatched;             ///< Elements whose volume terms are computed in batches
+	std::vector<std::vector<a_int>> vbelems;///< Elements of each block whose volume terms are batched
+	std::vector<Matrix> vbbasisT;           ///< Transposed reference basis table (ndofs x nquad) of each block
+	/// Reference gradients weighted by quadrature weights (nquad x NDIM*ndofs) of each block
+	/** Entry (ig, d*ndofs+j) holds w_ig times the derivative of basis function j in direction d.
+	 */
+	std::vector<Matrix> vbgrads;
+	/// Velocity transformed to reference space times the Jacobian determinant, for each block
+	/** Component d for the k-th batched element of the block is at index d*nb+k.
+	 */
+	std::vector<std::vector<a_real>> vbcoeffs;
+	std::vector<BatchedMatrices> vbsource;  ///< Source term contributions of batched elements, by block
+
+	/// Sorts affine elements with shared basis tables, that are not handled otherwise, into batches
+	void setupBatchedVolume();
+
+	/// Subtracts volume terms of [batched elements](@ref vbelems) from the residual
+	/** For each block, the DOFs are interpolated to quadrature points and tested against the
+	 * weighted reference gradients by [batched products](@ref batchedGemmSharedRight) with tables
+	 * common to the block. The result is then scaled by the per-element velocity coefficients.
+	 */
+	void computeBatchedVolumeTerms(const std::vector<Matrix>& u, std::vector<Matrix>& res) const;
+
 	/// Computes upwind flux
 	void computeNumericalFlux(const a_real* const uleft, const a_real* const uright, const a_real* const n,
 	                          a_real* const flux);
 
-	/// Computes face integrals from flow state described by the parameter
-	void computeFaceTerms(const std::vector<Matrix>& u);
-
-	/// Computes boundary (ghost) states depending on face marker for the face denoted by the first argument
-	void computeBoundaryState(const int iface, const Matrix& instate, Matrix& bstate);
+	/// Computes the derivatives of the [upwind flux](@ref computeNumericalFlux) w.r.t. the left and
+	/// right states
+	void computeNumericalFluxJacobian(const a_real* const uleft, const a_real* const uright,
+	                                  const a_real* const n, a_real* const dfdl, a_real* const dfdr) const;
+
+	/// Computes the contributions of a face to the residuals of its left and right elements
+	/** This is the face kernel for [face assembly](@ref SpatialBase::assembleFaceTerms).
+	 * \param[in] fgeom Workspace for the geometry of the face
+	 */
+	void computeFaceTerms(const a_int iface, const std::vector<Matrix>& u, FaceGeometry& fgeom,
+	                      Matrix& lterm, Matrix& rterm);
+
+	/// Computes the Jacobian blocks of a face; the kernel for [assembleFaceJacobians](@ref
+	/// SpatialBase::assembleFaceJacobians)
+	/** At boundary faces, the ghost state is the interior state at outflow and independent of it
+	 * at inflow, where the upwind flux does not depend on the interior state either.
+	 */
+	void computeFaceJacobian(const a_int iface, FaceGeometry& fgeom, Matrix& jll, Matrix& jlr,
+	                         Matrix& jrl, Matrix& jrr) const;
+
+	/// Computes boundary (ghost) states depending on face marker for the face whose geometry is given
+	void computeBoundaryState(const FaceGeometry& fgeom, const Matrix& instate, Matrix& bstate);
 
 	/// provide a test source term for a verification case
 	a_real source_term(const a_real pos[NDIM], const a_real time) const
@@ -1,268 +1,418 @@
 /** @file aspatialeuler.cpp
- * @brief Implementatio of spatial discretization for compressible Euler equations
+ * @brief Implementation of spatial discretization for compressible Euler equations
  * @author Aditya Kashi
  * @date 2017 May 6
  */
 
+#include <cmath>
 #include "aspatialeuler.hpp"
+#include "utilities/adual.hpp"
 
-namespace acfd {
+namespace tadgens {
 
-CompressibleEuler::CompressibleEuler(const UMesh2dh* mesh, const int _p_degree, const char basis, const Vector vel, const a_real b_val, const int inoutflag, const int extrapflag)
-	: SpatialBase(mesh, _p_degree, basis), a(vel), bval(b_val), inoutflow_flag(inoutflag), extrapolation_flag(extrapflag)
+constexpr int CompressibleEuler::nvars;
+
+CompressibleEuler::CompressibleEuler(const UMesh2dh* mesh, const int _p_degree, const char basis,
+                                     const a_real gamma, const a_real Minf, const a_real alpha,
+                                     const std::string numflux,
+                                     const int slipwallflag, const int farfieldflag)
+	: SpatialBase(mesh, _p_degree, basis), physics(gamma), rflux{nullptr},
+	  slipwall_flag(slipwallflag), farfield_flag(farfieldflag)
+{
+	const a_real aoa = alpha*PI/180.0;
+	const a_real pinf = 1.0/(gamma*Minf*Minf);
+	uinf[0] = 1.0;
+	uinf[1] = std::cos(aoa);
+	uinf[2] = std::sin(aoa);
+	uinf[3] = pinf/(gamma-1.0) + 0.5;
+
+	if(numflux == "VANLEER")
+		rflux = new VanLeerFlux(gamma);
+	else if(numflux == "ROE")
+		rflux = new RoeFlux(gamma);
+	else if(numflux == "HLLC")
+		rflux = new HLLCFlux(gamma);
+	else {
+		if(numflux != "LLF")
+			std::printf(" CompressibleEuler: ! Numerical flux %s not available; using LLF.\n",
+			            numflux.c_str());
+		rflux = new LocalLaxFriedrichsFlux(gamma);
+	}
+
+	a_int nunknown = 0;
+	for(a_int iface = 0; iface < m->gnbface(); iface++)
+		if(m->gintfacbtags(iface,0) != slipwall_flag && m->gintfacbtags(iface,0) != farfield_flag)
+			nunknown++;
+	if(nunknown > 0)
+		std::printf(" CompressibleEuler: ! %d boundary faces have unknown markers;"
+		            " the state is extrapolated there.\n", nunknown);
+
+	std::printf(" CompressibleEuler: Mach %f, angle of attack %f, flux %s\n", Minf, alpha,
+	            numflux.c_str());
+}
+
+CompressibleEuler::~CompressibleEuler()
+{
+	delete rflux;
+}
+
+void CompressibleEuler::initializeUnknowns(std::vector<Matrix>& u) const
 {
-	std::cout << " CompressibleEuler: (" << ")\n";
-	computeFEData();
-	u.resize(m->gnelem());
-	res.resize(m->gnelem());
-	mets.resize(m->gnelem());
-	for(a_int iel = 0; iel < m->gnelem(); iel++) 
+	ElementGeometry egeom;
+#pragma omp parallel for default(shared) firstprivate(egeom)
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
-		u[iel].resize(NVARS, elems[iel]->getNumDOFs());
-		res[iel].resize(NVARS, elems[iel]->getNumDOFs());
-		for(int i = 0; i < NVARS; i++)
-			for(int j = 0; j < elems[iel]->getNumDOFs(); j++) {
-				u[iel](i,j) = 0.0;
-				res[iel](i,j) = 0;
-			}
-		
-		a_real hsize = 1.0;
+		const int ng = map2d[iel].getQuadrature()->numGauss();
+		const int ndofs = elems[iel]->getNumDOFs();
+		const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+		const Matrix& bas = elems[iel]->bFunc();
+		egeom.evaluate(map2d[iel], false);
 
-		for(int ifa = 0; ifa < m->gnfael(iel); ifa++) {
-			a_int iface = m->gelemface(iel,ifa);
-			if(hsize > m->gedgelengthsquared(iface)) hsize = m->gedgelengthsquared(iface);
-		}
+		Matrix rhs = Matrix::Zero(nvars, ndofs);
+		for(int ig = 0; ig < ng; ig++)
+			for(int idof = 0; idof < ndofs; idof++) {
+				const a_real bw = bas(ig,idof) * wts(ig) * egeom.jacDet(ig);
+				for(int ivar = 0; ivar < nvars; ivar++)
+					rhs(ivar,idof) += uinf[ivar]*bw;
+			}
 
-		mets[iel] = std::sqrt(hsize)/amag;
+		applyElemMassInverse(iel, rhs, u[iel], egeom);
 	}
-
-	leftfaceterms.resize(m->gnaface());
-	rightfaceterms.resize(m->gnaface());
-	for(a_int iface = 0; iface < m->gnaface(); iface++)
-		leftfaceterms[iface].resize(NVARS, elems[m->gintfac(iface,0)]->getNumDOFs());
-	for(a_int iface = m->gnbface(); iface < m->gnaface(); iface++)
-		rightfaceterms[iface].resize(NVARS, elems[m->gintfac(iface,1)]->getNumDOFs());
 }
 
-void CompressibleEuler::computeBoundaryState(const int iface, const Matrix& __restrict__ instate, Matrix& __restrict__ bstate)
+template <typename scalar>
+void CompressibleEuler::computeBoundaryState(const a_int iface, const int npts,
+                                             const scalar *const __restrict__ ins,
+                                             const a_real *const __restrict__ n,
+                                             scalar *const __restrict__ bs) const
 {
-	if(m->gintfacbtags(iface, 0) == inoutflow_flag)
+	using std::sqrt; using std::pow;
+	const int tag = m->gintfacbtags(iface,0);
+	const a_real g = physics.gamma();
+
+	if(tag == slipwall_flag)
 	{
-		/// \todo TODO: Implement proper characteristic-based boundary conditions
-		const std::vector<Vector>& n = map1d[iface].normal();
-		for(size_t ig = 0; ig < n.size(); ig++) 
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
 		{
-			bstate.row(ig) = bval;
+			const scalar vn = (ins[npts+ip]*n[ip] + ins[2*npts+ip]*n[npts+ip])/ins[ip];
+			bs[ip] = ins[ip];
+			bs[npts+ip] = ins[npts+ip] - 2.0*vn*n[ip]*ins[ip];
+			bs[2*npts+ip] = ins[2*npts+ip] - 2.0*vn*n[npts+ip]*ins[ip];
+			bs[3*npts+ip] = ins[3*npts+ip];
 		}
 	}
-	else if(m->gintfacbtags(iface, 0) == extrapolation_flag)
-	{
-		bstate = instate;
-	}
-	else if(m->gintfacbtags(iface, 0) == slipwall_flag)
+	else if(tag == farfield_flag)
 	{
-		const std::vector<Vector>& n = map1d[iface].normal();
-		for(size_t ig = 0; ig < n.size(); ig++) 
+		const a_real vxinf = uinf[1]/uinf[0], vyinf = uinf[2]/uinf[0];
+		const a_real pinf = physics.getPressure(uinf[0], uinf[1], uinf[2], uinf[3]);
+		const a_real cinf = std::sqrt(g*pinf/uinf[0]);
+		const a_real sinf = pinf/std::pow(uinf[0],g);
+
+#pragma omp simd
+		for(int ip = 0; ip < npts; ip++)
 		{
-			a_real vn = (instate(ig,1)*n[ig](0) + instate(ig,2)*n[ig](1))/instate(ig,0);
-			bstate(ig,0) = instate(ig,0);
-			bstate(ig,1) = instate(ig,1) - 2*vn*n[ig](0)*instate(ig,0);
-			bstate(ig,2) = instate(ig,2) - 2*vn*n[ig](1)*instate(ig,0);
-			bstate(ig,3) = instate(ig,3);
+			const a_real nx = n[ip], ny = n[npts+ip];
+			const scalar rhoi = ins[ip], vxi = ins[npts+ip]/rhoi, vyi = ins[2*npts+ip]/rhoi;
+			const scalar pi = physics.getPressure(rhoi, ins[npts+ip], ins[2*npts+ip], ins[3*npts+ip]);
+			const scalar ci = sqrt(g*pi/rhoi);
+			const scalar vni = vxi*nx + vyi*ny;
+			const a_real vninf = vxinf*nx + vyinf*ny;
+
+			// Riemann invariants; both from one side if the normal flow is supersonic
+			const scalar rplus = vni >= -ci ? vni + 2.0*ci/(g-1.0) : vninf + 2.0*cinf/(g-1.0);
+			const scalar rminus = vni >= ci ? vni - 2.0*ci/(g-1.0) : vninf - 2.0*cinf/(g-1.0);
+			const scalar vnb = 0.5*(rplus + rminus);
+			const scalar cb = 0.25*(g-1.0)*(rplus - rminus);
+
+			// entropy and tangential velocity from upstream
+			const bool outflow = vnb >= 0;
+			const scalar sb = outflow ? pi/pow(rhoi,g) : sinf;
+			const scalar vtx = outflow ? vxi - vni*nx : vxinf - vninf*nx;
+			const scalar vty = outflow ? vyi - vni*ny : vyinf - vninf*ny;
+
+			const scalar rhob = pow(cb*cb/(g*sb), 1.0/(g-1.0));
+			const scalar pb = rhob*cb*cb/g;
+			const scalar vxb = vtx + vnb*nx, vyb = vty + vnb*ny;
+			bs[ip] = rhob;
+			bs[npts+ip] = rhob*vxb;
+			bs[2*npts+ip] = rhob*vyb;
+			bs[3*npts+ip] = pb/(g-1.0) + 0.5*rhob*(vxb*vxb + vyb*vyb);
 		}
 	}
-	else {
-		std::printf("!  CompressibleEuler: computeBoundaryState: Invalid boundary flag!!\n");
+	else
+	{
+		for(int k = 0; k < nvars*npts; k++)
+			bs[k] = ins[k];
 	}
 }
 
-void CompressibleEuler::computeFaceTerms(const std::vector<Matrix>& u)
+void CompressibleEuler::computeFaceTerms(const a_int iface, const std::vector<Matrix>& u,
+                                         FaceGeometry& fgeom, FaceWork& w,
+                                         Matrix& lterm, Matrix& rterm) const
 {
-	for(a_int iface = 0; iface < m->gnbface(); iface++)
-	{
-		a_int lelem = m->gintfac(iface,0);
-		int ng = map1d[iface].getQuadrature()->numGauss();
-		const std::vector<Vector>& n = map1d[iface].normal();
-		const Matrix& lbasis = faces[iface].leftBasis();
-
-		Matrix linterps(ng,NVARS), rinterps(ng,NVARS);
-		Matrix fluxes(ng,NVARS);
-		leftfaceterms[iface] = Matrix::Zero(NVARS, elems[lelem]->getNumDOFs());
-		
-		faces[iface].interpolateAll_left(u[lelem], linterps);
-		computeBoundaryState(iface, linterps, rinterps);
+	const a_int lelem = m->gintfac(iface,0);
+	const int ng = map1d[iface].getQuadrature()->numGauss();
+	const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
+	fgeom.evaluate(map1d[iface]);
+	const std::vector<Vector>& n = fgeom.normal();
+	const std::vector<a_real>& sp = fgeom.speed();
+
+	w.linterps.resize(ng, nvars);
+	faces[iface].interpolateAll_left(u[lelem], w.linterps);
+	w.ul = w.linterps.transpose();
+	w.ur.resize(nvars, ng);
+	w.normals.resize(NDIM, ng);
+	w.fluxes.resize(nvars, ng);
+	for(int ig = 0; ig < ng; ig++) {
+		w.normals(0,ig) = n[ig][0];
+		w.normals(1,ig) = n[ig][1];
+	}
+
+	const bool boundary = iface < m->gnbface();
+	if(boundary)
+		computeBoundaryState(iface, ng, w.ul.data(), w.normals.data(), w.ur.data());
+	else {
+		w.rinterps.resize(ng, nvars);
+		faces[iface].interpolateAll_right(u[m->gintfac(iface,1)], w.rinterps);
+		w.ur = w.rinterps.transpose();
+	}
 
+	rflux->get_fluxes(ng, w.ul.data(), w.ur.data(), w.normals.data(), w.fluxes.data());
+
+	for(int ig = 0; ig < ng; ig++)
+		w.fluxes.col(ig) *= wts(ig)*sp[ig];
+
+	// for collocated elements, the face values are node values and each flux only goes to that node
+	const std::vector<int> *const lnodes = faces[iface].leftNodes();
+	if(lnodes)
 		for(int ig = 0; ig < ng; ig++)
-		{
-			a_real weightandsp = map1d[iface].getQuadrature()->weights()(ig) * map1d[iface].speed()[ig];
+			lterm.col((*lnodes)[ig]) += w.fluxes.col(ig);
+	else
+		lterm.noalias() += w.fluxes*faces[iface].leftBasis();
 
-			rflux->get_flux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
+	if(boundary)
+		return;
 
-			for(int ivar = 0; ivar < NVARS; ivar++) {
-				for(int idof = 0; idof < elems[lelem]->getNumDOFs(); idof++)
-					leftfaceterms[iface](ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * weightandsp;
-			}
-		}
-	
-		// ! P0 only !
-		/*a_real length = std::pow(m->gcoords(m->gintfac(iface,2),0)-m->gcoords(m->gintfac(iface,3),0),2);
-		length += std::pow(m->gcoords(m->gintfac(iface,2),1)-m->gcoords(m->gintfac(iface,3),1),2);
-		length = std::sqrt(length);
-		leftfaceterms[iface](0,0) = fluxes(0,0)*length;*/
+	const std::vector<int> *const rnodes = faces[iface].rightNodes();
+	if(rnodes)
+		for(int ig = 0; ig < ng; ig++)
+			rterm.col((*rnodes)[ig]) -= w.fluxes.col(ig);
+	else
+		rterm.noalias() -= w.fluxes*faces[iface].rightBasis();
+}
+
+void CompressibleEuler::computeFaceJacobian(const a_int iface, const std::vector<Matrix>& u,
+                                            FaceGeometry& fgeom, FaceWork& w, Matrix& jll,
+                                            Matrix& jlr, Matrix& jrl, Matrix& jrr) const
+{
+	const a_int lelem = m->gintfac(iface,0);
+	const int ng = map1d[iface].getQuadrature()->numGauss();
+	const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
+	fgeom.evaluate(map1d[iface]);
+	const std::vector<Vector>& n = fgeom.normal();
+	const std::vector<a_real>& sp = fgeom.speed();
+
+	w.linterps.resize(ng, nvars);
+	faces[iface].interpolateAll_left(u[lelem], w.linterps);
+	w.ul = w.linterps.transpose();
+	w.ur.resize(nvars, ng);
+	w.normals.resize(NDIM, ng);
+	w.dfdl.resize(nvars*nvars, ng);
+	w.dfdr.resize(nvars*nvars, ng);
+	std::vector<a_real> wsp(ng), mwsp(ng);
+	for(int ig = 0; ig < ng; ig++) {
+		w.normals(0,ig) = n[ig][0];
+		w.normals(1,ig) = n[ig][1];
+		wsp[ig] = wts(ig)*sp[ig];
+		mwsp[ig] = -wsp[ig];
+	}
+
+	const bool boundary = iface < m->gnbface();
+	if(boundary)
+		computeBoundaryState(iface, ng, w.ul.data(), w.normals.data(), w.ur.data());
+	else {
+		w.rinterps.resize(ng, nvars);
+		faces[iface].interpolateAll_right(u[m->gintfac(iface,1)], w.rinterps);
+		w.ur = w.rinterps.transpose();
 	}
-	
-	for(a_int iface = m->gnbface(); iface < m->gnaface(); iface++)
+
+	rflux->get_jacobians(ng, w.ul.data(), w.ur.data(), w.normals.data(), w.dfdl.data(), w.dfdr.data());
+
+	Matrix lbasis;
+	getFaceBasis(iface, 0, lbasis);
+
+	if(boundary)
 	{
-		a_int lelem = m->gintfac(iface,0);
-		a_int relem = m->gintfac(iface,1);
-		int ng = map1d[iface].getQuadrature()->numGauss();
-		const std::vector<Vector>& n = map1d[iface].normal();
-		const Matrix& lbasis = faces[iface].leftBasis();
-		const Matrix& rbasis = faces[iface].rightBasis();
-
-		Matrix linterps(ng,NVARS), rinterps(ng,NVARS);
-		Matrix fluxes(ng,NVARS);
-		leftfaceterms[iface] = Matrix::Zero(NVARS, elems[lelem]->getNumDOFs());
-		rightfaceterms[iface] = Matrix::Zero(NVARS, elems[relem]->getNumDOFs());
-		
-		faces[iface].interpolateAll_left(u[lelem], linterps);
-		faces[iface].interpolateAll_right(u[relem], rinterps);
+		// chain rule through the ghost state, differentiated w.r.t. the interior state
+		std::vector<Dual<nvars>> uld(nvars*ng), urd(nvars*ng);
+		for(int j = 0; j < nvars; j++)
+			for(int ig = 0; ig < ng; ig++)
+				uld[j*ng+ig] = Dual<nvars>(w.ul(j,ig), j);
+		computeBoundaryState(iface, ng, &uld[0], w.normals.data(), &urd[0]);
 
 		for(int ig = 0; ig < ng; ig++)
-		{
-			a_real weightandsp = map1d[iface].getQuadrature()->weights()(ig) * map1d[iface].speed()[ig];
+			for(int i = 0; i < nvars; i++)
+				for(int j = 0; j < nvars; j++)
+					for(int k = 0; k < nvars; k++)
+						w.dfdl(i*nvars+j, ig) += w.dfdr(i*nvars+k, ig)*urd[k*ng+ig].d[j];
 
-			rflux->get_flux(&linterps(ig,0), &rinterps(ig,0), &n[ig](0), &fluxes(ig,0));
+		addFaceJacobianBlock(nvars, w.dfdl, &wsp[0], lbasis, lbasis, jll);
+		return;
+	}
 
-			for(int ivar = 0; ivar < NVARS; ivar++) {
-				for(int idof = 0; idof < elems[lelem]->getNumDOFs(); idof++)
-					leftfaceterms[iface](ivar,idof) += fluxes(ig,ivar) * lbasis(ig,idof) * weightandsp;
-				for(int idof = 0; idof < elems[relem]->getNumDOFs(); idof++)
-					rightfaceterms[iface](ivar,idof) += fluxes(ig,ivar) * rbasis(ig,idof) * weightandsp;
-			}
+	Matrix rbasis;
+	getFaceBasis(iface, 1, rbasis);
+	addFaceJacobianBlock(nvars, w.dfdl, &wsp[0], lbasis, lbasis, jll);
+	addFaceJacobianBlock(nvars, w.dfdr, &wsp[0], lbasis, rbasis, jlr);
+	addFaceJacobianBlock(nvars, w.dfdl, &mwsp[0], rbasis, lbasis, jrl);
+	addFaceJacobianBlock(nvars, w.dfdr, &mwsp[0], rbasis, rbasis, jrr);
+}
+
+void CompressibleEuler::computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac)
+{
+	FaceGeometry fgeom;
+	FaceWork fwork;
+	ElementGeometry egeom;
+	if(jac.numBlockRows() != m->gnelem())
+		setupJacobianMatrix(jac);
+	jac.setZero();
+
+	if(p_degree > 0) {
+#pragma omp parallel for default(shared) firstprivate(egeom)
+		for(a_int iel = 0; iel < m->gnelem(); iel++)
+		{
+			const int n = nvars*elems[iel]->getNumDOFs();
+			egeom.evaluate(map2d[iel], false);
+			Matrix vjac = Matrix::Zero(n, n);
+			addConvectiveVolumeJacobian(physics, iel, u[iel], egeom, vjac);
+			jac.diagonalBlock(iel) -= vjac;
 		}
-	
-		// ! P0 only !
-		/*a_real length = std::pow(m->gcoords(m->gintfac(iface,2),0)-m->gcoords(m->gintfac(iface,3),0),2);
-		length += std::pow(m->gcoords(m->gintfac(iface,2),1)-m->gcoords(m->gintfac(iface,3),1),2);
-		length = std::sqrt(length);
-		leftfaceterms[iface](0,0) = fluxes(0,0)*length;
-		rightfaceterms[iface](0,0) = fluxes(0,0)*length;*/
 	}
+
+	assembleFaceJacobians([this, &u, fgeom, fwork](const a_int iface, Matrix& jll, Matrix& jlr,
+	                                               Matrix& jrl, Matrix& jrr) mutable {
+			computeFaceJacobian(iface, u, fgeom, fwork, jll, jlr, jrl, jrr);
+		}, jac);
 }
 
-void CompressibleEuler::update_residual(const std::vector<Matrix>& u)
+void CompressibleEuler::update_residual(const std::vector<Matrix>& u, std::vector<Matrix>& res,
+                                        std::vector<a_real>& mets)
 {
-	computeFaceTerms(u);
+	// workspaces, copied to each thread
+	FaceGeometry fgeom;
+	FaceWork fwork;
+	ElementGeometry egeom;
+
+	assembleFaceTerms([this, &u, fgeom, fwork](const a_int iface, Matrix& lterm, Matrix& rterm) mutable {
+			computeFaceTerms(iface, u, fgeom, fwork, lterm, rterm);
+		}, res);
+
+	const a_real g = physics.gamma();
 
+#pragma omp parallel for default(shared) firstprivate(egeom)
 	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
-		if(p_degree > 0) {	
-			int ng = map2d[iel].getQuadrature()->numGauss();
-			int ndofs = elems[iel]->getNumDOFs();
-			const std::vector<Matrix>& bgrads = elems[iel]->bGrad();
+		const int ng = map2d[iel].getQuadrature()->numGauss();
+		egeom.evaluate(map2d[iel]);
 
-			Matrix xflux(ng, NVARS), yflux(ng, NVARS);
-			elems[iel]->interpolateAll(u[iel], xflux);
-			yflux = a[1]*xflux;
-			xflux *= a[0];
-			Matrix term = Matrix::Zero(NVARS, ndofs);
+		Matrix uinterp(ng, nvars);
+		const BernsteinElement *const bel = bernsteinElement(iel);
+		if(bel)
+			bel->evaluate(u[iel], uinterp);
+		else
+			elems[iel]->interpolateAll(u[iel], uinterp);
 
+		if(p_degree > 0 && bel)
+		{
+			// sum-factorized evaluation and integration, with fluxes transformed to reference space
+			const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+			const Matrix uq = uinterp.transpose();
+			Matrix flux(NDIM*nvars, ng), gx(ng, nvars), gy(ng, nvars);
+			physics.convFlux(ng, uq.data(), flux.data());
 			for(int ig = 0; ig < ng; ig++)
 			{
-				a_real weightjacdet = map2d[iel].jacDet()[ig] * map2d[iel].getQuadrature()->weights()(ig);
-				for(int ivar = 0; ivar < NVARS; ivar++)
-					for(int idof = 0; idof < ndofs; idof++)
-						term(ivar,idof) += (xflux(ig,ivar)*bgrads[ig](idof,0) + yflux(ig,ivar)*bgrads[ig](idof,1)) * weightjacdet;
+				const a_real weightjacdet = egeom.jacDet(ig) * wts(ig);
+				const MatrixDim& jinv = egeom.jacInv(ig);
+				for(int ivar = 0; ivar < nvars; ivar++) {
+					const a_real fx = flux(ivar,ig), fy = flux(nvars+ivar,ig);
+					gx(ig,ivar) = (jinv(0,0)*fx + jinv(0,1)*fy)*weightjacdet;
+					gy(ig,ivar) = (jinv(1,0)*fx + jinv(1,1)*fy)*weightjacdet;
+				}
 			}
 
+			Matrix term = Matrix::Zero(nvars, elems[iel]->getNumDOFs());
+			bel->addGradientMoments(gx, gy, term);
 			res[iel] -= term;
 		}
-
-		for(int ifa = 0; ifa < m->gnfael(iel); ifa++) {
-			a_int iface = m->gelemface(iel,ifa);
-			a_int nbdelem = m->gesuel(iel,ifa);
-			if(iel < nbdelem) {
-				res[iel] += leftfaceterms[iface];
-			}
-			else {
-				res[iel] -= rightfaceterms[iface];
-			}
+		else if(p_degree > 0)
+		{
+			Matrix term = Matrix::Zero(nvars, elems[iel]->getNumDOFs());
+			addConvectiveVolumeTerm(physics, iel, u[iel], egeom, term);
+			res[iel] -= term;
 		}
-	}
-}
-
-void CompressibleEuler::add_source( a_real (*const rhs)(a_real, a_real, a_real), a_real t)
-{
-	for(a_int iel = 0; iel < m->gnelem(); iel++)
-	{
-		int ng = map2d[iel].getQuadrature()->numGauss();
-		int ndofs = elems[iel]->getNumDOFs();
-		const Matrix& bas = elems[iel]->bFunc();
-		const Matrix& pts = elems[iel]->getGeometricMapping()->map();
-		Matrix term = Matrix::Zero(NVARS, ndofs);
 
+		// local time step from the fastest wave at the quadrature points
+		a_real maxspeed = SMALL_NUMBER;
 		for(int ig = 0; ig < ng; ig++)
 		{
-			a_real weightjacdet = map2d[iel].jacDet()[ig] * map2d[iel].getQuadrature()->weights()(ig);
-			for(int idof = 0; idof < ndofs; idof++)
-				term(0,idof) += rhs(pts(ig,0),pts(ig,1),t) * bas(ig,idof) * weightjacdet;
+			const a_real rho = uinterp(ig,0);
+			const a_real p = physics.getPressure(rho, uinterp(ig,1), uinterp(ig,2), uinterp(ig,3));
+			const a_real speed = std::sqrt(uinterp(ig,1)*uinterp(ig,1) + uinterp(ig,2)*uinterp(ig,2))/rho
+				+ std::sqrt(g*p/rho);
+			maxspeed = std::max(maxspeed, speed);
 		}
 
-		res[iel] -= term;
-	}
-}
+		a_real hsize = 1.0e30;
+		for(int ifa = 0; ifa < m->gnfael(iel); ifa++) {
+			const a_int iface = m->gelemface(iel,ifa);
+			if(hsize > m->gedgelengthsquared(iface)) hsize = m->gedgelengthsquared(iface);
+		}
 
-a_real CompressibleEuler::computeL2Error(double (*const exact)(double,double,double), const double time) const
-{
-	double l2error = 0;
-	for(int iel = 0; iel < m->gnelem(); iel++)
-	{
-		l2error += computeElemL2Error2(iel, 0, u[iel], exact, time);
+		mets[iel] = std::sqrt(hsize)/maxspeed;
 	}
-	return sqrt(l2error);
 }
 
-// very crude
-void CompressibleEuler::postprocess()
+void CompressibleEuler::postprocess(const std::vector<Matrix>& u)
 {
-	output.resize(m->gnpoin(),1);
+	output.resize(m->gnpoin(),3);
 	output.zeros();
 	std::vector<int> surelems(m->gnpoin(),0);
+	const a_real g = physics.gamma();
 
-	for(int iel = 0; iel < m->gnelem(); iel++)
+	ElementGeometry egeom;
+	for(a_int iel = 0; iel < m->gnelem(); iel++)
 	{
-		if(basis_type == 'l')
-		{
-			//int ndofs = elems[iel]->getNumDOFs();
-			for(int ino = 0; ino < m->gnfael(iel); ino++) {
-				output(m->ginpoel(iel,ino)) += u[iel](0,ino);
-				surelems[m->ginpoel(iel,ino)] += 1;
-			}
-			if(m->gnnode(iel) > m->gnfael(iel)) {
-				for(int ino = m->gnfael(iel); ino < 2*m->gnfael(iel); ino++) {
-					output(m->ginpoel(iel,ino)) += (u[iel](0,ino-m->gnfael(iel)) + u[iel](0, (ino-m->gnfael(iel)+1) % m->gnfael(iel)))/2.0;
-					surelems[m->ginpoel(iel,ino)] += 1;
-				}
-				// for interior nodes, just use average of vertices
-				for(int ino = 2*m->gnfael(iel); ino < m->gnnode(iel); ino++) {
-					for(int jno = 0; jno < m->gnfael(iel); jno++)
-						output(m->ginpoel(iel,ino)) += u[iel](0,jno);
-					output(m->ginpoel(iel,ino)) /= m->gnfael(iel);
-					surelems[m->ginpoel(iel,ino)] += 1;
-				}
-			}
+		const int ng = map2d[iel].getQuadrature()->numGauss();
+		const amat::Array2d<a_real>& wts = map2d[iel].getQuadrature()->weights();
+		egeom.evaluate(map2d[iel], false);
+		Matrix uinterp(ng, nvars);
+		elems[iel]->interpolateAll(u[iel], uinterp);
+
+		// element average
+		a_real avg[nvars] = {0,0,0,0}, area = 0;
+		for(int ig = 0; ig < ng; ig++) {
+			const a_real wj = wts(ig)*egeom.jacDet(ig);
+			for(int ivar = 0; ivar < nvars; ivar++)
+				avg[ivar] += uinterp(ig,ivar)*wj;
+			area += wj;
+		}
+		for(int ivar = 0; ivar < nvars; ivar++)
+			avg[ivar] /= area;
+
+		const a_real p = physics.getPressure(avg[0], avg[1], avg[2], avg[3]);
+		const a_real mach = std::sqrt(avg[1]*avg[1] + avg[2]*avg[2])/avg[0] / std::sqrt(g*p/avg[0]);
+		for(int ino = 0; ino < m->gnnode(iel); ino++) {
+			const a_int ip = m->ginpoel(iel,ino);
+			output(ip,0) += avg[0];
+			output(ip,1) += mach;
+			output(ip,2) += p;
+			surelems[ip] += 1;
 		}
-		
-		// for Taylor, use only average values
-		else
-			for(int ino = 0; ino < m->gnnode(iel); ino++) {
-				output(m->ginpoel(iel,ino)) += u[iel](0,0);
-				surelems[m->ginpoel(iel,ino)] += 1;
-			}
 	}
 	for(int ip = 0; ip < m->gnpoin(); ip++)
-		output(ip) /= (a_real)surelems[ip];
+		for(int j = 0; j < 3; j++)
+			output(ip,j) /= (a_real)surelems[ip];
 }
 
 }
@@ -4,58 +4,138 @@
  * @date 2017 May 6
  */
 
-#ifndef __ASPATIALEULER_H
-#define __ASPATIALEULER_H
-
-#define NVARS 4
+#ifndef ASPATIALEULER_H
+#define ASPATIALEULER_H
 
 #include "aspatial.hpp"
 #include "anumericalfluxeuler.hpp"
+#include "pde/euler.hpp"
 
-namespace acfd {
+namespace tadgens {
 
 /// Residual computation for compressible Euler equations
-/** \note Make sure to call both compute_topological and compute_boundary_maps on the mesh object before using an object of this class!
+/** \note Make sure to call both compute_topological and compute_boundary_maps on the mesh object
+ * before using an object of this class!
  *
  * If the ODE is \f$ \frac{du}{dt} + R(u) = 0 \f$, [res](@ref res) holds \f$ R \f$.
+ * The free stream has unit density and unit speed; its pressure is given by the Mach number.
+ * Face terms are computed in parallel and added to the residuals as selected by
+ * [setFaceAssemblyType](@ref SpatialBase::setFaceAssemblyType), and volume terms are computed in
+ * parallel over elements.
  */
 class CompressibleEuler : public SpatialBase
 {
-protected:
-	a_real g;								///< Adiabatic index
-	Vector instate;							///< State at inflow
-	a_real outstate;						///< State at exit
-	int inoutflow_flag;						///< Boundary flag at faces where inflow or outflow is required
-	int extrapolation_flag;					///< Boundary flag for extrapolation condition
-	int slipwall_flag;						///< Boundary flag for slip wall
-	int periodic_flag;						///< Boundary flag for periodic boundary
-	amat::Array2d<a_real> output;			///< Pointwise values for output
-	InviscidNumericalFlux* rflux;			///< Inviscid Riemann flux context
-
-	/// Computes face integrals from flow state described by the parameter
-	void computeFaceTerms(const std::vector<Matrix>& ustage);
-
-	/// Computes boundary (ghost) states depending on face marker for the face denoted by the first argument
-	void computeBoundaryState(const int iface, const Matrix& instate, Matrix& bstate);
-
 public:
-	CompressibleEuler(const UMesh2dh* mesh, const int _p_degree, const char basis, const a_real b_val, const int inoutflag, const int extrapflag);
-	
-	/// Adds face contributions and computes domain contribution to the [right hand side](@ref residual) 
-	void update_residual(const std::vector<Matrix>& ustage);
-	
-	/// Adds source term contribution to residual
-	void add_source( a_real (*const rhs)(a_real, a_real, a_real), a_real t);
+	/** \param[in] mesh The mesh context
+	 * \param[in] _p_degree Polynomial degree of the basis
+	 * \param[in] basis Type of basis
+	 * \param[in] gamma Adiabatic index
+	 * \param[in] Minf Free-stream Mach number
+	 * \param[in] alpha Angle of attack in degrees
+	 * \param[in] numflux Inviscid numerical flux - "LLF", "VANLEER", "ROE" or "HLLC"
+	 * \param[in] slipwallflag Boundary marker of slip walls
+	 * \param[in] farfieldflag Boundary marker of far-field boundaries
+	 */
+	CompressibleEuler(const UMesh2dh* mesh, const int _p_degree, const char basis,
+	                  const a_real gamma, const a_real Minf, const a_real alpha,
+	                  const std::string numflux, const int slipwallflag, const int farfieldflag);
+
+	~CompressibleEuler();
+
+	int numVars() const { return nvars; }
+
+	/// Sets the unknowns to the free stream, by L2 projection
+	void initializeUnknowns(std::vector<Matrix>& u) const;
 
-	/// Compute quantities to export
-	void postprocess();
+	/// Adds face contributions and computes domain contribution to the [right hand side](@ref residual)
+	void update_residual(const std::vector<Matrix>& u, std::vector<Matrix>& res, std::vector<a_real>& mets);
+
+	bool hasJacobian() const { return true; }
+
+	/// Computes the residual Jacobian from the [Jacobians](@ref InviscidNumericalFlux::get_jacobians)
+	/// of the numerical flux and the physical flux
+	void computeJacobian(const std::vector<Matrix>& u, BlockSparseMatrix& jac);
+
+	/// Computes density, Mach number and pressure at mesh nodes
+	/** The element averages are averaged over the elements surrounding each node.
+	 */
+	void postprocess(const std::vector<Matrix>& u);
 
 	/// Read-only access to output quantities
 	const amat::Array2d<a_real>& getOutput() const {
 		return output;
 	}
 
-	a_real computeL2Error(double (*const exact)(double,double,double), const double time) const;
+	/// There is no exact solution in general; returns zero
+	a_real exact_solution(const a_real position[NDIM], const a_real time) const {
+		return 0;
+	}
+
+	/// Free-stream state in conserved variables
+	const std::array<a_real,NDIM+2>& freeStream() const {
+		return uinf;
+	}
+
+protected:
+	static constexpr int nvars = EulerPDE::nvars;   ///< Number of conserved variables
+
+	const EulerPDE physics;                 ///< Flux functions
+	InviscidNumericalFlux* rflux;           ///< Inviscid Riemann flux context
+	std::array<a_real,NDIM+2> uinf;         ///< Free-stream state
+	int slipwall_flag;                      ///< Boundary flag for slip walls
+	int farfield_flag;                      ///< Boundary flag for far-field boundaries
+	amat::Array2d<a_real> output;           ///< Pointwise values for output
+
+	/// Workspaces for states and fluxes at the quadrature points of a face
+	/** Except for the left interpolations, these are in structure-of-arrays layout, as required
+	 * by the [numerical flux](@ref InviscidNumericalFlux::get_fluxes).
+	 */
+	struct FaceWork {
+		Matrix linterps;                    ///< Left states (nquad x nvars)
+		Matrix rinterps;                    ///< Right states (nquad x nvars)
+		Matrix ul;                          ///< Left states (nvars x nquad)
+		Matrix ur;                          ///< Right or ghost states (nvars x nquad)
+		Matrix normals;                     ///< Unit normals (NDIM x nquad)
+		Matrix fluxes;                      ///< Fluxes times quadrature weights (nvars x nquad)
+		Matrix dfdl;                        ///< Flux derivatives w.r.t. left states (nvars*nvars x nquad)
+		Matrix dfdr;                        ///< Flux derivatives w.r.t. right states (nvars*nvars x nquad)
+	};
+
+	bool hasNonlinearFlux() const { return true; }
+
+	/// Computes the contributions of a face to the residuals of its left and right elements
+	/** This is the face kernel for [face assembly](@ref SpatialBase::assembleFaceTerms).
+	 * The numerical fluxes at all quadrature points of the face are computed in one call.
+	 */
+	void computeFaceTerms(const a_int iface, const std::vector<Matrix>& u, FaceGeometry& fgeom,
+	                      FaceWork& w, Matrix& lterm, Matrix& rterm) const;
+
+	/// Computes the Jacobian blocks of a face; the kernel for [assembleFaceJacobians](@ref
+	/// SpatialBase::assembleFaceJacobians)
+	/** At boundary faces, the derivatives of the ghost state w.r.t. the interior state are
+	 * obtained by evaluating [computeBoundaryState](@ref computeBoundaryState) in dual numbers,
+	 * and combined with the flux derivatives w.r.t. the right state.
+	 */
+	void computeFaceJacobian(const a_int iface, const std::vector<Matrix>& u, FaceGeometry& fgeom,
+	                         FaceWork& w, Matrix& jll, Matrix& jlr, Matrix& jrl, Matrix& jrr) const;
+
+	/// Computes ghost states at the quadrature points of a boundary face, depending on its marker
+	/** At slip walls, the normal velocity is reflected. At far-field boundaries, the normal velocity
+	 * and speed of sound are obtained from the Riemann invariants of the outgoing and incoming
+	 * characteristics, taken from the interior and the free stream respectively (or both from one
+	 * of them if the normal flow is supersonic); the entropy and tangential velocity are taken from
+	 * the free stream at inflow and from the interior at outflow. Other faces extrapolate.
+	 * All arrays are in structure-of-arrays layout. The states may be of any scalar type, such as
+	 * [dual numbers](@ref Dual) for the derivatives of the ghost state.
+	 */
+	template <typename scalar>
+	void computeBoundaryState(const a_int iface, const int npts, const scalar *const ins,
+	                          const a_real *const n, scalar *const bs) const;
+
+	/// Not used
+	a_real source_term(const a_real position[NDIM], const a_real time) const {
+		return 0;
+	}
 };
 
 }
@@ -9,24 +9,25 @@
 namespace tadgens {
 
 LaplaceSIP::LaplaceSIP(const UMesh2dh* mesh, const int _p_degree, const a_real stab)
-	: SpatialBase(mesh, _p_degree, 'l')
+	: SpatialBase(mesh, _p_degree, 'l'), eta{stab}
 {
 	computeFEData();
 
+#pragma omp parallel for default(shared)
 	for(int iel = 0; iel < m->gnelem(); iel++)
 		map2d[iel].computePhysicalCoordsOfDomainQuadraturePoints();
 
+#pragma omp parallel for default(shared)
 	for(int iface = 0; iface < m->gnaface(); iface++)
 		faces[iface].computeBasisGrads();
 
-	int ndofs = elems[0]->getNumDOFs();
-	dirdofflags.resize(m->gnelem()*elems[0]->getNumDOFs(), 0);
+	dirdofflags.resize(ntotaldofs, 0);
 	for(int iel = 0; iel < m->gnelem(); iel++)
 	{
 		for(int ino = 0; ino < m->gnnode(iel); ino++) {
 			a_int pno = m->ginpoel(iel,ino);
 			if(m->gflag_bpoin(pno) == 1)
-				dirdofflags[iel*ndofs+ino] = 1;
+				dirdofflags[dofstart[iel]+ino] = 1;
 		}
 	}
 	ndirdofs = 0;
@@ -42,9 +43,8 @@ void LaplaceSIP::assemble()
 {
 	printf(" LaplaceSIP: solve: Assembling LHS and RHS\n");
 
-	// declare LHS in coordinate (triplet) form for assembly
-	typedef Eigen::Triplet<a_real> COO;
-	std::vector<COO> coo; 
+	// LHS in block-sparse form, one block per pair of coupled elements
+	setupJacobianMatrix(Ag);
 	const int ndofs = elems[0]->getNumDOFs();
 	bg = Vector::Zero(ntotaldofs);
 	
@@ -63,7 +63,7 @@ void LaplaceSIP::assemble()
 
 		for(int ig = 0; ig < ng; ig++)
 		{
-			const a_real weightAndJDet = wts(ig)*map2d[ielem].jacDet()[ig];
+			const a_real weightAndJDet = wts(ig)*map2d[ielem].jacDet(ig);
 			for(int i = 0; i < ndofs; i++) 
 			{
 				const a_real coords[] = {quadp(ig,0), quadp(ig,1)};
@@ -76,12 +76,8 @@ void LaplaceSIP::assemble()
 		}
 
 		for(int i = 0; i < ndofs; i++)
-		{
-			bg(ielem*ndofs+i) = bl(i);
-			for(int j = 0; j < ndofs; j++) {
-				coo.push_back(COO(ielem*ndofs+i, ielem*ndofs+j, A(i,j)));
-			}
-		}
+			bg(dofstart[ielem]+i) = bl(i);
+		Ag.diagonalBlock(ielem) += A;
 	}
 
 	// face integrals
@@ -107,7 +103,7 @@ void LaplaceSIP::assemble()
 				std::pow(m->gcoords(m->gintfac(iface,2),1) - m->gcoords(m->gintfac(iface,3),1),2) );
 
 		const int ng = map1d[iface].getQuadrature()->numGauss();
-		const amat::Array2d<a_real>& wts = bquad->weights();
+		const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
 		const std::vector<Vector>& n = map1d[iface].normal();
 		const std::vector<Matrix>& lgrad = faces[iface].leftBasisGrad();
 		const std::vector<Matrix>& rgrad = faces[iface].rightBasisGrad();
@@ -131,18 +127,18 @@ void LaplaceSIP::assemble()
 				}
 		}
 
-		// add to global stiffness matrix
+		// add to global stiffness matrix; with the normal n from left to right, the jump
+		// [v] = v_l - v_r and the average {.}, the face terms are
+		// -{grad u}.n [v] - {grad v}.n [u] + eta*nu/h [u][v]
+		Eigen::Map<Matrix> All = Ag.block(lelem,lelem), Alr = Ag.block(lelem,relem),
+			Arl = Ag.block(relem,lelem), Arr = Ag.block(relem,relem);
 		for(int i = 0; i < ndofs; i++)
 			for(int j = 0; j < ndofs; j++)
 			{
-				coo.push_back(COO( lelem*ndofs+i, lelem*ndofs+j,
-				                   -Bkk(i,j)  +Bkpk(i,j) -Bkk(j,i)  -Bkkp(j,i) +Skk(i,j)  -Skpk(i,j) ));
-				coo.push_back(COO( lelem*ndofs+i, relem*ndofs+j,
-				                   -Bkkp(i,j) +Bkpkp(i,j)+Bkpk(j,i) +Bkpkp(j,i)+Skpkp(i,j)-Skkp(i,j) ));
-				coo.push_back(COO( relem*ndofs+i, lelem*ndofs+j,
-				                   Bkpk(i,j) -Bkk(i,j)  -Bkkp(j,i) -Bkk(j,i)  +Skk(i,j)  -Skpk(i,j) ));
-				coo.push_back(COO( relem*ndofs+i, relem*ndofs+j,
-				                   Bkpkp(i,j)-Bkkp(i,j) +Bkpkp(j,i)+Bkpk(j,i) +Skpkp(i,j)-Skkp(i,j) ));
+				All(i,j) += -Bkk(i,j)  -Bkk(j,i)   +Skk(i,j);
+				Alr(i,j) += -Bkkp(i,j) +Bkpk(j,i)  -Skkp(i,j);
+				Arl(i,j) +=  Bkpk(i,j) -Bkkp(j,i)  -Skpk(i,j);
+				Arr(i,j) +=  Bkpkp(i,j)+Bkpkp(j,i) +Skpkp(i,j);
 			}
 	}
 	
@@ -158,7 +154,7 @@ void LaplaceSIP::assemble()
 				std::pow(m->gcoords(m->gintfac(iface,2),1) - m->gcoords(m->gintfac(iface,3),1),2) );
 
 		const int ng = map1d[iface].getQuadrature()->numGauss();
-		const amat::Array2d<a_real>& wts = bquad->weights();
+		const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
 		const std::vector<Vector>& n = map1d[iface].normal();
 		const std::vector<Matrix>& lgrad = faces[iface].leftBasisGrad();
 		const Matrix& lbas = faces[iface].leftBasis();
@@ -168,23 +164,20 @@ void LaplaceSIP::assemble()
 			const a_real weightandspeed = wts(ig) * map1d[iface].speed()[ig];
 			for(int i = 0; i < ndofs; i++)
 				for(int j = 0; j < ndofs; j++) {
-					Bkk(i,j) +=   nu*0.5 * lgrad[ig].row(j).dot(n[ig]) * lbas(ig,i) * weightandspeed;
+					Bkk(i,j) +=   nu * lgrad[ig].row(j).dot(n[ig]) * lbas(ig,i) * weightandspeed;
 
 					Skk(i,j) +=   eta*nu*hinv * lbas(ig,i)*lbas(ig,j) * weightandspeed;
 				}
 		}
 
-		// add to global stiffness matrix
+		// add to global stiffness matrix; for the homogeneous Dirichlet condition, the jump is the
+		// interior value and the average of the gradient is the interior gradient
+		Eigen::Map<Matrix> All = Ag.diagonalBlock(lelem);
 		for(int i = 0; i < ndofs; i++)
 			for(int j = 0; j < ndofs; j++)
-				coo.push_back(COO( lelem*ndofs+i, lelem*ndofs+j, -Bkk(i,j)-Bkk(j,i) +Skk(i,j) ));
+				All(i,j) += -Bkk(i,j)-Bkk(j,i) +Skk(i,j);
 	}
 
-	Ag.resize(ntotaldofs, ntotaldofs);
-
-	// assemble
-	Ag.setFromTriplets(coo.begin(), coo.end());
-
 	// apply Dirichlet penalties
 	/*for(int i = 0; i < ntotaldofs; i++)
 	{
@@ -225,8 +218,10 @@ void LaplaceSIP::solve()
 	// }
 	
 	printf(" LaplaceSIP: solve: Factoring LHS...\n");
+	Eigen::SparseMatrix<a_real> As;
+	Ag.toSparse(As);
 	Eigen::SparseLU<Eigen::SparseMatrix<a_real>,Eigen::COLAMDOrdering<int>> solver;
-	solver.compute(Ag);
+	solver.compute(As);
 	printf(" LaplaceSIP: solve: Solving\n");
 	ug = solver.solve(bg);
 	printf(" LaplaceSIP: solve: Done.\n");
@@ -247,13 +242,12 @@ void LaplaceSIP::postprocess(const std::vector<Matrix>& u)
 	output.resize(m->gnpoin(),1);
 	output.zeros();
 	std::vector<int> surelems(m->gnpoin(),0);
-	int ndofs = elems[0]->getNumDOFs();
 
 	for(int iel = 0; iel < m->gnelem(); iel++)
 	{
 		// iterate over vertices of element
 		for(int ino = 0; ino < m->gnfael(iel); ino++) {
-			output(m->ginpoel(iel,ino)) += ug(iel*ndofs+ino);
+			output(m->ginpoel(iel,ino)) += ug(dofstart[iel]+ino);
 			surelems[m->ginpoel(iel,ino)] += 1;
 		}
 	}
@@ -281,14 +275,14 @@ void LaplaceSIP::computeErrors(a_real& __restrict__ l2error, a_real& __restrict_
 		{
 			a_real lu = 0, lux = 0, luy = 0;
 			for(int j = 0; j < ndofs; j++) {
-				lu += ug(ielem*ndofs+j)*bfunc(ig,j);
-				lux += ug(ielem*ndofs+j)*bgrad[ig](j,0);
-				luy += ug(ielem*ndofs+j)*bgrad[ig](j,1);
+				lu += ug(dofstart[ielem]+j)*bfunc(ig,j);
+				lux += ug(dofstart[ielem]+j)*bgrad[ig](j,0);
+				luy += ug(dofstart[ielem]+j)*bgrad[ig](j,1);
 			}
 			const a_real crds[] = {qp(ig,0), qp(ig,1)};
-			l2error += std::pow(lu-exact_solution(crds,0),2) * wts(ig) * gmap->jacDet()[ig];
+			l2error += std::pow(lu-exact_solution(crds,0),2) * wts(ig) * gmap->jacDet(ig);
 			siperror += ( std::pow(lux-exactgradx(crds),2)
-			              + std::pow(luy-exactgrady(crds),2) ) * wts(ig) * gmap->jacDet()[ig];
+			              + std::pow(luy-exactgrady(crds),2) ) * wts(ig) * gmap->jacDet(ig);
 		}
 	}
 
@@ -304,7 +298,7 @@ void LaplaceSIP::computeErrors(a_real& __restrict__ l2error, a_real& __restrict_
 				std::pow(m->gcoords(m->gintfac(iface,2),1) - m->gcoords(m->gintfac(iface,3),1),2) );
 
 		int ng = map1d[iface].getQuadrature()->numGauss();
-		const amat::Array2d<a_real>& wts = bquad->weights();
+		const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
 		const Matrix& lbas = faces[iface].leftBasis();
 		const Matrix& rbas = faces[iface].rightBasis();
 
@@ -313,7 +307,7 @@ void LaplaceSIP::computeErrors(a_real& __restrict__ l2error, a_real& __restrict_
 			a_real weightandspeed = wts(ig) * map1d[iface].speed()[ig];
 			a_real lu = 0;
 			for(int j = 0; j < ndofs; j++) {
-				lu += ug(lelem*ndofs+j)*lbas(ig,j) - ug(relem*ndofs+j)*rbas(ig,j);
+				lu += ug(dofstart[lelem]+j)*lbas(ig,j) - ug(dofstart[relem]+j)*rbas(ig,j);
 			}
 			siperror += hinv * lu*lu * weightandspeed;
 		}
@@ -329,7 +323,7 @@ void LaplaceSIP::computeErrors(a_real& __restrict__ l2error, a_real& __restrict_
 				std::pow(m->gcoords(m->gintfac(iface,2),1) - m->gcoords(m->gintfac(iface,3),1),2) );
 
 		int ng = map1d[iface].getQuadrature()->numGauss();
-		const amat::Array2d<a_real>& wts = bquad->weights();
+		const amat::Array2d<a_real>& wts = map1d[iface].getQuadrature()->weights();
 		const Matrix& qp = map1d[iface].map();
 		const Matrix& lbas = faces[iface].leftBasis();
 
@@ -338,7 +332,7 @@ void LaplaceSIP::computeErrors(a_real& __restrict__ l2error, a_real& __restrict_
 			a_real weightandspeed = wts(ig) * map1d[iface].speed()[ig];
 			a_real lu = 0;
 			for(int j = 0; j < ndofs; j++) {
-				lu += ug(lelem*ndofs+j)*lbas(ig,j);
+				lu += ug(dofstart[lelem]+j)*lbas(ig,j);
 			}
 
 			const a_real coords[] = {qp(ig,0),qp(ig,1)};
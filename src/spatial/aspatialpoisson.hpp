@@ -53,7 +53,7 @@ protected:
 	a_int ndirdofs;										///< Number of Dirichlet DOFs
 	a_real cbig;										///< Penalty for Dirichlet condition
 
-	Eigen::SparseMatrix<a_real> Ag;						///< Global left hand side matrix
+	BlockSparseMatrix Ag;								///< Global left hand side matrix
 	Vector bg;											///< Global load vector
 	Vector ug;											///< 'Global' solution vector
 	amat::Array2d<a_real> output;						///< Output array for plotting
@@ -9,7 +9,7 @@
 
 #include "utilities/aarray2d.hpp"
 
-namespace acfd {
+namespace tadgens {
 
 amat::Array2d<double> tvdrk1(1,3);
 //tvdrk1[0][0] = 1.0;	tvdrk1[0][1] = 0.0; tvdrk1[0][2] = 1.0;
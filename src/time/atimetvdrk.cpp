@@ -5,8 +5,9 @@
  */
 
 #include "atimetvdrk.hpp"
+#include "aodecoeffs.hpp"
 
-namespace acfd {
+namespace tadgens {
 
 TVDRKStepping::TVDRKStepping(const UMesh2dh *const mesh, SpatialBase *const s, const int timeorder, 
 		a_real final_time, a_real cflnumber, 
@@ -14,20 +15,21 @@ TVDRKStepping::TVDRKStepping(const UMesh2dh *const mesh, SpatialBase *const s, c
 	: m(mesh), spatial(s), order{timeorder}, cfl{cflnumber}, ftime{final_time}, tch{tc}, 
 	timestep{time_step}
 {
+	spatial->spatialSetup(u, R, tsl);
+	spatial->initializeUnknowns(u);
 }
 
 double TVDRKStepping::integrate()
 {
 	int step = 0; double time = 0; double tsg = timestep;
-	std::vector<Matrix>& u = spatial->unk();
 	
 	std::vector<Matrix> ustage(m->gnelem());
 	for(int iel = 0; iel < m->gnelem(); iel++)
 		ustage[iel] = Matrix::Zero(u[iel].rows(), u[iel].cols());
 
-	std::vector<Matrix>& R = spatial->residual();
-	const std::vector<Matrix>& Mi = spatial->massInv();
-	const std::vector<a_real>& tsl = spatial->maxExplicitTimeStep();
+	std::vector<Matrix> dR(m->gnelem());
+	for(int iel = 0; iel < m->gnelem(); iel++)
+		dR[iel].resize(R[iel].rows(), R[iel].cols());
 	std::printf(" TVDRKStepping: integrate: Time step = %f, option = %c, order = %d\n", tsg, tch, order);
 	initializeOdeCoeffs();
 	amat::Array2d<a_real> tvdrk;
@@ -54,24 +56,34 @@ double TVDRKStepping::integrate()
 				R[iel] = Matrix::Zero(R[iel].rows(), R[iel].cols());
 			}
 
-			spatial->update_residual(ustage);
+			spatial->update_residual(ustage, R, tsl);
 			
 			if(istage == 0) {
 				// get global time step
 				if(tch == 'a') {
-					for(int iel = 0; iel < m->gnelem(); iel++) {
+					tsg = tsl[0];
+					for(int iel = 1; iel < m->gnelem(); iel++) {
 						if(tsl[iel] < tsg)
 							tsg = tsl[iel];
 					}
 					tsg = cfl*tsg;
 				}
+				else
+					tsg = timestep;
+
+				// do not step past the final time
+				if(time + tsg > ftime)
+					tsg = ftime - time;
 			}
 
-			// step
+			// step; a lifted residual is already multiplied by the mass inverse
+			if(!spatial->isResidualLifted())
+				spatial->applyMassInverse(R, dR);
+			const std::vector<Matrix>& update = spatial->isResidualLifted() ? R : dR;
 			for(int iel = 0; iel < m->gnelem(); iel++)
 			{
 				ustage[iel] = tvdrk[istage][0]*u[iel] + tvdrk[istage][1]*ustage[iel] 
-					- tvdrk[istage][2] * tsg*R[iel]*Mi[iel];
+					- tvdrk[istage][2] * tsg*update[iel];
 			}
 		}
 
@@ -85,53 +97,4 @@ double TVDRKStepping::integrate()
 	return time;
 }
 
-double TVDRKStepping::integrate_ForwardEuler()
-{
-	int step = 0; double time = 0; double tsg = timestep;
-	std::vector<Matrix>& u = spatial->unk();
-
-	std::vector<Matrix>& R = spatial->residual();
-	const std::vector<Matrix>& Mi = spatial->massInv();
-	const std::vector<a_real>& tsl = spatial->maxExplicitTimeStep();
-	std::printf(" TVDRKStepping: integrate: Time step = %f, option = %c, order = %d\n", tsg, tch, order);
-
-	// compare P1 area inverses
-	/*std::vector<a_real> mi(m->gnelem());
-	for(int i = 0; i < m->gnelem(); i++)
-	{
-		mi[i] = 2.0/( m->gcoords(m->ginpoel(i,0),0)*(m->gcoords(m->ginpoel(i,1),1) - m->gcoords(m->ginpoel(i,2),1)) 
-				- m->gcoords(m->ginpoel(i,0),1)*(m->gcoords(m->ginpoel(i,1),0)-m->gcoords(m->ginpoel(i,2),0)) 
-				+ m->gcoords(m->ginpoel(i,1),0)*m->gcoords(m->ginpoel(i,2),1) - m->gcoords(m->ginpoel(i,2),0)*m->gcoords(m->ginpoel(i,1),1) );
-	}*/
-
-	while(time < ftime-SMALL_NUMBER)
-	{
-		for(int iel = 0; iel < m->gnelem(); iel++) {
-			R[iel] = Matrix::Zero(R[iel].rows(), R[iel].cols());
-		}
-
-		spatial->update_residual(u);
-	
-		// get global time step
-		if(tch == 'a') {
-			for(int iel = 0; iel < m->gnelem(); iel++) {
-				if(tsl[iel] < tsg)
-					tsg = tsl[iel];
-			}
-			tsg = cfl*tsg;
-		}
-
-		// step
-		for(int iel = 0; iel < m->gnelem(); iel++)
-		{
-			u[iel](0,0) = u[iel](0,0) - tsg*R[iel](0,0)*Mi[iel](0,0);
-		}
-
-		time += tsg; step++;
-		if(step % 20 == 0)
-			std::printf("  TVDRKStepping: integrate: Step %d, time = %f\n", step, time);
-	}
-	return time;
-}
-
 }
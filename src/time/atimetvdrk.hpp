@@ -8,19 +8,19 @@
 #define ATIMETVDRK_H
 
 #include "spatial/aspatial.hpp"
-#include "aodecoeffs.hpp"
 
-namespace acfd {
+namespace tadgens {
 
 /// TVD RK explicit time stepping
-/** The initial condition must be specified in the spatial discretization context 
- * [elsewhere](@ref SpatialBase::setInitialConditionModal).
+/** The unknowns are set up by the spatial discretization and initialized to its
+ * [default state](@ref SpatialBase::initializeUnknowns); an initial condition can be set
+ * [elsewhere](@ref SpatialBase::setInitialConditionModal) through \ref unknowns before integrating.
  */
 class TVDRKStepping
 {
 protected:
 	const UMesh2dh *const m;						///< Mesh context
-	SpatialBase* spatial;							///< Spatial discretization context
+	SpatialBase *const spatial;						///< Spatial discretization context
 	int order;										///< Desird temporal order of accuracy
 	double cfl;										///< CFL number
 	double ftime;									///< Physical time up to which simulation should proceed
@@ -29,17 +29,27 @@ protected:
 	char tch;										
 	double timestep;								///< Fixed time step, if tch was 'c'
 
+	std::vector<Matrix> u;							///< DOFs of each element
+	std::vector<Matrix> R;							///< Residuals
+	std::vector<a_real> tsl;						///< Maximum allowable explicit time step of each element
+
 public:
 	TVDRKStepping(const UMesh2dh*const mesh, SpatialBase *const s, const int timeorder,
 	              a_real final_time, a_real cflnumber,
 	              const char tc, const double time_step);
 
-	void setInitialCondition();
+	/// Access to the unknowns, for setting the initial condition
+	std::vector<Matrix>& unknowns() {
+		return u;
+	}
+
+	/// Read-only access to solution
+	const std::vector<Matrix>& solution() const {
+		return u;
+	}
 
 	/// Carries out the time stepping process and returns the final time
 	double integrate();
-	
-	double integrate_ForwardEuler();
 };
 
 }
@@ -0,0 +1,192 @@
+/** @file adual.hpp
+ * @brief Dual numbers for forward-mode automatic differentiation
+ * @author Aditya Kashi
+ */
+
+#ifndef ADUAL_H
+#define ADUAL_H
+
+#include <cmath>
+#include "aconstants.hpp"
+
+namespace tadgens {
+
+/// A value together with its derivatives in N directions
+/** Code written for a generic scalar type computes, when instantiated with Dual<N>, the
+ * derivatives of its outputs along N directions in one pass, at a cost of about N+1 times that of
+ * the values. Usually the directions are the unit vectors of N inputs, set up by [seeding](@ref
+ * Dual(a_real,int)) each input with its own index.
+ *
+ * Comparisons only involve the values, so branches and selections are differentiated as the
+ * branch taken. Generic code should call the mathematical functions unqualified, after
+ * `using std::sqrt;` and so on, so that those for dual numbers are found.
+ */
+template <int N>
+struct Dual
+{
+	a_real v;                               ///< Value
+	a_real d[N];                            ///< Derivatives
+
+	Dual() = default;
+
+	/// A constant
+	Dual(const a_real value) : v(value)
+	{
+		for(int i = 0; i < N; i++)
+			d[i] = 0;
+	}
+
+	/// An independent variable: the derivative along direction idir is 1, the others are 0
+	Dual(const a_real value, const int idir) : v(value)
+	{
+		for(int i = 0; i < N; i++)
+			d[i] = i == idir ? 1.0 : 0;
+	}
+};
+
+template <int N>
+inline Dual<N> operator-(const Dual<N>& a)
+{
+	Dual<N> r; r.v = -a.v;
+	for(int i = 0; i < N; i++) r.d[i] = -a.d[i];
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator+(const Dual<N>& a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a.v + b.v;
+	for(int i = 0; i < N; i++) r.d[i] = a.d[i] + b.d[i];
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator+(const Dual<N>& a, const a_real b)
+{
+	Dual<N> r = a; r.v += b;
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator+(const a_real a, const Dual<N>& b)
+{
+	return b + a;
+}
+
+template <int N>
+inline Dual<N> operator-(const Dual<N>& a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a.v - b.v;
+	for(int i = 0; i < N; i++) r.d[i] = a.d[i] - b.d[i];
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator-(const Dual<N>& a, const a_real b)
+{
+	Dual<N> r = a; r.v -= b;
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator-(const a_real a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a - b.v;
+	for(int i = 0; i < N; i++) r.d[i] = -b.d[i];
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator*(const Dual<N>& a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a.v*b.v;
+	for(int i = 0; i < N; i++) r.d[i] = a.d[i]*b.v + a.v*b.d[i];
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator*(const Dual<N>& a, const a_real b)
+{
+	Dual<N> r; r.v = a.v*b;
+	for(int i = 0; i < N; i++) r.d[i] = a.d[i]*b;
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator*(const a_real a, const Dual<N>& b)
+{
+	return b*a;
+}
+
+template <int N>
+inline Dual<N> operator/(const Dual<N>& a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a.v/b.v;
+	const a_real ib = 1.0/b.v;
+	for(int i = 0; i < N; i++) r.d[i] = (a.d[i] - r.v*b.d[i])*ib;
+	return r;
+}
+
+template <int N>
+inline Dual<N> operator/(const Dual<N>& a, const a_real b)
+{
+	return a*(1.0/b);
+}
+
+template <int N>
+inline Dual<N> operator/(const a_real a, const Dual<N>& b)
+{
+	Dual<N> r; r.v = a/b.v;
+	const a_real fac = -r.v/b.v;
+	for(int i = 0; i < N; i++) r.d[i] = fac*b.d[i];
+	return r;
+}
+
+template <int N> inline bool operator<(const Dual<N>& a, const Dual<N>& b) { return a.v < b.v; }
+template <int N> inline bool operator<(const Dual<N>& a, const a_real b) { return a.v < b; }
+template <int N> inline bool operator<(const a_real a, const Dual<N>& b) { return a < b.v; }
+template <int N> inline bool operator>(const Dual<N>& a, const Dual<N>& b) { return a.v > b.v; }
+template <int N> inline bool operator>(const Dual<N>& a, const a_real b) { return a.v > b; }
+template <int N> inline bool operator>(const a_real a, const Dual<N>& b) { return a > b.v; }
+template <int N> inline bool operator<=(const Dual<N>& a, const Dual<N>& b) { return a.v <= b.v; }
+template <int N> inline bool operator<=(const Dual<N>& a, const a_real b) { return a.v <= b; }
+template <int N> inline bool operator<=(const a_real a, const Dual<N>& b) { return a <= b.v; }
+template <int N> inline bool operator>=(const Dual<N>& a, const Dual<N>& b) { return a.v >= b.v; }
+template <int N> inline bool operator>=(const Dual<N>& a, const a_real b) { return a.v >= b; }
+template <int N> inline bool operator>=(const a_real a, const Dual<N>& b) { return a >= b.v; }
+
+template <int N>
+inline Dual<N> sqrt(const Dual<N>& a)
+{
+	Dual<N> r; r.v = std::sqrt(a.v);
+	const a_real fac = 0.5/r.v;
+	for(int i = 0; i < N; i++) r.d[i] = fac*a.d[i];
+	return r;
+}
+
+/// Power with a constant exponent
+template <int N>
+inline Dual<N> pow(const Dual<N>& a, const a_real b)
+{
+	Dual<N> r; r.v = std::pow(a.v, b);
+	const a_real fac = b*std::pow(a.v, b-1.0);
+	for(int i = 0; i < N; i++) r.d[i] = fac*a.d[i];
+	return r;
+}
+
+/// Absolute value; the derivative at zero is taken from the positive side
+template <int N>
+inline Dual<N> fabs(const Dual<N>& a)
+{
+	return a.v >= 0 ? a : -a;
+}
+
+template <int N> inline Dual<N> fmax(const Dual<N>& a, const Dual<N>& b) { return a.v >= b.v ? a : b; }
+template <int N> inline Dual<N> fmax(const Dual<N>& a, const a_real b) { return a.v >= b ? a : Dual<N>(b); }
+template <int N> inline Dual<N> fmax(const a_real a, const Dual<N>& b) { return fmax(b, a); }
+template <int N> inline Dual<N> fmin(const Dual<N>& a, const Dual<N>& b) { return a.v <= b.v ? a : b; }
+template <int N> inline Dual<N> fmin(const Dual<N>& a, const a_real b) { return a.v <= b ? a : Dual<N>(b); }
+template <int N> inline Dual<N> fmin(const a_real a, const Dual<N>& b) { return fmin(b, a); }
+
+}
+#endif
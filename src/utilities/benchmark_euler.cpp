@@ -0,0 +1,81 @@
+/** @file benchmark_euler.cpp
+ * @brief Measures the throughput of the DG residual of the compressible Euler equations
+ *
+ * Usage: benchmark_euler <number of evaluations> <numerical flux> <basis type> <mesh file>
+ *   [more mesh files...]
+ *
+ * For each mesh and each polynomial degree from 0 to 3, the residual of a
+ * perturbed free stream is evaluated repeatedly. The wall-clock time per evaluation and the number
+ * of DOF-updates per second, counting all conserved variables, are printed.
+ * Boundary markers 2 and 4 are taken to be slip walls and far-field boundaries respectively,
+ * as in the meshes in tests/2dcylinder and tests/naca0012. Use OMP_NUM_THREADS to vary the number
+ * of threads. Lagrange and serendipity bases are only available up to degree 2, so higher degrees
+ * are skipped for them.
+ *
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include "spatial/aspatialeuler.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 5)
+	{
+		std::printf("Usage: %s <number of evaluations> <numerical flux> <basis type> <mesh file>"
+		            " [mesh files...]\n", argv[0]);
+		return -1;
+	}
+	const int nevals = std::atoi(argv[1]);
+	const std::string numflux = argv[2];
+	const char basistype = argv[3][0];
+	const int maxdegree = (basistype == 'l' || basistype == 'e') ? 2 : 3;
+
+	std::printf("%d threads\n", omp_get_max_threads());
+	std::printf("%-40s %6s %5s %10s %14s %16s\n", "Mesh", "Elems", "p", "DOFs", "ms/residual",
+	            "DOF-updates/s");
+
+	for(int imesh = 4; imesh < argc; imesh++)
+	{
+		const std::string meshfile = argv[imesh];
+		const UMesh2dh m = prepare_mesh(meshfile);
+
+		for(int degree = 0; degree <= maxdegree; degree++)
+		{
+			CompressibleEuler sd(&m, degree, basistype, 1.4, 0.5, 1.0, numflux, 2, 4);
+			std::vector<Matrix> u, res;
+			std::vector<a_real> mets;
+			sd.spatialSetup(u, res, mets);
+			sd.initializeUnknowns(u);
+
+			std::srand(1);
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				for(int i = 0; i < u[iel].rows(); i++)
+					for(int j = 0; j < u[iel].cols(); j++)
+						u[iel](i,j) *= 1.0 + 0.01*(std::rand()/(a_real)RAND_MAX - 0.5);
+
+			// one evaluation to warm up
+			sd.update_residual(u, res, mets);
+
+			double time = 0;
+			for(int ieval = 0; ieval < nevals; ieval++)
+			{
+				for(a_int iel = 0; iel < m.gnelem(); iel++)
+					res[iel].setZero();
+				const double start = omp_get_wtime();
+				sd.update_residual(u, res, mets);
+				time += omp_get_wtime() - start;
+			}
+
+			const double ndofs = (double)sd.numTotalDOFs()*sd.numVars();
+			std::printf("%-40s %6d %5d %10.0f %14.4f %16.4e\n", meshfile.c_str(), m.gnelem(), degree,
+			            ndofs, time/nevals*1000.0, ndofs*nevals/time);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/** @file benchmark_faceassembly.cpp
+ * @brief Compares the face assembly types of SpatialBase on the linear advection residual
+ *
+ * Usage: benchmark_faceassembly <mesh file> <polynomial degree> <basis type> <number of evaluations>
+ *
+ * For each assembly type, the residual of the same random state is evaluated repeatedly; the
+ * wall-clock time per evaluation and the largest difference from the gather result are printed.
+ * Use OMP_NUM_THREADS to vary the number of threads.
+ *
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include "spatial/aspatialadvection.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 5)
+	{
+		std::printf("Usage: %s <mesh file> <polynomial degree> <basis type> <number of evaluations>\n",
+		            argv[0]);
+		return -1;
+	}
+	const std::string meshfile = argv[1];
+	const int degree = std::atoi(argv[2]);
+	const char basistype = argv[3][0];
+	const int nevals = std::atoi(argv[4]);
+
+	const UMesh2dh m = prepare_mesh(meshfile);
+	std::printf("Mesh with %d elements and %d faces, %d threads\n", m.gnelem(), m.gnaface(),
+	            omp_get_max_threads());
+
+	const char types[] = {'g', 'a', 'c'};
+	const char *const names[] = {"gather", "atomic", "coloring"};
+	std::vector<Matrix> refres;
+
+	for(int itype = 0; itype < 3; itype++)
+	{
+		LinearAdvection sd(&m, degree, basistype, 1, 2);
+		sd.setFaceAssemblyType(types[itype]);
+		std::vector<Matrix> u, res;
+		std::vector<a_real> mets;
+		sd.spatialSetup(u, res, mets);
+
+		// the same state for every type
+		std::srand(1);
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+			for(int i = 0; i < u[iel].rows(); i++)
+				for(int j = 0; j < u[iel].cols(); j++)
+					u[iel](i,j) = std::rand()/(a_real)RAND_MAX;
+
+		double time = 0;
+		for(int ieval = 0; ieval < nevals; ieval++)
+		{
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				res[iel].setZero();
+			const double start = omp_get_wtime();
+			sd.update_residual(u, res, mets);
+			time += omp_get_wtime() - start;
+		}
+
+		a_real diff = 0;
+		if(itype == 0)
+			refres = res;
+		else
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				diff = std::max(diff, (res[iel]-refres[iel]).cwiseAbs().maxCoeff());
+
+		std::printf("%-9s: %10.4f ms per residual, %12.4e DOF-updates/s, max difference %.2e\n",
+		            names[itype], time/nevals*1000.0, sd.numTotalDOFs()*nevals/time, diff);
+	}
+
+	return 0;
+}
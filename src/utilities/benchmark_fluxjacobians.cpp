@@ -0,0 +1,130 @@
+/** @file benchmark_fluxjacobians.cpp
+ * @brief Compares the cost of the Jacobians of the Euler numerical fluxes with that of the fluxes
+ *
+ * Usage: benchmark_fluxjacobians <number of points> <points per call> <number of repetitions>
+ *
+ * For each numerical flux, the fluxes and their Jacobians w.r.t. both states are computed at
+ * random states near a Mach 0.5 free stream, a batch of points (such as the quadrature points of a
+ * face) per call. The batched fluxes are compared with fluxes computed one point per call, which
+ * cannot use the vectorized loop over points. The Jacobians by automatic differentiation are
+ * compared with those by forward differences in the base class, which need 9 evaluations of the
+ * flux. The time per point of each, its ratio to the time of the batched flux, and the largest
+ * difference between the two Jacobians relative to the largest entry are printed.
+ *
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "spatial/anumericalfluxeuler.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 4)
+	{
+		std::printf("Usage: %s <number of points> <points per call> <number of repetitions>\n", argv[0]);
+		return -1;
+	}
+	const int nbatch = std::atoi(argv[2]);
+	const int nreps = std::atoi(argv[3]);
+	const int ncalls = nbatch > 0 ? std::atoi(argv[1])/nbatch : 0;
+	if(ncalls <= 0 || nreps <= 0) {
+		std::printf("! Invalid arguments.\n");
+		return -1;
+	}
+	const int npoints = ncalls*nbatch;
+
+	const a_real g = 1.4, pinf = 1.0/(g*0.25);
+	std::vector<a_real> ul(4*npoints), ur(4*npoints), n(2*npoints), flux(4*npoints);
+	std::vector<a_real> dfdl(16*npoints), dfdr(16*npoints), fdl(16*npoints), fdr(16*npoints);
+	std::srand(1);
+	for(int icall = 0; icall < ncalls; icall++)
+		for(int ip = 0; ip < nbatch; ip++)
+		{
+			for(int side = 0; side < 2; side++)
+			{
+				a_real *const u = (side == 0 ? &ul[0] : &ur[0]) + 4*nbatch*icall;
+				const a_real rho = 1.0 + 0.1*(std::rand()/(a_real)RAND_MAX - 0.5);
+				const a_real vx = 1.0 + 0.1*(std::rand()/(a_real)RAND_MAX - 0.5);
+				const a_real vy = 0.1*(std::rand()/(a_real)RAND_MAX - 0.5);
+				const a_real p = pinf*(1.0 + 0.1*(std::rand()/(a_real)RAND_MAX - 0.5));
+				u[ip] = rho; u[nbatch+ip] = rho*vx; u[2*nbatch+ip] = rho*vy;
+				u[3*nbatch+ip] = p/(g-1.0) + 0.5*rho*(vx*vx+vy*vy);
+			}
+			const a_real theta = 2*PI*std::rand()/(a_real)RAND_MAX;
+			n[2*nbatch*icall+ip] = std::cos(theta);
+			n[2*nbatch*icall+nbatch+ip] = std::sin(theta);
+		}
+
+	LocalLaxFriedrichsFlux llf(g);
+	VanLeerFlux vl(g);
+	RoeFlux roe(g);
+	HLLCFlux hllc(g);
+	const InviscidNumericalFlux *const fluxes[] = {&llf, &vl, &roe, &hllc};
+	const char *const names[] = {"LLF", "Van Leer", "Roe", "HLLC"};
+
+	std::printf("%d points, %d per call\n", npoints, nbatch);
+	std::printf("%-9s %12s %12s %8s %12s %8s %12s %8s %12s\n", "Flux", "ns/flux", "ns/pt-flux",
+	            "ratio", "ns/AD-jac", "ratio", "ns/FD-jac", "ratio", "AD vs FD");
+
+	for(int iflux = 0; iflux < 4; iflux++)
+	{
+		const InviscidNumericalFlux& nf = *fluxes[iflux];
+		double tflux = 0, tpoint = 0, tad = 0, tfd = 0;
+
+		for(int irep = 0; irep < nreps; irep++)
+		{
+			double start = omp_get_wtime();
+			for(int icall = 0; icall < ncalls; icall++)
+				nf.get_fluxes(nbatch, &ul[4*nbatch*icall], &ur[4*nbatch*icall], &n[2*nbatch*icall],
+				              &flux[4*nbatch*icall]);
+			tflux += omp_get_wtime() - start;
+
+			start = omp_get_wtime();
+			for(int icall = 0; icall < ncalls; icall++)
+				for(int ip = 0; ip < nbatch; ip++)
+				{
+					const int is = 4*nbatch*icall + ip;
+					const a_real uli[] = {ul[is], ul[is+nbatch], ul[is+2*nbatch], ul[is+3*nbatch]};
+					const a_real uri[] = {ur[is], ur[is+nbatch], ur[is+2*nbatch], ur[is+3*nbatch]};
+					const a_real ni[] = {n[2*nbatch*icall+ip], n[2*nbatch*icall+nbatch+ip]};
+					a_real fi[4];
+					nf.get_flux(uli, uri, ni, fi);
+					for(int k = 0; k < 4; k++)
+						flux[is+k*nbatch] = fi[k];
+				}
+			tpoint += omp_get_wtime() - start;
+
+			start = omp_get_wtime();
+			for(int icall = 0; icall < ncalls; icall++)
+				nf.get_jacobians(nbatch, &ul[4*nbatch*icall], &ur[4*nbatch*icall], &n[2*nbatch*icall],
+				                 &dfdl[16*nbatch*icall], &dfdr[16*nbatch*icall]);
+			tad += omp_get_wtime() - start;
+
+			start = omp_get_wtime();
+			for(int icall = 0; icall < ncalls; icall++)
+				nf.InviscidNumericalFlux::get_jacobians(nbatch, &ul[4*nbatch*icall], &ur[4*nbatch*icall],
+				                                        &n[2*nbatch*icall], &fdl[16*nbatch*icall],
+				                                        &fdr[16*nbatch*icall]);
+			tfd += omp_get_wtime() - start;
+		}
+
+		a_real diff = 0, scale = 0;
+		for(size_t i = 0; i < dfdl.size(); i++) {
+			diff = std::fmax(diff, std::fmax(std::fabs(dfdl[i]-fdl[i]), std::fabs(dfdr[i]-fdr[i])));
+			scale = std::fmax(scale, std::fmax(std::fabs(dfdl[i]), std::fabs(dfdr[i])));
+		}
+
+		const double nevals = (double)ncalls*nbatch*nreps;
+		std::printf("%-9s %12.2f %12.2f %8.2f %12.2f %8.2f %12.2f %8.2f %12.2e\n", names[iflux],
+		            tflux/nevals*1e9, tpoint/nevals*1e9, tpoint/tflux, tad/nevals*1e9, tad/tflux,
+		            tfd/nevals*1e9, tfd/tflux, diff/scale);
+	}
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+/** @file benchmark_preconditioners.cpp
+ * @brief Compares block preconditioners for the implicit pseudo-time systems of the Euler equations
+ *
+ * Usage: benchmark_preconditioners <CFL number> <numerical flux> <basis type> <mesh file>
+ *   [more mesh files...]
+ *
+ * For each mesh and each polynomial degree, the system (M/dt + dR/du) du = -R of one implicit
+ * pseudo-time step from a perturbed free stream is set up, as in SteadyImplicit. It is solved by
+ * GMRES(100) to a relative tolerance of 1e-6 with block Jacobi, sequential block SSOR and multicolor
+ * block SSOR (both with relaxation factor 1) as preconditioners. For each, the number of colors,
+ * the time to factor the diagonal blocks, the time per application, the GMRES iterations and
+ * time, and the relative residual after 10 sweeps of the preconditioner used as a relaxation
+ * scheme are printed. Boundary markers 2 and 4 are taken to be slip walls and far-field boundaries
+ * respectively, as in the meshes in tests/2dcylinder. Use OMP_NUM_THREADS to vary the number of
+ * threads.
+ *
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include "spatial/aspatialeuler.hpp"
+#include "solvers/alinalg.hpp"
+#include "solvers/akrylov.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 5)
+	{
+		std::printf("Usage: %s <CFL number> <numerical flux> <basis type> <mesh file>"
+		            " [mesh files...]\n", argv[0]);
+		return -1;
+	}
+	const a_real cfl = std::atof(argv[1]);
+	const std::string numflux = argv[2];
+	const char basistype = argv[3][0];
+	const int maxdegree = (basistype == 'l' || basistype == 'e') ? 2 : 3;
+	const int nsweeps = 10, restart = 100, maxiter = 1000;
+	const a_real lintol = 1e-6;
+
+	std::printf("%d threads, CFL %g\n", omp_get_max_threads(), cfl);
+	std::printf("%-40s %3s %8s %-12s %6s %10s %10s %6s %10s %12s\n", "Mesh", "p", "Rows", "Prec",
+	            "Colors", "Setup ms", "Apply ms", "Its", "GMRES ms", "Relax res");
+
+	for(int imesh = 4; imesh < argc; imesh++)
+	{
+		const std::string meshfile = argv[imesh];
+		const UMesh2dh m = prepare_mesh(meshfile);
+
+		for(int degree = 0; degree <= maxdegree; degree++)
+		{
+			CompressibleEuler sd(&m, degree, basistype, 1.4, 0.5, 1.0, numflux, 2, 4);
+			std::vector<Matrix> u, res;
+			std::vector<a_real> tsl;
+			sd.spatialSetup(u, res, tsl);
+			sd.initializeUnknowns(u);
+
+			std::srand(1);
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				for(int i = 0; i < u[iel].rows(); i++)
+					for(int j = 0; j < u[iel].cols(); j++)
+						u[iel](i,j) *= 1.0 + 0.01*(std::rand()/(a_real)RAND_MAX - 0.5);
+
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				res[iel].setZero();
+			sd.update_residual(u, res, tsl);
+
+			BlockSparseMatrix jac;
+			sd.computeJacobian(u, jac);
+			const int nvars = sd.numVars();
+			Vector b(jac.numRows());
+			ElementGeometry egeom;
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+			{
+				Matrix mass;
+				sd.computeElemMassMatrix(iel, mass, egeom);
+				const int ndofs = static_cast<int>(mass.rows());
+				Eigen::Map<Matrix> diag = jac.diagonalBlock(iel);
+				for(int ivar = 0; ivar < nvars; ivar++)
+					diag.block(ivar*ndofs, ivar*ndofs, ndofs, ndofs) += mass/(cfl*tsl[iel]);
+				b.segment(jac.rowStart(iel), res[iel].size())
+					= -Eigen::Map<const Vector>(res[iel].data(), res[iel].size());
+			}
+
+			BlockJacobi bj(&jac);
+			BlockSSOR ssor(&m, &jac, 1.0, false);
+			BlockSSOR mcssor(&m, &jac, 1.0, true);
+			BlockIterativeSolver *const precs[] = {&bj, &ssor, &mcssor};
+			const char *const names[] = {"BJ", "SSOR", "SSOR-color"};
+			const int colors[] = {0, 0, mcssor.numColors()};
+
+			for(int iprec = 0; iprec < 3; iprec++)
+			{
+				BlockIterativeSolver& prec = *precs[iprec];
+
+				double start = omp_get_wtime();
+				prec.compute();
+				const double tsetup = omp_get_wtime() - start;
+
+				Vector z(b.size());
+				const int napply = 10;
+				start = omp_get_wtime();
+				for(int iapp = 0; iapp < napply; iapp++)
+					prec.apply(b, z);
+				const double tapply = (omp_get_wtime() - start)/napply;
+
+				Vector du = Vector::Zero(b.size());
+				a_real relres;
+				start = omp_get_wtime();
+				const int its = gmres([&jac](const Vector& x, Vector& y) { jac.apply(x, y); },
+				                      [&prec](const Vector& r, Vector& y) { prec.apply(r, y); },
+				                      b, du, restart, maxiter, lintol, relres);
+				const double tgmres = omp_get_wtime() - start;
+
+				du.setZero();
+				prec.relax(b, du, nsweeps);
+				Vector r(b.size());
+				jac.apply(du, r);
+				const a_real relaxres = (b-r).norm()/b.norm();
+
+				std::printf("%-40s %3d %8d %-12s %6d %10.3f %10.4f %6d %10.2f %12.3e\n",
+				            meshfile.c_str(), degree, jac.numRows(), names[iprec], colors[iprec],
+				            tsetup*1e3, tapply*1e3, its, tgmres*1e3, relaxres);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/** @file benchmark_spmv.cpp
+ * @brief Compares products with the DG Jacobian in block-sparse and scalar sparse formats
+ *
+ * Usage: benchmark_spmv <number of products> <numerical flux> <basis type> <mesh file>
+ *   [more mesh files...]
+ *
+ * For each mesh and each polynomial degree, the Jacobian of the Euler residual at a perturbed
+ * free stream is computed in [block-sparse](@ref BlockSparseMatrix) form and copied into a
+ * row-major scalar sparse (CSR) matrix. Products with a random vector are then timed for both;
+ * the CSR product is a threaded loop over rows, with one column index per entry. The memory used
+ * for indices, the time per product and the effective bandwidth are printed, counting for the
+ * latter each value, index and vector entry read or written once. Boundary markers 2 and 4 are
+ * taken to be slip walls and far-field boundaries respectively. Use OMP_NUM_THREADS to vary the
+ * number of threads.
+ *
+ * @author Aditya Kashi
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include "spatial/aspatialeuler.hpp"
+
+using namespace tadgens;
+
+typedef Eigen::SparseMatrix<a_real,Eigen::RowMajor> CSRMatrix;
+
+/// y = A x by rows, in parallel
+static void csr_apply(const CSRMatrix& a, const Vector& x, Vector& y)
+{
+	const a_int *const rowptr = a.outerIndexPtr();
+	const a_int *const colind = a.innerIndexPtr();
+	const a_real *const vals = a.valuePtr();
+#pragma omp parallel for default(shared)
+	for(a_int i = 0; i < a.rows(); i++)
+	{
+		a_real sum = 0;
+		for(a_int k = rowptr[i]; k < rowptr[i+1]; k++)
+			sum += vals[k]*x[colind[k]];
+		y[i] = sum;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 5)
+	{
+		std::printf("Usage: %s <number of products> <numerical flux> <basis type> <mesh file>"
+		            " [mesh files...]\n", argv[0]);
+		return -1;
+	}
+	const int nprods = std::atoi(argv[1]);
+	const std::string numflux = argv[2];
+	const char basistype = argv[3][0];
+	const int maxdegree = (basistype == 'l' || basistype == 'e') ? 2 : 3;
+
+	std::printf("%d threads\n", omp_get_max_threads());
+	std::printf("%-40s %5s %10s %12s %10s %10s %10s %10s %10s %10s\n", "Mesh", "p", "Rows", "Nonzeros",
+	            "BSR idx MB", "CSR idx MB", "BSR ms", "CSR ms", "BSR GB/s", "CSR GB/s");
+
+	for(int imesh = 4; imesh < argc; imesh++)
+	{
+		const std::string meshfile = argv[imesh];
+		const UMesh2dh m = prepare_mesh(meshfile);
+
+		for(int degree = 0; degree <= maxdegree; degree++)
+		{
+			CompressibleEuler sd(&m, degree, basistype, 1.4, 0.5, 1.0, numflux, 2, 4);
+			std::vector<Matrix> u, res;
+			std::vector<a_real> mets;
+			sd.spatialSetup(u, res, mets);
+			sd.initializeUnknowns(u);
+
+			std::srand(1);
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				for(int i = 0; i < u[iel].rows(); i++)
+					for(int j = 0; j < u[iel].cols(); j++)
+						u[iel](i,j) *= 1.0 + 0.01*(std::rand()/(a_real)RAND_MAX - 0.5);
+
+			BlockSparseMatrix jac;
+			sd.computeJacobian(u, jac);
+			Eigen::SparseMatrix<a_real> colmajor;
+			jac.toSparse(colmajor);
+			const CSRMatrix csr = colmajor;
+			colmajor.resize(0,0);
+
+			const a_int n = jac.numRows();
+			Vector x(n), ybsr(n), ycsr(n);
+			for(a_int i = 0; i < n; i++)
+				x[i] = std::rand()/(a_real)RAND_MAX - 0.5;
+
+			// one product each to warm up
+			jac.apply(x, ybsr);
+			csr_apply(csr, x, ycsr);
+			if((ybsr-ycsr).cwiseAbs().maxCoeff() > 1e-10*ycsr.cwiseAbs().maxCoeff())
+				std::printf(" ! The products in the two formats differ!\n");
+
+			double start = omp_get_wtime();
+			for(int iprod = 0; iprod < nprods; iprod++)
+				jac.apply(x, ybsr);
+			const double tbsr = (omp_get_wtime() - start)/nprods;
+
+			start = omp_get_wtime();
+			for(int iprod = 0; iprod < nprods; iprod++)
+				csr_apply(csr, x, ycsr);
+			const double tcsr = (omp_get_wtime() - start)/nprods;
+
+			const double nnz = (double)csr.nonZeros();
+			const double bsridx = (double)jac.indexMemory();
+			const double csridx = (nnz + n + 1)*sizeof(a_int);
+			const double vecbytes = 2.0*n*sizeof(a_real);
+			const double valbytes = nnz*sizeof(a_real);
+			std::printf("%-40s %5d %10d %12.0f %10.3f %10.3f %10.4f %10.4f %10.2f %10.2f\n",
+			            meshfile.c_str(), degree, n, nnz, bsridx/1e6, csridx/1e6, tbsr*1e3, tcsr*1e3,
+			            (valbytes+bsridx+vecbytes)/tbsr/1e9, (valbytes+csridx+vecbytes)/tcsr/1e9);
+		}
+	}
+
+	return 0;
+}
@@ -44,6 +44,37 @@ int main(int argc, char* argv[])
 	control >> dum; control >> maxits;
 	control >> dum; control >> inoutflag;
 	control >> dum; control >> extrapflag;
+
+	// optional entries, identified by their keys
+	char massinvtype = 's', faceassemblytype = 'a', timescheme = 'e', prectype = 'j';
+	int quadfree = 0, lifted = 0, orthonormal = 0, recomputegeom = 0, linmaxits = 100;
+	double cflmax = 1e6, lintol = 1e-3;
+	while(control >> dum) {
+		if(dum == "-Mass-inverse-type")
+			control >> massinvtype;
+		else if(dum == "-Quadrature-free")
+			control >> quadfree;
+		else if(dum == "-Lifted-residual")
+			control >> lifted;
+		else if(dum == "-Orthonormal-basis")
+			control >> orthonormal;
+		else if(dum == "-Recompute-geometry")
+			control >> recomputegeom;
+		else if(dum == "-Face-assembly-type")
+			control >> faceassemblytype;
+		else if(dum == "-Time-scheme")
+			control >> timescheme;
+		else if(dum == "-CFL-max")
+			control >> cflmax;
+		else if(dum == "-Linear-solver-tolerance")
+			control >> lintol;
+		else if(dum == "-Linear-solver-max-iterations")
+			control >> linmaxits;
+		else if(dum == "-Preconditioner")
+			control >> prectype;
+		else
+			printf("! Unknown control file entry %s\n", dum.c_str());
+	}
 	control.close();
 
 	vector<string> mfiles(nmesh), sfiles(nmesh), exfiles(nmesh);
@@ -68,14 +99,33 @@ int main(int argc, char* argv[])
 		printf("Mesh %d: h = %f\n", imesh, hhactual);
 
 		LinearAdvection sd(&m, sdegree, basistype, inoutflag, extrapflag);
+		sd.setMassInverseType(massinvtype);
+		sd.setQuadratureFree(quadfree == 1);
+		sd.setLiftedResidual(lifted == 1);
+		sd.setOrthonormalBasis(orthonormal == 1);
+		sd.setRecomputeGeometry(recomputegeom == 1);
+		sd.setFaceAssemblyType(faceassemblytype);
 		//const double hh = 1.0/sqrt(sd.numTotalDOFs());
 		
-		SteadyExplicit td(&m, &sd, cfl, tol, maxits);
+		// explicit ('e'), implicit ('i') or Jacobian-free implicit ('j') pseudo-time stepping;
+		//  without an analytic Jacobian, implicit stepping is Jacobian-free
+		if(timescheme == 'i' && !sd.hasJacobian()) {
+			printf("! The residual Jacobian is not available; using the Jacobian-free solver.\n");
+			timescheme = 'j';
+		}
+		SteadyBase *td;
+		if(timescheme == 'i')
+			td = new SteadyImplicit(&m, &sd, cfl, cflmax, tol, maxits, lintol, linmaxits, prectype);
+		else if(timescheme == 'j')
+			td = new SteadyJFNK(&m, &sd, cfl, cflmax, tol, maxits, lintol, linmaxits);
+		else
+			td = new SteadyExplicit(&m, &sd, cfl, tol, maxits);
 		
-		td.solve();
+		td->solve();
 
-		sd.postprocess(td.solution());
-		l2err[imesh] = sd.computeL2Error(0, td.solution());
+		sd.postprocess(td->solution());
+		l2err[imesh] = sd.computeL2Error(0, td->solution());
+		delete td;
 		
 		l2err[imesh] = log10(l2err[imesh]);
 		h[imesh] = log10(hhactual);
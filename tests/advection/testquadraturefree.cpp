@@ -0,0 +1,73 @@
+/** @file testquadraturefree.cpp
+ * @brief Checks the quadrature-free linear advection residual against the quadrature-based one
+ *
+ * Usage: testquadraturefree <mesh file> <inflow-outflow marker> <extrapolation marker>
+ *
+ * On a mesh of straight-sided elements, the flux is linear and the quadrature rules integrate the
+ * volume and face terms exactly, so the quadrature-free residual must equal the quadrature-based
+ * residual to round-off. This is checked for degrees 1 to 3 at random states.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "spatial/aspatialadvection.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 4) {
+		std::printf("Usage: %s <mesh file> <inflow-outflow marker> <extrapolation marker>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+	const int inoutflag = std::atoi(argv[2]), extrapflag = std::atoi(argv[3]);
+	const a_real tol = 1e-12;
+	int nfail = 0;
+
+	for(int degree = 1; degree <= 3; degree++)
+	{
+		std::vector<Matrix> res[2];
+		for(int iqf = 0; iqf < 2; iqf++)
+		{
+			LinearAdvection sd(&m, degree, 'l', inoutflag, extrapflag);
+			sd.setQuadratureFree(iqf == 1);
+			std::vector<Matrix> u;
+			std::vector<a_real> tsl;
+			sd.spatialSetup(u, res[iqf], tsl);
+
+			std::srand(1);
+			for(a_int iel = 0; iel < m.gnelem(); iel++) {
+				for(int j = 0; j < u[iel].cols(); j++)
+					u[iel](0,j) = std::rand()/(a_real)RAND_MAX - 0.5;
+				res[iqf][iel].setZero();
+			}
+			sd.update_residual(u, res[iqf], tsl);
+		}
+
+		// not-a-number entries must fail the test, so they are counted rather than maximized over
+		a_real diff = 0, scale = 0;
+		a_int nnotfinite = 0;
+		for(a_int iel = 0; iel < m.gnelem(); iel++) {
+			if(!res[0][iel].allFinite() || !res[1][iel].allFinite()) {
+				nnotfinite++;
+				continue;
+			}
+			diff = std::max(diff, (res[1][iel] - res[0][iel]).cwiseAbs().maxCoeff());
+			scale = std::max(scale, res[0][iel].cwiseAbs().maxCoeff());
+		}
+
+		std::printf("P%d: relative difference between quadrature-free and quadrature residuals %.2e,"
+		            " %d elements with non-finite residuals\n", degree, diff/scale, nnotfinite);
+		if(nnotfinite > 0 || !(diff/scale < tol)) {
+			std::printf("! P%d quadrature-free residual failed!\n", degree);
+			nfail++;
+		}
+	}
+
+	return nfail;
+}
@@ -0,0 +1,95 @@
+/** @file testeulerjacobian.cpp
+ * @brief Checks the residual Jacobian of the compressible Euler equations
+ *
+ * Usage: testeulerjacobian <mesh file with slip walls marked 2 and far-field boundaries marked 4>
+ *
+ * For several numerical fluxes, bases and degrees, the product of the element-block Jacobian with
+ * a random vector at a perturbed free stream is compared with a central difference of the residual.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "spatial/aspatialeuler.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		std::printf("Usage: %s <mesh file>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+
+	const char *const fluxes[] = {"LLF", "ROE", "HLLC", "VANLEER"};
+	const char bases[] = {'l', 'l', 'b', 'l'};
+	const int degrees[] = {0, 1, 2, 1};
+	const a_real tol = 1e-6, eps = 1e-6;
+	int nfail = 0;
+
+	for(int icase = 0; icase < 4; icase++)
+	{
+		CompressibleEuler sd(&m, degrees[icase], bases[icase], 1.4, 0.5, 2.0, fluxes[icase], 2, 4);
+		std::vector<Matrix> u, res;
+		BlockSparseMatrix jac;
+		std::vector<a_real> mets;
+		sd.spatialSetup(u, res, mets);
+		sd.initializeUnknowns(u);
+
+		std::srand(1);
+		std::vector<Matrix> v(m.gnelem());
+		for(a_int iel = 0; iel < m.gnelem(); iel++) {
+			v[iel].resize(u[iel].rows(), u[iel].cols());
+			for(int i = 0; i < u[iel].rows(); i++)
+				for(int j = 0; j < u[iel].cols(); j++) {
+					u[iel](i,j) *= 1.0 + 0.05*(std::rand()/(a_real)RAND_MAX - 0.5);
+					v[iel](i,j) = std::rand()/(a_real)RAND_MAX - 0.5;
+				}
+		}
+
+		sd.computeJacobian(u, jac);
+		Vector vg(jac.numRows()), jvg(jac.numRows());
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+			vg.segment(jac.rowStart(iel), v[iel].size()) = Eigen::Map<const Vector>(v[iel].data(), v[iel].size());
+		jac.apply(vg, jvg);
+
+		// central difference of the residual along v
+		std::vector<Matrix> up(m.gnelem()), um(m.gnelem()), resm(m.gnelem());
+		for(a_int iel = 0; iel < m.gnelem(); iel++) {
+			up[iel] = u[iel] + eps*v[iel];
+			um[iel] = u[iel] - eps*v[iel];
+			res[iel].setZero();
+			resm[iel] = Matrix::Zero(u[iel].rows(), u[iel].cols());
+		}
+		sd.update_residual(up, res, mets);
+		sd.update_residual(um, resm, mets);
+
+		a_real diff = 0, scale = 0;
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+		{
+			const int n = static_cast<int>(u[iel].size());
+			const Vector jv = jvg.segment(jac.rowStart(iel), n);
+
+			const Matrix fd = (res[iel]-resm[iel])/(2*eps);
+			const Eigen::Map<const Vector> fdv(fd.data(), n);
+			if(!jv.allFinite()) {
+				diff = NAN;
+				break;
+			}
+			diff = std::fmax(diff, (jv-fdv).cwiseAbs().maxCoeff());
+			scale = std::fmax(scale, fdv.cwiseAbs().maxCoeff());
+		}
+
+		std::printf("Flux %s, basis %c, degree %d: relative difference %.2e\n", fluxes[icase],
+		            bases[icase], degrees[icase], diff/scale);
+		if(!(diff <= tol*scale)) {
+			std::printf("! Failed!\n");
+			nfail++;
+		}
+	}
+
+	return nfail;
+}
@@ -0,0 +1,98 @@
+/** @file testeulerresidual.cpp
+ * @brief Checks the DG residual of the compressible Euler equations
+ *
+ * Usage: testeulerresidual <mesh file with slip walls marked 2 and far-field boundaries marked 4>
+ *
+ * For several bases and degrees, checks that
+ *  - the free stream is preserved: the residual vanishes in elements not touching a wall,
+ *    including those at the characteristic far-field boundary,
+ *  - all face assembly types give the same residual for a perturbed state.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "spatial/aspatialeuler.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		std::printf("Usage: %s <mesh file>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+
+	std::vector<char> wallelem(m.gnelem(), 0);
+	for(a_int iface = 0; iface < m.gnbface(); iface++)
+		if(m.gintfacbtags(iface,0) == 2)
+			wallelem[m.gintfac(iface,0)] = 1;
+
+	const char bases[] = {'l', 'l', 'l', 'b'};
+	const int degrees[] = {0, 1, 2, 3};
+	const char fatypes[] = {'a', 'g', 'c'};
+	const a_real tol = 1e-11;
+	int nfail = 0;
+
+	for(int icase = 0; icase < 4; icase++)
+	{
+		std::vector<Matrix> refres;
+		a_real dfree = 0, dassembly = 0;
+
+		for(int ifa = 0; ifa < 3; ifa++)
+		{
+			CompressibleEuler sd(&m, degrees[icase], bases[icase], 1.4, 0.5, 2.0, "ROE", 2, 4);
+			sd.setFaceAssemblyType(fatypes[ifa]);
+			std::vector<Matrix> u, res;
+			std::vector<a_real> mets;
+			sd.spatialSetup(u, res, mets);
+			sd.initializeUnknowns(u);
+
+			if(ifa == 0) {
+				for(a_int iel = 0; iel < m.gnelem(); iel++)
+					res[iel].setZero();
+				sd.update_residual(u, res, mets);
+				for(a_int iel = 0; iel < m.gnelem(); iel++) {
+					if(!res[iel].allFinite()) {
+						dfree = NAN;
+						break;
+					}
+					if(!wallelem[iel])
+						dfree = std::fmax(dfree, res[iel].cwiseAbs().maxCoeff());
+				}
+			}
+
+			std::srand(1);
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				for(int i = 0; i < u[iel].rows(); i++)
+					for(int j = 0; j < u[iel].cols(); j++)
+						u[iel](i,j) *= 1.0 + 0.05*(std::rand()/(a_real)RAND_MAX - 0.5);
+
+			for(a_int iel = 0; iel < m.gnelem(); iel++)
+				res[iel].setZero();
+			sd.update_residual(u, res, mets);
+			if(ifa == 0)
+				refres = res;
+			else
+				for(a_int iel = 0; iel < m.gnelem(); iel++) {
+					if(!res[iel].allFinite()) {
+						dassembly = NAN;
+						break;
+					}
+					dassembly = std::fmax(dassembly, (res[iel]-refres[iel]).cwiseAbs().maxCoeff());
+				}
+		}
+
+		std::printf("Basis %c, degree %d: free stream %.2e, assembly types %.2e\n", bases[icase],
+		            degrees[icase], dfree, dassembly);
+		if(!(dfree <= tol) || !(dassembly <= tol)) {
+			std::printf("! Failed!\n");
+			nfail++;
+		}
+	}
+
+	return nfail;
+}
@@ -0,0 +1,365 @@
+/** @file testnumericalfluxes.cpp
+ * @brief Checks the numerical fluxes for the Euler equations
+ *
+ * For random states and normals, checks that each flux
+ *  - computed for a batch of points agrees with a plain point-by-point reference implementation,
+ *    which selects the wave pattern by branches, for subsonic and supersonic states,
+ *  - is consistent with the physical normal flux when both states are equal,
+ *  - is conservative: the flux from the right state to the left along -n is the negative,
+ * and that upwind fluxes equal the left physical flux for supersonic flow from the left.
+ * The flux Jacobians, obtained by automatic differentiation, are compared with central differences.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "pde/euler.hpp"
+#include "spatial/anumericalfluxeuler.hpp"
+
+using namespace tadgens;
+
+static const a_real adiabaticindex = 1.4;
+
+/// Random state with given velocity ranges
+static void randomState(const a_real vmin, const a_real vmax, a_real *const u, const int npts,
+                        const int ip)
+{
+	const a_real rho = 0.5 + std::rand()/(a_real)RAND_MAX;
+	const a_real vx = vmin + (vmax-vmin)*std::rand()/(a_real)RAND_MAX;
+	const a_real vy = -0.5 + std::rand()/(a_real)RAND_MAX;
+	const a_real p = 0.5 + std::rand()/(a_real)RAND_MAX;
+	u[ip] = rho; u[npts+ip] = rho*vx; u[2*npts+ip] = rho*vy;
+	u[3*npts+ip] = p/(adiabaticindex-1.0) + 0.5*rho*(vx*vx+vy*vy);
+}
+
+static a_real maxdiff(const std::vector<a_real>& a, const std::vector<a_real>& b)
+{
+	a_real d = 0;
+	for(size_t i = 0; i < a.size(); i++)
+		d = std::fmax(d, std::fabs(a[i]-b[i])/(1.0+std::fabs(a[i])));
+	return d;
+}
+
+/// Jacobians of a numerical flux w.r.t. the left and right states by central differences
+static void centralDifferenceJacobians(const InviscidNumericalFlux& nf, const std::vector<a_real>& ul,
+                                       const std::vector<a_real>& ur, const std::vector<a_real>& n,
+                                       std::vector<a_real>& dfdl, std::vector<a_real>& dfdr)
+{
+	const int npts = static_cast<int>(n.size()/2);
+	const a_real h = 1e-6;
+	std::vector<a_real> fp(4*npts), fm(4*npts);
+	for(int side = 0; side < 2; side++)
+		for(int j = 0; j < 4; j++)
+		{
+			std::vector<a_real> up = side == 0 ? ul : ur, um = up;
+			for(int ip = 0; ip < npts; ip++) {
+				up[j*npts+ip] += h;
+				um[j*npts+ip] -= h;
+			}
+			nf.get_fluxes(npts, side == 0 ? &up[0] : &ul[0], side == 0 ? &ur[0] : &up[0], &n[0], &fp[0]);
+			nf.get_fluxes(npts, side == 0 ? &um[0] : &ul[0], side == 0 ? &ur[0] : &um[0], &n[0], &fm[0]);
+			std::vector<a_real>& dfdu = side == 0 ? dfdl : dfdr;
+			for(int i = 0; i < 4; i++)
+				for(int ip = 0; ip < npts; ip++)
+					dfdu[(i*4+j)*npts+ip] = (fp[i*npts+ip] - fm[i*npts+ip])/(2*h);
+		}
+}
+
+/// Pressure, speed of sound and normal velocity of a state, stored with stride 1
+static void primitives(const a_real g, const a_real *const u, const a_real *const n, a_real& p,
+                       a_real& c, a_real& vn)
+{
+	p = (g-1)*(u[3] - 0.5*(u[1]*u[1] + u[2]*u[2])/u[0]);
+	c = std::sqrt(g*p/u[0]);
+	vn = (u[1]*n[0] + u[2]*n[1])/u[0];
+}
+
+/// Physical normal flux of a state, stored with stride 1
+static void physicalFlux(const a_real *const u, const a_real p, const a_real vn,
+                         const a_real *const n, a_real *const f)
+{
+	f[0] = u[0]*vn;
+	f[1] = vn*u[1] + p*n[0];
+	f[2] = vn*u[2] + p*n[1];
+	f[3] = vn*(u[3] + p);
+}
+
+/// Reference local Lax-Friedrichs flux at one point
+static void referenceLLF(const a_real g, const a_real *const ul, const a_real *const ur,
+                         const a_real *const n, a_real *const flux)
+{
+	a_real pi, ci, vni, pj, cj, vnj, fi[4], fj[4];
+	primitives(g, ul, n, pi, ci, vni);
+	primitives(g, ur, n, pj, cj, vnj);
+	physicalFlux(ul, pi, vni, n, fi);
+	physicalFlux(ur, pj, vnj, n, fj);
+	a_real eig = std::fabs(vni) + ci;
+	if(std::fabs(vnj) + cj > eig)
+		eig = std::fabs(vnj) + cj;
+	for(int i = 0; i < 4; i++)
+		flux[i] = 0.5*(fi[i] + fj[i] - eig*(ur[i]-ul[i]));
+}
+
+/// Reference Van Leer flux at one point
+static void referenceVanLeer(const a_real g, const a_real *const ul, const a_real *const ur,
+                             const a_real *const n, a_real *const flux)
+{
+	a_real pi, ci, vni, pj, cj, vnj, fplus[4], fminus[4];
+	primitives(g, ul, n, pi, ci, vni);
+	primitives(g, ur, n, pj, cj, vnj);
+	const a_real Mni = vni/ci, Mnj = vnj/cj;
+
+	if(Mni < -1.0)
+		for(int i = 0; i < 4; i++)
+			fplus[i] = 0;
+	else if(Mni > 1.0)
+		physicalFlux(ul, pi, vni, n, fplus);
+	else {
+		const a_real vmags = (ul[1]*ul[1] + ul[2]*ul[2])/(ul[0]*ul[0]);
+		fplus[0] = ul[0]*ci*(Mni+1)*(Mni+1)/4.0;
+		fplus[1] = fplus[0]*(ul[1]/ul[0] + n[0]*(2.0*ci - vni)/g);
+		fplus[2] = fplus[0]*(ul[2]/ul[0] + n[1]*(2.0*ci - vni)/g);
+		fplus[3] = fplus[0]*((vmags - vni*vni)/2.0 + std::pow((g-1)*vni+2*ci, 2)/(2*(g*g-1)));
+	}
+
+	if(Mnj > 1.0)
+		for(int i = 0; i < 4; i++)
+			fminus[i] = 0;
+	else if(Mnj < -1.0)
+		physicalFlux(ur, pj, vnj, n, fminus);
+	else {
+		const a_real vmags = (ur[1]*ur[1] + ur[2]*ur[2])/(ur[0]*ur[0]);
+		fminus[0] = -ur[0]*cj*(Mnj-1)*(Mnj-1)/4.0;
+		fminus[1] = fminus[0]*(ur[1]/ur[0] + n[0]*(-2.0*cj - vnj)/g);
+		fminus[2] = fminus[0]*(ur[2]/ur[0] + n[1]*(-2.0*cj - vnj)/g);
+		fminus[3] = fminus[0]*((vmags - vnj*vnj)/2.0 + std::pow((g-1)*vnj-2*cj, 2)/(2*(g*g-1)));
+	}
+
+	for(int i = 0; i < 4; i++)
+		flux[i] = fplus[i] + fminus[i];
+}
+
+/// Roe-averaged normal velocity, speed of sound, velocity, enthalpy and density
+static void roeAverages(const a_real g, const a_real *const ul, const a_real *const ur,
+                        const a_real *const n, a_real& vn, a_real& c, a_real& vx, a_real& vy,
+                        a_real& H, a_real& rho)
+{
+	const a_real pi = (g-1)*(ul[3] - 0.5*(ul[1]*ul[1] + ul[2]*ul[2])/ul[0]);
+	const a_real pj = (g-1)*(ur[3] - 0.5*(ur[1]*ur[1] + ur[2]*ur[2])/ur[0]);
+	const a_real Hi = (ul[3] + pi)/ul[0], Hj = (ur[3] + pj)/ur[0];
+	const a_real R = std::sqrt(ur[0]/ul[0]);
+	rho = R*ul[0];
+	vx = (R*ur[1]/ur[0] + ul[1]/ul[0])/(R+1);
+	vy = (R*ur[2]/ur[0] + ul[2]/ul[0])/(R+1);
+	H = (R*Hj + Hi)/(R+1);
+	vn = vx*n[0] + vy*n[1];
+	c = std::sqrt((g-1)*(H - 0.5*(vx*vx + vy*vy)));
+}
+
+/// Reference Roe flux at one point, with the Harten-Hyman entropy fix
+static void referenceRoe(const a_real g, const a_real *const ul, const a_real *const ur,
+                         const a_real *const n, a_real *const flux)
+{
+	a_real pi, ci, vni, pj, cj, vnj, fi[4], fj[4];
+	primitives(g, ul, n, pi, ci, vni);
+	primitives(g, ur, n, pj, cj, vnj);
+	physicalFlux(ul, pi, vni, n, fi);
+	physicalFlux(ur, pj, vnj, n, fj);
+	a_real vn, c, vx, vy, H, rho;
+	roeAverages(g, ul, ur, n, vn, c, vx, vy, H, rho);
+
+	// eigenvalue magnitudes, and the left and right characteristic speeds for the entropy fix
+	const a_real l[] = {vn, vn + c, vn - c};
+	const a_real li[] = {vni, vni + ci, vni - ci};
+	const a_real lj[] = {vnj, vnj + cj, vnj - cj};
+	a_real al[3];
+	for(int k = 0; k < 3; k++) {
+		a_real eps = 0;
+		if(eps < l[k]-li[k]) eps = l[k]-li[k];
+		if(eps < lj[k]-l[k]) eps = lj[k]-l[k];
+		al[k] = std::fabs(l[k]);
+		if(al[k] < eps) al[k] = eps;
+	}
+
+	// right eigenvectors as columns, and the wave strengths
+	const a_real r[4][4] = {
+		{1.0, 0, 1.0, 1.0},
+		{vx, rho*n[1], vx + c*n[0], vx - c*n[0]},
+		{vy, -rho*n[0], vy + c*n[1], vy - c*n[1]},
+		{0.5*(vx*vx+vy*vy), rho*(vx*n[1]-vy*n[0]), H + c*vn, H - c*vn} };
+	const a_real dvn = vnj - vni;
+	const a_real dvt = (ur[1]/ur[0]-ul[1]/ul[0])*n[1] - (ur[2]/ur[0]-ul[2]/ul[0])*n[0];
+	const a_real dw[] = {(ur[0]-ul[0]) - (pj-pi)/(c*c), dvt,
+	                     (dvn + (pj-pi)/(rho*c))*rho/(2*c), (-dvn + (pj-pi)/(rho*c))*rho/(2*c)};
+	const a_real alw[] = {al[0], al[0], al[1], al[2]};
+
+	for(int i = 0; i < 4; i++) {
+		a_real sum = 0;
+		for(int k = 0; k < 4; k++)
+			sum += alw[k]*dw[k]*r[i][k];
+		flux[i] = 0.5*(fi[i] + fj[i] - sum);
+	}
+}
+
+/// Reference HLLC flux at one point
+static void referenceHLLC(const a_real g, const a_real *const ul, const a_real *const ur,
+                          const a_real *const n, a_real *const flux)
+{
+	a_real pi, ci, vni, pj, cj, vnj;
+	primitives(g, ul, n, pi, ci, vni);
+	primitives(g, ur, n, pj, cj, vnj);
+	a_real vn, c, vx, vy, H, rho;
+	roeAverages(g, ul, ur, n, vn, c, vx, vy, H, rho);
+
+	a_real sl = vni - ci, sr = vnj + cj;
+	if(sl > vn - c) sl = vn - c;
+	if(sr < vn + c) sr = vn + c;
+	const a_real sm = (ur[0]*vnj*(sr-vnj) - ul[0]*vni*(sl-vni) + pi-pj)
+		/ (ur[0]*(sr-vnj) - ul[0]*(sl-vni));
+
+	if(sl > 0)
+		physicalFlux(ul, pi, vni, n, flux);
+	else if(sm > 0) {
+		physicalFlux(ul, pi, vni, n, flux);
+		const a_real pstar = ul[0]*(vni-sl)*(vni-sm) + pi;
+		const a_real ustar[] = {ul[0]*(sl-vni)/(sl-sm),
+		                        ((sl-vni)*ul[1] + (pstar-pi)*n[0])/(sl-sm),
+		                        ((sl-vni)*ul[2] + (pstar-pi)*n[1])/(sl-sm),
+		                        ((sl-vni)*ul[3] - pi*vni + pstar*sm)/(sl-sm)};
+		for(int i = 0; i < 4; i++)
+			flux[i] += sl*(ustar[i] - ul[i]);
+	}
+	else if(sr >= 0) {
+		physicalFlux(ur, pj, vnj, n, flux);
+		const a_real pstar = ur[0]*(vnj-sr)*(vnj-sm) + pj;
+		const a_real ustar[] = {ur[0]*(sr-vnj)/(sr-sm),
+		                        ((sr-vnj)*ur[1] + (pstar-pj)*n[0])/(sr-sm),
+		                        ((sr-vnj)*ur[2] + (pstar-pj)*n[1])/(sr-sm),
+		                        ((sr-vnj)*ur[3] - pj*vnj + pstar*sm)/(sr-sm)};
+		for(int i = 0; i < 4; i++)
+			flux[i] += sr*(ustar[i] - ur[i]);
+	}
+	else
+		physicalFlux(ur, pj, vnj, n, flux);
+}
+
+typedef void (*ReferenceFlux)(const a_real, const a_real *const, const a_real *const,
+                              const a_real *const, a_real *const);
+
+/// Fluxes at all points by a reference implementation, one point at a time
+static void referenceFluxes(const ReferenceFlux ref, const std::vector<a_real>& ul,
+                            const std::vector<a_real>& ur, const std::vector<a_real>& n,
+                            std::vector<a_real>& flux)
+{
+	const int npts = static_cast<int>(n.size()/2);
+	for(int ip = 0; ip < npts; ip++) {
+		a_real uli[4], uri[4], fi[4];
+		for(int k = 0; k < 4; k++) { uli[k] = ul[k*npts+ip]; uri[k] = ur[k*npts+ip]; }
+		const a_real ni[] = {n[ip], n[npts+ip]};
+		ref(adiabaticindex, uli, uri, ni, fi);
+		for(int k = 0; k < 4; k++)
+			flux[k*npts+ip] = fi[k];
+	}
+}
+
+int main()
+{
+	const int npts = 37;
+	const a_real tol = 1e-12;
+	std::vector<a_real> ul(4*npts), ur(4*npts), n(2*npts), mn(2*npts);
+	std::vector<a_real> flux(4*npts), flux2(4*npts), phys(4*npts);
+	std::srand(1);
+	for(int ip = 0; ip < npts; ip++) {
+		randomState(-1.5, 1.5, &ul[0], npts, ip);
+		randomState(-1.5, 1.5, &ur[0], npts, ip);
+		const a_real theta = 2*PI*std::rand()/(a_real)RAND_MAX;
+		n[ip] = std::cos(theta); n[npts+ip] = std::sin(theta);
+		mn[ip] = -n[ip]; mn[npts+ip] = -n[npts+ip];
+	}
+
+	// states with normal Mach numbers of either sign from well below to well above 1
+	std::vector<a_real> wul(4*npts), wur(4*npts);
+	for(int ip = 0; ip < npts; ip++) {
+		randomState(-4.0, 4.0, &wul[0], npts, ip);
+		randomState(-4.0, 4.0, &wur[0], npts, ip);
+	}
+
+	const EulerPDE pde(adiabaticindex);
+	LocalLaxFriedrichsFlux llf(adiabaticindex);
+	VanLeerFlux vl(adiabaticindex);
+	RoeFlux roe(adiabaticindex);
+	HLLCFlux hllc(adiabaticindex);
+	const InviscidNumericalFlux *const fluxes[] = {&llf, &vl, &roe, &hllc};
+	const char *const names[] = {"LLF", "Van Leer", "Roe", "HLLC"};
+	const ReferenceFlux references[] = {referenceLLF, referenceVanLeer, referenceRoe, referenceHLLC};
+
+	int nfail = 0;
+	for(int iflux = 0; iflux < 4; iflux++)
+	{
+		const InviscidNumericalFlux& nf = *fluxes[iflux];
+
+		// batch versus the point-by-point reference
+		nf.get_fluxes(npts, &ul[0], &ur[0], &n[0], &flux[0]);
+		referenceFluxes(references[iflux], ul, ur, n, flux2);
+		a_real dbatch = maxdiff(flux, flux2);
+
+		// conservation
+		nf.get_fluxes(npts, &ur[0], &ul[0], &mn[0], &flux2[0]);
+		for(size_t i = 0; i < flux2.size(); i++)
+			flux2[i] = -flux2[i];
+		const a_real dcons = maxdiff(flux, flux2);
+
+		// consistency
+		nf.get_fluxes(npts, &ul[0], &ul[0], &n[0], &flux[0]);
+		pde.normalConvFlux(npts, &ul[0], &n[0], &phys[0]);
+		const a_real dconsist = maxdiff(flux, phys);
+
+		nf.get_fluxes(npts, &wul[0], &wur[0], &n[0], &flux[0]);
+		referenceFluxes(references[iflux], wul, wur, n, flux2);
+		dbatch = std::fmax(dbatch, maxdiff(flux, flux2));
+
+		std::printf("%-9s: batch %.2e, conservation %.2e, consistency %.2e\n", names[iflux],
+		            dbatch, dcons, dconsist);
+		if(dbatch > tol || dcons > tol || dconsist > tol) {
+			std::printf("! %s flux failed!\n", names[iflux]);
+			nfail++;
+		}
+	}
+
+	const a_real jtol = 1e-6;
+	std::vector<a_real> dfdl(16*npts), dfdr(16*npts), fdl(16*npts), fdr(16*npts);
+	for(int iflux = 0; iflux < 4; iflux++)
+	{
+		const InviscidNumericalFlux& nf = *fluxes[iflux];
+		nf.get_jacobians(npts, &ul[0], &ur[0], &n[0], &dfdl[0], &dfdr[0]);
+		centralDifferenceJacobians(nf, ul, ur, n, fdl, fdr);
+		const a_real djac = std::fmax(maxdiff(dfdl, fdl), maxdiff(dfdr, fdr));
+		std::printf("%-9s: Jacobians %.2e\n", names[iflux], djac);
+		if(!(djac <= jtol)) {
+			std::printf("! %s flux Jacobians failed!\n", names[iflux]);
+			nfail++;
+		}
+	}
+
+	// supersonic flow from left to right along n = (1,0), with tangential jumps
+	for(int ip = 0; ip < npts; ip++) {
+		randomState(2.5, 3.5, &ul[0], npts, ip);
+		randomState(2.5, 3.5, &ur[0], npts, ip);
+		n[ip] = 1.0; n[npts+ip] = 0.0;
+	}
+	pde.normalConvFlux(npts, &ul[0], &n[0], &phys[0]);
+	for(int iflux = 1; iflux < 4; iflux++) {
+		fluxes[iflux]->get_fluxes(npts, &ul[0], &ur[0], &n[0], &flux[0]);
+		const a_real dup = maxdiff(flux, phys);
+		std::printf("%-9s: supersonic upwinding %.2e\n", names[iflux], dup);
+		if(dup > tol) {
+			std::printf("! %s flux is not upwind!\n", names[iflux]);
+			nfail++;
+		}
+	}
+
+	return nfail;
+}
@@ -0,0 +1,148 @@
+/** \file testbernstein.cpp
+ * \brief Unit test for Bernstein elements: degree elevation, domain points and sum factorization
+ *
+ * On a triangle and a quadrilateral, for degrees up to 5, checks that
+ *  - the coefficients from \ref elevateBernsteinDegree give the same function in the basis of
+ *    one degree higher, at the quadrature points,
+ *  - the domain points reproduce linear functions, ie., the sum of the basis functions weighted
+ *    by their domain points is the reference coordinate,
+ *  - the domain point of the vertex DOF of each vertex is that vertex,
+ *  - with the collapsed rule on the triangle and the Gauss rule on the quad, for degrees 1 to 5,
+ *    the sum-factorized evaluation, integration against the basis functions and integration
+ *    against their reference gradients agree with products with the dense tables.
+ * No mesh file is needed.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "fem/aquadrature.hpp"
+#include "fem/abernstein.hpp"
+
+using namespace tadgens;
+
+int main()
+{
+	const a_real tol = 10*SMALL_NUMBER;
+	const int maxdeg = 5, nvars = 2;
+
+	Quadrature2DTriangle triquad;
+	triquad.initialize(4);
+	Quadrature2DSquare quadquad;
+	quadquad.initialize(4);
+	const Quadrature2D *const quads[] = {&triquad, &quadquad};
+	const char *const names[] = {"triangle", "quad"};
+
+	Matrix trinodes(NDIM,3), quadnodes(NDIM,4);
+	trinodes << 0.0, 1.0, 0.3,
+	            0.0, 0.2, 1.0;
+	quadnodes << 0.0, 1.0, 1.2, 0.1,
+	             0.0, 0.2, 1.0, 0.9;
+	const Matrix *const nodes[] = {&trinodes, &quadnodes};
+	const a_real trivert[][NDIM] = {{0,0}, {1,0}, {0,1}, {0,0}};
+	const a_real quadvert[][NDIM] = {{-1,-1}, {1,-1}, {1,1}, {-1,1}};
+
+	std::srand(1);
+	int nfail = 0;
+	for(int ishape = 0; ishape < 2; ishape++)
+	{
+		const Matrix& gp = quads[ishape]->points();
+		const int nverts = ishape == 0 ? 3 : 4;
+		const a_real (*const verts)[NDIM] = ishape == 0 ? trivert : quadvert;
+
+		for(int degree = 0; degree <= maxdeg; degree++)
+		{
+			LagrangeMapping2D map;
+			map.setAll(1, *nodes[ishape], quads[ishape]);
+			BernsteinElement elem, elevelem;
+			elem.initialize(degree, &map);
+			elevelem.initialize(degree+1, &map);
+
+			// elevation
+			const Matrix dofs = Matrix::Random(nvars, elem.getNumDOFs());
+			Matrix elevated;
+			elevateBernsteinDegree(quads[ishape]->getShape(), degree, dofs, elevated);
+			Matrix vals(gp.rows(), elem.getNumDOFs()), elevvals(gp.rows(), elevelem.getNumDOFs());
+			elem.computeBasis(gp, vals);
+			elevelem.computeBasis(gp, elevvals);
+			a_real eerr = std::fabs(elevated.cols() - elevelem.getNumDOFs());
+			if(eerr == 0)
+				eerr = (vals*dofs.transpose() - elevvals*elevated.transpose()).cwiseAbs().maxCoeff();
+
+			// domain points; degree 0 has no meaningful ones
+			a_real derr = 0;
+			if(degree > 0) {
+				const Matrix dpoints = elem.getDomainPoints();
+				derr = (vals*dpoints - gp).cwiseAbs().maxCoeff();
+				for(int iv = 0; iv < nverts; iv++)
+					for(int idim = 0; idim < NDIM; idim++)
+						derr = std::fmax(derr, std::fabs(dpoints(elem.vertexDOF(iv),idim)
+						                                 - verts[iv][idim]));
+			}
+
+			std::printf("P%d Bernstein %s: elevation %.2e, domain points %.2e\n", degree,
+			            names[ishape], eerr, derr);
+			if(eerr > tol || derr > tol) {
+				std::printf("! P%d Bernstein %s failed!\n", degree, names[ishape]);
+				nfail++;
+			}
+		}
+	}
+
+	// sum factorization against the dense reference basis and gradients
+	for(int ishape = 0; ishape < 2; ishape++)
+		for(int degree = 1; degree <= maxdeg; degree++)
+		{
+			Quadrature2DTriangleCollapsed tquad;
+			Quadrature2DSquare squad;
+			Quadrature2D *const quad = ishape == 0 ? static_cast<Quadrature2D*>(&tquad)
+				: static_cast<Quadrature2D*>(&squad);
+			quad->initialize(2*degree);
+			const int ng = quad->numGauss();
+
+			BernsteinTables tab;
+			const bool tensor = computeBernsteinTables(quad, degree, tab);
+			assert(tensor);
+			BasisSet bset;
+			computeBernsteinReferenceBasisSet(quad, degree, bset);
+			const Matrix& basis = bset.basis[0];
+			const int ndof = static_cast<int>(basis.cols());
+
+			LagrangeMapping2D map;
+			map.setAll(1, *nodes[ishape], quad);
+			BernsteinElement elem;
+			elem.setTables(&tab);
+			elem.initialize(degree, &map);
+			assert(elem.hasTables());
+
+			const Matrix dofs = Matrix::Random(nvars, ndof);
+			const Matrix g = Matrix::Random(ng, nvars), gx = Matrix::Random(ng, nvars),
+				gy = Matrix::Random(ng, nvars);
+
+			Matrix vals(ng, nvars);
+			elem.evaluate(dofs, vals);
+			const a_real verr = (vals - basis*dofs.transpose()).cwiseAbs().maxCoeff();
+
+			Matrix mom = Matrix::Zero(nvars, ndof);
+			elem.addMoments(g, mom);
+			const a_real merr = (mom - g.transpose()*basis).cwiseAbs().maxCoeff();
+
+			Matrix gmom = Matrix::Zero(nvars, ndof), gref = Matrix::Zero(nvars, ndof);
+			elem.addGradientMoments(gx, gy, gmom);
+			for(int ig = 0; ig < ng; ig++)
+				gref += gx.row(ig).transpose()*bset.basisGrad[0][ig].col(0).transpose()
+					+ gy.row(ig).transpose()*bset.basisGrad[0][ig].col(1).transpose();
+			const a_real gerr = (gmom - gref).cwiseAbs().maxCoeff()/gref.cwiseAbs().maxCoeff();
+
+			std::printf("P%d Bernstein %s, %d points: evaluation %.2e, moments %.2e, gradient moments %.2e\n",
+			            degree, names[ishape], ng, verr, merr, gerr);
+			if(verr > tol || merr > tol || gerr > tol) {
+				std::printf("! P%d Bernstein %s sum factorization failed!\n", degree, names[ishape]);
+				nfail++;
+			}
+		}
+
+	return nfail;
+}
@@ -56,7 +56,7 @@ int main()
 		assert(fabs(map.map()(ig,0)-qc(ig,0)) <= 10*SMALL_NUMBER
 		       || fabs(map.map()(ig,1)-qc(ig,1)) <= 10*SMALL_NUMBER);
 		printf("Test passed at phy coords of domain quadrature points.\n");
-		cout << map.jacDet()[ig] << ".  ";
+		cout << map.jacDet(ig) << ".  ";
 	}
 	cout << endl;
 
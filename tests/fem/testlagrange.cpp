@@ -0,0 +1,133 @@
+/** \file testlagrange.cpp
+ * \brief Unit test for Lagrange basis functions on triangles and quadrilaterals
+ *
+ * For degrees 1 to 3, checks that
+ *  - each basis function is 1 at its own reference node and 0 at the others,
+ *  - the basis functions sum to 1 and their reference gradients to 0 at the quadrature points,
+ *  - the reference gradients agree with central differences of the basis functions,
+ *  - all polynomials in reference coordinates of total degree up to p, interpolated at the nodes,
+ *    are reproduced with their gradients at the quadrature points.
+ * Degree 4 is not available and must be rejected. No mesh file is needed.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include "fem/aquadrature.hpp"
+#include "fem/aelements.hpp"
+
+using namespace tadgens;
+
+int main()
+{
+	const a_real tol = 10*SMALL_NUMBER, fdtol = 1e-7, h = 1e-6;
+	Quadrature2DTriangle triquad;
+	triquad.initialize(6);
+	Quadrature2DSquare quadquad;
+	quadquad.initialize(6);
+	const Quadrature2D *const quads[] = {&triquad, &quadquad};
+	const char *const names[] = {"triangle", "quad"};
+
+	Matrix trinodes(NDIM,3), quadnodes(NDIM,4);
+	trinodes << 0.0, 1.0, 0.3,
+	            0.0, 0.2, 1.0;
+	quadnodes << 0.0, 1.0, 1.2, 0.1,
+	             0.0, 0.2, 1.0, 0.9;
+	const Matrix *const nodes[] = {&trinodes, &quadnodes};
+
+	int nfail = 0;
+	for(int ishape = 0; ishape < 2; ishape++)
+	{
+		const int ng = quads[ishape]->numGauss();
+		const Matrix& gp = quads[ishape]->points();
+
+		for(int degree = 1; degree <= 3; degree++)
+		{
+			LagrangeMapping2D map;
+			map.setAll(1, *nodes[ishape], quads[ishape]);
+			LagrangeElement elem;
+			elem.initialize(degree, &map);
+			const int ndof = elem.getNumDOFs();
+			const Matrix refs = elem.getReferenceNodes();
+
+			// Kronecker delta at the nodes
+			Matrix nodalvals(ndof, ndof);
+			elem.computeBasis(refs, nodalvals);
+			const a_real kerr = (nodalvals - Matrix::Identity(ndof,ndof)).cwiseAbs().maxCoeff();
+
+			// partition of unity
+			const std::vector<MatrixDim> ident(ng, MatrixDim::Identity());
+			std::vector<Matrix> refgrads(ng, Matrix(ndof,NDIM));
+			elem.computeBasisGrads(gp, ident, refgrads);
+			Matrix vals(ng, ndof);
+			elem.computeBasis(gp, vals);
+			a_real perr = 0;
+			for(int ig = 0; ig < ng; ig++) {
+				perr = std::fmax(perr, std::fabs(vals.row(ig).sum() - 1.0));
+				for(int idim = 0; idim < NDIM; idim++)
+					perr = std::fmax(perr, std::fabs(refgrads[ig].col(idim).sum()));
+			}
+
+			// reference gradients against central differences
+			a_real gerr = 0;
+			for(int idim = 0; idim < NDIM; idim++) {
+				Matrix pp = gp, pm = gp, vp(ng,ndof), vm(ng,ndof);
+				pp.col(idim).array() += h;
+				pm.col(idim).array() -= h;
+				elem.computeBasis(pp, vp);
+				elem.computeBasis(pm, vm);
+				for(int ig = 0; ig < ng; ig++)
+					for(int idof = 0; idof < ndof; idof++)
+						gerr = std::fmax(gerr, std::fabs((vp(ig,idof)-vm(ig,idof))/(2*h)
+						                                 - refgrads[ig](idof,idim)));
+			}
+
+			// reproduction of polynomials of total degree p in reference coordinates
+			a_real rerr = 0;
+			for(int a = 0; a <= degree; a++)
+				for(int b = 0; a+b <= degree; b++)
+				{
+					Vector dofs(ndof);
+					for(int i = 0; i < ndof; i++)
+						dofs[i] = std::pow(refs(i,0),a)*std::pow(refs(i,1),b);
+					for(int ig = 0; ig < ng; ig++) {
+						const a_real x = gp(ig,0), y = gp(ig,1);
+						const a_real f = std::pow(x,a)*std::pow(y,b);
+						const a_real fx = a > 0 ? a*std::pow(x,a-1)*std::pow(y,b) : 0;
+						const a_real fy = b > 0 ? b*std::pow(x,a)*std::pow(y,b-1) : 0;
+						rerr = std::fmax(rerr, std::fabs(vals.row(ig).dot(dofs) - f));
+						rerr = std::fmax(rerr, std::fabs(refgrads[ig].col(0).dot(dofs) - fx));
+						rerr = std::fmax(rerr, std::fabs(refgrads[ig].col(1).dot(dofs) - fy));
+					}
+				}
+
+			std::printf("P%d Lagrange %s, %d DOFs: nodal %.2e, partition of unity %.2e, "
+			            "gradients %.2e, polynomials %.2e\n", degree, names[ishape], ndof, kerr, perr,
+			            gerr, rerr);
+			if(kerr > tol || perr > tol || gerr > fdtol || rerr > tol) {
+				std::printf("! P%d Lagrange %s basis failed!\n", degree, names[ishape]);
+				nfail++;
+			}
+		}
+	}
+
+	// degree 4 is rejected
+	LagrangeMapping2D map;
+	map.setAll(1, trinodes, &triquad);
+	LagrangeElement elem;
+	bool thrown = false;
+	try {
+		elem.initialize(4, &map);
+	} catch(const std::logic_error&) {
+		thrown = true;
+	}
+	std::printf("P4 Lagrange: %s\n", thrown ? "rejected" : "not rejected");
+	if(!thrown) {
+		std::printf("! P4 Lagrange should have been rejected!\n");
+		nfail++;
+	}
+
+	return nfail;
+}
@@ -0,0 +1,128 @@
+/** \file testserendipity.cpp
+ * \brief Unit test for serendipity basis functions on a parallelogram
+ *
+ * For degrees 2 and 3, checks that
+ *  - each basis function is 1 at its own reference node and 0 at the others,
+ *  - the basis functions sum to 1 and their gradients to 0 at the quadrature points,
+ *  - the reference gradients agree with central differences of the basis functions,
+ *  - all polynomials in physical coordinates of total degree up to p, interpolated at the nodes,
+ *    are reproduced with their gradients at the quadrature points, which holds on parallelograms.
+ * Degree 4 is not available and must be rejected. No mesh file is needed.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include "fem/aquadrature.hpp"
+#include "fem/aelements.hpp"
+
+using namespace tadgens;
+
+int main()
+{
+	const a_real tol = 10*SMALL_NUMBER, fdtol = 1e-7, h = 1e-6;
+	Quadrature2DSquare quad;
+	quad.initialize(8);
+	const int ng = quad.numGauss();
+	const Matrix& gp = quad.points();
+
+	// a parallelogram: the 4th vertex is v0 + (v1-v0) + (v3-v0)
+	Matrix nodes(NDIM,4);
+	nodes << 0.0, 1.0, 1.3, 0.3,
+	         0.0, 0.2, 1.1, 0.9;
+
+	int nfail = 0;
+	for(int degree = 2; degree <= 3; degree++)
+	{
+		LagrangeMapping2D map;
+		map.setAll(1, nodes, &quad);
+		SerendipityElement elem;
+		elem.initialize(degree, &map);
+		const int ndof = elem.getNumDOFs();
+		const Matrix refs = elem.getReferenceNodes();
+
+		// Kronecker delta at the nodes
+		Matrix nodalvals(ndof, ndof);
+		elem.computeBasis(refs, nodalvals);
+		const a_real kerr = (nodalvals - Matrix::Identity(ndof,ndof)).cwiseAbs().maxCoeff();
+
+		// partition of unity
+		a_real perr = 0;
+		for(int ig = 0; ig < ng; ig++) {
+			perr = std::fmax(perr, std::fabs(elem.bFunc().row(ig).sum() - 1.0));
+			for(int idim = 0; idim < NDIM; idim++)
+				perr = std::fmax(perr, std::fabs(elem.bGrad()[ig].col(idim).sum()));
+		}
+
+		// reference gradients against central differences
+		const std::vector<MatrixDim> ident(ng, MatrixDim::Identity());
+		std::vector<Matrix> refgrads(ng, Matrix(ndof,NDIM));
+		elem.computeBasisGrads(gp, ident, refgrads);
+		a_real gerr = 0;
+		for(int idim = 0; idim < NDIM; idim++) {
+			Matrix pp = gp, pm = gp, vp(ng,ndof), vm(ng,ndof);
+			pp.col(idim).array() += h;
+			pm.col(idim).array() -= h;
+			elem.computeBasis(pp, vp);
+			elem.computeBasis(pm, vm);
+			for(int ig = 0; ig < ng; ig++)
+				for(int idof = 0; idof < ndof; idof++)
+					gerr = std::fmax(gerr, std::fabs((vp(ig,idof)-vm(ig,idof))/(2*h)
+					                                 - refgrads[ig](idof,idim)));
+		}
+
+		// reproduction of polynomials of total degree p in physical coordinates
+		Matrix phynodes(ndof,NDIM), phyqp(ng,NDIM);
+		for(int idim = 0; idim < NDIM; idim++) {
+			const a_real e1 = 0.5*(nodes(idim,1)-nodes(idim,0)), e2 = 0.5*(nodes(idim,3)-nodes(idim,0));
+			for(int i = 0; i < ndof; i++)
+				phynodes(i,idim) = nodes(idim,0) + (refs(i,0)+1.0)*e1 + (refs(i,1)+1.0)*e2;
+			for(int ig = 0; ig < ng; ig++)
+				phyqp(ig,idim) = nodes(idim,0) + (gp(ig,0)+1.0)*e1 + (gp(ig,1)+1.0)*e2;
+		}
+		a_real rerr = 0;
+		for(int a = 0; a <= degree; a++)
+			for(int b = 0; a+b <= degree; b++)
+			{
+				Vector dofs(ndof);
+				for(int i = 0; i < ndof; i++)
+					dofs[i] = std::pow(phynodes(i,0),a)*std::pow(phynodes(i,1),b);
+				for(int ig = 0; ig < ng; ig++) {
+					const a_real x = phyqp(ig,0), y = phyqp(ig,1);
+					const a_real f = std::pow(x,a)*std::pow(y,b);
+					const a_real fx = a > 0 ? a*std::pow(x,a-1)*std::pow(y,b) : 0;
+					const a_real fy = b > 0 ? b*std::pow(x,a)*std::pow(y,b-1) : 0;
+					rerr = std::fmax(rerr, std::fabs(elem.bFunc().row(ig).dot(dofs) - f));
+					rerr = std::fmax(rerr, std::fabs(elem.bGrad()[ig].col(0).dot(dofs) - fx));
+					rerr = std::fmax(rerr, std::fabs(elem.bGrad()[ig].col(1).dot(dofs) - fy));
+				}
+			}
+
+		std::printf("P%d serendipity, %d DOFs: nodal %.2e, partition of unity %.2e, "
+		            "gradients %.2e, polynomials %.2e\n", degree, ndof, kerr, perr, gerr, rerr);
+		if(ndof != 4*degree || kerr > tol || perr > tol || gerr > fdtol || rerr > tol) {
+			std::printf("! P%d serendipity basis failed!\n", degree);
+			nfail++;
+		}
+	}
+
+	// degree 4 is rejected
+	LagrangeMapping2D map;
+	map.setAll(1, nodes, &quad);
+	SerendipityElement elem;
+	bool thrown = false;
+	try {
+		elem.initialize(4, &map);
+	} catch(const std::logic_error&) {
+		thrown = true;
+	}
+	std::printf("P4 serendipity: %s\n", thrown ? "rejected" : "not rejected");
+	if(!thrown) {
+		std::printf("! P4 serendipity should have been rejected!\n");
+		nfail++;
+	}
+
+	return nfail;
+}
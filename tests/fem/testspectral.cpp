@@ -0,0 +1,101 @@
+/** \file testspectral.cpp
+ * \brief Unit test for Gauss-Lobatto-Legendre rules and spectral elements of high degree
+ *
+ * Checks that
+ *  - GLL rules with 2 to 10 points include the end points and integrate all monomials of
+ *    degree upto 2n-3 exactly, and that one more degree is not integrated exactly,
+ *  - spectral elements of degrees 5 to 7 on a quadrilateral, with the GLL rule through their
+ *    nodes, are collocated: the nodes are the quadrature points, the basis is the identity there,
+ *    the basis functions sum to 1 and the gradients of an interpolated bilinear function are exact.
+ * Degree 6 and above need more GLL points than the closed-form rules provide.
+ * No mesh file is needed.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cmath>
+#include "fem/aquadrature.hpp"
+#include "fem/aelements.hpp"
+
+using namespace tadgens;
+
+int main()
+{
+	const a_real tol = 10*SMALL_NUMBER;
+	int nfail = 0;
+
+	for(int npoin = 2; npoin <= 10; npoin++)
+	{
+		Quadrature1DGLL gll;
+		gll.initialize(2*npoin-3);
+		const Matrix& gp = gll.points();
+		const amat::Array2d<a_real>& gw = gll.weights();
+
+		// monomials of odd degree integrate to 0, those of even degree k to 2/(k+1)
+		a_real err = 0, nexterr = 0;
+		for(int k = 0; k <= 2*npoin-2; k++) {
+			a_real integral = 0;
+			for(int i = 0; i < gll.numGauss(); i++)
+				integral += std::pow(gp(i,0),k)*gw(i);
+			const a_real e = std::fabs(integral - (k % 2 == 0 ? 2.0/(k+1) : 0.0));
+			if(k <= 2*npoin-3)
+				err = std::fmax(err, e);
+			else
+				nexterr = e;
+		}
+		err = std::fmax(err, std::fmax(std::fabs(gp(0,0)+1.0), std::fabs(gp(npoin-1,0)-1.0)));
+
+		std::printf("GLL rule, %2d points: error %.2e, error at degree %d %.2e\n", gll.numGauss(),
+		            err, 2*npoin-2, nexterr);
+		if(gll.numGauss() != npoin || err > tol || nexterr < 1e-8) {
+			std::printf("! GLL rule with %d points failed!\n", npoin);
+			nfail++;
+		}
+	}
+
+	Matrix nodes(NDIM,4);
+	nodes << 0.0, 1.0, 1.2, 0.1,
+	         0.0, 0.2, 1.0, 0.9;
+	for(int degree = 5; degree <= 7; degree++)
+	{
+		Quadrature2DSquareGLL quad;
+		quad.initialize(2*degree-1);
+		LagrangeMapping2D map;
+		map.setAll(1, nodes, &quad);
+		SpectralElement elem;
+		elem.initialize(degree, &map);
+		const int ndof = elem.getNumDOFs(), ng = quad.numGauss();
+
+		const a_real nerr = (elem.getReferenceNodes() - quad.points()).cwiseAbs().maxCoeff();
+		Matrix nodalvals(ndof,ndof);
+		elem.computeBasis(quad.points(), nodalvals);
+		a_real berr = (nodalvals - Matrix::Identity(ndof,ndof)).cwiseAbs().maxCoeff();
+
+		// a bilinear function of the reference coordinates is in the space; its physical
+		// gradient follows from the reference gradient through the inverse Jacobian
+		const Matrix& refs = elem.getReferenceNodes();
+		Vector dofs(ndof);
+		for(int i = 0; i < ndof; i++)
+			dofs[i] = 1.0 + 2.0*refs(i,0) - refs(i,1) + 0.5*refs(i,0)*refs(i,1);
+		Matrix pts(1,NDIM);
+		pts << 0.3, -0.7;
+		Matrix vals(1,ndof);
+		elem.computeBasis(pts, vals);
+		berr = std::fmax(berr, std::fabs(vals.row(0).sum() - 1.0));
+		const std::vector<MatrixDim> ident(1, MatrixDim::Identity());
+		std::vector<Matrix> grads(1, Matrix(ndof,NDIM));
+		elem.computeBasisGrads(pts, ident, grads);
+		const a_real gerr = std::fmax(std::fabs(grads[0].col(0).dot(dofs) - (2.0 + 0.5*pts(0,1))),
+		                              std::fabs(grads[0].col(1).dot(dofs) - (-1.0 + 0.5*pts(0,0))));
+
+		std::printf("P%d spectral element, %d points: collocated %d, nodes %.2e, basis %.2e, "
+		            "gradients %.2e\n", degree, ng, elem.isCollocated(), nerr, berr, gerr);
+		if(ng != ndof || !elem.isCollocated() || nerr > tol || berr > tol || gerr > tol) {
+			std::printf("! P%d spectral element failed!\n", degree);
+			nfail++;
+		}
+	}
+
+	return nfail;
+}
@@ -0,0 +1,183 @@
+/** \file testtaylorbasis.cpp
+ * \brief Unit test for Taylor basis functions on straight-sided triangles
+ *
+ * For a skewed triangle, checks that
+ *  - the basis functions and their gradients at the quadrature points agree with the Taylor
+ *    polynomials (x-xc)/dx, (y-yc)/dy, and their quadratic products less the offsets,
+ *  - all basis functions except the first have zero mean over the element, for P1 and P2,
+ *  - the orthonormalized P2 basis is orthonormal and maps back to the Taylor basis,
+ *  - with a 3-point rule, in whose inner product the P2 basis is linearly dependent,
+ *    orthonormalization is abandoned and the Taylor basis is kept.
+ *  - batched initialization of several elements, and batched evaluation of their basis functions
+ *    at shared points, give the same results as element-by-element initialization and evaluation.
+ * No mesh file is needed.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cmath>
+#include "fem/aquadrature.hpp"
+#include "fem/aelements.hpp"
+
+using namespace tadgens;
+
+int main()
+{
+	const a_real tol = 10*SMALL_NUMBER;
+	Quadrature2DTriangle quad;
+	quad.initialize(4);
+	const int ng = quad.numGauss();
+	const amat::Array2d<a_real>& gw = quad.weights();
+
+	Matrix nodes(NDIM,3);
+	nodes << 0.0, 1.0, 0.3,
+	         0.0, 0.2, 1.0;
+
+	int nfail = 0;
+	for(int degree = 1; degree <= 2; degree++)
+	{
+		LagrangeMapping2D map;
+		map.setAll(1, nodes, &quad);
+		TaylorElement elem;
+		elem.initialize(degree, &map);
+		const Matrix& gp = map.map();
+		const a_real *const c = elem.getCenter();
+		const a_real *const d = elem.getDelta();
+
+		// values and gradients against the Taylor polynomials
+		a_real derr = 0;
+		for(int ig = 0; ig < ng; ig++)
+		{
+			const a_real X = (gp(ig,0)-c[0])/d[0], Y = (gp(ig,1)-c[1])/d[1];
+			a_real vals[] = {1.0, X, Y, 0, 0, 0};
+			a_real grads[][NDIM] = {{0,0}, {1.0/d[0], 0}, {0, 1.0/d[1]}, {0,0}, {0,0}, {0,0}};
+			if(degree >= 2) {
+				const std::vector<a_real>& off = elem.getBasisOffsets()[0];
+				vals[3] = 0.5*X*X - off[0]; vals[4] = X*Y - off[1]; vals[5] = 0.5*Y*Y - off[2];
+				grads[3][0] = X/d[0]; grads[4][0] = Y/d[0]; grads[4][1] = X/d[1]; grads[5][1] = Y/d[1];
+			}
+			for(int idof = 0; idof < elem.getNumDOFs(); idof++) {
+				derr = std::fmax(derr, std::fabs(elem.bFunc()(ig,idof) - vals[idof]));
+				for(int idim = 0; idim < NDIM; idim++)
+					derr = std::fmax(derr, std::fabs(elem.bGrad()[ig](idof,idim) - grads[idof][idim]));
+			}
+		}
+
+		// means over the element
+		a_real merr = 0;
+		for(int idof = 1; idof < elem.getNumDOFs(); idof++) {
+			a_real mean = 0;
+			for(int ig = 0; ig < ng; ig++)
+				mean += elem.bFunc()(ig,idof) * map.jacDet(ig) * gw(ig);
+			merr = std::fmax(merr, std::fabs(mean));
+		}
+
+		std::printf("P%d Taylor basis: values and gradients %.2e, means %.2e\n", degree, derr, merr);
+		if(derr > tol || merr > tol) {
+			std::printf("! P%d Taylor basis failed!\n", degree);
+			nfail++;
+		}
+	}
+
+	// orthonormalization, and its failure with too few quadrature points
+	Quadrature2DTriangle lowquad;
+	lowquad.initialize(2);
+	const Quadrature2DTriangle *const quads[] = {&quad, &lowquad};
+	for(int iq = 0; iq < 2; iq++)
+	{
+		const int nq = quads[iq]->numGauss();
+		const amat::Array2d<a_real>& qw = quads[iq]->weights();
+		LagrangeMapping2D map;
+		map.setAll(1, nodes, quads[iq]);
+		TaylorElement plain, ortho;
+		plain.initialize(2, &map);
+		ortho.setOrthonormalize(true);
+		ortho.initialize(2, &map);
+		const int ndof = ortho.getNumDOFs();
+
+		a_real err = 0;
+		if(iq == 0) {
+			// the mass matrix is the identity, and the Taylor coefficients give the same function
+			Matrix mass = Matrix::Zero(ndof,ndof);
+			for(int ig = 0; ig < nq; ig++)
+				mass += ortho.bFunc().row(ig).transpose()*ortho.bFunc().row(ig) * map.jacDet(ig)*qw(ig);
+			err = (mass - Matrix::Identity(ndof,ndof)).cwiseAbs().maxCoeff();
+
+			const Matrix dofs = Matrix::Ones(1,ndof);
+			Matrix coeffs(1,ndof);
+			ortho.getTaylorCoeffs(dofs, coeffs);
+			err = std::fmax(err, (ortho.bFunc()*dofs.transpose()
+			                      - plain.bFunc()*coeffs.transpose()).cwiseAbs().maxCoeff());
+		}
+		else
+			err = (ortho.bFunc() - plain.bFunc()).cwiseAbs().maxCoeff();
+
+		const bool expected = iq == 0;
+		std::printf("P2 orthonormalized Taylor basis, %d points: orthonormal %d, error %.2e\n", nq,
+		            ortho.hasOrthonormalBasis(), err);
+		if(ortho.hasOrthonormalBasis() != expected || err > tol) {
+			std::printf("! P2 orthonormalized Taylor basis failed!\n");
+			nfail++;
+		}
+	}
+
+	// batched setup and evaluation against element-by-element, for 3 triangles
+	const int nbatch = 3;
+	std::vector<Matrix> bnodes(nbatch, nodes);
+	bnodes[1].row(0).array() += 0.7;
+	bnodes[2] << 0.0, 2.0, -0.5,
+	             0.0, 0.4, 0.3;
+	Matrix fpoints(2,NDIM);
+	fpoints << 0.1, 0.2,
+	           0.5, -0.3;
+	for(int degree = 1; degree <= 2; degree++)
+		for(int iortho = 0; iortho < 2; iortho++)
+		{
+			std::vector<LagrangeMapping2D> maps(2*nbatch);
+			std::vector<TaylorElement> single(nbatch), batch(nbatch);
+			TaylorElement* belems[nbatch];
+			GeomMapping2D* bmaps[nbatch];
+			for(int ie = 0; ie < nbatch; ie++) {
+				maps[ie].setAll(1, bnodes[ie], &quad);
+				maps[nbatch+ie].setAll(1, bnodes[ie], &quad);
+				single[ie].setOrthonormalize(iortho == 1);
+				single[ie].initialize(degree, &maps[ie]);
+				batch[ie].setOrthonormalize(iortho == 1);
+				belems[ie] = &batch[ie];
+				bmaps[ie] = &maps[nbatch+ie];
+			}
+			TaylorElement::initializeBatch(degree, nbatch, belems, bmaps);
+
+			a_real err = 0;
+			const TaylorElement* celems[nbatch];
+			std::vector<Matrix> fvals(nbatch, Matrix(fpoints.rows(), single[0].getNumDOFs()));
+			Matrix* fdest[nbatch];
+			for(int ie = 0; ie < nbatch; ie++) {
+				err = std::fmax(err, (batch[ie].bFunc() - single[ie].bFunc()).cwiseAbs().maxCoeff());
+				for(int ig = 0; ig < ng; ig++)
+					err = std::fmax(err, (batch[ie].bGrad()[ig] - single[ie].bGrad()[ig]).cwiseAbs().maxCoeff());
+				if(batch[ie].hasOrthonormalBasis() != single[ie].hasOrthonormalBasis())
+					err = 1.0;
+				celems[ie] = &batch[ie];
+				fdest[ie] = &fvals[ie];
+			}
+
+			// at points shared by all elements, as on a face
+			TaylorElement::computeBasisBatch(nbatch, celems, fpoints, fdest);
+			for(int ie = 0; ie < nbatch; ie++) {
+				Matrix fsingle(fpoints.rows(), single[ie].getNumDOFs());
+				single[ie].computeBasis(fpoints, fsingle);
+				err = std::fmax(err, (fvals[ie] - fsingle).cwiseAbs().maxCoeff());
+			}
+
+			std::printf("P%d Taylor basis, batch of %d%s: difference %.2e\n", degree, nbatch,
+			            iortho ? ", orthonormalized" : "", err);
+			if(err > tol) {
+				std::printf("! P%d batched Taylor basis failed!\n", degree);
+				nfail++;
+			}
+		}
+
+	return nfail;
+}
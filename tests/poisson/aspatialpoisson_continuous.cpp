@@ -103,7 +103,7 @@ void LaplaceC::assemble()
 
 		for(int ig = 0; ig < ng; ig++)
 		{
-			const a_real weightAndJDet = wts(ig)*map2d[ielem].jacDet()[ig];
+			const a_real weightAndJDet = wts(ig)*map2d[ielem].jacDet(ig);
 			const a_real qcoords[NDIM] = { quadp(ig,0), quadp(ig,1) };
 
 			for(int i = 0; i < ndofs; i++) 
@@ -236,10 +236,10 @@ void LaplaceC::computeErrors(a_real& __restrict__ l2error, a_real& __restrict__
 				lux += ug(getGlobalDofIdx(ielem,j))*bgrad[ig](j,0);
 				luy += ug(getGlobalDofIdx(ielem,j))*bgrad[ig](j,1);
 			}
-			l2error += std::pow(lu-exact_solution(qcoords,0),2) * wts(ig) * gmap->jacDet()[ig];
+			l2error += std::pow(lu-exact_solution(qcoords,0),2) * wts(ig) * gmap->jacDet(ig);
 			const std::array<a_real,NDIM> ugrad = exact_gradient(qcoords,0);
 			h1error += ( std::pow(lux-ugrad[0],2) +
-			             std::pow(luy-ugrad[1],2) ) * wts(ig)*gmap->jacDet()[ig];
+			             std::pow(luy-ugrad[1],2) ) * wts(ig)*gmap->jacDet(ig);
 		}
 	}
 
@@ -0,0 +1,120 @@
+/** @file testsipoperator.cpp
+ * @brief Checks the assembled symmetric interior penalty operator for the Laplacian
+ *
+ * Usage: testsipoperator <triangular mesh file>
+ *
+ * For P1 Lagrange elements, checks that the block-sparse SIP matrix is symmetric and positive
+ * definite, and that it is consistent: for the harmonic functions 1, x and y, which the basis
+ * represents exactly, the rows of elements away from the boundary of the product of the matrix
+ * with the nodal values vanish. On boundary faces, which carry a homogeneous Dirichlet condition,
+ * the form is checked through a(x,x) = |grad x|^2 |Omega| - 2 int_dOmega x n_x + eta int_dOmega x^2/h
+ * = eta sum_F int_F x^2/h - |Omega|, which is exact for straight faces.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cmath>
+#include <Eigen/Cholesky>
+#include "spatial/aspatialpoisson.hpp"
+
+using namespace tadgens;
+
+/// Gives access to the assembled matrix
+class TestLaplaceSIP : public LaplaceSIP
+{
+public:
+	TestLaplaceSIP(const UMesh2dh* mesh, const int degree, const a_real stab)
+		: LaplaceSIP(mesh, degree, stab)
+	{ }
+
+	const BlockSparseMatrix& matrix() const { return Ag; }
+};
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		std::printf("Usage: %s <mesh file>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+	const a_real tol = 1e-12;
+	int nfail = 0;
+
+	const a_real eta = 10.0;
+	TestLaplaceSIP sd(&m, 1, eta);
+	sd.assemble();
+	const BlockSparseMatrix& a = sd.matrix();
+
+	Eigen::SparseMatrix<a_real> as;
+	a.toSparse(as);
+	const Matrix ad = Matrix(as);
+	const a_real scale = ad.cwiseAbs().maxCoeff();
+
+	const a_real asym = (ad - ad.transpose()).cwiseAbs().maxCoeff()/scale;
+	std::printf("Asymmetry %.2e\n", asym);
+	if(!(asym < tol)) {
+		std::printf("! Not symmetric!\n");
+		nfail++;
+	}
+
+	const Eigen::LLT<Matrix> llt(ad);
+	if(llt.info() != Eigen::Success) {
+		std::printf("! Not positive definite!\n");
+		nfail++;
+	}
+
+	const char *const names[] = {"1", "x", "y"};
+	for(int ifunc = 0; ifunc < 3; ifunc++)
+	{
+		Vector v(a.numRows()), av(a.numRows());
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+			for(int ino = 0; ino < m.gnnode(iel); ino++)
+				v[a.rowStart(iel)+ino] = ifunc == 0 ? 1.0 : m.gcoords(m.ginpoel(iel,ino), ifunc-1);
+		a.apply(v, av);
+
+		a_real err = 0;
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+		{
+			bool boundary = false;
+			for(int ifa = 0; ifa < m.gnfael(iel); ifa++)
+				if(m.gesuel(iel,ifa) >= m.gnelem())
+					boundary = true;
+			if(!boundary)
+				err = std::fmax(err, av.segment(a.rowStart(iel), a.blockSize(iel)).cwiseAbs().maxCoeff());
+		}
+		err /= scale*v.cwiseAbs().maxCoeff();
+
+		std::printf("Consistency for %s: %.2e\n", names[ifunc], err);
+		if(!(err < tol)) {
+			std::printf("! Failed!\n");
+			nfail++;
+		}
+	}
+
+	// a(x,x) from the boundary faces and the area
+	a_real area = 0;
+	for(a_int iel = 0; iel < m.gnelem(); iel++) {
+		const a_int p0 = m.ginpoel(iel,0), p1 = m.ginpoel(iel,1), p2 = m.ginpoel(iel,2);
+		area += 0.5*std::fabs((m.gcoords(p1,0)-m.gcoords(p0,0))*(m.gcoords(p2,1)-m.gcoords(p0,1))
+		                     - (m.gcoords(p2,0)-m.gcoords(p0,0))*(m.gcoords(p1,1)-m.gcoords(p0,1)));
+	}
+	a_real exact = -area;
+	for(a_int iface = 0; iface < m.gnbface(); iface++) {
+		const a_real xa = m.gcoords(m.gintfac(iface,2),0), xb = m.gcoords(m.gintfac(iface,3),0);
+		exact += eta*(xa*xa + xa*xb + xb*xb)/3.0;
+	}
+	Vector x(a.numRows()), ax(a.numRows());
+	for(a_int iel = 0; iel < m.gnelem(); iel++)
+		for(int ino = 0; ino < m.gnnode(iel); ino++)
+			x[a.rowStart(iel)+ino] = m.gcoords(m.ginpoel(iel,ino), 0);
+	a.apply(x, ax);
+	const a_real bdiff = std::fabs(x.dot(ax) - exact)/std::fabs(exact);
+	std::printf("Boundary terms, a(x,x): %.2e\n", bdiff);
+	if(!(bdiff < tol)) {
+		std::printf("! Failed!\n");
+		nfail++;
+	}
+
+	return nfail;
+}
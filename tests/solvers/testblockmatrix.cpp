@@ -0,0 +1,173 @@
+/** @file testblockmatrix.cpp
+ * @brief Checks the operations of block-sparse matrices against dense ones
+ *
+ * Usage: testblockmatrix <mesh file>
+ *
+ * A block-sparse matrix with the pattern of the mesh and random entries is set up, with block sizes
+ * that differ between elements. Its product with a vector is compared with that of its scalar
+ * sparse copy. Its block-diagonal solve and its forward and backward substitutions, sequential and
+ * in multicolor ordering, are compared with dense solves. Asking for a block outside the
+ * pattern must throw.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "solvers/ablockmatrix.hpp"
+
+using namespace tadgens;
+
+namespace {
+
+a_real relativeDifference(const Vector& a, const Vector& b)
+{
+	return (a-b).norm()/b.norm();
+}
+
+int check(const char *const name, const a_real diff, const a_real tol)
+{
+	std::printf("%-40s %.2e\n", name, diff);
+	if(!(diff < tol)) {
+		std::printf("! Failed!\n");
+		return 1;
+	}
+	return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		std::printf("Usage: %s <mesh file>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+	const a_int nelem = m.gnelem();
+	const a_real tol = 1e-12, w = 0.7;
+	int nfail = 0;
+
+	std::vector<int> blocksizes(nelem);
+	for(a_int iel = 0; iel < nelem; iel++)
+		blocksizes[iel] = 2*m.gnfael(iel) + iel%3;
+
+	BlockSparseMatrix a;
+	a.setStructure(&m, blocksizes);
+	std::srand(1);
+	for(a_int i = 0; i < nelem; i++)
+		for(a_int k = a.rowBegin(i); k < a.rowBegin(i+1); k++) {
+			Eigen::Map<Matrix> blk = a.block(i, a.blockColumn(k));
+			for(int ii = 0; ii < blk.rows(); ii++)
+				for(int jj = 0; jj < blk.cols(); jj++)
+					blk(ii,jj) = std::rand()/(a_real)RAND_MAX - 0.5;
+			if(a.blockColumn(k) == i)
+				blk += 4.0*Matrix::Identity(blk.rows(), blk.cols());
+		}
+
+	const a_int n = a.numRows();
+	Vector x(n), b(n), y(n), dx(n);
+	for(a_int i = 0; i < n; i++) {
+		x[i] = std::rand()/(a_real)RAND_MAX - 0.5;
+		b[i] = std::rand()/(a_real)RAND_MAX - 0.5;
+	}
+
+	Eigen::SparseMatrix<a_real> as;
+	a.toSparse(as);
+	a.apply(x, y);
+	nfail += check("Product", relativeDifference(y, as*x), tol);
+
+	// greedy coloring, so that no two face neighbours have the same color
+	std::vector<int> color(nelem);
+	int ncolors = 0;
+	for(a_int iel = 0; iel < nelem; iel++) {
+		int icolor = 0;
+		for(bool taken = true; taken; ) {
+			taken = false;
+			for(int ifa = 0; ifa < m.gnfael(iel); ifa++) {
+				const a_int jel = m.gesuel(iel,ifa);
+				if(jel >= 0 && jel < iel && color[jel] == icolor) {
+					taken = true;
+					icolor++;
+					break;
+				}
+			}
+		}
+		color[iel] = icolor;
+		ncolors = std::max(ncolors, icolor+1);
+	}
+	std::vector<a_int> colorstart(ncolors+1, 0), colorder;
+	for(int icolor = 0; icolor < ncolors; icolor++) {
+		for(a_int iel = 0; iel < nelem; iel++)
+			if(color[iel] == icolor)
+				colorder.push_back(iel);
+		colorstart[icolor+1] = static_cast<a_int>(colorder.size());
+	}
+
+	// dense block diagonal, and lower and upper parts by index and by color
+	const Matrix ad = Matrix(as);
+	Matrix d = Matrix::Zero(n,n), l = Matrix::Zero(n,n), u = Matrix::Zero(n,n);
+	Matrix lc = Matrix::Zero(n,n), uc = Matrix::Zero(n,n);
+	for(a_int i = 0; i < nelem; i++)
+		for(a_int j = 0; j < nelem; j++)
+		{
+			const a_int ri = a.rowStart(i), rj = a.rowStart(j);
+			const int ni = a.blockSize(i), nj = a.blockSize(j);
+			const Matrix blk = ad.block(ri,rj,ni,nj);
+			(j < i ? l : (j > i ? u : d)).block(ri,rj,ni,nj) = blk;
+			if(color[j] < color[i])
+				lc.block(ri,rj,ni,nj) = blk;
+			else if(color[j] > color[i])
+				uc.block(ri,rj,ni,nj) = blk;
+		}
+
+	std::vector<Eigen::PartialPivLU<Matrix>> dlu;
+	a.factorDiagonalBlocks(dlu);
+
+	a.diagonalSolve(dlu, b, y);
+	nfail += check("Block-diagonal solve", relativeDifference(y, d.lu().solve(b)), tol);
+
+	a.lowerSolve(dlu, b, y, w, &dx);
+	nfail += check("Forward substitution", relativeDifference(y, (d+w*l).lu().solve(b)), tol);
+	nfail += check("Forward substitution, D x", relativeDifference(dx, d*y), tol);
+	a.upperSolve(dlu, b, y, w);
+	nfail += check("Backward substitution", relativeDifference(y, (d+w*u).lu().solve(b)), tol);
+
+	a.lowerSolve(dlu, color, colorstart, colorder, b, y, w, &dx);
+	nfail += check("Multicolor forward substitution", relativeDifference(y, (d+w*lc).lu().solve(b)),
+	               tol);
+	nfail += check("Multicolor forward substitution, D x", relativeDifference(dx, d*y), tol);
+	a.upperSolve(dlu, color, colorstart, colorder, b, y, w);
+	nfail += check("Multicolor backward substitution", relativeDifference(y, (d+w*uc).lu().solve(b)),
+	               tol);
+
+	// only the diagonal blocks
+	BlockSparseMatrix ab;
+	ab.setStructure(&m, blocksizes, true);
+	for(a_int i = 0; i < nelem; i++)
+		ab.diagonalBlock(i) = a.diagonalBlock(i);
+	assert(ab.isBlockDiagonal());
+	ab.apply(x, y);
+	nfail += check("Block-diagonal product", relativeDifference(y, d*x), tol);
+
+	// a block outside the pattern is an error
+	bool thrown = false;
+	try {
+		ab.block(0, 1);
+	} catch(const std::logic_error&) {
+		thrown = true;
+	}
+	std::printf("%-40s %s\n", "Missing block", thrown ? "rejected" : "not rejected");
+	if(!thrown) {
+		std::printf("! Failed!\n");
+		nfail++;
+	}
+
+	std::printf("%d elements, %d colors, block sizes %d to %d\n", nelem, ncolors,
+	            *std::min_element(blocksizes.begin(), blocksizes.end()),
+	            *std::max_element(blocksizes.begin(), blocksizes.end()));
+	return nfail;
+}
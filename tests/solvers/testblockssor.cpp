@@ -0,0 +1,132 @@
+/** @file testblockssor.cpp
+ * @brief Checks block SSOR against dense solves with the Jacobian of the Euler equations
+ *
+ * Usage: testblockssor <mesh file with slip walls marked 2 and far-field boundaries marked 4>
+ *
+ * The matrix is that of an implicit pseudo-time step, M/dt + dR/du, at a perturbed free stream.
+ * One application of sequential block SSOR with relaxation factor w is compared with
+ * w(2-w) (D + wU)^{-1} D (D + wL)^{-1} r computed with the dense matrix. Then, block SSOR with
+ * sequential and multicolor ordering is used as a relaxation scheme. Its residual may grow in the
+ * first sweeps, but must decrease in every later sweep and by a large factor overall.
+ */
+
+#undef NDEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "spatial/aspatialeuler.hpp"
+#include "solvers/alinalg.hpp"
+
+using namespace tadgens;
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		std::printf("Usage: %s <mesh file>\n", argv[0]);
+		return -1;
+	}
+	const UMesh2dh m = prepare_mesh(argv[1]);
+
+	const int degrees[] = {0, 1};
+	const a_real cfl = 10.0, tol = 1e-10, relaxtol = 1e-2;
+	const int nsweeps = 30;
+	int nfail = 0;
+
+	for(int icase = 0; icase < 2; icase++)
+	{
+		CompressibleEuler sd(&m, degrees[icase], 'l', 1.4, 0.5, 2.0, "ROE", 2, 4);
+		std::vector<Matrix> u, res;
+		std::vector<a_real> tsl;
+		sd.spatialSetup(u, res, tsl);
+		sd.initializeUnknowns(u);
+
+		std::srand(1);
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+			for(int i = 0; i < u[iel].rows(); i++)
+				for(int j = 0; j < u[iel].cols(); j++)
+					u[iel](i,j) *= 1.0 + 0.05*(std::rand()/(a_real)RAND_MAX - 0.5);
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+			res[iel].setZero();
+		sd.update_residual(u, res, tsl);
+
+		BlockSparseMatrix jac;
+		sd.computeJacobian(u, jac);
+		ElementGeometry egeom;
+		for(a_int iel = 0; iel < m.gnelem(); iel++)
+		{
+			Matrix mass;
+			sd.computeElemMassMatrix(iel, mass, egeom);
+			const int ndofs = static_cast<int>(mass.rows());
+			for(int ivar = 0; ivar < sd.numVars(); ivar++)
+				jac.diagonalBlock(iel).block(ivar*ndofs, ivar*ndofs, ndofs, ndofs)
+					+= mass/(cfl*tsl[iel]);
+		}
+
+		const a_int n = jac.numRows();
+		Vector r(n);
+		for(a_int i = 0; i < n; i++)
+			r[i] = std::rand()/(a_real)RAND_MAX - 0.5;
+
+		// dense block diagonal, lower and upper parts
+		Eigen::SparseMatrix<a_real> as;
+		jac.toSparse(as);
+		const Matrix a = Matrix(as);
+		Matrix d = Matrix::Zero(n,n), l = Matrix::Zero(n,n), up = Matrix::Zero(n,n);
+		for(a_int i = 0; i < m.gnelem(); i++)
+			for(a_int j = 0; j < m.gnelem(); j++)
+			{
+				const a_int ri = jac.rowStart(i), rj = jac.rowStart(j);
+				const int ni = jac.blockSize(i), nj = jac.blockSize(j);
+				Matrix& part = j < i ? l : (j > i ? up : d);
+				part.block(ri,rj,ni,nj) = a.block(ri,rj,ni,nj);
+			}
+
+		const a_real omegas[] = {1.0, 1.4};
+		for(int iw = 0; iw < 2; iw++)
+		{
+			const a_real w = omegas[iw];
+			BlockSSOR ssor(&m, &jac, w, false);
+			ssor.compute();
+			Vector z(n);
+			ssor.apply(r, z);
+
+			const Vector y = Eigen::PartialPivLU<Matrix>(d + w*l).solve(w*(2.0-w)*r);
+			const Vector zref = Eigen::PartialPivLU<Matrix>(d + w*up).solve(d*y);
+			const a_real diff = (z-zref).norm()/zref.norm();
+
+			std::printf("Degree %d, omega %.1f: SSOR vs dense solves %.2e\n", degrees[icase], w,
+			            diff);
+			if(!(diff < tol)) {
+				std::printf("! Failed!\n");
+				nfail++;
+			}
+		}
+
+		for(int multicolor = 0; multicolor < 2; multicolor++)
+		{
+			BlockSSOR ssor(&m, &jac, 1.0, multicolor);
+			ssor.compute();
+			Vector x = Vector::Zero(n), ax(n);
+			a_real relres = 1.0;
+			bool decreasing = true;
+			for(int isweep = 0; isweep < nsweeps; isweep++) {
+				ssor.relax(r, x, 1);
+				jac.apply(x, ax);
+				const a_real newres = (r-ax).norm()/r.norm();
+				if(isweep >= nsweeps/2)
+					decreasing = decreasing && newres < relres;
+				relres = newres;
+			}
+
+			std::printf("Degree %d, %s SSOR: relative residual after %d sweeps %.2e\n",
+			            degrees[icase], multicolor ? "multicolor" : "sequential", nsweeps, relres);
+			if(!decreasing || !(relres < relaxtol)) {
+				std::printf("! Failed!\n");
+				nfail++;
+			}
+		}
+	}
+
+	return nfail;
+}